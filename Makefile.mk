@@ -30,6 +30,7 @@ REL_VER  = $(shell printf `git rev-parse HEAD | cut -c 1-8`_`date +%Y%m%d%H%M%S`
 ifeq ($(MOD),mini)
     CFLAGS  += -O3
     CFLAGS  += -DMINI
+    CFLAGS  += -DLOG_NO_DEBUG
     CFLAGS  += -mcpu=cortex-a7
     CFLAGS  += -mfpu=neon-vfpv4
     CFLAGS  += -I../alsa
@@ -49,6 +50,7 @@ endif
 ifeq ($(MOD),a30)
     CFLAGS  += -O3
     CFLAGS  += -DA30
+    CFLAGS  += -DLOG_NO_DEBUG
     CFLAGS  += -I../alsa
     CFLAGS  += -I../detour
     CFLAGS  += -I../common
@@ -70,7 +72,16 @@ ifeq ($(MOD),ut)
     CFLAGS  += -I../ut/extras/memory/src
     CFLAGS  += -I../ut/extras/fixture/src
     CFLAGS  += -fno-omit-frame-pointer
+    # timings of a sanitizer build say nothing about the kernels
+    ifeq ($(BENCH),1)
+    CFLAGS  += -O3
+    else
     CFLAGS  += -fsanitize=address,leak,undefined
+    endif
+endif
+
+ifeq ($(BENCH),1)
+    CFLAGS  += -DBENCH
 endif
 
 export CC=${CROSS}gcc
@@ -86,27 +97,54 @@ all: cfg
 	cp common/libcommon.so drastic/libs/
 	MOD=$(MOD) make -C detour
 	cp detour/libdetour.so drastic/libs/
+ifeq ($(MOD),ut)
+	MOD=$(MOD) make -C mi
+	cp mi/libmi.so drastic/libs/
+endif
 	MOD=$(MOD) make -C alsa
 	cp alsa/libasound.so.2 drastic/libs/
 	MOD=$(MOD) make -C sdl2 -j4
 	cp sdl2/build/.libs/libSDL2-2.0.so.0 drastic/libs/
 	MOD=$(MOD) make -C ut $(MOD)
+	make -C gamedb db
+	make -C png2raw assets
+ifneq ($(MOD),ut)
+	make -C splash -f Makefile.$(MOD)
+	cp splash/show_hotkeys drastic/
+	make -C splash -f Makefile.$(MOD) assets
+	mkdir -p drastic/resources/splash
+	cp splash/splash/*.asset drastic/resources/splash/
+endif
+
+.PHONY: assets
+assets:
+	make -C png2raw assets
+ifneq ($(MOD),ut)
+	make -C splash -f Makefile.$(MOD) assets
+	mkdir -p drastic/resources/splash
+	cp splash/splash/*.asset drastic/resources/splash/
+endif
+
+.PHONY: bench
+bench:
+	MOD=$(MOD) make -C ut bench
 
 .PHONY: cfg
 cfg:
 ifeq (,$(wildcard sdl2/Makefile))
 	cp -a ChangeLog.txt drastic/
 	cp -a assets/$(MOD)/* drastic/
-	cd sdl2 && ./autogen.sh && MOD=$(MOD) ./configure $(SDL2_CFG) --host=$(HOST)
+	cd sdl2 && ./autogen.sh && MOD=$(MOD) BENCH=$(BENCH) ./configure $(SDL2_CFG) --host=$(HOST)
 endif
 
 .PHONY: rel
-rel:
+rel: assets
 	zip -r drastic_$(MOD)_$(REL_VER).zip drastic
 
 .PHONY: clean
 clean:
 	rm -rf ut/ut
+	rm -rf drastic/bench
 	rm -rf drastic/libs2
 	rm -rf drastic/cpuclock
 	rm -rf drastic/launch.sh
@@ -115,18 +153,25 @@ clean:
 	rm -rf drastic/ChangeLog.txt
 	rm -rf drastic/miyoo/settings.pb
 	rm -rf drastic/system
+	rm -rf drastic/game_database.bin
 	rm -rf drastic/libs/libdetour.so
 	rm -rf drastic/libs/libcommon.so
 	rm -rf drastic/libs/libasound.so.2
+	rm -rf drastic/libs/libmi.so
 	rm -rf drastic/libs/libpcre2-8.so.0
 	rm -rf drastic/libs/libSDL2-2.0.so.0
 	rm -rf drastic/libs/libfreetype.so.6
 	rm -rf drastic/libs/libglib-2.0.so.0
 	rm -rf drastic/libs/libharfbuzz.so.0
 	make -C ut clean
+	make -C mi clean
 	make -C alsa clean
 	make -C detour clean
 	make -C common clean
+	make -C gamedb clean
+	make -C png2raw clean
+	make -C splash -f Makefile.mini clean
+	find drastic -name "*.asset" -delete
 	make -C sdl2 distclean > /dev/null 2>&1 || true
 	sed -i 's/screen_orientation.*/screen_orientation = 0/g' drastic/config/drastic.cfg
 	cd drastic && mkdir -p system backup scripts slot2 unzip_cache cheats input_record profiles savestates
@@ -52,6 +52,9 @@
 #include "hook.h"
 #include "cfg.pb.h"
 #include "drastic.h"
+#include "thread.h"
+#include "profile.h"
+#include "bench.h"
 
 miyoo_alsa myalsa = { 0 };
 
@@ -206,7 +209,7 @@ static int set_volume_raw(int value, int add)
     if (value == prev_value) {
         close(fd);
         warn(SND"volume is same as previous value in %s\n", __func__);
-        return prev_value;
+        return 0;
     }
 
     buf2[1] = value;
@@ -231,7 +234,7 @@ static int set_volume_raw(int value, int add)
     close(fd);
 
     info(SND"new volume is %d in %s\n", value, __func__);
-    return value;
+    return 0;
 }
 
 #if defined(UT)
@@ -527,21 +530,12 @@ static int queue_put(queue_t *q, uint8_t *buffer, size_t size)
         if ((q->write >= q->read) && ((q->write + size) > q->size)) {
             tmp = q->size - q->write;
             size-= tmp;
-#if defined(UT)
-            memcpy(&q->buffer[q->write], buffer, tmp);
-            memcpy(q->buffer, &buffer[tmp], size);
-#else
             neon_memcpy(&q->buffer[q->write], buffer, tmp);
             neon_memcpy(q->buffer, &buffer[tmp], size);
-#endif
             q->write = size;
         }
         else {
-#if defined(UT)
-            memcpy(&q->buffer[q->write], buffer, size);
-#else
             neon_memcpy(&q->buffer[q->write], buffer, size);
-#endif
             q->write += size;
         }
     }
@@ -598,21 +592,12 @@ static size_t queue_get(queue_t *q, uint8_t *buffer, size_t max_size)
         if ((q->read > q->write) && (q->read + size) > q->size) {
             tmp = q->size - q->read;
             size-= tmp;
-#if defined(UT)
-            memcpy(buffer, &q->buffer[q->read], tmp);
-            memcpy(&buffer[tmp], q->buffer, size);
-#else
             neon_memcpy(buffer, &q->buffer[q->read], tmp);
             neon_memcpy(&buffer[tmp], q->buffer, size);
-#endif
             q->read = size;
         }
         else {
-#if defined(UT)
-            memcpy(buffer, &q->buffer[q->read], size);
-#else
             neon_memcpy(buffer, &q->buffer[q->read], size);
-#endif
             q->read+= size;
         }
     }
@@ -661,6 +646,7 @@ static void *alsa_snd_handler(void *threadid)
     return NULL;
 #endif
 
+    register_thread("audio", THREAD_ROLE_AUDIO);
     myalsa.pcm.ready = 1;
     while (myalsa.pcm.ready) {
         r = queue_get(&myalsa.queue, &myalsa.pcm.buf[idx], len);
@@ -711,6 +697,7 @@ static void *alsa_snd_handler(void *threadid)
 #endif
         usleep(10);
     }
+    unregister_thread();
     pthread_exit(NULL);
 }
 
@@ -928,7 +915,7 @@ int snd_pcm_start(snd_pcm_t *pcm)
 {
 #if defined(MINI)
     MI_S32 miret = 0;
-    MI_SYS_ChnPort_t chn = 0;
+    MI_SYS_ChnPort_t chn = { 0 };
 #endif
 
 #if defined(A30)
@@ -1115,11 +1102,88 @@ TEST(alsa_snd, snd_pcm_sw_params_malloc)
 }
 #endif
 
+static int get_latency_room(queue_t *q)
+{
+    int room = 0;
+    int limit = (get_audio_latency() * PCM_FREQ / 1000) * 2 * PCM_CHANNELS;
+
+    if (!q || !q->buffer || (limit <= 0)) {
+        return -1;
+    }
+
+    room = limit - queue_size_for_read(q);
+    return (room > 0) ? room : 0;
+}
+
+#if defined(UT)
+TEST(alsa_snd, get_latency_room)
+{
+    queue_t t = { 0 };
+    uint8_t buf[4096] = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, get_latency_room(NULL));
+    TEST_ASSERT_EQUAL_INT(0, queue_init(&t, DEF_QUEUE_SIZE));
+    TEST_ASSERT_EQUAL_INT(sizeof(buf), queue_put(&t, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(-1, get_latency_room(&t));
+
+    TEST_ASSERT_EQUAL_INT(0, set_audio_latency(10));
+    TEST_ASSERT_EQUAL_INT(0, get_latency_room(&t));
+    TEST_ASSERT_EQUAL_INT(0, set_audio_latency(100));
+    TEST_ASSERT_EQUAL_INT(((100 * PCM_FREQ / 1000) * 2 * PCM_CHANNELS) - sizeof(buf), get_latency_room(&t));
+    TEST_ASSERT_EQUAL_INT(0, set_audio_latency(0));
+    TEST_ASSERT_EQUAL_INT(0, queue_destroy(&t));
+}
+#endif
+
+static int put_pcm(queue_t *q, uint8_t *buf, int len)
+{
+    int wait = get_audio_latency();
+    int room = get_latency_room(q);
+
+    // block like a real pcm device while the mixer drains the queue, then trim
+    // whatever is still over the target instead of dropping the whole period
+    while ((room >= 0) && (room < len) && (wait-- > 0)) {
+        usleep(1000);
+        room = get_latency_room(q);
+    }
+
+    if ((room >= 0) && (room < len)) {
+        len = room & ~((2 * PCM_CHANNELS) - 1);
+    }
+
+    if (len <= 0) {
+        return 0;
+    }
+    return queue_put(q, buf, len);
+}
+
+#if defined(UT)
+TEST(alsa_snd, put_pcm)
+{
+    queue_t t = { 0 };
+    uint8_t buf[4096] = { 0 };
+    int limit = (100 * PCM_FREQ / 1000) * 2 * PCM_CHANNELS;
+
+    TEST_ASSERT_EQUAL_INT(0, queue_init(&t, DEF_QUEUE_SIZE));
+    TEST_ASSERT_EQUAL_INT(sizeof(buf), put_pcm(&t, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(sizeof(buf), put_pcm(&t, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(sizeof(buf), put_pcm(&t, buf, sizeof(buf)));
+
+    TEST_ASSERT_EQUAL_INT(0, set_audio_latency(100));
+    TEST_ASSERT_EQUAL_INT(sizeof(buf), put_pcm(&t, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(limit - (4 * sizeof(buf)), put_pcm(&t, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(limit, queue_size_for_read(&t));
+    TEST_ASSERT_EQUAL_INT(0, put_pcm(&t, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(0, set_audio_latency(0));
+    TEST_ASSERT_EQUAL_INT(0, queue_destroy(&t));
+}
+#endif
+
 snd_pcm_sframes_t snd_pcm_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_uframes_t size)
 {
     if ((size > 1) && (size != myalsa.pcm.len)) {
 #if !defined(UT)
-        queue_put(&myalsa.queue, (uint8_t *)buffer, size * 2 * PCM_CHANNELS);
+        put_pcm(&myalsa.queue, (uint8_t *)buffer, size * 2 * PCM_CHANNELS);
 #endif
     }
     return size;
@@ -1136,6 +1200,92 @@ TEST(alsa_snd, snd_pcm_writei)
 }
 #endif
 
+#if defined(UT) || defined(BENCH)
+#define BENCH_ADPCM_SIZE 1024
+#define BENCH_QUEUE_SIZE 4096
+
+typedef struct {
+    queue_t q;
+    uint8_t buf[BENCH_QUEUE_SIZE];
+} bench_queue_t;
+
+typedef struct {
+    spu_channel_struct ch;
+    uint8_t data[BENCH_ADPCM_SIZE];
+} bench_adpcm_t;
+
+static const int16_t bench_adpcm_step[] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31,
+    34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+    157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+    3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t bench_adpcm_index[] = {
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static void bench_queue(void *arg)
+{
+    bench_queue_t *p = (bench_queue_t *)arg;
+
+    queue_put(&p->q, p->buf, sizeof(p->buf));
+    queue_get(&p->q, p->buf, sizeof(p->buf));
+}
+
+static void bench_adpcm(void *arg)
+{
+    int cc = 0;
+    bench_adpcm_t *p = (bench_adpcm_t *)arg;
+
+    // 8 samples (4 bytes) per call, the same block is decoded from the start every time
+    p->ch.adpcm_sample = 0;
+    p->ch.adpcm_current_index = 0;
+    p->ch.adpcm_cache_block_offset = 0;
+    for (cc = 0; cc < (BENCH_ADPCM_SIZE / 4); cc++) {
+        spu_adpcm_decode_block(&p->ch);
+    }
+}
+
+BENCH_GROUP(alsa_snd)
+{
+    int cc = 0;
+    uint32_t *step = myhook.var.adpcm.step_table;
+    uint32_t *index = myhook.var.adpcm.index_step_table;
+    bench_queue_t *q = NULL;
+    bench_adpcm_t *a = NULL;
+
+    q = malloc(sizeof(bench_queue_t));
+    if (q) {
+        memset(q, 0, sizeof(bench_queue_t));
+        if (queue_init(&q->q, DEF_QUEUE_SIZE) == 0) {
+            // the audio thread drains what SDL puts, so a put is always followed by a get
+            memset(q->buf, 0x5a, sizeof(q->buf));
+            run_bench("queue_put_get/4096", bench_queue, q, sizeof(q->buf));
+            queue_destroy(&q->q);
+        }
+        free(q);
+    }
+
+    a = malloc(sizeof(bench_adpcm_t));
+    if (a) {
+        memset(a, 0, sizeof(bench_adpcm_t));
+        for (cc = 0; cc < BENCH_ADPCM_SIZE; cc++) {
+            a->data[cc] = (uint8_t)((cc * 37) ^ (cc >> 3));
+        }
+        a->ch.samples = a->data;
+        myhook.var.adpcm.step_table = (uint32_t *)bench_adpcm_step;
+        myhook.var.adpcm.index_step_table = (uint32_t *)bench_adpcm_index;
+        run_bench("spu_adpcm_decode_block/1024", bench_adpcm, a, BENCH_ADPCM_SIZE);
+        myhook.var.adpcm.step_table = step;
+        myhook.var.adpcm.index_step_table = index;
+        free(a);
+    }
+}
+#endif
+
 #if defined(UT)
 TEST_GROUP_RUNNER(alsa_snd)
 {
@@ -1173,6 +1323,8 @@ TEST_GROUP_RUNNER(alsa_snd)
     RUN_TEST_CASE(alsa_snd, snd_pcm_sw_params_current);
     RUN_TEST_CASE(alsa_snd, snd_pcm_sw_params_free);
     RUN_TEST_CASE(alsa_snd, snd_pcm_sw_params_malloc);
+    RUN_TEST_CASE(alsa_snd, get_latency_room);
+    RUN_TEST_CASE(alsa_snd, put_pcm);
     RUN_TEST_CASE(alsa_snd, snd_pcm_writei);
 }
 #endif
@@ -4,7 +4,8 @@ mydir=`dirname "$0"`
 cd $mydir
 if [ ! -f "/tmp/.show_hotkeys" ]; then
     touch /tmp/.show_hotkeys
-    LD_LIBRARY_PATH=libs2:/usr/miyoo/lib ./show_hotkeys
+    LD_LIBRARY_PATH=libs2:/usr/miyoo/lib ./show_hotkeys &
+    echo $! > /tmp/.splash_busy
 fi
 
 export HOME=$mydir
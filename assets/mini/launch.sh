@@ -8,7 +8,8 @@ mydir=`dirname "$0"`
 cd $mydir
 if [ ! -f "/tmp/.show_hotkeys" ]; then
     touch /tmp/.show_hotkeys
-    LD_LIBRARY_PATH=./libs:/customer/lib:/config/lib ./show_hotkeys
+    LD_LIBRARY_PATH=./libs:/customer/lib:/config/lib ./show_hotkeys &
+    echo $! > /tmp/.splash_busy
 fi
 
 export HOME=$mydir
@@ -30,6 +31,9 @@ if [  -d "/customer/app/skin_large" ]; then
 fi
 
 if [ "$USE_752x560_RES" == "1" ]; then
+    while [ -f /tmp/.splash_busy ] && kill -0 `cat /tmp/.splash_busy` 2>/dev/null; do
+        sleep 0.1
+    done
     fbset -g 752 560 752 1120 32
 fi
 
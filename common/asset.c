@@ -0,0 +1,295 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "log.h"
+#include "asset.h"
+
+#if defined(UT)
+#define UT_ASSET_SRC "./asset_ut.png"
+#define UT_ASSET_BIN "./asset_ut.asset"
+
+static int write_fake_asset(int fmt, int rotate, int w, int h, int src_size)
+{
+    int fd = -1;
+    int bpp = (fmt == ASSET_FMT_RGB565) ? 2 : 4;
+    asset_hdr_t hdr = { 0 };
+    uint8_t pixels[64] = { 0 };
+
+    hdr.magic = ASSET_MAGIC;
+    hdr.version = ASSET_VERSION;
+    hdr.hdr_size = ASSET_HDR_SIZE;
+    hdr.fmt = fmt;
+    hdr.rotate = rotate;
+    hdr.w = w;
+    hdr.h = h;
+    hdr.pitch = w * bpp;
+    hdr.size = hdr.pitch * h;
+    hdr.src_size = src_size;
+    memset(pixels, 0x5a, sizeof(pixels));
+
+    fd = open(UT_ASSET_BIN, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    write(fd, &hdr, sizeof(hdr));
+    write(fd, pixels, hdr.size);
+    close(fd);
+    return 0;
+}
+
+TEST_GROUP(common_asset);
+
+TEST_SETUP(common_asset)
+{
+}
+
+TEST_TEAR_DOWN(common_asset)
+{
+    unlink(UT_ASSET_SRC);
+    unlink(UT_ASSET_BIN);
+}
+#endif
+
+int get_asset_path(const char *src, char *buf, int len)
+{
+    int n = 0;
+    const char *dot = NULL;
+
+    if (!src || !buf || (len <= 0)) {
+        err(COM"invalid parameters(0x%x, 0x%x, %d) in %s\n", src, buf, len, __func__);
+        return -1;
+    }
+
+    dot = strrchr(src, '.');
+    if (!dot || strchr(dot, '/')) {
+        dot = src + strlen(src);
+    }
+
+    n = snprintf(buf, len, "%.*s%s", (int)(dot - src), src, ASSET_EXT);
+    if ((n < 0) || (n >= len)) {
+        return -1;
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_asset, get_asset_path)
+{
+    char buf[64] = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, get_asset_path(NULL, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(-1, get_asset_path("a.png", NULL, 0));
+    TEST_ASSERT_EQUAL_INT(0, get_asset_path("bg/bg_s0.png", buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("bg/bg_s0"ASSET_EXT, buf);
+    TEST_ASSERT_EQUAL_INT(0, get_asset_path("bg.v1/pen", buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("bg.v1/pen"ASSET_EXT, buf);
+    TEST_ASSERT_EQUAL_INT(-1, get_asset_path("a.png", buf, 4));
+}
+#endif
+
+static int is_valid_hdr(const asset_hdr_t *hdr, size_t file_size)
+{
+    uint32_t bpp = 0;
+
+    if ((hdr->magic != ASSET_MAGIC) || (hdr->version != ASSET_VERSION)) {
+        return 0;
+    }
+
+    if ((hdr->hdr_size < sizeof(asset_hdr_t)) || (hdr->rotate > ASSET_ROTATE_270)) {
+        return 0;
+    }
+
+    switch (hdr->fmt) {
+    case ASSET_FMT_ARGB8888:
+        bpp = 4;
+        break;
+    case ASSET_FMT_RGB565:
+        bpp = 2;
+        break;
+    default:
+        return 0;
+    }
+
+    if ((hdr->w == 0) || (hdr->h == 0) || (hdr->pitch < (hdr->w * bpp))) {
+        return 0;
+    }
+
+    if (((uint64_t)hdr->pitch * hdr->h) != hdr->size) {
+        return 0;
+    }
+    return ((uint64_t)hdr->hdr_size + hdr->size) <= file_size;
+}
+
+int open_asset(const char *src, int fmt, int rotate, asset_t *a)
+{
+    int fd = -1;
+    void *map = NULL;
+    struct stat st = { 0 };
+    const asset_hdr_t *hdr = NULL;
+    char buf[256] = { 0 };
+
+    if (!src || !a) {
+        err(COM"invalid parameters(0x%x, 0x%x) in %s\n", src, a, __func__);
+        return -1;
+    }
+
+    memset(a, 0, sizeof(asset_t));
+    a->fd = -1;
+
+    if (get_asset_path(src, buf, sizeof(buf)) < 0) {
+        return -1;
+    }
+
+    fd = open(buf, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if ((fstat(fd, &st) < 0) || (st.st_size < (off_t)sizeof(asset_hdr_t))) {
+        close(fd);
+        return -1;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        err(COM"failed to map \"%s\" in %s\n", buf, __func__);
+        close(fd);
+        return -1;
+    }
+
+    hdr = (const asset_hdr_t *)map;
+    a->fd = fd;
+    a->map = map;
+    a->map_size = st.st_size;
+
+    if (!is_valid_hdr(hdr, st.st_size)) {
+        warn(COM"invalid asset(\"%s\") in %s\n", buf, __func__);
+        close_asset(a);
+        return -1;
+    }
+
+    if ((hdr->fmt != fmt) || (hdr->rotate != rotate)) {
+        debug(COM"asset format mismatch(\"%s\") in %s\n", buf, __func__);
+        close_asset(a);
+        return -1;
+    }
+
+    // the source image wins if it was edited after the asset was compiled
+    if (stat(src, &st) == 0) {
+        if ((st.st_size != hdr->src_size) || ((uint32_t)st.st_mtime != hdr->src_mtime)) {
+            info(COM"stale asset(\"%s\") in %s\n", buf, __func__);
+            close_asset(a);
+            return -1;
+        }
+    }
+
+    a->hdr = hdr;
+    a->pixels = (const uint8_t *)map + hdr->hdr_size;
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_asset, open_asset)
+{
+    asset_t a = { 0 };
+    FILE *f = NULL;
+    struct stat st = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, open_asset(NULL, ASSET_FMT_RGB565, ASSET_ROTATE_0, &a));
+    TEST_ASSERT_EQUAL_INT(-1, open_asset(UT_ASSET_SRC, ASSET_FMT_RGB565, ASSET_ROTATE_0, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, open_asset(UT_ASSET_SRC, ASSET_FMT_RGB565, ASSET_ROTATE_0, &a));
+
+    TEST_ASSERT_EQUAL_INT(0, write_fake_asset(ASSET_FMT_RGB565, ASSET_ROTATE_180, 4, 2, 0));
+    TEST_ASSERT_EQUAL_INT(-1, open_asset(UT_ASSET_SRC, ASSET_FMT_ARGB8888, ASSET_ROTATE_180, &a));
+    TEST_ASSERT_EQUAL_INT(-1, open_asset(UT_ASSET_SRC, ASSET_FMT_RGB565, ASSET_ROTATE_0, &a));
+    TEST_ASSERT_EQUAL_INT(0, open_asset(UT_ASSET_SRC, ASSET_FMT_RGB565, ASSET_ROTATE_180, &a));
+    TEST_ASSERT_EQUAL_INT(4, a.hdr->w);
+    TEST_ASSERT_EQUAL_INT(2, a.hdr->h);
+    TEST_ASSERT_EQUAL_HEX8(0x5a, ((const uint8_t *)a.pixels)[15]);
+    TEST_ASSERT_EQUAL_INT(0, close_asset(&a));
+
+    f = fopen(UT_ASSET_SRC, "w+");
+    TEST_ASSERT_NOT_NULL(f);
+    fprintf(f, "png");
+    fclose(f);
+    TEST_ASSERT_EQUAL_INT(-1, open_asset(UT_ASSET_SRC, ASSET_FMT_RGB565, ASSET_ROTATE_180, &a));
+
+    stat(UT_ASSET_SRC, &st);
+    TEST_ASSERT_EQUAL_INT(0, write_fake_asset(ASSET_FMT_RGB565, ASSET_ROTATE_180, 4, 2, 3));
+    TEST_ASSERT_EQUAL_INT(-1, open_asset(UT_ASSET_SRC, ASSET_FMT_RGB565, ASSET_ROTATE_180, &a));
+}
+#endif
+
+int close_asset(asset_t *a)
+{
+    if (!a) {
+        err(COM"invalid parameter(0x%x) in %s\n", a, __func__);
+        return -1;
+    }
+
+    if (a->map) {
+        munmap(a->map, a->map_size);
+    }
+
+    if (a->fd >= 0) {
+        close(a->fd);
+    }
+
+    memset(a, 0, sizeof(asset_t));
+    a->fd = -1;
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_asset, close_asset)
+{
+    asset_t a = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, close_asset(NULL));
+    TEST_ASSERT_EQUAL_INT(0, write_fake_asset(ASSET_FMT_ARGB8888, ASSET_ROTATE_0, 2, 2, 0));
+    TEST_ASSERT_EQUAL_INT(0, open_asset(UT_ASSET_SRC, ASSET_FMT_ARGB8888, ASSET_ROTATE_0, &a));
+    TEST_ASSERT_EQUAL_INT(0, close_asset(&a));
+    TEST_ASSERT_NULL(a.map);
+    TEST_ASSERT_EQUAL_INT(-1, a.fd);
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(common_asset)
+{
+    RUN_TEST_CASE(common_asset, get_asset_path);
+    RUN_TEST_CASE(common_asset, open_asset);
+    RUN_TEST_CASE(common_asset, close_asset);
+}
+#endif
+
@@ -0,0 +1,68 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __COMMON_ASSET_H__
+#define __COMMON_ASSET_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ASSET_MAGIC 0x41534e44
+#define ASSET_VERSION 1
+#define ASSET_EXT ".asset"
+#define ASSET_HDR_SIZE 64
+
+#define ASSET_FMT_ARGB8888 0
+#define ASSET_FMT_RGB565 1
+
+#define ASSET_ROTATE_0 0
+#define ASSET_ROTATE_90 1
+#define ASSET_ROTATE_180 2
+#define ASSET_ROTATE_270 3
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t hdr_size;
+    uint16_t fmt;
+    uint16_t rotate;
+    uint32_t w;
+    uint32_t h;
+    uint32_t pitch;
+    uint32_t size;
+    uint32_t src_size;
+    uint32_t src_mtime;
+    uint8_t reserved[ASSET_HDR_SIZE - 36];
+} asset_hdr_t;
+
+typedef struct {
+    int fd;
+    void *map;
+    size_t map_size;
+    const asset_hdr_t *hdr;
+    const void *pixels;
+} asset_t;
+
+int get_asset_path(const char *src, char *buf, int len);
+int open_asset(const char *src, int fmt, int rotate, asset_t *a);
+int close_asset(asset_t *a);
+
+#endif
+
@@ -0,0 +1,587 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+#include <time.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <json-c/json.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "log.h"
+#include "bench.h"
+#include "governor.h"
+
+#define JSON_BENCH_ARCH "arch"
+#define JSON_BENCH_BUILD "build"
+#define JSON_BENCH_RESULT "result"
+#define JSON_BENCH_NAME "name"
+#define JSON_BENCH_MEDIAN "median_ns"
+
+static struct {
+    int warmup;
+    int repeat;
+    int cnt;
+    char filter[BENCH_MAX_NAME];
+    bench_result_t result[BENCH_MAX_CASE];
+} bench = { 0 };
+
+static const char *status_str[] = {
+    "new",
+    "ok",
+    "regress"
+};
+
+void *neon_memcpy(void *dest, const void *src, size_t n);
+
+#if defined(UT)
+#define UT_BENCH_FILE "/tmp/bench_ut_XXXXXX"
+
+static char ut_file[sizeof(UT_BENCH_FILE)] = { 0 };
+
+TEST_GROUP(common_bench);
+
+TEST_SETUP(common_bench)
+{
+    int fd = -1;
+
+    init_bench(0, 5, NULL);
+    strcpy(ut_file, UT_BENCH_FILE);
+    fd = mkstemp(ut_file);
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+TEST_TEAR_DOWN(common_bench)
+{
+    quit_bench();
+    unlink(ut_file);
+}
+#endif
+
+const char *get_bench_arch(void)
+{
+#if defined(__aarch64__)
+    return "aarch64";
+#elif defined(__arm__)
+    return "arm";
+#elif defined(__x86_64__)
+    return "x86_64";
+#elif defined(__i386__)
+    return "i386";
+#else
+    return "unknown";
+#endif
+}
+
+static const char *get_bench_build(void)
+{
+#if defined(MINI)
+    return "mini";
+#elif defined(A30)
+    return "a30";
+#elif defined(UT)
+    return "ut";
+#else
+    return "unknown";
+#endif
+}
+
+static uint64_t time_bench(bench_fn_t fn, void *arg, uint32_t op)
+{
+    uint32_t cc = 0;
+    uint64_t t0 = get_clock_ns(CLOCK_MONOTONIC);
+
+    for (cc = 0; cc < op; cc++) {
+        fn(arg);
+    }
+    return get_clock_ns(CLOCK_MONOTONIC) - t0;
+}
+
+static int cmp_sample(const void *a, const void *b)
+{
+    double v0 = *(const double *)a;
+    double v1 = *(const double *)b;
+
+    return (v0 > v1) - (v0 < v1);
+}
+
+static int calc_bench_stat(double *sample, int cnt, bench_result_t *r)
+{
+    int cc = 0;
+    double sum = 0;
+
+    if (!sample || (cnt <= 0) || !r) {
+        err(COM"invalid parameters(0x%x, %d, 0x%x) in %s\n", sample, cnt, r, __func__);
+        return -1;
+    }
+
+    qsort(sample, cnt, sizeof(double), cmp_sample);
+    r->min_ns = sample[0];
+    r->max_ns = sample[cnt - 1];
+    if (cnt & 1) {
+        r->median_ns = sample[cnt >> 1];
+    }
+    else {
+        r->median_ns = (sample[(cnt >> 1) - 1] + sample[cnt >> 1]) / 2;
+    }
+
+    for (cc = 0; cc < cnt; cc++) {
+        sum += sample[cc];
+    }
+    r->mean_ns = sum / cnt;
+
+    sum = 0;
+    for (cc = 0; cc < cnt; cc++) {
+        sum += (sample[cc] - r->mean_ns) * (sample[cc] - r->mean_ns);
+    }
+    r->stddev_ns = (cnt > 1) ? sqrt(sum / (cnt - 1)) : 0;
+
+    // MB/s from the median, bytes per ns times 1000
+    r->mbps = 0;
+    if (r->byte && (r->median_ns > 0)) {
+        r->mbps = (double)r->byte * 1000 / r->median_ns;
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_bench, calc_bench_stat)
+{
+    bench_result_t r = { 0 };
+    double s0[] = { 30, 10, 20, 50, 40 };
+    double s1[] = { 4, 1, 3, 2 };
+
+    TEST_ASSERT_EQUAL_INT(-1, calc_bench_stat(NULL, 5, &r));
+    TEST_ASSERT_EQUAL_INT(-1, calc_bench_stat(s0, 0, &r));
+    TEST_ASSERT_EQUAL_INT(-1, calc_bench_stat(s0, 5, NULL));
+
+    r.byte = 300;
+    TEST_ASSERT_EQUAL_INT(0, calc_bench_stat(s0, 5, &r));
+    TEST_ASSERT_EQUAL_INT(10, (int)r.min_ns);
+    TEST_ASSERT_EQUAL_INT(50, (int)r.max_ns);
+    TEST_ASSERT_EQUAL_INT(30, (int)r.median_ns);
+    TEST_ASSERT_EQUAL_INT(30, (int)r.mean_ns);
+    TEST_ASSERT_EQUAL_INT(15811, (int)(r.stddev_ns * 1000));
+    TEST_ASSERT_EQUAL_INT(10000, (int)r.mbps);
+
+    r.byte = 0;
+    TEST_ASSERT_EQUAL_INT(0, calc_bench_stat(s1, 4, &r));
+    TEST_ASSERT_EQUAL_INT(25, (int)(r.median_ns * 10));
+    TEST_ASSERT_EQUAL_INT(0, (int)r.mbps);
+}
+#endif
+
+int init_bench(int warmup, int repeat, const char *filter)
+{
+    if ((warmup < 0) || (repeat <= 0) || (repeat > BENCH_MAX_REPEAT)) {
+        err(COM"invalid parameters(%d, %d) in %s\n", warmup, repeat, __func__);
+        return -1;
+    }
+
+    memset(&bench, 0, sizeof(bench));
+    bench.warmup = warmup;
+    bench.repeat = repeat;
+    if (filter) {
+        snprintf(bench.filter, sizeof(bench.filter), "%s", filter);
+    }
+    return 0;
+}
+
+int quit_bench(void)
+{
+    memset(&bench, 0, sizeof(bench));
+    return 0;
+}
+
+int run_bench(const char *name, bench_fn_t fn, void *arg, uint64_t byte)
+{
+    int cc = 0;
+    uint32_t op = 1;
+    bench_result_t *r = NULL;
+    double sample[BENCH_MAX_REPEAT] = { 0 };
+
+    if (!name || !fn || (strlen(name) >= BENCH_MAX_NAME)) {
+        err(COM"invalid parameters(0x%x, 0x%x) in %s\n", name, fn, __func__);
+        return -1;
+    }
+
+    if ((bench.repeat <= 0) || (bench.cnt >= BENCH_MAX_CASE)) {
+        err(COM"no room for \"%s\"(%d) in %s\n", name, bench.cnt, __func__);
+        return -1;
+    }
+
+    if (bench.filter[0] && !strstr(name, bench.filter) && strcmp(name, BENCH_REF_NAME)) {
+        return 0;
+    }
+
+    // one sample has to be long enough to hide the clock and the loop
+    while ((time_bench(fn, arg, op) < BENCH_SAMPLE_NS) && (op < BENCH_MAX_OP)) {
+        op <<= 1;
+    }
+
+    for (cc = 0; cc < bench.warmup; cc++) {
+        time_bench(fn, arg, op);
+    }
+
+    for (cc = 0; cc < bench.repeat; cc++) {
+        sample[cc] = (double)time_bench(fn, arg, op) / op;
+    }
+
+    r = &bench.result[bench.cnt];
+    memset(r, 0, sizeof(bench_result_t));
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->op = op;
+    r->byte = byte;
+    r->repeat = bench.repeat;
+    r->status = BENCH_STATUS_NEW;
+    calc_bench_stat(sample, bench.repeat, r);
+    bench.cnt += 1;
+
+    printf("%-32s %12.1f ns/op %10.1f MB/s %6.1f%%\n",
+        r->name,
+        r->median_ns,
+        r->mbps,
+        (r->mean_ns > 0) ? (r->stddev_ns * 100 / r->mean_ns) : 0
+    );
+    return 0;
+}
+
+#if defined(UT)
+static void bench_nop(void *arg)
+{
+    *(volatile uint32_t *)arg += 1;
+}
+
+TEST(common_bench, run_bench)
+{
+    uint32_t cnt = 0;
+    const bench_result_t *r = NULL;
+
+    TEST_ASSERT_EQUAL_INT(-1, run_bench(NULL, bench_nop, &cnt, 0));
+    TEST_ASSERT_EQUAL_INT(-1, run_bench("nop", NULL, &cnt, 0));
+    TEST_ASSERT_EQUAL_INT(-1, run_bench("0123456789012345678901234567890123456789012345678", bench_nop, &cnt, 0));
+
+    TEST_ASSERT_EQUAL_INT(0, run_bench("nop", bench_nop, &cnt, 4));
+    TEST_ASSERT_EQUAL_INT(1, get_bench_count());
+    TEST_ASSERT_NOT_NULL(r = get_bench_result("nop"));
+    TEST_ASSERT_TRUE(cnt >= (r->op * 5));
+    TEST_ASSERT_TRUE(r->min_ns <= r->median_ns);
+    TEST_ASSERT_TRUE(r->median_ns <= r->max_ns);
+    TEST_ASSERT_TRUE(r->mbps > 0);
+    TEST_ASSERT_EQUAL_INT(5, r->repeat);
+    TEST_ASSERT_EQUAL_INT(BENCH_STATUS_NEW, r->status);
+    TEST_ASSERT_NULL(get_bench_result("none"));
+
+    TEST_ASSERT_EQUAL_INT(0, init_bench(0, 3, "memcpy"));
+    TEST_ASSERT_EQUAL_INT(0, run_bench("nop", bench_nop, &cnt, 0));
+    TEST_ASSERT_EQUAL_INT(0, get_bench_count());
+    TEST_ASSERT_EQUAL_INT(0, run_bench(BENCH_REF_NAME, bench_nop, &cnt, 0));
+    TEST_ASSERT_EQUAL_INT(1, get_bench_count());
+    TEST_ASSERT_EQUAL_INT(-1, init_bench(0, BENCH_MAX_REPEAT + 1, NULL));
+}
+#endif
+
+int get_bench_count(void)
+{
+    return bench.cnt;
+}
+
+const bench_result_t *get_bench_result(const char *name)
+{
+    int cc = 0;
+
+    if (!name) {
+        return NULL;
+    }
+
+    for (cc = 0; cc < bench.cnt; cc++) {
+        if (!strcmp(bench.result[cc].name, name)) {
+            return &bench.result[cc];
+        }
+    }
+    return NULL;
+}
+
+int dump_bench(const char *path)
+{
+    int cc = 0;
+    FILE *f = stdout;
+    const bench_result_t *r = NULL;
+
+    if (path) {
+        f = fopen(path, "w");
+        if (!f) {
+            err(COM"failed to create file(\"%s\") in %s\n", path, __func__);
+            return -1;
+        }
+    }
+
+    fprintf(f, "{\n");
+    fprintf(f, "    \"%s\": \"%s\",\n", JSON_BENCH_ARCH, get_bench_arch());
+    fprintf(f, "    \"%s\": \"%s\",\n", JSON_BENCH_BUILD, get_bench_build());
+    fprintf(f, "    \"warmup\": %d,\n", bench.warmup);
+    fprintf(f, "    \"repeat\": %d,\n", bench.repeat);
+    fprintf(f, "    \"%s\": [\n", JSON_BENCH_RESULT);
+    for (cc = 0; cc < bench.cnt; cc++) {
+        r = &bench.result[cc];
+        fprintf(f, "        { \"%s\": \"%s\", \"op\": %u, \"byte\": %llu, ", JSON_BENCH_NAME, r->name, r->op, (unsigned long long)r->byte);
+        fprintf(f, "\"min_ns\": %.1f, \"%s\": %.1f, \"mean_ns\": %.1f, \"max_ns\": %.1f, \"stddev_ns\": %.1f, ",
+            r->min_ns, JSON_BENCH_MEDIAN, r->median_ns, r->mean_ns, r->max_ns, r->stddev_ns);
+        fprintf(f, "\"mbps\": %.1f, \"base_ns\": %.1f, \"delta\": %.1f, \"status\": \"%s\" }%s\n",
+            r->mbps, r->base_ns, r->delta, status_str[r->status], (cc + 1) < bench.cnt ? "," : "");
+    }
+    fprintf(f, "    ]\n");
+    fprintf(f, "}\n");
+
+    if (path) {
+        fclose(f);
+    }
+    return 0;
+}
+
+static double get_base_median(struct json_object *jarr, const char *name)
+{
+    int cc = 0;
+    int cnt = 0;
+    struct json_object *jval = NULL;
+    struct json_object *jitem = NULL;
+
+    if (!jarr || !name) {
+        return 0;
+    }
+
+    cnt = json_object_array_length(jarr);
+    for (cc = 0; cc < cnt; cc++) {
+        jitem = json_object_array_get_idx(jarr, cc);
+        if (!json_object_object_get_ex(jitem, JSON_BENCH_NAME, &jval) || strcmp(json_object_get_string(jval), name)) {
+            continue;
+        }
+        if (json_object_object_get_ex(jitem, JSON_BENCH_MEDIAN, &jval)) {
+            return json_object_get_double(jval);
+        }
+        break;
+    }
+    return 0;
+}
+
+int compare_bench(const char *path, double threshold)
+{
+    int cc = 0;
+    int regress = 0;
+    double base = 0;
+    double scale = 1.0;
+    bench_result_t *r = NULL;
+    const char *arch = NULL;
+    const char *build = NULL;
+    const bench_result_t *ref = NULL;
+    struct json_object *jval = NULL;
+    struct json_object *jarr = NULL;
+    struct json_object *jfile = NULL;
+
+    if (!path || (threshold < 0)) {
+        err(COM"invalid parameters(0x%x) in %s\n", path, __func__);
+        return -1;
+    }
+
+    jfile = json_object_from_file(path);
+    if (!jfile) {
+        err(COM"failed to load baseline(\"%s\") in %s\n", path, __func__);
+        return -1;
+    }
+
+    for (cc = 0; cc < bench.cnt; cc++) {
+        bench.result[cc].base_ns = 0;
+        bench.result[cc].delta = 0;
+        bench.result[cc].status = BENCH_STATUS_NEW;
+    }
+
+    if (json_object_object_get_ex(jfile, JSON_BENCH_ARCH, &jval)) {
+        arch = json_object_get_string(jval);
+    }
+    if (json_object_object_get_ex(jfile, JSON_BENCH_BUILD, &jval)) {
+        build = json_object_get_string(jval);
+    }
+
+    // numbers from another cpu or from a sanitizer build mean nothing here
+    if (!arch || !build || strcmp(arch, get_bench_arch()) || strcmp(build, get_bench_build())) {
+        info(COM"baseline(\"%s\") is for %s/%s in %s\n", path, arch ? arch : "?", build ? build : "?", __func__);
+        json_object_put(jfile);
+        return 0;
+    }
+
+    json_object_object_get_ex(jfile, JSON_BENCH_RESULT, &jarr);
+
+    // the host may run at another clock than when the baseline was taken,
+    // every baseline is scaled by how the reference case moved in between
+    ref = get_bench_result(BENCH_REF_NAME);
+    base = get_base_median(jarr, BENCH_REF_NAME);
+    if (ref && (ref->median_ns > 0) && (base > 0)) {
+        scale = ref->median_ns / base;
+        printf("%-32s scaled baseline by %.2f\n", BENCH_REF_NAME, scale);
+    }
+
+    for (cc = 0; cc < bench.cnt; cc++) {
+        r = &bench.result[cc];
+        base = get_base_median(jarr, r->name);
+        if (base <= 0) {
+            continue;
+        }
+
+        r->base_ns = base * scale;
+        r->delta = ((r->median_ns - r->base_ns) * 100) / r->base_ns;
+        r->status = BENCH_STATUS_OK;
+        if (r->delta > threshold) {
+            r->status = BENCH_STATUS_REGRESS;
+            regress += 1;
+            printf("%-32s %12.1f ns/op, baseline %.1f ns/op (+%.1f%%)\n", r->name, r->median_ns, r->base_ns, r->delta);
+        }
+    }
+    json_object_put(jfile);
+    return regress;
+}
+
+#if defined(UT)
+TEST(common_bench, compare_bench)
+{
+    FILE *f = NULL;
+    uint32_t cnt = 0;
+    const bench_result_t *r = NULL;
+
+    TEST_ASSERT_EQUAL_INT(0, run_bench("nop", bench_nop, &cnt, 0));
+    TEST_ASSERT_EQUAL_INT(0, run_bench("nop2", bench_nop, &cnt, 0));
+    TEST_ASSERT_EQUAL_INT(-1, compare_bench(NULL, 10));
+    TEST_ASSERT_EQUAL_INT(-1, compare_bench("/tmp/none.json", 10));
+
+    f = fopen(ut_file, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fprintf(f, "{ \"arch\": \"%s\", \"build\": \"%s\", \"result\": [ ", get_bench_arch(), get_bench_build());
+    fprintf(f, "{ \"name\": \"nop\", \"median_ns\": 0.0001 }, { \"name\": \"nop2\", \"median_ns\": 1000000000 } ] }");
+    fclose(f);
+
+    TEST_ASSERT_EQUAL_INT(1, compare_bench(ut_file, 10));
+    TEST_ASSERT_NOT_NULL(r = get_bench_result("nop"));
+    TEST_ASSERT_EQUAL_INT(BENCH_STATUS_REGRESS, r->status);
+    TEST_ASSERT_NOT_NULL(r = get_bench_result("nop2"));
+    TEST_ASSERT_EQUAL_INT(BENCH_STATUS_OK, r->status);
+    TEST_ASSERT_TRUE(r->delta < 0);
+
+    // a result file is a baseline for the next run
+    TEST_ASSERT_EQUAL_INT(0, dump_bench(ut_file));
+    TEST_ASSERT_EQUAL_INT(0, compare_bench(ut_file, 10000));
+    TEST_ASSERT_EQUAL_INT(BENCH_STATUS_OK, get_bench_result("nop")->status);
+
+    f = fopen(ut_file, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fprintf(f, "{ \"arch\": \"none\", \"build\": \"%s\", \"result\": [ { \"name\": \"nop\", \"median_ns\": 0.0001 } ] }", get_bench_build());
+    fclose(f);
+    TEST_ASSERT_EQUAL_INT(0, compare_bench(ut_file, 10));
+    TEST_ASSERT_EQUAL_INT(BENCH_STATUS_NEW, get_bench_result("nop")->status);
+
+    // the host ran twice as fast when the baseline was taken, so 1.5x the
+    // current median is only 0.75x of it after scaling
+    TEST_ASSERT_EQUAL_INT(0, run_bench(BENCH_REF_NAME, bench_nop, &cnt, 0));
+    TEST_ASSERT_NOT_NULL(r = get_bench_result(BENCH_REF_NAME));
+    f = fopen(ut_file, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fprintf(f, "{ \"arch\": \"%s\", \"build\": \"%s\", \"result\": [ ", get_bench_arch(), get_bench_build());
+    fprintf(f, "{ \"name\": \"%s\", \"median_ns\": %.9g }, ", BENCH_REF_NAME, r->median_ns * 2);
+    fprintf(f, "{ \"name\": \"nop\", \"median_ns\": %.9g } ] }", get_bench_result("nop")->median_ns * 1.5);
+    fclose(f);
+    TEST_ASSERT_EQUAL_INT(1, compare_bench(ut_file, 25));
+    TEST_ASSERT_EQUAL_INT(BENCH_STATUS_REGRESS, get_bench_result("nop")->status);
+    TEST_ASSERT_EQUAL_INT(333, (int)(get_bench_result("nop")->delta * 10));
+    TEST_ASSERT_EQUAL_INT(BENCH_STATUS_OK, get_bench_result(BENCH_REF_NAME)->status);
+    TEST_ASSERT_EQUAL_INT(0, compare_bench(ut_file, 50));
+}
+#endif
+
+#if defined(UT) || defined(BENCH)
+static void bench_ref(void *arg)
+{
+    int cc = 0;
+    uint32_t v = *(volatile uint32_t *)arg;
+
+    // one dependent chain in registers, it only follows the core clock
+    for (cc = 0; cc < 256; cc++) {
+        v = (v * 1664525) + 1013904223;
+    }
+    *(volatile uint32_t *)arg = v;
+}
+
+BENCH_GROUP(common_ref)
+{
+    uint32_t v = 1;
+
+    run_bench(BENCH_REF_NAME, bench_ref, &v, 0);
+}
+
+typedef struct {
+    uint8_t *src;
+    uint8_t *dst;
+    size_t size;
+} bench_memcpy_t;
+
+static void bench_memcpy(void *arg)
+{
+    bench_memcpy_t *p = (bench_memcpy_t *)arg;
+
+    neon_memcpy(p->dst, p->src, p->size);
+}
+
+BENCH_GROUP(common_memcpy)
+{
+    int cc = 0;
+    char name[BENCH_MAX_NAME] = { 0 };
+    bench_memcpy_t p = { 0 };
+    // one 256x192 screen in RGB565 and in ARGB8888, as GFX_Copy() stages them
+    const size_t size[] = { 64, 1024, 4096, 98304, 196608, 1048576 };
+    const size_t max_size = 1048576;
+
+    p.src = malloc(max_size);
+    p.dst = malloc(max_size);
+    if (p.src && p.dst) {
+        memset(p.src, 0x5a, max_size);
+        memset(p.dst, 0, max_size);
+        for (cc = 0; cc < (int)(sizeof(size) / sizeof(size[0])); cc++) {
+            p.size = size[cc];
+            snprintf(name, sizeof(name), "neon_memcpy/%d", (int)size[cc]);
+            run_bench(name, bench_memcpy, &p, size[cc]);
+        }
+    }
+    free(p.src);
+    free(p.dst);
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(common_bench)
+{
+    RUN_TEST_CASE(common_bench, calc_bench_stat);
+    RUN_TEST_CASE(common_bench, run_bench);
+    RUN_TEST_CASE(common_bench, compare_bench);
+}
+#endif
@@ -0,0 +1,73 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __COMMON_BENCH_H__
+#define __COMMON_BENCH_H__
+
+#include <stdint.h>
+
+    #define BENCH_MAX_CASE 64
+    #define BENCH_MAX_REPEAT 101
+    #define BENCH_MAX_NAME 48
+    #define BENCH_MAX_OP (1 << 20)
+    #define BENCH_SAMPLE_NS 2000000
+    #define BENCH_DEF_WARMUP 3
+    #define BENCH_DEF_REPEAT 15
+    #define BENCH_DEF_THRESHOLD 50.0
+    #define BENCH_REF_NAME "ref/lcg"
+
+    #define BENCH_STATUS_NEW 0
+    #define BENCH_STATUS_OK 1
+    #define BENCH_STATUS_REGRESS 2
+
+    // kernels live in their own modules and are usually static, so each module
+    // exports one group function that sets up fixed inputs and calls run_bench()
+    #define BENCH_GROUP(g) void bench_group_##g(void)
+    #define RUN_BENCH_GROUP(g) do { extern void bench_group_##g(void); bench_group_##g(); } while (0)
+
+    typedef void (*bench_fn_t)(void *arg);
+
+    // all times are per call of the kernel, "op" calls make up one sample
+    typedef struct _bench_result {
+        char name[BENCH_MAX_NAME];
+        uint32_t op;
+        uint32_t repeat;
+        uint64_t byte;
+        double min_ns;
+        double max_ns;
+        double median_ns;
+        double mean_ns;
+        double stddev_ns;
+        double mbps;
+        double base_ns;
+        double delta;
+        int status;
+    } bench_result_t;
+
+    int init_bench(int warmup, int repeat, const char *filter);
+    int quit_bench(void);
+    int run_bench(const char *name, bench_fn_t fn, void *arg, uint64_t byte);
+    int compare_bench(const char *path, double threshold);
+    int dump_bench(const char *path);
+    int get_bench_count(void);
+    const bench_result_t *get_bench_result(const char *name);
+    const char *get_bench_arch(void);
+
+#endif
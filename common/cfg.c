@@ -43,6 +43,17 @@
 #include "cfg.pb.h"
 
 static char cfg_path[MAX_PATH * 2] = { 0 };
+static int cfg_dirty = 0;
+static int cfg_running = 0;
+static int cfg_sys_vol = -1;
+static int cfg_pend_vol = 0;
+static size_t cfg_pend_len = 0;
+static uint8_t cfg_pend_buf[MAX_MALLOC_SIZE] = { 0 };
+static pthread_t cfg_thread = 0;
+static struct timespec cfg_deadline = { 0 };
+static pthread_cond_t cfg_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t cfg_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t cfg_write_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 miyoo_settings mycfg = miyoo_settings_init_zero;
 
@@ -65,10 +76,316 @@ TEST_SETUP(common_cfg)
 
 TEST_TEAR_DOWN(common_cfg)
 {
+    flush_config_settings();
     unlink(JSON_SYS_FILE);
 }
 #endif
 
+static int write_file_atomic(const char *path, const void *buf, size_t len)
+{
+    int fd = -1;
+    int ret = -1;
+    ssize_t r = 0;
+    size_t cnt = 0;
+    char *p = NULL;
+    char tmp[MAX_PATH * 2 + 8] = { 0 };
+
+    if (!path || !buf) {
+        err(COM"invalid parameters(0x%x, 0x%x) in %s\n", path, buf, __func__);
+        return -1;
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fd = open(tmp, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (fd < 0) {
+        err(COM"failed to create file(\"%s\") in %s\n", tmp, __func__);
+        return -1;
+    }
+
+    do {
+        while (cnt < len) {
+            r = write(fd, (const uint8_t *)buf + cnt, len - cnt);
+            if (r <= 0) {
+                break;
+            }
+            cnt += r;
+        }
+
+        if (cnt != len) {
+            err(COM"failed to write file(\"%s\") in %s\n", tmp, __func__);
+            break;
+        }
+
+        if (fsync(fd) < 0) {
+            err(COM"failed to sync file(\"%s\") in %s\n", tmp, __func__);
+            break;
+        }
+        ret = 0;
+    } while (0);
+    close(fd);
+
+    if (ret < 0) {
+        unlink(tmp);
+        return -1;
+    }
+
+    if (rename(tmp, path) < 0) {
+        err(COM"failed to rename file(\"%s\") in %s\n", tmp, __func__);
+        unlink(tmp);
+        return -1;
+    }
+
+    p = strrchr(tmp, '/');
+    if (p) {
+        *p = 0;
+        fd = open(tmp, O_RDONLY | O_DIRECTORY);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+    }
+
+    info(COM"wrote %ld bytes to \"%s\" in %s\n", (long)len, path, __func__);
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_cfg, write_file_atomic)
+{
+    char buf[32] = { 0 };
+    const char *path = "./cfg_atomic.tmp";
+    int fd = -1;
+
+    TEST_ASSERT_EQUAL_INT(-1, write_file_atomic(NULL, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(-1, write_file_atomic(path, NULL, 0));
+    TEST_ASSERT_EQUAL_INT(0, write_file_atomic(path, "1234", 4));
+    TEST_ASSERT_EQUAL_INT(-1, access("./cfg_atomic.tmp.tmp", F_OK));
+
+    fd = open(path, O_RDONLY);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL_INT(4, read(fd, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("1234", buf);
+    close(fd);
+    unlink(path);
+}
+#endif
+
+static int write_system_volume(int vol)
+{
+    int ret = -1;
+    const char *str = NULL;
+    struct json_object *jfile = NULL;
+
+    jfile = json_object_from_file(JSON_SYS_PATH);
+    if (jfile == NULL) {
+        err(COM"failed to open file(\"%s\") in %s\n", JSON_SYS_PATH, __func__);
+        return -1;
+    }
+
+    json_object_object_add(jfile, JSON_SYS_VOLUME, json_object_new_int(vol));
+    str = json_object_to_json_string_ext(jfile, JSON_C_TO_STRING_PRETTY);
+    if (str) {
+        ret = write_file_atomic(JSON_SYS_PATH, str, strlen(str));
+    }
+    json_object_put(jfile);
+
+    info(COM"wrote new system volume(%d) in %s\n", vol, __func__);
+    return ret;
+}
+
+// the snapshot is taken and written under cfg_write_mutex, so a writer that
+// took an older snapshot can never land on disk after a newer one
+static int write_dirty_settings(void)
+{
+    int ret = 0;
+    int vol = 0;
+    int dirty = 0;
+    size_t len = 0;
+    static uint8_t buf[MAX_MALLOC_SIZE] = { 0 };
+
+    pthread_mutex_lock(&cfg_write_mutex);
+    pthread_mutex_lock(&cfg_mutex);
+    dirty = cfg_dirty;
+    vol = cfg_pend_vol;
+    len = cfg_pend_len;
+    memcpy(buf, cfg_pend_buf, len);
+    cfg_dirty = 0;
+    pthread_mutex_unlock(&cfg_mutex);
+
+    if (dirty & CFG_DIRTY_PB) {
+        if (write_file_atomic(cfg_path, buf, len) < 0) {
+            ret = -1;
+        }
+    }
+
+    if (dirty & CFG_DIRTY_VOL) {
+        if (write_system_volume(vol) < 0) {
+            ret = -1;
+        }
+    }
+    pthread_mutex_unlock(&cfg_write_mutex);
+
+    return ret;
+}
+
+#if defined(UT)
+static void *ut_flush_handler(void *param)
+{
+    *(int *)param = flush_config_settings();
+    return NULL;
+}
+
+TEST(common_cfg, write_dirty_settings)
+{
+    int fd = -1;
+    int ret = -1;
+    pthread_t id = 0;
+    uint8_t buf[MAX_MALLOC_SIZE] = { 0 };
+
+    // a flush that is held off by another writer must not keep the snapshot
+    // it would have taken before, the newer settings have to win
+    strncpy(mycfg.version, "AAA", sizeof(mycfg.version));
+    TEST_ASSERT_EQUAL_INT(0, update_config_settings());
+    pthread_mutex_lock(&cfg_write_mutex);
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&id, NULL, ut_flush_handler, &ret));
+    usleep(50000);
+    strncpy(mycfg.version, "BBB", sizeof(mycfg.version));
+    TEST_ASSERT_EQUAL_INT(0, update_config_settings());
+    pthread_mutex_unlock(&cfg_write_mutex);
+    pthread_join(id, NULL);
+    TEST_ASSERT_EQUAL_INT(0, ret);
+    TEST_ASSERT_EQUAL_INT(0, cfg_dirty);
+
+    fd = open(cfg_path, O_RDONLY);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL_INT(cfg_pend_len, read(fd, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_MEMORY(cfg_pend_buf, buf, cfg_pend_len);
+    close(fd);
+
+    TEST_ASSERT_EQUAL_INT(0, reset_config_settings());
+    TEST_ASSERT_EQUAL_INT(0, update_config_settings());
+}
+#endif
+
+static void *cfg_handler(void *param)
+{
+    struct timespec now = { 0 };
+
+    pthread_mutex_lock(&cfg_mutex);
+    while (cfg_running) {
+        if (!cfg_dirty) {
+            pthread_cond_wait(&cfg_cond, &cfg_mutex);
+            continue;
+        }
+
+        clock_gettime(CLOCK_REALTIME, &now);
+        if ((now.tv_sec < cfg_deadline.tv_sec) ||
+            ((now.tv_sec == cfg_deadline.tv_sec) && (now.tv_nsec < cfg_deadline.tv_nsec)))
+        {
+            pthread_cond_timedwait(&cfg_cond, &cfg_mutex, &cfg_deadline);
+            continue;
+        }
+
+        pthread_mutex_unlock(&cfg_mutex);
+        write_dirty_settings();
+        pthread_mutex_lock(&cfg_mutex);
+    }
+    pthread_mutex_unlock(&cfg_mutex);
+
+    return NULL;
+}
+
+static int mark_dirty(int flag)
+{
+    struct timespec now = { 0 };
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    now.tv_sec += CFG_DEBOUNCE_MS / 1000;
+    now.tv_nsec += (CFG_DEBOUNCE_MS % 1000) * 1000000;
+    if (now.tv_nsec >= 1000000000) {
+        now.tv_sec += 1;
+        now.tv_nsec -= 1000000000;
+    }
+
+    cfg_dirty |= flag;
+    cfg_deadline = now;
+
+    if (!cfg_running) {
+        cfg_running = 1;
+        if (pthread_create(&cfg_thread, NULL, cfg_handler, NULL) != 0) {
+            err(COM"failed to create config thread in %s\n", __func__);
+            cfg_running = 0;
+            cfg_thread = 0;
+            return -1;
+        }
+    }
+    pthread_cond_signal(&cfg_cond);
+
+    return 0;
+}
+
+int flush_config_settings(void)
+{
+    return write_dirty_settings();
+}
+
+#if defined(UT)
+TEST(common_cfg, flush_config_settings)
+{
+    int fd = -1;
+    uint8_t buf[MAX_MALLOC_SIZE] = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(0, flush_config_settings());
+
+    strncpy(mycfg.version, "ZZZ", sizeof(mycfg.version));
+    TEST_ASSERT_EQUAL_INT(0, update_config_settings());
+    TEST_ASSERT_EQUAL_INT(CFG_DIRTY_PB, cfg_dirty & CFG_DIRTY_PB);
+    TEST_ASSERT_EQUAL_INT(0, flush_config_settings());
+    TEST_ASSERT_EQUAL_INT(0, cfg_dirty);
+
+    fd = open(cfg_path, O_RDONLY);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL_INT(cfg_pend_len, read(fd, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_MEMORY(cfg_pend_buf, buf, cfg_pend_len);
+    close(fd);
+
+    TEST_ASSERT_EQUAL_INT(0, reset_config_settings());
+    TEST_ASSERT_EQUAL_INT(0, update_config_settings());
+}
+#endif
+
+int quit_config_settings(void)
+{
+    pthread_mutex_lock(&cfg_mutex);
+    cfg_running = 0;
+    pthread_cond_signal(&cfg_cond);
+    pthread_mutex_unlock(&cfg_mutex);
+
+    if (cfg_thread) {
+        pthread_join(cfg_thread, NULL);
+        cfg_thread = 0;
+    }
+    return flush_config_settings();
+}
+
+#if defined(UT)
+TEST(common_cfg, quit_config_settings)
+{
+    TEST_ASSERT_EQUAL_INT(3, set_system_volume(3));
+    TEST_ASSERT_EQUAL_INT(0, quit_config_settings());
+    TEST_ASSERT_EQUAL_INT(0, cfg_running);
+    TEST_ASSERT_EQUAL_INT(0, cfg_dirty);
+
+    cfg_sys_vol = -1;
+    TEST_ASSERT_EQUAL_INT(3, get_system_volume());
+}
+#endif
+
+static void __attribute__((destructor)) exit_config_settings(void)
+{
+    quit_config_settings();
+}
+
 int load_config_settings(void)
 {
     int ret = -1;
@@ -80,6 +397,7 @@ int load_config_settings(void)
     }
     memset(buf, 0, MAX_MALLOC_SIZE);
 
+    flush_config_settings();
     int fd = open(cfg_path, O_RDONLY);
     do {
         if (fd < 0) {
@@ -113,17 +431,9 @@ TEST(common_cfg, load_config_settings)
 
 int update_config_settings(void)
 {
-    int fd = -1;
     int ret = -1;
-    uint8_t *buf = malloc(MAX_MALLOC_SIZE);
-
-    if (!buf) {
-        err(COM"failed to allocate memory in %s\n", __func__);
-        return ret;
-    }
+    pb_ostream_t stream = { 0 };
 
-    memset(buf, 0, MAX_MALLOC_SIZE);
-    pb_ostream_t stream = pb_ostream_from_buffer(buf, MAX_MALLOC_SIZE);
     mycfg.has_display = true;
     mycfg.display.has_small = true;
 
@@ -150,27 +460,21 @@ int update_config_settings(void)
     mycfg.joy.right.has_x = true;
     mycfg.joy.right.has_y = true;
     mycfg.joy.right.has_remap = true;
-    pb_encode(&stream, miyoo_settings_fields, &mycfg);
 
-    unlink(cfg_path);
-    fd = open(cfg_path, O_CREAT | O_WRONLY, 0644);
+    pthread_mutex_lock(&cfg_mutex);
     do {
-        if (fd < 0) {
-            err(COM"failed to create file(\"%s\") in %s\n", cfg_path, __func__);
+        memset(cfg_pend_buf, 0, sizeof(cfg_pend_buf));
+        stream = pb_ostream_from_buffer(cfg_pend_buf, sizeof(cfg_pend_buf));
+        if (!pb_encode(&stream, miyoo_settings_fields, &mycfg)) {
+            err(COM"failed to encode config settings in %s\n", __func__);
             break;
         }
 
-        ssize_t r = write(fd, buf, stream.bytes_written);
-        if (r < 0) {
-            err(COM"failed to write file(\"%s\") in %s\n", cfg_path, __func__);
-        }
-
-        info(COM"wrote %ld bytes to \"%s\" in %s\n", r, cfg_path, __func__);
-        close(fd);
-        ret = 0;
+        cfg_pend_len = stream.bytes_written;
+        ret = mark_dirty(CFG_DIRTY_PB);
     } while (0);
+    pthread_mutex_unlock(&cfg_mutex);
 
-    free(buf);
     return ret;
 }
 
@@ -211,6 +515,9 @@ TEST(common_cfg, update_config_settings)
 
 int init_config_settings(void)
 {
+    flush_config_settings();
+    cfg_sys_vol = -1;
+
     getcwd(mycfg.home_folder, sizeof(mycfg.home_folder));
 
 #if defined(UT)
@@ -247,6 +554,11 @@ int get_system_volume(void)
     struct json_object *jval = NULL;
     struct json_object *jfile = NULL;
 
+    if (cfg_sys_vol >= 0) {
+        mycfg.system_volume = cfg_sys_vol;
+        return cfg_sys_vol;
+    }
+
     jfile = json_object_from_file(JSON_SYS_PATH);
     if (jfile == NULL) {
         err(COM"failed to open file(\"%s\") in %s\n", JSON_SYS_PATH, __func__);
@@ -255,6 +567,7 @@ int get_system_volume(void)
 
     if (json_object_object_get_ex(jfile, JSON_SYS_VOLUME, &jval)) {
         mycfg.system_volume = json_object_get_int(jval);
+        cfg_sys_vol = mycfg.system_volume;
         info(COM"read system volume(%d) in %s\n", mycfg.system_volume, __func__);
     }
     else {
@@ -275,26 +588,18 @@ TEST(common_cfg, get_system_volume)
 
 int set_system_volume(int vol)
 {
-    struct json_object *jval = NULL;
-    struct json_object *jfile = NULL;
-
     if ((vol < 0) || (vol > MAX_VOLUME)) {
         err(COM"invalid parameter(vol:%d) in %s\n", vol, __func__);
         return -1;
     }
 
-    jfile = json_object_from_file(JSON_SYS_PATH);
-    if (jfile == NULL) {
-        err(COM"failed to open file(\"%s\") in %s\n", JSON_SYS_PATH, __func__);
-        return -1;
-    }
-
-    json_object_object_add(jfile, JSON_SYS_VOLUME, json_object_new_int(vol));
-    info(COM"wrote new system volume(%d) in %s\n", vol, __func__);
-
-    json_object_to_file_ext(JSON_SYS_PATH, jfile, JSON_C_TO_STRING_PRETTY);
-    json_object_put(jfile);
+    pthread_mutex_lock(&cfg_mutex);
+    cfg_sys_vol = vol;
+    cfg_pend_vol = vol;
     mycfg.system_volume = vol;
+    mark_dirty(CFG_DIRTY_VOL);
+    pthread_mutex_unlock(&cfg_mutex);
+
     return vol;
 }
 
@@ -484,6 +789,10 @@ TEST(common_cfg, reset_config_settings)
 #if defined(UT)
 TEST_GROUP_RUNNER(common_cfg)
 {
+    RUN_TEST_CASE(common_cfg, write_file_atomic);
+    RUN_TEST_CASE(common_cfg, write_dirty_settings);
+    RUN_TEST_CASE(common_cfg, flush_config_settings);
+    RUN_TEST_CASE(common_cfg, quit_config_settings);
     RUN_TEST_CASE(common_cfg, load_config_settings);
     RUN_TEST_CASE(common_cfg, update_config_settings);
     RUN_TEST_CASE(common_cfg, get_system_volume);
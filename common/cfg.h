@@ -40,6 +40,9 @@
 #define CFG_PATH "miyoo/settings.pb"
 #define MAX_PATH 128
 #define MAX_MALLOC_SIZE 4096
+#define CFG_DEBOUNCE_MS 1000
+#define CFG_DIRTY_PB 0x01
+#define CFG_DIRTY_VOL 0x02
 
 #define DEF_CFG_VERSION "20250101"
 #define DEF_CFG_LANGUAGE "en_US"
@@ -90,6 +93,8 @@ int reset_config_settings(void);
 int update_config_settings(void);
 int get_system_volume(void);
 int set_system_volume(int vol);
+int flush_config_settings(void);
+int quit_config_settings(void);
 
 #endif
 
@@ -40,6 +40,7 @@
 #include "log.h"
 #include "cfg.h"
 #include "file.h"
+#include "governor.h"
 #include "cfg.pb.h"
 
 #include "nds_firmware.h"
@@ -63,105 +64,272 @@ TEST_TEAR_DOWN(common_file)
 }
 #endif
 
-static int write_file(const char *fpath, const void *buf, int len)
+typedef struct {
+    const char *name;
+    const uint8_t *buf;
+    size_t len;
+} bios_file_t;
+
+static const bios_file_t bios_files[] = {
+    { "drastic_bios_arm7.bin", drastic_bios_arm7, sizeof(drastic_bios_arm7) },
+    { "drastic_bios_arm9.bin", drastic_bios_arm9, sizeof(drastic_bios_arm9) },
+#if GENERATE_ALL_BIOS_FILES
+    { "nds_bios_arm7.bin", nds_bios_arm7, sizeof(nds_bios_arm7) },
+    { "nds_bios_arm9.bin", nds_bios_arm9, sizeof(nds_bios_arm9) },
+    { "nds_firmware.bin", nds_firmware, sizeof(nds_firmware) },
+#endif
+};
+
+static uint32_t calc_checksum(uint32_t sum, const void *buf, size_t len)
+{
+    size_t cc = 0;
+    const uint8_t *p = (const uint8_t *)buf;
+
+    // FNV-1a, fast enough to verify the 256KB firmware on every boot
+    for (cc = 0; cc < len; cc++) {
+        sum ^= p[cc];
+        sum *= FILE_FNV_PRIME;
+    }
+    return sum;
+}
+
+#if defined(UT)
+TEST(common_file, calc_checksum)
+{
+    const char *s = "drastic";
+
+    TEST_ASSERT_EQUAL_HEX32(FILE_FNV_BASIS, calc_checksum(FILE_FNV_BASIS, s, 0));
+    TEST_ASSERT_EQUAL_HEX32(
+        calc_checksum(FILE_FNV_BASIS, s, 7),
+        calc_checksum(calc_checksum(FILE_FNV_BASIS, s, 3), s + 3, 4)
+    );
+    TEST_ASSERT_TRUE(
+        calc_checksum(FILE_FNV_BASIS, "ab", 2) !=
+        calc_checksum(FILE_FNV_BASIS, "ba", 2)
+    );
+}
+#endif
+
+static int verify_file(const char *fpath, const void *buf, size_t len)
 {
     int fd = -1;
+    ssize_t r = 0;
+    size_t cnt = 0;
+    uint32_t sum = FILE_FNV_BASIS;
+    struct stat st = { 0 };
+    static uint8_t chunk[FILE_CHUNK_SIZE] = { 0 };
 
     if (!fpath || !buf) {
         err(COM"invalid parameters(0x%x, 0x%x) in %s\n", fpath, buf, __func__);
         return -1;
     }
 
-    if (access(fpath, F_OK) == 0) {
-        warn(COM"file exists(%s), skip writing in %s\n", fpath, __func__);
-        return 0;
+    if (stat(fpath, &st) < 0) {
+        return -1;
     }
 
-    fd = open(fpath, O_CREAT | O_WRONLY, 0644);
-    if (fd < 0) {
-        err(COM"failed to create file \"%s\" in %s\n", fpath, __func__);
+    if ((size_t)st.st_size != len) {
+        info(COM"size mismatch(%d != %d) for \"%s\" in %s\n",
+            (int)st.st_size, (int)len, fpath, __func__);
         return -1;
     }
 
-    if (write(fd, buf, len) != len) {
-        err(COM"failed to write data to \"%s\" in %s\n", fpath, __func__);
+    fd = open(fpath, O_RDONLY);
+    if (fd < 0) {
+        return -1;
     }
 
+    while (cnt < len) {
+        r = read(fd, chunk, sizeof(chunk));
+        if (r <= 0) {
+            break;
+        }
+        sum = calc_checksum(sum, chunk, r);
+        cnt += r;
+    }
     close(fd);
+
+    if (cnt != len) {
+        err(COM"failed to read file(\"%s\") in %s\n", fpath, __func__);
+        return -1;
+    }
+
+    if (sum != calc_checksum(FILE_FNV_BASIS, buf, len)) {
+        info(COM"checksum mismatch for \"%s\" in %s\n", fpath, __func__);
+        return -1;
+    }
     return 0;
 }
 
 #if defined(UT)
-TEST(common_file, write_file)
+TEST(common_file, verify_file)
 {
-    char buf[32] = { 0 };
+    int fd = -1;
     const char *FPATH = "/tmp/xxx";
 
-    TEST_ASSERT_EQUAL_INT(-1, write_file(NULL, NULL, 0));
-    TEST_ASSERT_EQUAL_INT(0, write_file(FPATH, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(-1, verify_file(NULL, NULL, 0));
+    unlink(FPATH);
+    TEST_ASSERT_EQUAL_INT(-1, verify_file(FPATH, "1234", 4));
+
+    fd = open(FPATH, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL_INT(4, write(fd, "1234", 4));
+    close(fd);
+
+    TEST_ASSERT_EQUAL_INT(0, verify_file(FPATH, "1234", 4));
+    TEST_ASSERT_EQUAL_INT(-1, verify_file(FPATH, "1235", 4));
+    TEST_ASSERT_EQUAL_INT(-1, verify_file(FPATH, "12345", 5));
     unlink(FPATH);
 }
 #endif
 
-int create_bios_files(void)
+static int write_file(const char *fpath, const void *buf, int len)
 {
-    char buf[MAX_PATH] = { 0 };
+    int fd = -1;
+    int ret = -1;
+    ssize_t r = 0;
+    size_t cnt = 0;
+    char *p = NULL;
+    char tmp[MAX_PATH + 8] = { 0 };
 
-    snprintf(buf, sizeof(buf),
-        "%s%s/drastic_bios_arm7.bin", mycfg.home_folder, BIOS_PATH);
-    if (write_file(buf, drastic_bios_arm7, sizeof(drastic_bios_arm7)) < 0)  {
+    if (!fpath || !buf || (len < 0)) {
+        err(COM"invalid parameters(0x%x, 0x%x) in %s\n", fpath, buf, __func__);
         return -1;
     }
-    debug(COM"wrote \"%s\" in %s\n", buf, __func__);
 
-    snprintf(buf, sizeof(buf), "%s%s/drastic_bios_arm9.bin",
-        mycfg.home_folder, BIOS_PATH);
-    if (write_file(buf, drastic_bios_arm9, sizeof(drastic_bios_arm9)) < 0) {
+    if (verify_file(fpath, buf, len) == 0) {
+        debug(COM"file is up to date(%s), skip writing in %s\n", fpath, __func__);
+        return 0;
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", fpath);
+    fd = open(tmp, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (fd < 0) {
+        err(COM"failed to create file \"%s\" in %s\n", tmp, __func__);
         return -1;
     }
-    debug(COM"wrote \"%s\" in %s\n", buf, __func__);
 
-#if GENERATE_ALL_BIOS_FILES
-    snprintf(
-        buf,
-        sizeof(buf),
-        "%s%s/nds_bios_arm7.bin",
-        mycfg.home_folder,
-        BIOS_PATH
-    );
+    do {
+        while (cnt < (size_t)len) {
+            r = write(fd, (const uint8_t *)buf + cnt, len - cnt);
+            if (r <= 0) {
+                break;
+            }
+            cnt += r;
+        }
+
+        if (cnt != (size_t)len) {
+            err(COM"failed to write data to \"%s\" in %s\n", tmp, __func__);
+            break;
+        }
+
+        if (fsync(fd) < 0) {
+            err(COM"failed to sync \"%s\" in %s\n", tmp, __func__);
+            break;
+        }
+        ret = 0;
+    } while (0);
+    close(fd);
 
-    if (write_file(buf, nds_bios_arm7, sizeof(nds_bios_arm7)) < 0) {
+    if (ret < 0) {
+        unlink(tmp);
         return -1;
     }
-    debug(COM"wrote \"%s\" in %s\n", buf, __func__);
 
-    snprintf(
-        buf,
-        sizeof(buf),
-        "%s%s/nds_bios_arm9.bin",
-        mycfg.home_folder,
-        BIOS_PATH
-    );
-
-    if (write_file(buf, nds_bios_arm9, sizeof(nds_bios_arm9)) < 0) {
+    if (rename(tmp, fpath) < 0) {
+        err(COM"failed to rename \"%s\" in %s\n", tmp, __func__);
+        unlink(tmp);
         return -1;
     }
-    debug(COM"wrote \"%s\" in %s\n", buf, __func__);
 
-    snprintf(
-        buf,
-        sizeof(buf),
-        "%s%s/nds_firmware.bin",
-        mycfg.home_folder,
-        BIOS_PATH
-    );
+    p = strrchr(tmp, '/');
+    if (p) {
+        *p = 0;
+        fd = open(tmp, O_RDONLY | O_DIRECTORY);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+    }
+    info(COM"wrote \"%s\"(%d bytes) in %s\n", fpath, len, __func__);
+    return 1;
+}
+
+#if defined(UT)
+TEST(common_file, write_file)
+{
+    int fd = -1;
+    char buf[32] = { 0 };
+    struct stat st0 = { 0 };
+    struct stat st1 = { 0 };
+    const char *FPATH = "/tmp/xxx";
+
+    unlink(FPATH);
+    TEST_ASSERT_EQUAL_INT(-1, write_file(NULL, NULL, 0));
+    TEST_ASSERT_EQUAL_INT(1, write_file(FPATH, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(0, stat(FPATH, &st0));
+    TEST_ASSERT_EQUAL_INT(sizeof(buf), st0.st_size);
+
+    TEST_ASSERT_EQUAL_INT(0, write_file(FPATH, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(0, stat(FPATH, &st1));
+    TEST_ASSERT_EQUAL_INT(st0.st_ino, st1.st_ino);
+
+    buf[0] = 0x55;
+    TEST_ASSERT_EQUAL_INT(1, write_file(FPATH, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(-1, access("/tmp/xxx.tmp", F_OK));
+
+    memset(buf, 0, sizeof(buf));
+    fd = open(FPATH, O_RDONLY);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL_INT(sizeof(buf), read(fd, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_HEX8(0x55, buf[0]);
+    close(fd);
+    unlink(FPATH);
+}
+#endif
 
-    if (write_file(buf, nds_firmware, sizeof(nds_firmware)) < 0) {
+int create_bios_files(void)
+{
+    int r = 0;
+    int cc = 0;
+    int wrote = 0;
+    uint64_t t0 = 0;
+    uint64_t total = get_clock_us(CLOCK_MONOTONIC);
+    char buf[MAX_PATH << 1] = { 0 };
+    char folder[MAX_PATH] = { 0 };
+
+    if (mycfg.home_folder[0]) {
+        snprintf(folder, sizeof(folder), "%s", mycfg.home_folder);
+    }
+    else if (getcwd(folder, sizeof(folder)) == NULL) {
+        err(COM"failed to get current folder in %s\n", __func__);
         return -1;
     }
-    debug(COM"wrote \"%s\" in %s\n", buf, __func__);
-#endif
 
+    for (cc = 0; cc < (int)(sizeof(bios_files) / sizeof(bios_files[0])); cc++) {
+        t0 = get_clock_us(CLOCK_MONOTONIC);
+        snprintf(buf, sizeof(buf), "%s%s/%s", folder, BIOS_PATH, bios_files[cc].name);
+
+        r = write_file(buf, bios_files[cc].buf, bios_files[cc].len);
+        if (r < 0) {
+            return -1;
+        }
+        wrote += r;
+
+        info(COM"%s \"%s\" in %lluus in %s\n",
+            r ? "wrote" : "verified",
+            bios_files[cc].name,
+            (unsigned long long)(get_clock_us(CLOCK_MONOTONIC) - t0),
+            __func__
+        );
+    }
+
+    info(COM"%d/%d bios files written in %lluus in %s\n",
+        wrote,
+        cc,
+        (unsigned long long)(get_clock_us(CLOCK_MONOTONIC) - total),
+        __func__
+    );
     return 0;
 }
 
@@ -217,6 +385,8 @@ TEST(common_file, create_bios_files)
 #if defined(UT)
 TEST_GROUP_RUNNER(common_file)
 {
+    RUN_TEST_CASE(common_file, calc_checksum);
+    RUN_TEST_CASE(common_file, verify_file);
     RUN_TEST_CASE(common_file, write_file);
     RUN_TEST_CASE(common_file, create_bios_files);
 }
@@ -21,9 +21,15 @@
 #ifndef __COMMON_FILE_H__
 #define __COMMON_FILE_H__
 
+#ifndef BIOS_PATH
 #define BIOS_PATH "/system"
+#endif
 #define GENERATE_ALL_BIOS_FILES 0
 
+#define FILE_CHUNK_SIZE (64 * 1024)
+#define FILE_FNV_BASIS  0x811c9dc5
+#define FILE_FNV_PRIME  0x01000193
+
 int create_bios_files(void);
 
 #endif
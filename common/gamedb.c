@@ -0,0 +1,842 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "log.h"
+#include "gamedb.h"
+
+typedef struct {
+    int fd;
+    void *map;
+    size_t map_size;
+    const gamedb_hdr_t *hdr;
+    const gamedb_rec_t *rec;
+    const uint32_t *id;
+    const char *str;
+} gamedb_ctx_t;
+
+typedef struct {
+    gamedb_rec_t *rec;
+    uint32_t count;
+    char *str;
+    uint32_t str_size;
+    uint32_t str_max;
+} gamedb_build_t;
+
+static gamedb_ctx_t db = {
+    .fd = -1,
+};
+
+#if defined(UT)
+#define UT_GAMEDB_XML "./gamedb_ut.xml"
+#define UT_GAMEDB_BIN "./gamedb_ut.bin"
+#define UT_GAMEDB_ROM "./gamedb_ut.nds"
+
+TEST_GROUP(common_gamedb);
+
+TEST_SETUP(common_gamedb)
+{
+    FILE *f = fopen(UT_GAMEDB_XML, "w+");
+
+    if (f) {
+        fprintf(f, "<?xml version='1.0' encoding='UTF-8'?>\n");
+        fprintf(f, "<database>\n");
+        fprintf(f, "  <cartridge title='Yoshi Touch &amp; Go'>\n");
+        fprintf(f, "    <slot1>\n");
+        fprintf(f, "      <rom name='rom' size='0x01000000' crc32='03d56334' id='45495941' title='YOSHI' />\n");
+        fprintf(f, "      <save name='save' size='0x200' type='EEPROM' />\n");
+        fprintf(f, "    </slot1>\n");
+        fprintf(f, "  </cartridge>\n");
+        fprintf(f, "  <cartridge title='Electroplankton'>\n");
+        fprintf(f, "    <slot1>\n");
+        fprintf(f, "      <rom name='rom' size='0x01000000' crc32='94767cd4' id='4a495441' title='ELE' />\n");
+        fprintf(f, "    </slot1>\n");
+        fprintf(f, "  </cartridge>\n");
+        fprintf(f, "  <cartridge title='Yoshi Touch &amp; Go (Rev 1)'>\n");
+        fprintf(f, "    <slot1>\n");
+        fprintf(f, "      <rom name='rom' size='0x02000000' crc32='01234567' id='45495941' title='YOSHI' />\n");
+        fprintf(f, "      <save name='save' size='0x40000' type='Flash' />\n");
+        fprintf(f, "    </slot1>\n");
+        fprintf(f, "  </cartridge>\n");
+        fprintf(f, "  <cartridge title='Yoshi Touch &amp; Go (Kiosk)'>\n");
+        fprintf(f, "    <slot1>\n");
+        fprintf(f, "      <rom name='rom' size='0x02000000' crc32='08ca2198' id='45495941' title='YOSHI' />\n");
+        fprintf(f, "    </slot1>\n");
+        fprintf(f, "  </cartridge>\n");
+        fprintf(f, "</database>\n");
+        fclose(f);
+    }
+}
+
+TEST_TEAR_DOWN(common_gamedb)
+{
+    close_gamedb();
+    unlink(UT_GAMEDB_XML);
+    unlink(UT_GAMEDB_BIN);
+    unlink(UT_GAMEDB_ROM);
+}
+#endif
+
+static int get_xml_attr(const char *tag, const char *end, const char *name, char *buf, int len)
+{
+    int cc = 0;
+    const char *p = tag;
+    char key[32] = { 0 };
+
+    snprintf(key, sizeof(key), " %s='", name);
+    p = strstr(p, key);
+    if (!p || (p >= end)) {
+        return -1;
+    }
+    p += strlen(key);
+
+    while ((p < end) && (*p != '\'') && (cc < (len - 1))) {
+        if (*p == '&') {
+            if (!strncmp(p, "&amp;", 5)) {
+                buf[cc++] = '&';
+                p += 5;
+                continue;
+            }
+            if (!strncmp(p, "&apos;", 6)) {
+                buf[cc++] = '\'';
+                p += 6;
+                continue;
+            }
+            if (!strncmp(p, "&quot;", 6)) {
+                buf[cc++] = '"';
+                p += 6;
+                continue;
+            }
+            if (!strncmp(p, "&lt;", 4)) {
+                buf[cc++] = '<';
+                p += 4;
+                continue;
+            }
+            if (!strncmp(p, "&gt;", 4)) {
+                buf[cc++] = '>';
+                p += 4;
+                continue;
+            }
+        }
+        buf[cc++] = *p++;
+    }
+    buf[cc] = 0;
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_gamedb, get_xml_attr)
+{
+    char buf[32] = { 0 };
+    const char *tag = "<rom size='0x10' title='A &amp; B&apos;s' />";
+
+    TEST_ASSERT_EQUAL_INT(0, get_xml_attr(tag, tag + strlen(tag), "size", buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("0x10", buf);
+    TEST_ASSERT_EQUAL_INT(0, get_xml_attr(tag, tag + strlen(tag), "title", buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("A & B's", buf);
+    TEST_ASSERT_EQUAL_INT(-1, get_xml_attr(tag, tag + strlen(tag), "crc32", buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(-1, get_xml_attr(tag, tag + 8, "title", buf, sizeof(buf)));
+}
+#endif
+
+static int add_title(gamedb_build_t *b, const char *title)
+{
+    char *p = NULL;
+    uint32_t max = 0;
+    uint32_t off = b->str_size;
+    uint32_t len = strlen(title) + 1;
+
+    if ((b->str_size + len) > b->str_max) {
+        max = (b->str_max + len) * 2;
+        p = realloc(b->str, max);
+        if (!p) {
+            err(COM"failed to allocate %d bytes in %s\n", max, __func__);
+            return -1;
+        }
+        b->str = p;
+        b->str_max = max;
+    }
+    memcpy(b->str + off, title, len);
+    b->str_size += len;
+    return off;
+}
+
+static int cmp_rec_crc(const void *a, const void *b)
+{
+    const gamedb_rec_t *r0 = (const gamedb_rec_t *)a;
+    const gamedb_rec_t *r1 = (const gamedb_rec_t *)b;
+
+    if (r0->crc32 != r1->crc32) {
+        return (r0->crc32 < r1->crc32) ? -1 : 1;
+    }
+    return 0;
+}
+
+static const gamedb_rec_t *sort_rec = NULL;
+
+static int cmp_idx_id(const void *a, const void *b)
+{
+    const gamedb_rec_t *r0 = &sort_rec[*(const uint32_t *)a];
+    const gamedb_rec_t *r1 = &sort_rec[*(const uint32_t *)b];
+
+    if (r0->id != r1->id) {
+        return (r0->id < r1->id) ? -1 : 1;
+    }
+    return (*(const uint32_t *)a < *(const uint32_t *)b) ? -1 : 1;
+}
+
+static uint32_t get_save_type(const char *type)
+{
+    if (!strcasecmp(type, "EEPROM")) {
+        return GAMEDB_SAVE_EEPROM;
+    }
+
+    if (!strcasecmp(type, "Flash")) {
+        return GAMEDB_SAVE_FLASH;
+    }
+
+    if (!strcasecmp(type, "NAND")) {
+        return GAMEDB_SAVE_NAND;
+    }
+    return GAMEDB_SAVE_NONE;
+}
+
+static int parse_gamedb(const char *xml, gamedb_build_t *b)
+{
+    int off = 0;
+    const char *p = xml;
+    const char *end = NULL;
+    const char *tag = NULL;
+    const char *tag_end = NULL;
+    gamedb_rec_t *r = NULL;
+    char buf[GAMEDB_TITLE_LEN] = { 0 };
+    char title[GAMEDB_TITLE_LEN] = { 0 };
+
+    b->rec = calloc(GAMEDB_MAX_GAME, sizeof(gamedb_rec_t));
+    if (!b->rec) {
+        return -1;
+    }
+    if (add_title(b, "") < 0) {
+        return -1;
+    }
+
+    while ((p = strstr(p, "<cartridge")) != NULL) {
+        end = strstr(p, "</cartridge>");
+        if (!end) {
+            break;
+        }
+
+        tag_end = strchr(p, '>');
+        if (get_xml_attr(p, tag_end, "title", title, sizeof(title)) < 0) {
+            title[0] = 0;
+        }
+
+        tag = strstr(p, "<rom ");
+        if (tag && (tag < end) && (b->count < GAMEDB_MAX_GAME)) {
+            r = &b->rec[b->count];
+            tag_end = strchr(tag, '>');
+
+            if (get_xml_attr(tag, tag_end, "crc32", buf, sizeof(buf)) == 0) {
+                r->crc32 = strtoul(buf, NULL, 16);
+            }
+
+            if (get_xml_attr(tag, tag_end, "id", buf, sizeof(buf)) == 0) {
+                r->id = strtoul(buf, NULL, 16);
+            }
+
+            if (get_xml_attr(tag, tag_end, "size", buf, sizeof(buf)) == 0) {
+                r->size = strtoul(buf, NULL, 0);
+            }
+
+            tag = strstr(p, "<save ");
+            if (tag && (tag < end)) {
+                tag_end = strchr(tag, '>');
+                if (get_xml_attr(tag, tag_end, "size", buf, sizeof(buf)) == 0) {
+                    r->save_size = strtoul(buf, NULL, 0);
+                }
+
+                if (get_xml_attr(tag, tag_end, "type", buf, sizeof(buf)) == 0) {
+                    r->save_type = get_save_type(buf);
+                }
+            }
+            off = add_title(b, title);
+            if (off < 0) {
+                return -1;
+            }
+            r->title = off;
+            b->count += 1;
+        }
+        p = end;
+    }
+    return 0;
+}
+
+int compile_gamedb(const char *xml, const char *bin)
+{
+    int fd = -1;
+    int ret = -1;
+    char *buf = NULL;
+    FILE *f = NULL;
+    uint32_t cc = 0;
+    uint32_t *idx = NULL;
+    struct stat st = { 0 };
+    gamedb_hdr_t hdr = { 0 };
+    gamedb_build_t b = { 0 };
+    char tmp[256] = { 0 };
+
+    if (!xml || !bin) {
+        err(COM"invalid parameters(0x%x, 0x%x) in %s\n", xml, bin, __func__);
+        return -1;
+    }
+
+    fd = open(xml, O_RDONLY);
+    if ((fd < 0) || (fstat(fd, &st) < 0)) {
+        err(COM"failed to open \"%s\" in %s\n", xml, __func__);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    do {
+        buf = malloc(st.st_size + 1);
+        if (!buf || (read(fd, buf, st.st_size) != st.st_size)) {
+            break;
+        }
+        buf[st.st_size] = 0;
+
+        if (parse_gamedb(buf, &b) < 0) {
+            break;
+        }
+
+        qsort(b.rec, b.count, sizeof(gamedb_rec_t), cmp_rec_crc);
+
+        idx = malloc((b.count + 1) * sizeof(uint32_t));
+        if (!idx) {
+            break;
+        }
+
+        for (cc = 0; cc < b.count; cc++) {
+            idx[cc] = cc;
+        }
+        sort_rec = b.rec;
+        qsort(idx, b.count, sizeof(uint32_t), cmp_idx_id);
+        sort_rec = NULL;
+
+        hdr.magic = GAMEDB_MAGIC;
+        hdr.version = GAMEDB_VERSION;
+        hdr.count = b.count;
+        hdr.rec_off = sizeof(hdr);
+        hdr.id_off = hdr.rec_off + (b.count * sizeof(gamedb_rec_t));
+        hdr.str_off = hdr.id_off + (b.count * sizeof(uint32_t));
+        hdr.str_size = b.str_size;
+
+        snprintf(tmp, sizeof(tmp), "%s.tmp", bin);
+        f = fopen(tmp, "wb");
+        if (!f) {
+            err(COM"failed to create \"%s\" in %s\n", tmp, __func__);
+            break;
+        }
+
+        if ((fwrite(&hdr, sizeof(hdr), 1, f) != 1) ||
+            (fwrite(b.rec, sizeof(gamedb_rec_t), b.count, f) != b.count) ||
+            (fwrite(idx, sizeof(uint32_t), b.count, f) != b.count) ||
+            (fwrite(b.str, 1, b.str_size, f) != b.str_size))
+        {
+            err(COM"failed to write \"%s\" in %s\n", tmp, __func__);
+            fclose(f);
+            unlink(tmp);
+            break;
+        }
+        fclose(f);
+
+        if (rename(tmp, bin) < 0) {
+            unlink(tmp);
+            break;
+        }
+        info(COM"compiled %d games into \"%s\" in %s\n", b.count, bin, __func__);
+        ret = 0;
+    } while (0);
+
+    close(fd);
+    free(buf);
+    free(idx);
+    free(b.rec);
+    free(b.str);
+    return ret;
+}
+
+#if defined(UT)
+TEST(common_gamedb, compile_gamedb)
+{
+    struct stat st = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, compile_gamedb(NULL, UT_GAMEDB_BIN));
+    TEST_ASSERT_EQUAL_INT(-1, compile_gamedb("/NOT_EXIST", UT_GAMEDB_BIN));
+    TEST_ASSERT_EQUAL_INT(0, compile_gamedb(UT_GAMEDB_XML, UT_GAMEDB_BIN));
+    TEST_ASSERT_EQUAL_INT(0, stat(UT_GAMEDB_BIN, &st));
+    TEST_ASSERT_TRUE(st.st_size > (off_t)(sizeof(gamedb_hdr_t) + (3 * sizeof(gamedb_rec_t))));
+}
+#endif
+
+int close_gamedb(void)
+{
+    if (db.map) {
+        munmap(db.map, db.map_size);
+    }
+
+    if (db.fd >= 0) {
+        close(db.fd);
+    }
+
+    memset(&db, 0, sizeof(db));
+    db.fd = -1;
+    return 0;
+}
+
+int open_gamedb(const char *bin)
+{
+    struct stat st = { 0 };
+    const gamedb_hdr_t *hdr = NULL;
+
+    if (!bin) {
+        err(COM"invalid parameter(0x%x) in %s\n", bin, __func__);
+        return -1;
+    }
+
+    close_gamedb();
+    db.fd = open(bin, O_RDONLY);
+    if (db.fd < 0) {
+        warn(COM"failed to open \"%s\" in %s\n", bin, __func__);
+        return -1;
+    }
+
+    if ((fstat(db.fd, &st) < 0) || (st.st_size < (off_t)sizeof(gamedb_hdr_t))) {
+        close_gamedb();
+        return -1;
+    }
+
+    db.map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, db.fd, 0);
+    if (db.map == MAP_FAILED) {
+        db.map = NULL;
+        close_gamedb();
+        return -1;
+    }
+    db.map_size = st.st_size;
+
+    hdr = (const gamedb_hdr_t *)db.map;
+    if ((hdr->magic != GAMEDB_MAGIC) ||
+        (hdr->version != GAMEDB_VERSION) ||
+        (hdr->count > GAMEDB_MAX_GAME) ||
+        (hdr->id_off != (hdr->rec_off + (hdr->count * sizeof(gamedb_rec_t)))) ||
+        (hdr->str_off != (hdr->id_off + (hdr->count * sizeof(uint32_t)))) ||
+        (((uint64_t)hdr->str_off + hdr->str_size) > db.map_size) ||
+        (hdr->str_size == 0))
+    {
+        err(COM"invalid game database \"%s\" in %s\n", bin, __func__);
+        close_gamedb();
+        return -1;
+    }
+
+    db.hdr = hdr;
+    db.rec = (const gamedb_rec_t *)((const uint8_t *)db.map + hdr->rec_off);
+    db.id = (const uint32_t *)((const uint8_t *)db.map + hdr->id_off);
+    db.str = (const char *)db.map + hdr->str_off;
+    info(COM"loaded %d games from \"%s\" in %s\n", hdr->count, bin, __func__);
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_gamedb, open_gamedb)
+{
+    FILE *f = NULL;
+
+    TEST_ASSERT_EQUAL_INT(-1, open_gamedb(NULL));
+    TEST_ASSERT_EQUAL_INT(-1, open_gamedb("/NOT_EXIST"));
+    TEST_ASSERT_EQUAL_INT(0, compile_gamedb(UT_GAMEDB_XML, UT_GAMEDB_BIN));
+    TEST_ASSERT_EQUAL_INT(0, open_gamedb(UT_GAMEDB_BIN));
+    TEST_ASSERT_EQUAL_INT(4, db.hdr->count);
+
+    f = fopen(UT_GAMEDB_BIN, "r+");
+    TEST_ASSERT_NOT_NULL(f);
+    fwrite("XXXX", 1, 4, f);
+    fclose(f);
+    TEST_ASSERT_EQUAL_INT(-1, open_gamedb(UT_GAMEDB_BIN));
+}
+#endif
+
+static void fill_info(const gamedb_rec_t *r, gamedb_info_t *info)
+{
+    info->crc32 = r->crc32;
+    info->id = r->id;
+    info->size = r->size;
+    info->save_size = r->save_size;
+    info->save_type = r->save_type;
+    memcpy(info->code, &r->id, 4);
+    info->code[4] = 0;
+    snprintf(info->title, sizeof(info->title), "%s",
+        (r->title < db.hdr->str_size) ? (db.str + r->title) : "");
+}
+
+int find_gamedb_by_crc(uint32_t crc32, gamedb_info_t *info)
+{
+    int lo = 0;
+    int hi = 0;
+    int mid = 0;
+
+    if (!info) {
+        err(COM"invalid parameter(0x%x) in %s\n", info, __func__);
+        return -1;
+    }
+
+    if (!db.hdr) {
+        return -1;
+    }
+
+    hi = db.hdr->count - 1;
+    while (lo <= hi) {
+        mid = (lo + hi) >> 1;
+        if (db.rec[mid].crc32 == crc32) {
+            fill_info(&db.rec[mid], info);
+            return 0;
+        }
+
+        if (db.rec[mid].crc32 < crc32) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+    return -1;
+}
+
+#if defined(UT)
+TEST(common_gamedb, find_gamedb_by_crc)
+{
+    gamedb_info_t info = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, find_gamedb_by_crc(0x94767cd4, &info));
+    TEST_ASSERT_EQUAL_INT(0, compile_gamedb(UT_GAMEDB_XML, UT_GAMEDB_BIN));
+    TEST_ASSERT_EQUAL_INT(0, open_gamedb(UT_GAMEDB_BIN));
+
+    TEST_ASSERT_EQUAL_INT(-1, find_gamedb_by_crc(0x94767cd4, NULL));
+    TEST_ASSERT_EQUAL_INT(0, find_gamedb_by_crc(0x94767cd4, &info));
+    TEST_ASSERT_EQUAL_STRING("Electroplankton", info.title);
+    TEST_ASSERT_EQUAL_STRING("ATIJ", info.code);
+    TEST_ASSERT_EQUAL_INT(GAMEDB_SAVE_NONE, info.save_type);
+
+    TEST_ASSERT_EQUAL_INT(0, find_gamedb_by_crc(0x03d56334, &info));
+    TEST_ASSERT_EQUAL_STRING("Yoshi Touch & Go", info.title);
+    TEST_ASSERT_EQUAL_INT(0x200, info.save_size);
+    TEST_ASSERT_EQUAL_INT(GAMEDB_SAVE_EEPROM, info.save_type);
+    TEST_ASSERT_EQUAL_INT(-1, find_gamedb_by_crc(0x11111111, &info));
+}
+#endif
+
+int find_gamedb_by_id(uint32_t id, uint32_t size, gamedb_info_t *info)
+{
+    int lo = 0;
+    int hi = 0;
+    int mid = 0;
+    int first = -1;
+
+    if (!info) {
+        err(COM"invalid parameter(0x%x) in %s\n", info, __func__);
+        return -1;
+    }
+
+    if (!db.hdr) {
+        return -1;
+    }
+
+    hi = db.hdr->count;
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (db.rec[db.id[mid]].id < id) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    // several dumps (revisions, regions) can share one game code
+    for (; (lo < (int)db.hdr->count) && (db.rec[db.id[lo]].id == id); lo++) {
+        if (first < 0) {
+            first = lo;
+        }
+
+        if (size && (db.rec[db.id[lo]].size == size)) {
+            first = lo;
+            break;
+        }
+    }
+
+    if (first < 0) {
+        return -1;
+    }
+    fill_info(&db.rec[db.id[first]], info);
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_gamedb, find_gamedb_by_id)
+{
+    gamedb_info_t info = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(0, compile_gamedb(UT_GAMEDB_XML, UT_GAMEDB_BIN));
+    TEST_ASSERT_EQUAL_INT(0, open_gamedb(UT_GAMEDB_BIN));
+
+    TEST_ASSERT_EQUAL_INT(-1, find_gamedb_by_id(0x45495941, 0, NULL));
+    TEST_ASSERT_EQUAL_INT(0, find_gamedb_by_id(0x45495941, 0x02000000, &info));
+    TEST_ASSERT_EQUAL_STRING("Yoshi Touch & Go (Rev 1)", info.title);
+    TEST_ASSERT_EQUAL_INT(GAMEDB_SAVE_FLASH, info.save_type);
+
+    TEST_ASSERT_EQUAL_INT(0, find_gamedb_by_id(0x45495941, 0x01000000, &info));
+    TEST_ASSERT_EQUAL_HEX32(0x03d56334, info.crc32);
+    TEST_ASSERT_EQUAL_INT(0, find_gamedb_by_id(0x4a495441, 0, &info));
+    TEST_ASSERT_EQUAL_INT(-1, find_gamedb_by_id(0x41414141, 0, &info));
+}
+#endif
+
+static int count_gamedb_by_id(uint32_t id, uint32_t size)
+{
+    int lo = 0;
+    int hi = db.hdr->count;
+    int mid = 0;
+    int cnt = 0;
+
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (db.rec[db.id[mid]].id < id) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    for (; (lo < (int)db.hdr->count) && (db.rec[db.id[lo]].id == id); lo++) {
+        if (!size || (db.rec[db.id[lo]].size == size)) {
+            cnt += 1;
+        }
+    }
+    return cnt;
+}
+
+static int get_rom_crc(const char *path, uint32_t *crc)
+{
+    static uint32_t table[256] = { 0 };
+
+    int r = 0;
+    int fd = -1;
+    uint32_t cc = 0;
+    uint32_t k = 0;
+    uint32_t v = 0xffffffff;
+    uint8_t buf[16384] = { 0 };
+
+    if (!table[1]) {
+        for (cc = 0; cc < 256; cc++) {
+            v = cc;
+            for (k = 0; k < 8; k++) {
+                v = (v & 1) ? (0xedb88320 ^ (v >> 1)) : (v >> 1);
+            }
+            table[cc] = v;
+        }
+        v = 0xffffffff;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    while ((r = read(fd, buf, sizeof(buf))) > 0) {
+        for (k = 0; k < (uint32_t)r; k++) {
+            v = table[(v ^ buf[k]) & 0xff] ^ (v >> 8);
+        }
+    }
+    close(fd);
+
+    if (r < 0) {
+        return -1;
+    }
+    *crc = ~v;
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_gamedb, get_rom_crc)
+{
+    FILE *f = NULL;
+    uint32_t crc = 0;
+
+    f = fopen(UT_GAMEDB_ROM, "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    fwrite("123456789", 1, 9, f);
+    fclose(f);
+
+    TEST_ASSERT_EQUAL_INT(-1, get_rom_crc("/NOT_EXIST.nds", &crc));
+    TEST_ASSERT_EQUAL_INT(0, get_rom_crc(UT_GAMEDB_ROM, &crc));
+    TEST_ASSERT_EQUAL_HEX32(0xcbf43926, crc);
+}
+#endif
+
+static int get_rom_path(char *buf, int len)
+{
+    int fd = -1;
+    int r = 0;
+    char *p = NULL;
+    char cmd[512] = { 0 };
+
+    fd = open("/proc/self/cmdline", O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    r = read(fd, cmd, sizeof(cmd) - 1);
+    close(fd);
+
+    if (r <= 0) {
+        return -1;
+    }
+
+    // drastic is launched as "./drastic <rom>"
+    p = cmd + strlen(cmd) + 1;
+    if ((p >= (cmd + r)) || !p[0]) {
+        return -1;
+    }
+    snprintf(buf, len, "%s", p);
+    return 0;
+}
+
+int identify_game(const char *rom, const char *name, gamedb_info_t *info)
+{
+    int fd = -1;
+    uint32_t id = 0;
+    uint32_t crc = 0;
+    uint32_t size = 0;
+    const char *base = NULL;
+    uint8_t hdr[GAMEDB_ROM_HDR_LEN] = { 0 };
+    char path[256] = { 0 };
+
+    if (!info) {
+        err(COM"invalid parameter(0x%x) in %s\n", info, __func__);
+        return -1;
+    }
+
+    if (rom) {
+        snprintf(path, sizeof(path), "%s", rom);
+    }
+    else if (get_rom_path(path, sizeof(path)) < 0) {
+        return -1;
+    }
+
+    base = strrchr(path, '/');
+    base = base ? (base + 1) : path;
+    if (name && name[0] && strncmp(base, name, strlen(name))) {
+        warn(COM"rom(\"%s\") is not \"%s\" in %s\n", base, name, __func__);
+        return -1;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (read(fd, hdr, sizeof(hdr)) != sizeof(hdr)) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    // game code at 0x0c, chip capacity at 0x14 is 128KB << n
+    memcpy(&id, &hdr[0x0c], sizeof(id));
+    size = (hdr[0x14] < 16) ? (0x20000 << hdr[0x14]) : 0;
+
+    // revisions and kiosk dumps can share the code and size, only crc32 tells
+    // them apart and it costs a full read, so it is done only for those
+    if (db.hdr && (count_gamedb_by_id(id, size) > 1)) {
+        if ((get_rom_crc(path, &crc) == 0) && (find_gamedb_by_crc(crc, info) == 0) && (info->id == id)) {
+            return 0;
+        }
+    }
+    return find_gamedb_by_id(id, size, info);
+}
+
+#if defined(UT)
+TEST(common_gamedb, identify_game)
+{
+    FILE *f = NULL;
+    uint8_t hdr[GAMEDB_ROM_HDR_LEN] = { 0 };
+    gamedb_info_t info = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(0, compile_gamedb(UT_GAMEDB_XML, UT_GAMEDB_BIN));
+    TEST_ASSERT_EQUAL_INT(0, open_gamedb(UT_GAMEDB_BIN));
+
+    memcpy(&hdr[0x0c], "AYIE", 4);
+    hdr[0x14] = 8;
+    f = fopen(UT_GAMEDB_ROM, "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    fwrite(hdr, 1, sizeof(hdr), f);
+    fclose(f);
+
+    TEST_ASSERT_EQUAL_INT(-1, identify_game(UT_GAMEDB_ROM, NULL, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, identify_game("/NOT_EXIST.nds", NULL, &info));
+    TEST_ASSERT_EQUAL_INT(-1, identify_game(UT_GAMEDB_ROM, "other", &info));
+    TEST_ASSERT_EQUAL_INT(0, identify_game(UT_GAMEDB_ROM, "gamedb_ut", &info));
+    TEST_ASSERT_EQUAL_STRING("AYIE", info.code);
+    TEST_ASSERT_EQUAL_STRING("Yoshi Touch & Go (Rev 1)", info.title);
+
+    f = fopen(UT_GAMEDB_ROM, "ab");
+    TEST_ASSERT_NOT_NULL(f);
+    fwrite("K", 1, 1, f);
+    fclose(f);
+    TEST_ASSERT_EQUAL_INT(0, identify_game(UT_GAMEDB_ROM, NULL, &info));
+    TEST_ASSERT_EQUAL_HEX32(0x08ca2198, info.crc32);
+    TEST_ASSERT_EQUAL_STRING("Yoshi Touch & Go (Kiosk)", info.title);
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(common_gamedb)
+{
+    RUN_TEST_CASE(common_gamedb, get_xml_attr);
+    RUN_TEST_CASE(common_gamedb, compile_gamedb);
+    RUN_TEST_CASE(common_gamedb, open_gamedb);
+    RUN_TEST_CASE(common_gamedb, find_gamedb_by_crc);
+    RUN_TEST_CASE(common_gamedb, find_gamedb_by_id);
+    RUN_TEST_CASE(common_gamedb, get_rom_crc);
+    RUN_TEST_CASE(common_gamedb, identify_game);
+}
+#endif
+
@@ -0,0 +1,77 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __COMMON_GAMEDB_H__
+#define __COMMON_GAMEDB_H__
+
+#include <stdint.h>
+
+#define GAMEDB_MAGIC 0x42444753
+#define GAMEDB_VERSION 1
+#define GAMEDB_XML "game_database.xml"
+#define GAMEDB_FILE "game_database.bin"
+#define GAMEDB_MAX_GAME 16384
+#define GAMEDB_TITLE_LEN 128
+#define GAMEDB_ROM_HDR_LEN 0x200
+
+#define GAMEDB_SAVE_NONE 0
+#define GAMEDB_SAVE_EEPROM 1
+#define GAMEDB_SAVE_FLASH 2
+#define GAMEDB_SAVE_NAND 3
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t rec_off;
+    uint32_t id_off;
+    uint32_t str_off;
+    uint32_t str_size;
+    uint32_t reserved;
+} gamedb_hdr_t;
+
+typedef struct {
+    uint32_t crc32;
+    uint32_t id;
+    uint32_t size;
+    uint32_t save_size;
+    uint32_t title;
+    uint32_t save_type;
+} gamedb_rec_t;
+
+typedef struct {
+    uint32_t crc32;
+    uint32_t id;
+    uint32_t size;
+    uint32_t save_size;
+    uint32_t save_type;
+    char code[5];
+    char title[GAMEDB_TITLE_LEN];
+} gamedb_info_t;
+
+int compile_gamedb(const char *xml, const char *bin);
+int open_gamedb(const char *bin);
+int close_gamedb(void);
+int find_gamedb_by_crc(uint32_t crc32, gamedb_info_t *info);
+int find_gamedb_by_id(uint32_t id, uint32_t size, gamedb_info_t *info);
+int identify_game(const char *rom, const char *name, gamedb_info_t *info);
+
+#endif
+
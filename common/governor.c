@@ -0,0 +1,463 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#define _GNU_SOURCE
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "log.h"
+#include "governor.h"
+
+static governor_t gov = { 0 };
+
+#if defined(UT)
+static int fake_clock = 0;
+
+static int fake_set_clock(int clk)
+{
+    fake_clock = clk;
+    return 0;
+}
+
+TEST_GROUP(common_governor);
+
+TEST_SETUP(common_governor)
+{
+    fake_clock = 0;
+    init_governor(400, 1400, 1000, fake_set_clock);
+}
+
+TEST_TEAR_DOWN(common_governor)
+{
+    quit_governor();
+}
+#endif
+
+uint64_t get_clock_us(clockid_t id)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(id, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+#if defined(UT)
+TEST(common_governor, get_clock_us)
+{
+    uint64_t t0 = get_clock_us(CLOCK_MONOTONIC);
+
+    usleep(1000);
+    TEST_ASSERT_TRUE(get_clock_us(CLOCK_MONOTONIC) > t0);
+}
+#endif
+
+uint64_t get_clock_ns(clockid_t id)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(id, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+#if defined(UT)
+TEST(common_governor, get_clock_ns)
+{
+    uint64_t t0 = get_clock_ns(CLOCK_MONOTONIC_RAW);
+
+    usleep(1000);
+    TEST_ASSERT_TRUE((get_clock_ns(CLOCK_MONOTONIC_RAW) - t0) >= 1000000);
+}
+#endif
+
+static int limit_clock(int clk)
+{
+    if (clk > gov.max) {
+        clk = gov.max;
+    }
+    if (clk < gov.min) {
+        clk = gov.min;
+    }
+    return clk;
+}
+
+int init_governor(int min, int max, int cur, int (*set_clock)(int))
+{
+    if ((min <= 0) || (max < min) || !set_clock) {
+        err(COM"invalid parameters(%d, %d, 0x%x) in %s\n", min, max, set_clock, __func__);
+        return -1;
+    }
+
+    if (gov.trace) {
+        fclose(gov.trace);
+    }
+    memset(&gov, 0, sizeof(gov));
+
+    gov.min = (min < GOV_HW_MIN) ? GOV_HW_MIN : min;
+    gov.max = (max > GOV_HW_MAX) ? GOV_HW_MAX : max;
+    if (gov.max < gov.min) {
+        gov.max = gov.min;
+    }
+
+    gov.enable = 1;
+    gov.set_clock = set_clock;
+    gov.cur = limit_clock(cur);
+    gov.peak = gov.cur;
+    gov.start_us = get_clock_us(CLOCK_MONOTONIC);
+    info(COM"governor range %d~%dMHz, start %dMHz in %s\n", gov.min, gov.max, gov.cur, __func__);
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_governor, init_governor)
+{
+    TEST_ASSERT_EQUAL_INT(-1, init_governor(0, 0, 0, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, init_governor(800, 400, 600, fake_set_clock));
+    TEST_ASSERT_EQUAL_INT(0, init_governor(1, 99999, 99999, fake_set_clock));
+    TEST_ASSERT_EQUAL_INT(GOV_HW_MIN, gov.min);
+    TEST_ASSERT_EQUAL_INT(GOV_HW_MAX, gov.max);
+    TEST_ASSERT_EQUAL_INT(GOV_HW_MAX, gov.cur);
+}
+#endif
+
+int set_governor_enable(int enable)
+{
+    gov.enable = enable ? 1 : 0;
+    info(COM"governor %s in %s\n", gov.enable ? "enabled" : "disabled", __func__);
+    return gov.enable;
+}
+
+int set_governor_range(int min, int max)
+{
+    if ((min <= 0) || (max < min)) {
+        err(COM"invalid parameters(%d, %d) in %s\n", min, max, __func__);
+        return -1;
+    }
+
+    gov.min = (min < GOV_HW_MIN) ? GOV_HW_MIN : min;
+    gov.max = (max > GOV_HW_MAX) ? GOV_HW_MAX : max;
+    if (gov.max < gov.min) {
+        gov.max = gov.min;
+    }
+
+    if (limit_clock(gov.cur) != gov.cur) {
+        gov.cur = limit_clock(gov.cur);
+        if (gov.set_clock) {
+            gov.set_clock(gov.cur);
+        }
+    }
+    gov.peak = gov.cur;
+    info(COM"governor range %d~%dMHz in %s\n", gov.min, gov.max, __func__);
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_governor, set_governor_range)
+{
+    TEST_ASSERT_EQUAL_INT(-1, set_governor_range(0, 0));
+    TEST_ASSERT_EQUAL_INT(-1, set_governor_range(800, 600));
+    TEST_ASSERT_EQUAL_INT(0, set_governor_range(1, 800));
+    TEST_ASSERT_EQUAL_INT(GOV_HW_MIN, gov.min);
+    TEST_ASSERT_EQUAL_INT(800, gov.max);
+    TEST_ASSERT_EQUAL_INT(800, gov.cur);
+    TEST_ASSERT_EQUAL_INT(800, fake_clock);
+    TEST_ASSERT_EQUAL_INT(0, set_governor_range(900, 99999));
+    TEST_ASSERT_EQUAL_INT(GOV_HW_MAX, gov.max);
+    TEST_ASSERT_EQUAL_INT(900, gov.cur);
+}
+#endif
+
+static int step_clock(int delta)
+{
+    int clk = limit_clock(gov.cur + delta);
+
+    if (clk == gov.cur) {
+        return 0;
+    }
+
+    if (gov.set_clock(clk) < 0) {
+        err(COM"failed to set cpu clock(%d) in %s\n", clk, __func__);
+        return -1;
+    }
+
+    debug(COM"governor %dMHz -> %dMHz in %s\n", gov.cur, clk, __func__);
+    gov.cur = clk;
+    if (gov.cur > gov.peak) {
+        gov.peak = gov.cur;
+    }
+    gov.cooldown = GOV_COOLDOWN;
+    gov.down_cnt = 0;
+    return 1;
+}
+
+static void end_window(void)
+{
+    uint32_t avg = gov.sum_us / gov.frames;
+    uint32_t predict = 0;
+
+    if (gov.trace) {
+        fprintf(gov.trace, "%llu,%d,%u,%u,%u\n",
+            (unsigned long long)((get_clock_us(CLOCK_MONOTONIC) - gov.start_us) / 1000),
+            gov.cur, avg, gov.max_us, gov.miss);
+    }
+
+    if (gov.cooldown > 0) {
+        gov.cooldown -= 1;
+    }
+    else if (gov.max_us >= GOV_UP_US) {
+        step_clock(GOV_STEP_UP);
+    }
+    else if (gov.max_us < GOV_DOWN_US) {
+        predict = (gov.max_us * gov.cur) / limit_clock(gov.cur - GOV_STEP_DOWN);
+        gov.down_cnt = (predict < GOV_UP_US) ? (gov.down_cnt + 1) : 0;
+        if (gov.down_cnt >= GOV_DOWN_HOLD) {
+            step_clock(-GOV_STEP_DOWN);
+        }
+    }
+    else {
+        gov.down_cnt = 0;
+    }
+
+    gov.frames = 0;
+    gov.sum_us = 0;
+    gov.max_us = 0;
+    gov.miss = 0;
+}
+
+int update_governor(uint32_t emu_us, uint32_t comp_us)
+{
+    uint32_t load = (emu_us > comp_us) ? emu_us : comp_us;
+
+    if (!gov.enable || !gov.set_clock) {
+        return gov.cur;
+    }
+
+    gov.frames += 1;
+    gov.sum_us += load;
+    if (load > gov.max_us) {
+        gov.max_us = load;
+    }
+
+    if (load >= GOV_FRAME_US) {
+        gov.miss += 1;
+        if (gov.cooldown == 0) {
+            step_clock(GOV_STEP_UP);
+        }
+    }
+
+    if (gov.frames >= GOV_WINDOW) {
+        end_window();
+    }
+    return gov.cur;
+}
+
+#if defined(UT)
+TEST(common_governor, update_governor)
+{
+    int cc = 0;
+
+    for (cc = 0; cc < GOV_WINDOW; cc++) {
+        update_governor(GOV_UP_US, 1000);
+    }
+    TEST_ASSERT_EQUAL_INT(1000 + GOV_STEP_UP, gov.cur);
+    TEST_ASSERT_EQUAL_INT(gov.cur, fake_clock);
+
+    for (cc = 0; cc < (GOV_WINDOW * GOV_COOLDOWN); cc++) {
+        update_governor(1000, 1000);
+    }
+    TEST_ASSERT_EQUAL_INT(1000 + GOV_STEP_UP, gov.cur);
+
+    TEST_ASSERT_EQUAL_INT(1200 + GOV_STEP_UP, update_governor(GOV_FRAME_US, 1000));
+    TEST_ASSERT_EQUAL_INT(1400, update_governor(GOV_FRAME_US, 1000));
+
+    for (cc = 0; cc < (GOV_WINDOW * (GOV_COOLDOWN + GOV_DOWN_HOLD + 1)); cc++) {
+        update_governor(1000, 1000);
+    }
+    TEST_ASSERT_EQUAL_INT(1400 - GOV_STEP_DOWN, gov.cur);
+    TEST_ASSERT_EQUAL_INT(1400, gov.peak);
+
+    set_governor_enable(0);
+    fake_clock = 0;
+    for (cc = 0; cc < (GOV_WINDOW * 2); cc++) {
+        update_governor(GOV_FRAME_US, GOV_FRAME_US);
+    }
+    TEST_ASSERT_EQUAL_INT(0, fake_clock);
+}
+#endif
+
+int load_governor_profile(const char *path)
+{
+    FILE *f = NULL;
+    char buf[64] = { 0 };
+
+    if (!path) {
+        err(COM"invalid parameter(0x%x) in %s\n", path, __func__);
+        return -1;
+    }
+
+    f = fopen(path, "r");
+    if (!f) {
+        info(COM"no governor profile(\"%s\") in %s\n", path, __func__);
+        return -1;
+    }
+
+    while (fgets(buf, sizeof(buf), f)) {
+        if (!strncmp(buf, "min=", 4)) {
+            gov.min = (atoi(&buf[4]) < GOV_HW_MIN) ? GOV_HW_MIN : atoi(&buf[4]);
+        }
+        else if (!strncmp(buf, "max=", 4)) {
+            gov.max = (atoi(&buf[4]) > GOV_HW_MAX) ? GOV_HW_MAX : atoi(&buf[4]);
+        }
+        else if (!strncmp(buf, "start=", 6)) {
+            gov.cur = atoi(&buf[6]);
+        }
+    }
+    fclose(f);
+
+    if (gov.max < gov.min) {
+        gov.max = gov.min;
+    }
+
+    gov.cur = limit_clock(gov.cur);
+    gov.peak = gov.cur;
+    if (gov.set_clock) {
+        gov.set_clock(gov.cur);
+    }
+    info(COM"loaded governor profile(\"%s\") %d~%dMHz, start %dMHz in %s\n", path, gov.min, gov.max, gov.cur, __func__);
+    return 0;
+}
+
+int save_governor_profile(const char *path)
+{
+    FILE *f = NULL;
+
+    if (!path) {
+        err(COM"invalid parameter(0x%x) in %s\n", path, __func__);
+        return -1;
+    }
+
+    f = fopen(path, "w");
+    if (!f) {
+        err(COM"failed to create file(\"%s\") in %s\n", path, __func__);
+        return -1;
+    }
+
+    fprintf(f, "min=%d\n", gov.min);
+    fprintf(f, "max=%d\n", gov.max);
+    fprintf(f, "start=%d\n", gov.peak);
+    fclose(f);
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_governor, governor_profile)
+{
+    const char *path = "./governor_profile.txt";
+
+    TEST_ASSERT_EQUAL_INT(-1, load_governor_profile(NULL));
+    TEST_ASSERT_EQUAL_INT(-1, save_governor_profile(NULL));
+    TEST_ASSERT_EQUAL_INT(-1, load_governor_profile("/NOT_EXIST"));
+
+    gov.min = 500;
+    gov.max = 1300;
+    gov.peak = 1100;
+    TEST_ASSERT_EQUAL_INT(0, save_governor_profile(path));
+
+    init_governor(400, 1400, 600, fake_set_clock);
+    TEST_ASSERT_EQUAL_INT(0, load_governor_profile(path));
+    TEST_ASSERT_EQUAL_INT(500, gov.min);
+    TEST_ASSERT_EQUAL_INT(1300, gov.max);
+    TEST_ASSERT_EQUAL_INT(1100, gov.cur);
+    TEST_ASSERT_EQUAL_INT(1100, fake_clock);
+    unlink(path);
+}
+#endif
+
+int open_governor_trace(const char *path)
+{
+    if (!path) {
+        err(COM"invalid parameter(0x%x) in %s\n", path, __func__);
+        return -1;
+    }
+
+    if (gov.trace) {
+        fclose(gov.trace);
+    }
+
+    gov.trace = fopen(path, "w");
+    if (!gov.trace) {
+        err(COM"failed to create file(\"%s\") in %s\n", path, __func__);
+        return -1;
+    }
+
+    setvbuf(gov.trace, NULL, _IOFBF, 4096);
+    fprintf(gov.trace, "ms,mhz,avg_us,max_us,miss\n");
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_governor, open_governor_trace)
+{
+    int cc = 0;
+    struct stat st = { 0 };
+    const char *path = "./governor_trace.csv";
+
+    TEST_ASSERT_EQUAL_INT(-1, open_governor_trace(NULL));
+    TEST_ASSERT_EQUAL_INT(0, open_governor_trace(path));
+    for (cc = 0; cc < GOV_WINDOW; cc++) {
+        update_governor(1000, 1000);
+    }
+    TEST_ASSERT_EQUAL_INT(0, quit_governor());
+    TEST_ASSERT_EQUAL_INT(0, stat(path, &st));
+    TEST_ASSERT_TRUE(st.st_size > 0);
+    unlink(path);
+}
+#endif
+
+int quit_governor(void)
+{
+    if (gov.trace) {
+        fclose(gov.trace);
+        gov.trace = NULL;
+    }
+    gov.enable = 0;
+    return 0;
+}
+
+#if defined(UT)
+TEST_GROUP_RUNNER(common_governor)
+{
+    RUN_TEST_CASE(common_governor, get_clock_us);
+    RUN_TEST_CASE(common_governor, get_clock_ns);
+    RUN_TEST_CASE(common_governor, init_governor);
+    RUN_TEST_CASE(common_governor, set_governor_range);
+    RUN_TEST_CASE(common_governor, update_governor);
+    RUN_TEST_CASE(common_governor, governor_profile);
+    RUN_TEST_CASE(common_governor, open_governor_trace);
+}
+#endif
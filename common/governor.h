@@ -0,0 +1,75 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __COMMON_GOVERNOR_H__
+#define __COMMON_GOVERNOR_H__
+
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#if defined(A30)
+#define GOV_HW_MIN 648
+#define GOV_HW_MAX 1512
+#else
+#define GOV_HW_MIN 400
+#define GOV_HW_MAX 1500
+#endif
+
+#define GOV_FRAME_US 16667
+#define GOV_UP_US 14000
+#define GOV_DOWN_US 9000
+#define GOV_WINDOW 30
+#define GOV_DOWN_HOLD 4
+#define GOV_COOLDOWN 2
+#define GOV_STEP_UP 200
+#define GOV_STEP_DOWN 50
+#define GOV_PROFILE_PATH "miyoo/governor"
+#define GOV_TRACE_FILE "miyoo_governor_trace.csv"
+
+typedef struct {
+    int enable;
+    int min;
+    int max;
+    int cur;
+    int peak;
+    int down_cnt;
+    int cooldown;
+    int frames;
+    uint32_t sum_us;
+    uint32_t max_us;
+    uint32_t miss;
+    uint64_t start_us;
+    FILE *trace;
+    int (*set_clock)(int);
+} governor_t;
+
+uint64_t get_clock_us(clockid_t id);
+uint64_t get_clock_ns(clockid_t id);
+int init_governor(int min, int max, int cur, int (*set_clock)(int));
+int quit_governor(void);
+int set_governor_enable(int enable);
+int set_governor_range(int min, int max);
+int update_governor(uint32_t emu_us, uint32_t comp_us);
+int load_governor_profile(const char *path);
+int save_governor_profile(const char *path);
+int open_governor_trace(const char *path);
+
+#endif
@@ -21,11 +21,16 @@
 #define _GNU_SOURCE
 #include <time.h>
 #include <stdio.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdarg.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
 
 #if defined(UT)
 #include "unity_fixture.h"
@@ -35,6 +40,18 @@
 #include "hook.h"
 
 static int debug_level = LOG_LEVEL_DEFAULT;
+static int log_fd = -1;
+static off_t log_size = 0;
+static int log_running = 0;
+static pthread_t log_thread = 0;
+static pthread_key_t log_key = 0;
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static log_ring_t log_ring[LOG_MAX_RING] = { 0 };
+static log_site_t log_site[LOG_MAX_SITE] = { 0 };
+static __thread log_ring_t *my_ring = NULL;
+static __thread time_t stamp_time = 0;
+static __thread char stamp_buf[64] = { 0 };
 
 #if defined(UT)
 TEST_GROUP(common_log);
@@ -64,39 +81,363 @@ TEST(common_log, set_debug_level)
 }
 #endif
 
+static int open_log_file(void)
+{
+    struct stat st = { 0 };
+
+    log_fd = open(LOG_FILE_NAME, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd < 0) {
+        return -1;
+    }
+
+    log_size = 0;
+    if (fstat(log_fd, &st) == 0) {
+        log_size = st.st_size;
+    }
+    return 0;
+}
+
+static int rotate_log_file(void)
+{
+    if (log_fd >= 0) {
+        close(log_fd);
+        log_fd = -1;
+    }
+
+    rename(LOG_FILE_NAME, LOG_FILE_OLD);
+    return open_log_file();
+}
+
+#if defined(UT)
+TEST(common_log, rotate_log_file)
+{
+    pthread_mutex_lock(&log_mutex);
+    TEST_ASSERT_EQUAL_INT(0, rotate_log_file());
+    TEST_ASSERT_EQUAL_INT(0, log_size);
+    TEST_ASSERT_EQUAL_INT(0, access(LOG_FILE_OLD, F_OK));
+    pthread_mutex_unlock(&log_mutex);
+    unlink(LOG_FILE_OLD);
+}
+#endif
+
+static int write_lines(struct iovec *iov, int cnt)
+{
+    ssize_t r = 0;
+
+    if (!iov || (cnt <= 0)) {
+        return -1;
+    }
+
+    if ((log_fd < 0) && (open_log_file() < 0)) {
+        return -1;
+    }
+
+    r = writev(log_fd, iov, cnt);
+    if (r > 0) {
+        log_size += r;
+    }
+
+    if (log_size >= LOG_MAX_SIZE) {
+        rotate_log_file();
+    }
+    return (r < 0) ? -1 : 0;
+}
+
+static int flush_ring(log_ring_t *r)
+{
+    int cnt = 0;
+    int total = 0;
+    uint32_t tail = 0;
+    uint32_t head = 0;
+    uint32_t dropped = 0;
+    char tmp[64] = { 0 };
+    struct iovec iov[LOG_MAX_IOV] = { 0 };
+
+    dropped = __atomic_exchange_n(&r->dropped, 0, __ATOMIC_RELAXED);
+    if (dropped) {
+        iov[0].iov_base = tmp;
+        iov[0].iov_len = snprintf(tmp, sizeof(tmp), COM"dropped %u log lines\n", dropped);
+        write_lines(iov, 1);
+    }
+
+    tail = r->tail;
+    head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    while (tail != head) {
+        cnt = 0;
+        while ((tail + cnt != head) && (cnt < LOG_MAX_IOV)) {
+            log_line_t *l = &r->line[(tail + cnt) & (LOG_RING_LEN - 1)];
+
+            iov[cnt].iov_base = l->buf;
+            iov[cnt].iov_len = l->len;
+            cnt += 1;
+        }
+
+        write_lines(iov, cnt);
+        tail += cnt;
+        total += cnt;
+        __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+    }
+    return total;
+}
+
+int flush_log(void)
+{
+    int cc = 0;
+    int total = 0;
+
+    pthread_mutex_lock(&log_mutex);
+    for (cc = 0; cc < LOG_MAX_RING; cc++) {
+        total += flush_ring(&log_ring[cc]);
+    }
+    pthread_mutex_unlock(&log_mutex);
+
+    return total;
+}
+
+#if defined(UT)
+TEST(common_log, flush_log)
+{
+    off_t size = 0;
+    struct stat st = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(LOG_LEVEL_DEBUG, set_debug_level(LOG_LEVEL_DEBUG));
+    flush_log();
+    if (stat(LOG_FILE_NAME, &st) == 0) {
+        size = st.st_size;
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, write_log_to_file(LOG_LEVEL_INFO, INFO, COM"run test with flush\n"));
+    flush_log();
+    TEST_ASSERT_EQUAL_INT(0, flush_log());
+    TEST_ASSERT_EQUAL_INT(0, stat(LOG_FILE_NAME, &st));
+    TEST_ASSERT_TRUE(st.st_size > size);
+}
+#endif
+
+static void *log_handler(void *param)
+{
+    while (__atomic_load_n(&log_running, __ATOMIC_ACQUIRE)) {
+        usleep(LOG_FLUSH_MS * 1000);
+        flush_log();
+    }
+    return NULL;
+}
+
+static void release_ring(void *param)
+{
+    log_ring_t *r = (log_ring_t *)param;
+
+    if (r) {
+        __atomic_store_n(&r->used, 0, __ATOMIC_RELEASE);
+    }
+}
+
+static void init_log(void)
+{
+    pthread_key_create(&log_key, release_ring);
+
+    log_running = 1;
+    if (pthread_create(&log_thread, NULL, log_handler, NULL) != 0) {
+        log_running = 0;
+        log_thread = 0;
+    }
+}
+
+static void __attribute__((destructor)) quit_log(void)
+{
+    if (log_thread) {
+        __atomic_store_n(&log_running, 0, __ATOMIC_RELEASE);
+        pthread_join(log_thread, NULL);
+        log_thread = 0;
+    }
+
+    flush_log();
+    if (log_fd >= 0) {
+        close(log_fd);
+        log_fd = -1;
+    }
+}
+
+static log_ring_t *get_ring(void)
+{
+    int cc = 0;
+    uint32_t used = 0;
+
+    if (my_ring) {
+        return my_ring;
+    }
+
+    for (cc = 0; cc < LOG_MAX_RING; cc++) {
+        used = 0;
+        if (__atomic_compare_exchange_n(&log_ring[cc].used, &used, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            my_ring = &log_ring[cc];
+            pthread_setspecific(log_key, my_ring);
+            return my_ring;
+        }
+    }
+    return NULL;
+}
+
+#if defined(UT)
+TEST(common_log, get_ring)
+{
+    TEST_ASSERT_NOT_NULL(get_ring());
+    TEST_ASSERT_EQUAL_PTR(get_ring(), get_ring());
+    TEST_ASSERT_EQUAL_INT(1, get_ring()->used);
+}
+#endif
+
+static int check_rate_limit(uintptr_t site, uint32_t sec, uint32_t *missed)
+{
+    int cc = 0;
+    uintptr_t key = 0;
+    uint32_t idx = (uint32_t)(site >> 2) * 2654435761u;
+    log_site_t *s = NULL;
+
+    for (cc = 0; cc < LOG_SITE_PROBE; cc++) {
+        s = &log_site[(idx + cc) & (LOG_MAX_SITE - 1)];
+
+        key = __atomic_load_n(&s->site, __ATOMIC_ACQUIRE);
+        if (key == 0) {
+            __atomic_compare_exchange_n(&s->site, &key, site, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+            if (key == 0) {
+                key = site;
+            }
+        }
+
+        if (key == site) {
+            break;
+        }
+        s = NULL;
+    }
+
+    if (!s) {
+        return 0;
+    }
+
+    if (__atomic_load_n(&s->sec, __ATOMIC_RELAXED) != sec) {
+        __atomic_store_n(&s->sec, sec, __ATOMIC_RELAXED);
+        __atomic_store_n(&s->cnt, 0, __ATOMIC_RELAXED);
+        if (missed) {
+            *missed = __atomic_exchange_n(&s->dropped, 0, __ATOMIC_RELAXED);
+        }
+    }
+
+    if (__atomic_add_fetch(&s->cnt, 1, __ATOMIC_RELAXED) > LOG_RATE_BURST) {
+        __atomic_add_fetch(&s->dropped, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_log, check_rate_limit)
+{
+    int cc = 0;
+    int drop = 0;
+    uint32_t missed = 0;
+
+    for (cc = 0; cc < LOG_RATE_BURST; cc++) {
+        TEST_ASSERT_EQUAL_INT(0, check_rate_limit(0x1234, 1, &missed));
+    }
+
+    for (cc = 0; cc < 10; cc++) {
+        drop += check_rate_limit(0x1234, 1, &missed);
+    }
+    TEST_ASSERT_EQUAL_INT(10, drop);
+    TEST_ASSERT_EQUAL_INT(0, check_rate_limit(0x5678, 1, &missed));
+
+    missed = 0;
+    TEST_ASSERT_EQUAL_INT(0, check_rate_limit(0x1234, 2, &missed));
+    TEST_ASSERT_EQUAL_INT(10, missed);
+}
+#endif
+
+static int format_line(char *buf, int level, uint32_t missed, const char *msg, const char *fmt, va_list va)
+{
+    int len = 0;
+    time_t rawtime = 0;
+    struct tm timeinfo = { 0 };
+
+    time(&rawtime);
+    if ((rawtime != stamp_time) || !stamp_buf[0]) {
+        stamp_time = rawtime;
+        localtime_r(&rawtime, &timeinfo);
+        snprintf(stamp_buf, sizeof(stamp_buf), "[%04d/%02d/%02d-%02d:%02d:%02d]",
+            timeinfo.tm_year + 1900,
+            timeinfo.tm_mday,
+            timeinfo.tm_mon + 1,
+            timeinfo.tm_hour,
+            timeinfo.tm_min,
+            timeinfo.tm_sec
+        );
+    }
+
+    len = snprintf(buf, LOG_LINE_LEN, "%s%s", stamp_buf, msg);
+    if (missed && (len < LOG_LINE_LEN)) {
+        len += snprintf(buf + len, LOG_LINE_LEN - len, "(%u suppressed)", missed);
+    }
+
+    if (len < LOG_LINE_LEN) {
+        len += vsnprintf(buf + len, LOG_LINE_LEN - len, fmt, va);
+    }
+
+    if (len >= LOG_LINE_LEN) {
+        len = LOG_LINE_LEN - 1;
+        buf[len - 1] = '\n';
+    }
+    return len;
+}
+
 int write_log_to_file(int level, const char *msg, const char *fmt, ...)
 {
+    int len = 0;
+    uint32_t head = 0;
+    uint32_t missed = 0;
+    va_list va = { 0 };
+    log_ring_t *r = NULL;
+    log_line_t *l = NULL;
+    struct iovec iov = { 0 };
+    char tmp[LOG_LINE_LEN] = { 0 };
+
     if (level < debug_level) {
         return -1;
     }
 
-    FILE *file = fopen(LOG_FILE_NAME, "a+"); 
-    if (NULL == file) {
+    pthread_once(&log_once, init_log);
+    if (check_rate_limit((uintptr_t)__builtin_return_address(0), (uint32_t)time(NULL), &missed)) {
         return -1;
     }
 
-    va_list va = { 0 };
-    time_t rawtime = { 0 };
-    struct tm *timeinfo = { 0 };
-    
-    time(&rawtime);
-    timeinfo = localtime(&rawtime);
-    
-    fprintf(file, "[%04d/%02d/%02d-%02d:%02d:%02d]",
-        timeinfo->tm_year + 1900,
-        timeinfo->tm_mday,
-        timeinfo->tm_mon + 1,
-        timeinfo->tm_hour,
-        timeinfo->tm_min,
-        timeinfo->tm_sec
-    );
+    r = get_ring();
+    if (!r) {
+        va_start(va, fmt);
+        len = format_line(tmp, level, missed, msg, fmt, va);
+        va_end(va);
+
+        iov.iov_base = tmp;
+        iov.iov_len = len;
+        pthread_mutex_lock(&log_mutex);
+        write_lines(&iov, 1);
+        pthread_mutex_unlock(&log_mutex);
+        return 0;
+    }
+
+    head = r->head;
+    if ((head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)) >= LOG_RING_LEN) {
+        __atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
 
+    l = &r->line[head & (LOG_RING_LEN - 1)];
     va_start(va, fmt);
-    fprintf(file, "%s", msg);
-    vfprintf(file, fmt, va);
+    l->len = format_line(l->buf, level, missed, msg, fmt, va);
     va_end(va);
-    fclose(file);
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
 
+    if (!log_thread || (level >= LOG_LEVEL_ERROR)) {
+        flush_log();
+    }
     return 0;
 }
 
@@ -111,13 +452,32 @@ TEST(common_log, write_log_to_file)
     TEST_ASSERT_EQUAL_INT(0, write_log_to_file(LOG_LEVEL_ERROR, INFO, COM"run test with error level\n"));
     TEST_ASSERT_EQUAL_INT(0, write_log_to_file(LOG_LEVEL_DEBUG, INFO, COM"run test with debug level\n"));
 }
+
+TEST(common_log, write_log_to_file_rate_limit)
+{
+    int cc = 0;
+    int drop = 0;
+
+    TEST_ASSERT_EQUAL_INT(LOG_LEVEL_DEBUG, set_debug_level(LOG_LEVEL_DEBUG));
+    for (cc = 0; cc < (LOG_RATE_BURST * 3); cc++) {
+        if (write_log_to_file(LOG_LEVEL_DEBUG, DEBUG, COM"run test with rate limit\n") < 0) {
+            drop += 1;
+        }
+    }
+    flush_log();
+    TEST_ASSERT_TRUE(drop >= LOG_RATE_BURST);
+}
 #endif
 
 #if defined(UT)
 TEST_GROUP_RUNNER(common_log)
 {
     RUN_TEST_CASE(common_log, set_debug_level);
+    RUN_TEST_CASE(common_log, rotate_log_file);
+    RUN_TEST_CASE(common_log, flush_log);
+    RUN_TEST_CASE(common_log, get_ring);
+    RUN_TEST_CASE(common_log, check_rate_limit);
     RUN_TEST_CASE(common_log, write_log_to_file);
+    RUN_TEST_CASE(common_log, write_log_to_file_rate_limit);
 }
 #endif
-
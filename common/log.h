@@ -21,14 +21,27 @@
 #ifndef __COMMON_LOG_H__
 #define __COMMON_LOG_H__
 
+#include <stdint.h>
+
     #define LOG_LEVEL_DEBUG 0
     #define LOG_LEVEL_INFO 1
     #define LOG_LEVEL_WARN 2
     #define LOG_LEVEL_ERROR 3
 
     #define LOG_FILE_NAME "miyoo_drastic_log.txt"
+    #define LOG_FILE_OLD LOG_FILE_NAME".1"
     #define LOG_LEVEL_DEFAULT LOG_LEVEL_DEBUG
 
+    #define LOG_LINE_LEN 256
+    #define LOG_RING_LEN 64
+    #define LOG_MAX_RING 16
+    #define LOG_MAX_SITE 256
+    #define LOG_SITE_PROBE 8
+    #define LOG_MAX_IOV 32
+    #define LOG_RATE_BURST 32
+    #define LOG_FLUSH_MS 200
+    #define LOG_MAX_SIZE (512 * 1024)
+
     #define SND "[SND]"
     #define DTR "[DTR]"
     #define COM "[COM]"
@@ -42,10 +55,35 @@
     #define err(...) write_log_to_file(LOG_LEVEL_ERROR, ERROR, __VA_ARGS__)
     #define warn(...) write_log_to_file(LOG_LEVEL_WARN, WARN, __VA_ARGS__)
     #define info(...) write_log_to_file(LOG_LEVEL_INFO, INFO, __VA_ARGS__)
+#if defined(LOG_NO_DEBUG)
+    #define debug(...) ((void)0)
+#else
     #define debug(...) write_log_to_file(LOG_LEVEL_DEBUG, DEBUG, __VA_ARGS__)
+#endif
+
+    typedef struct {
+        uint32_t len;
+        char buf[LOG_LINE_LEN];
+    } log_line_t;
+
+    typedef struct {
+        uint32_t used;
+        uint32_t head;
+        uint32_t tail;
+        uint32_t dropped;
+        log_line_t line[LOG_RING_LEN];
+    } log_ring_t;
+
+    typedef struct {
+        uintptr_t site;
+        uint32_t sec;
+        uint32_t cnt;
+        uint32_t dropped;
+    } log_site_t;
 
     int set_debug_level(int newlevel);
     int write_log_to_file(int level, const char *msg, const char *fmt, ...);
+    int flush_log(void);
 
 #endif
 
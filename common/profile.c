@@ -0,0 +1,337 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "log.h"
+#include "profile.h"
+#include "governor.h"
+
+#define PROFILE_ITEM(n) { #n, offsetof(profile_t, n) }
+
+static volatile int audio_latency = 0;
+
+static const struct {
+    const char *key;
+    size_t offset;
+} profile_items[] = {
+    PROFILE_ITEM(cpu_min),
+    PROFILE_ITEM(cpu_max),
+    PROFILE_ITEM(core),
+    PROFILE_ITEM(fast_forward),
+    PROFILE_ITEM(audio_latency),
+    PROFILE_ITEM(filter),
+    PROFILE_ITEM(layout),
+};
+
+#if defined(UT)
+#define UT_PROFILE_FILE "./profile_ut.txt"
+
+TEST_GROUP(common_profile);
+
+TEST_SETUP(common_profile)
+{
+}
+
+TEST_TEAR_DOWN(common_profile)
+{
+    unlink(UT_PROFILE_FILE);
+    set_audio_latency(0);
+}
+#endif
+
+int reset_profile(profile_t *p)
+{
+    int cc = 0;
+
+    if (!p) {
+        err(COM"invalid parameter(0x%x) in %s\n", p, __func__);
+        return -1;
+    }
+
+    for (cc = 0; cc < (int)(sizeof(profile_items) / sizeof(profile_items[0])); cc++) {
+        *(int *)((uint8_t *)p + profile_items[cc].offset) = PROFILE_UNSET;
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_profile, reset_profile)
+{
+    profile_t p = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, reset_profile(NULL));
+    TEST_ASSERT_EQUAL_INT(0, reset_profile(&p));
+    TEST_ASSERT_EQUAL_INT(PROFILE_UNSET, p.cpu_min);
+    TEST_ASSERT_EQUAL_INT(PROFILE_UNSET, p.audio_latency);
+    TEST_ASSERT_EQUAL_INT(PROFILE_UNSET, p.layout);
+}
+#endif
+
+int load_profile(const char *path, profile_t *p)
+{
+    int cc = 0;
+    int len = 0;
+    FILE *f = NULL;
+    char buf[64] = { 0 };
+
+    if (!path || !p) {
+        err(COM"invalid parameters(0x%x, 0x%x) in %s\n", path, p, __func__);
+        return -1;
+    }
+
+    reset_profile(p);
+    f = fopen(path, "r");
+    if (!f) {
+        info(COM"no game profile(\"%s\") in %s\n", path, __func__);
+        return -1;
+    }
+
+    while (fgets(buf, sizeof(buf), f)) {
+        for (cc = 0; cc < (int)(sizeof(profile_items) / sizeof(profile_items[0])); cc++) {
+            len = strlen(profile_items[cc].key);
+            if (!strncmp(buf, profile_items[cc].key, len) && (buf[len] == '=')) {
+                *(int *)((uint8_t *)p + profile_items[cc].offset) = atoi(&buf[len + 1]);
+                break;
+            }
+        }
+    }
+    fclose(f);
+
+    info(COM"loaded game profile(\"%s\") in %s\n", path, __func__);
+    return 0;
+}
+
+int save_profile(const char *path, const profile_t *p)
+{
+    int cc = 0;
+    int v = 0;
+    FILE *f = NULL;
+
+    if (!path || !p) {
+        err(COM"invalid parameters(0x%x, 0x%x) in %s\n", path, p, __func__);
+        return -1;
+    }
+
+    f = fopen(path, "w");
+    if (!f) {
+        err(COM"failed to create file(\"%s\") in %s\n", path, __func__);
+        return -1;
+    }
+
+    for (cc = 0; cc < (int)(sizeof(profile_items) / sizeof(profile_items[0])); cc++) {
+        v = *(const int *)((const uint8_t *)p + profile_items[cc].offset);
+        if (v != PROFILE_UNSET) {
+            fprintf(f, "%s=%d\n", profile_items[cc].key, v);
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_profile, load_profile)
+{
+    FILE *f = NULL;
+    profile_t p = { 0 };
+    profile_t q = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, load_profile(NULL, &p));
+    TEST_ASSERT_EQUAL_INT(-1, load_profile(UT_PROFILE_FILE, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, load_profile("/NOT_EXIST", &p));
+    TEST_ASSERT_EQUAL_INT(PROFILE_UNSET, p.cpu_max);
+
+    f = fopen(UT_PROFILE_FILE, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fprintf(f, "cpu_max=1100\ncore=4\ncorex=9\nlayout=3\n");
+    fclose(f);
+
+    TEST_ASSERT_EQUAL_INT(0, load_profile(UT_PROFILE_FILE, &p));
+    TEST_ASSERT_EQUAL_INT(1100, p.cpu_max);
+    TEST_ASSERT_EQUAL_INT(4, p.core);
+    TEST_ASSERT_EQUAL_INT(3, p.layout);
+    TEST_ASSERT_EQUAL_INT(PROFILE_UNSET, p.cpu_min);
+    TEST_ASSERT_EQUAL_INT(PROFILE_UNSET, p.filter);
+
+    p.filter = 0;
+    TEST_ASSERT_EQUAL_INT(-1, save_profile(NULL, &p));
+    TEST_ASSERT_EQUAL_INT(0, save_profile(UT_PROFILE_FILE, &p));
+    TEST_ASSERT_EQUAL_INT(0, load_profile(UT_PROFILE_FILE, &q));
+    TEST_ASSERT_EQUAL_MEMORY(&p, &q, sizeof(p));
+}
+#endif
+
+int reset_profile_stat(profile_stat_t *s)
+{
+    if (!s) {
+        err(COM"invalid parameter(0x%x) in %s\n", s, __func__);
+        return -1;
+    }
+
+    memset(s, 0, sizeof(profile_stat_t));
+    return 0;
+}
+
+int record_profile_frame(profile_stat_t *s, uint32_t frame_us, int clk)
+{
+    uint32_t avg = 0;
+
+    if (!s || (clk <= 0)) {
+        return -1;
+    }
+
+    s->frames += 1;
+    s->sum_us += frame_us;
+    s->clk_sum += clk;
+    if (frame_us > GOV_FRAME_US) {
+        s->miss += 1;
+    }
+
+    // a single long frame (loading, savestate) must not drive the suggestion
+    s->win_us += frame_us;
+    s->win_cnt += 1;
+    if (s->win_cnt >= GOV_WINDOW) {
+        avg = s->win_us / s->win_cnt;
+        if (avg > s->peak_us) {
+            s->peak_us = avg;
+        }
+        s->win_us = 0;
+        s->win_cnt = 0;
+    }
+    return 0;
+}
+
+int suggest_profile(const profile_stat_t *s, profile_t *p)
+{
+    uint64_t clk = 0;
+
+    if (!s || !p) {
+        err(COM"invalid parameters(0x%x, 0x%x) in %s\n", s, p, __func__);
+        return -1;
+    }
+
+    if (s->frames < PROFILE_MIN_FRAMES) {
+        return -1;
+    }
+
+    reset_profile(p);
+    if ((s->miss * PROFILE_MISS_RATE) > s->frames) {
+        clk = GOV_HW_MAX;
+    }
+    else {
+        clk = (s->clk_sum / s->frames) * s->peak_us * PROFILE_HEADROOM;
+        clk /= ((uint64_t)GOV_FRAME_US * 100);
+        clk = ((clk + PROFILE_CLOCK_STEP - 1) / PROFILE_CLOCK_STEP) * PROFILE_CLOCK_STEP;
+    }
+
+    if (clk < GOV_HW_MIN) {
+        clk = GOV_HW_MIN;
+    }
+
+    if (clk > GOV_HW_MAX) {
+        clk = GOV_HW_MAX;
+    }
+
+    p->cpu_min = GOV_HW_MIN;
+    p->cpu_max = (int)clk;
+    info(COM"suggested %d~%dMHz (peak %uus, miss %u/%u) in %s\n",
+        p->cpu_min, p->cpu_max, s->peak_us, s->miss, s->frames, __func__);
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_profile, suggest_profile)
+{
+    int cc = 0;
+    profile_t p = { 0 };
+    profile_stat_t s = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, reset_profile_stat(NULL));
+    TEST_ASSERT_EQUAL_INT(-1, suggest_profile(NULL, &p));
+    TEST_ASSERT_EQUAL_INT(-1, record_profile_frame(&s, 1000, 0));
+
+    TEST_ASSERT_EQUAL_INT(0, reset_profile_stat(&s));
+    for (cc = 0; cc < (PROFILE_MIN_FRAMES - 1); cc++) {
+        record_profile_frame(&s, GOV_FRAME_US / 2, 1000);
+    }
+    TEST_ASSERT_EQUAL_INT(-1, suggest_profile(&s, &p));
+
+    record_profile_frame(&s, GOV_FRAME_US * 4, 1000);
+    TEST_ASSERT_EQUAL_INT(0, suggest_profile(&s, &p));
+    TEST_ASSERT_TRUE(p.cpu_max < GOV_HW_MAX);
+    TEST_ASSERT_TRUE(p.cpu_max >= 600);
+    TEST_ASSERT_EQUAL_INT(0, p.cpu_max % PROFILE_CLOCK_STEP);
+    TEST_ASSERT_EQUAL_INT(GOV_HW_MIN, p.cpu_min);
+    TEST_ASSERT_EQUAL_INT(PROFILE_UNSET, p.layout);
+
+    reset_profile_stat(&s);
+    for (cc = 0; cc < PROFILE_MIN_FRAMES; cc++) {
+        record_profile_frame(&s, GOV_FRAME_US + ((cc & 1) ? 1000 : 0), 1000);
+    }
+    TEST_ASSERT_EQUAL_INT(0, suggest_profile(&s, &p));
+    TEST_ASSERT_EQUAL_INT(GOV_HW_MAX, p.cpu_max);
+}
+#endif
+
+int set_audio_latency(int ms)
+{
+    if ((ms < 0) || (ms > PROFILE_MAX_LATENCY)) {
+        err(COM"invalid parameter(%d) in %s\n", ms, __func__);
+        return -1;
+    }
+
+    audio_latency = ms;
+    return 0;
+}
+
+int get_audio_latency(void)
+{
+    return audio_latency;
+}
+
+#if defined(UT)
+TEST(common_profile, set_audio_latency)
+{
+    TEST_ASSERT_EQUAL_INT(-1, set_audio_latency(-1));
+    TEST_ASSERT_EQUAL_INT(-1, set_audio_latency(PROFILE_MAX_LATENCY + 1));
+    TEST_ASSERT_EQUAL_INT(0, set_audio_latency(64));
+    TEST_ASSERT_EQUAL_INT(64, get_audio_latency());
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(common_profile)
+{
+    RUN_TEST_CASE(common_profile, reset_profile);
+    RUN_TEST_CASE(common_profile, load_profile);
+    RUN_TEST_CASE(common_profile, suggest_profile);
+    RUN_TEST_CASE(common_profile, set_audio_latency);
+}
+#endif
+
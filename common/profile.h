@@ -0,0 +1,66 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __COMMON_PROFILE_H__
+#define __COMMON_PROFILE_H__
+
+#include <stdint.h>
+
+#define PROFILE_PATH "miyoo/profile"
+#define PROFILE_EXT ".txt"
+#define PROFILE_SUGGEST_EXT ".suggest"
+#define PROFILE_UNSET -1
+#define PROFILE_MIN_FRAMES 600
+#define PROFILE_MISS_RATE 100
+#define PROFILE_HEADROOM 115
+#define PROFILE_CLOCK_STEP 50
+#define PROFILE_MAX_LATENCY 500
+
+typedef struct {
+    int cpu_min;
+    int cpu_max;
+    int core;
+    int fast_forward;
+    int audio_latency;
+    int filter;
+    int layout;
+} profile_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t miss;
+    uint32_t win_cnt;
+    uint32_t win_us;
+    uint32_t peak_us;
+    uint64_t sum_us;
+    uint64_t clk_sum;
+} profile_stat_t;
+
+int reset_profile(profile_t *p);
+int load_profile(const char *path, profile_t *p);
+int save_profile(const char *path, const profile_t *p);
+int reset_profile_stat(profile_stat_t *s);
+int record_profile_frame(profile_stat_t *s, uint32_t frame_us, int clk);
+int suggest_profile(const profile_stat_t *s, profile_t *p);
+int set_audio_latency(int ms);
+int get_audio_latency(void);
+
+#endif
+
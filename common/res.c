@@ -0,0 +1,627 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <time.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "log.h"
+#include "res.h"
+#include "thread.h"
+
+typedef struct {
+    int running;
+    pthread_t thread;
+    pthread_cond_t cond;
+    pthread_mutex_t mutex;
+    res_index_t idx[RES_MAX_INDEX];
+} res_ctx_t;
+
+static res_ctx_t res = {
+    .cond = PTHREAD_COND_INITIALIZER,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+#if defined(UT)
+#define UT_RES_PATH "./res_ut"
+
+static void touch_file(const char *name)
+{
+    FILE *f = NULL;
+    char buf[RES_MAX_NAME] = { 0 };
+
+    snprintf(buf, sizeof(buf), "%s/%s", UT_RES_PATH, name);
+    f = fopen(buf, "w+");
+    if (f) {
+        fclose(f);
+    }
+}
+
+TEST_GROUP(common_res);
+
+TEST_SETUP(common_res)
+{
+    mkdir(UT_RES_PATH, 0755);
+    mkdir(UT_RES_PATH"/dir_b", 0755);
+    mkdir(UT_RES_PATH"/dir_a", 0755);
+    touch_file("pen_c.png");
+    touch_file("pen_a.png");
+    touch_file("pen_b.png");
+}
+
+TEST_TEAR_DOWN(common_res)
+{
+    quit_res_index();
+    unlink(UT_RES_PATH"/pen_a.png");
+    unlink(UT_RES_PATH"/pen_b.png");
+    unlink(UT_RES_PATH"/pen_c.png");
+    unlink(UT_RES_PATH"/pen_d.png");
+    rmdir(UT_RES_PATH"/dir_a");
+    rmdir(UT_RES_PATH"/dir_b");
+    rmdir(UT_RES_PATH);
+}
+#endif
+
+static uint32_t calc_name_hash(const char *name)
+{
+    uint32_t h = 0x811c9dc5;
+
+    while (*name) {
+        h ^= (uint8_t)(*name++);
+        h *= 0x01000193;
+    }
+    return h;
+}
+
+static int cmp_entry(const void *a, const void *b)
+{
+    return strcmp(((const res_entry_t *)a)->name, ((const res_entry_t *)b)->name);
+}
+
+static int is_dir_entry(const char *path, struct dirent *d)
+{
+    struct stat st = { 0 };
+    char buf[RES_MAX_NAME << 2] = { 0 };
+
+    if (d->d_type != DT_UNKNOWN) {
+        return d->d_type == DT_DIR;
+    }
+
+    snprintf(buf, sizeof(buf), "%s/%s", path, d->d_name);
+    if (stat(buf, &st) < 0) {
+        return 0;
+    }
+    return S_ISDIR(st.st_mode) ? 1 : 0;
+}
+
+static int build_index(res_index_t *p, const char *path, int type)
+{
+    int cc = 0;
+    int pos = 0;
+    int cnt = 0;
+    int max = 0;
+    size_t len = 0;
+    DIR *d = NULL;
+    uint16_t *hash = NULL;
+    res_entry_t *entry = NULL;
+    res_entry_t *tmp = NULL;
+    struct dirent *dir = NULL;
+    struct stat st = { 0 };
+
+    if (!p || !path) {
+        err(COM"invalid parameters(0x%x, 0x%x) in %s\n", p, path, __func__);
+        return -1;
+    }
+
+    memset(p, 0, sizeof(res_index_t));
+    snprintf(p->path, sizeof(p->path), "%s", path);
+    p->type = type;
+
+    if (stat(path, &st) == 0) {
+        p->mtime = st.st_mtim.tv_sec;
+        p->mtime_ns = st.st_mtim.tv_nsec;
+    }
+
+    d = opendir(path);
+    if (d) {
+        while ((dir = readdir(d)) != NULL) {
+            if (strcmp(dir->d_name, ".") == 0) {
+                continue;
+            }
+
+            if (strcmp(dir->d_name, "..") == 0) {
+                continue;
+            }
+
+            if (is_dir_entry(path, dir) != (type == RES_TYPE_DIR)) {
+                continue;
+            }
+
+            len = strlen(dir->d_name);
+            if (len >= RES_MAX_NAME) {
+                warn(COM"name too long(%s) in %s\n", dir->d_name, __func__);
+                continue;
+            }
+
+            if (cnt >= RES_MAX_ENTRY) {
+                warn(COM"too many entries in \"%s\" in %s\n", path, __func__);
+                break;
+            }
+
+            if (cnt >= max) {
+                max = max ? (max << 1) : 16;
+                tmp = realloc(entry, max * sizeof(res_entry_t));
+                if (!tmp) {
+                    break;
+                }
+                entry = tmp;
+            }
+
+            memcpy(entry[cnt].name, dir->d_name, len + 1);
+            entry[cnt].hash = calc_name_hash(entry[cnt].name);
+            cnt += 1;
+        }
+        closedir(d);
+    }
+
+    if (cnt > 0) {
+        qsort(entry, cnt, sizeof(res_entry_t), cmp_entry);
+
+        p->hash_size = 8;
+        while (p->hash_size < (cnt << 1)) {
+            p->hash_size <<= 1;
+        }
+
+        hash = calloc(p->hash_size, sizeof(uint16_t));
+        if (!hash) {
+            free(entry);
+            return -1;
+        }
+
+        for (cc = 0; cc < cnt; cc++) {
+            pos = entry[cc].hash & (p->hash_size - 1);
+            while (hash[pos]) {
+                pos = (pos + 1) & (p->hash_size - 1);
+            }
+            hash[pos] = cc + 1;
+        }
+    }
+
+    p->used = 1;
+    p->count = cnt;
+    p->hash = hash;
+    p->entry = entry;
+    debug(COM"indexed %d entries in \"%s\" in %s\n", cnt, path, __func__);
+    return 0;
+}
+
+static void free_index(res_index_t *p)
+{
+    if (p->entry) {
+        free(p->entry);
+    }
+
+    if (p->hash) {
+        free(p->hash);
+    }
+    memset(p, 0, sizeof(res_index_t));
+}
+
+#if defined(UT)
+TEST(common_res, build_index)
+{
+    res_index_t t = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, build_index(NULL, NULL, RES_TYPE_FILE));
+    TEST_ASSERT_EQUAL_INT(0, build_index(&t, UT_RES_PATH, RES_TYPE_FILE));
+    TEST_ASSERT_EQUAL_INT(3, t.count);
+    TEST_ASSERT_EQUAL_STRING("pen_a.png", t.entry[0].name);
+    TEST_ASSERT_EQUAL_STRING("pen_c.png", t.entry[2].name);
+    free_index(&t);
+
+    TEST_ASSERT_EQUAL_INT(0, build_index(&t, UT_RES_PATH, RES_TYPE_DIR));
+    TEST_ASSERT_EQUAL_INT(2, t.count);
+    TEST_ASSERT_EQUAL_STRING("dir_a", t.entry[0].name);
+    free_index(&t);
+
+    TEST_ASSERT_EQUAL_INT(0, build_index(&t, "/NOT_EXIST", RES_TYPE_DIR));
+    TEST_ASSERT_EQUAL_INT(0, t.count);
+    free_index(&t);
+}
+#endif
+
+static int is_valid_id(int id)
+{
+    return (id >= 0) && (id < RES_MAX_INDEX) && res.idx[id].used;
+}
+
+int get_res_id(const char *path, int type)
+{
+    int cc = 0;
+    int id = -1;
+
+    if (!path) {
+        err(COM"invalid parameter(0x%x) in %s\n", path, __func__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&res.mutex);
+    for (cc = 0; cc < RES_MAX_INDEX; cc++) {
+        if (!res.idx[cc].used) {
+            if (id < 0) {
+                id = cc;
+            }
+            continue;
+        }
+
+        if ((res.idx[cc].type == type) && !strcmp(res.idx[cc].path, path)) {
+            pthread_mutex_unlock(&res.mutex);
+            return cc;
+        }
+    }
+
+    if ((id >= 0) && (build_index(&res.idx[id], path, type) < 0)) {
+        id = -1;
+    }
+    pthread_mutex_unlock(&res.mutex);
+
+    if (id < 0) {
+        err(COM"failed to index \"%s\" in %s\n", path, __func__);
+    }
+    return id;
+}
+
+#if defined(UT)
+TEST(common_res, get_res_id)
+{
+    int id = -1;
+
+    TEST_ASSERT_EQUAL_INT(-1, get_res_id(NULL, RES_TYPE_FILE));
+
+    id = get_res_id(UT_RES_PATH, RES_TYPE_FILE);
+    TEST_ASSERT_TRUE(id >= 0);
+    TEST_ASSERT_EQUAL_INT(id, get_res_id(UT_RES_PATH, RES_TYPE_FILE));
+    TEST_ASSERT_TRUE(id != get_res_id(UT_RES_PATH, RES_TYPE_DIR));
+}
+#endif
+
+int get_res_count(int id)
+{
+    int r = -1;
+
+    pthread_mutex_lock(&res.mutex);
+    if (is_valid_id(id)) {
+        r = res.idx[id].count;
+    }
+    pthread_mutex_unlock(&res.mutex);
+    return r;
+}
+
+#if defined(UT)
+TEST(common_res, get_res_count)
+{
+    TEST_ASSERT_EQUAL_INT(-1, get_res_count(-1));
+    TEST_ASSERT_EQUAL_INT(-1, get_res_count(RES_MAX_INDEX));
+    TEST_ASSERT_EQUAL_INT(3, get_res_count(get_res_id(UT_RES_PATH, RES_TYPE_FILE)));
+    TEST_ASSERT_EQUAL_INT(2, get_res_count(get_res_id(UT_RES_PATH, RES_TYPE_DIR)));
+}
+#endif
+
+int get_res_name(int id, int idx, char *buf, int len)
+{
+    int r = -1;
+
+    if (!buf || (len <= 0)) {
+        err(COM"invalid parameters(0x%x, %d) in %s\n", buf, len, __func__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&res.mutex);
+    if (is_valid_id(id) && (idx >= 0) && (idx < res.idx[id].count)) {
+        snprintf(buf, len, "%s", res.idx[id].entry[idx].name);
+        r = 0;
+    }
+    pthread_mutex_unlock(&res.mutex);
+    return r;
+}
+
+#if defined(UT)
+TEST(common_res, get_res_name)
+{
+    int id = get_res_id(UT_RES_PATH, RES_TYPE_FILE);
+    char buf[RES_MAX_NAME] = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, get_res_name(id, 0, NULL, 0));
+    TEST_ASSERT_EQUAL_INT(-1, get_res_name(id, 3, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(0, get_res_name(id, 1, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("pen_b.png", buf);
+}
+#endif
+
+int get_res_path(int id, int idx, char *buf, int len)
+{
+    int r = -1;
+
+    if (!buf || (len <= 0)) {
+        err(COM"invalid parameters(0x%x, %d) in %s\n", buf, len, __func__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&res.mutex);
+    if (is_valid_id(id) && (idx >= 0) && (idx < res.idx[id].count)) {
+        snprintf(buf, len, "%s/%s", res.idx[id].path, res.idx[id].entry[idx].name);
+        r = 0;
+    }
+    pthread_mutex_unlock(&res.mutex);
+    return r;
+}
+
+#if defined(UT)
+TEST(common_res, get_res_path)
+{
+    int id = get_res_id(UT_RES_PATH, RES_TYPE_DIR);
+    char buf[RES_MAX_NAME] = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, get_res_path(id, 0, NULL, 0));
+    TEST_ASSERT_EQUAL_INT(-1, get_res_path(-1, 0, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(0, get_res_path(id, 1, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING(UT_RES_PATH"/dir_b", buf);
+}
+#endif
+
+int find_res_name(int id, const char *name)
+{
+    int r = -1;
+    int pos = 0;
+    int cnt = 0;
+    uint32_t h = 0;
+    res_index_t *p = NULL;
+
+    if (!name) {
+        err(COM"invalid parameter(0x%x) in %s\n", name, __func__);
+        return -1;
+    }
+
+    h = calc_name_hash(name);
+    pthread_mutex_lock(&res.mutex);
+    if (is_valid_id(id) && res.idx[id].hash) {
+        p = &res.idx[id];
+        pos = h & (p->hash_size - 1);
+        for (cnt = 0; p->hash[pos] && (cnt < p->hash_size); cnt++) {
+            if ((p->entry[p->hash[pos] - 1].hash == h) &&
+                !strcmp(p->entry[p->hash[pos] - 1].name, name))
+            {
+                r = p->hash[pos] - 1;
+                break;
+            }
+            pos = (pos + 1) & (p->hash_size - 1);
+        }
+    }
+    pthread_mutex_unlock(&res.mutex);
+    return r;
+}
+
+#if defined(UT)
+TEST(common_res, find_res_name)
+{
+    int id = get_res_id(UT_RES_PATH, RES_TYPE_FILE);
+
+    TEST_ASSERT_EQUAL_INT(-1, find_res_name(id, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, find_res_name(-1, "pen_a.png"));
+    TEST_ASSERT_EQUAL_INT(0, find_res_name(id, "pen_a.png"));
+    TEST_ASSERT_EQUAL_INT(2, find_res_name(id, "pen_c.png"));
+    TEST_ASSERT_EQUAL_INT(-1, find_res_name(id, "pen_x.png"));
+}
+#endif
+
+int refresh_res_index(int id)
+{
+    int type = 0;
+    int changed = 0;
+    struct stat st = { 0 };
+    res_index_t t = { 0 };
+    res_index_t old = { 0 };
+    char path[RES_MAX_NAME << 1] = { 0 };
+
+    pthread_mutex_lock(&res.mutex);
+    if (!is_valid_id(id)) {
+        pthread_mutex_unlock(&res.mutex);
+        return -1;
+    }
+    type = res.idx[id].type;
+    snprintf(path, sizeof(path), "%s", res.idx[id].path);
+    if (stat(path, &st) == 0) {
+        changed = (st.st_mtim.tv_sec != res.idx[id].mtime) ||
+            (st.st_mtim.tv_nsec != res.idx[id].mtime_ns);
+    }
+    pthread_mutex_unlock(&res.mutex);
+
+    if (!changed) {
+        return 0;
+    }
+
+    // directory walk happens outside of the lock so lookups never stall on SD
+    if (build_index(&t, path, type) < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&res.mutex);
+    if (is_valid_id(id) && !strcmp(res.idx[id].path, path)) {
+        old = res.idx[id];
+        res.idx[id] = t;
+        memset(&t, 0, sizeof(t));
+    }
+    pthread_mutex_unlock(&res.mutex);
+
+    free_index(&old);
+    free_index(&t);
+    info(COM"reindexed \"%s\" in %s\n", path, __func__);
+    return 1;
+}
+
+#if defined(UT)
+TEST(common_res, refresh_res_index)
+{
+    struct timespec ts[2] = { 0 };
+    int id = get_res_id(UT_RES_PATH, RES_TYPE_FILE);
+
+    TEST_ASSERT_EQUAL_INT(-1, refresh_res_index(-1));
+    TEST_ASSERT_EQUAL_INT(0, refresh_res_index(id));
+
+    touch_file("pen_d.png");
+    ts[0].tv_nsec = UTIME_OMIT;
+    ts[1].tv_sec = time(NULL) + 10;
+    utimensat(AT_FDCWD, UT_RES_PATH, ts, 0);
+
+    TEST_ASSERT_EQUAL_INT(1, refresh_res_index(id));
+    TEST_ASSERT_EQUAL_INT(4, get_res_count(id));
+    TEST_ASSERT_EQUAL_INT(3, find_res_name(id, "pen_d.png"));
+}
+#endif
+
+static void *res_handler(void *param)
+{
+    int cc = 0;
+    struct timespec ts = { 0 };
+
+    register_thread("res", THREAD_ROLE_IDLE);
+
+    pthread_mutex_lock(&res.mutex);
+    while (res.running) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += RES_RESCAN_MS / 1000;
+        ts.tv_nsec += (RES_RESCAN_MS % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec += 1;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&res.cond, &res.mutex, &ts);
+
+        if (!res.running) {
+            break;
+        }
+
+        pthread_mutex_unlock(&res.mutex);
+        for (cc = 0; cc < RES_MAX_INDEX; cc++) {
+            refresh_res_index(cc);
+        }
+        pthread_mutex_lock(&res.mutex);
+    }
+    pthread_mutex_unlock(&res.mutex);
+
+    unregister_thread();
+    return NULL;
+}
+
+int start_res_rescan(void)
+{
+    pthread_mutex_lock(&res.mutex);
+    if (res.running) {
+        pthread_mutex_unlock(&res.mutex);
+        return 0;
+    }
+
+    res.running = 1;
+    if (pthread_create(&res.thread, NULL, res_handler, NULL) != 0) {
+        err(COM"failed to create rescan thread in %s\n", __func__);
+        res.running = 0;
+        pthread_mutex_unlock(&res.mutex);
+        return -1;
+    }
+    pthread_mutex_unlock(&res.mutex);
+    return 0;
+}
+
+int stop_res_rescan(void)
+{
+    pthread_mutex_lock(&res.mutex);
+    if (!res.running) {
+        pthread_mutex_unlock(&res.mutex);
+        return 0;
+    }
+
+    res.running = 0;
+    pthread_cond_signal(&res.cond);
+    pthread_mutex_unlock(&res.mutex);
+    pthread_join(res.thread, NULL);
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_res, start_res_rescan)
+{
+    TEST_ASSERT_EQUAL_INT(0, start_res_rescan());
+    TEST_ASSERT_EQUAL_INT(0, start_res_rescan());
+    TEST_ASSERT_EQUAL_INT(0, stop_res_rescan());
+    TEST_ASSERT_EQUAL_INT(0, stop_res_rescan());
+}
+#endif
+
+int quit_res_index(void)
+{
+    int cc = 0;
+
+    stop_res_rescan();
+
+    pthread_mutex_lock(&res.mutex);
+    for (cc = 0; cc < RES_MAX_INDEX; cc++) {
+        free_index(&res.idx[cc]);
+    }
+    pthread_mutex_unlock(&res.mutex);
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_res, quit_res_index)
+{
+    int id = get_res_id(UT_RES_PATH, RES_TYPE_FILE);
+
+    TEST_ASSERT_TRUE(id >= 0);
+    TEST_ASSERT_EQUAL_INT(0, quit_res_index());
+    TEST_ASSERT_EQUAL_INT(-1, get_res_count(id));
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(common_res)
+{
+    RUN_TEST_CASE(common_res, build_index);
+    RUN_TEST_CASE(common_res, get_res_id);
+    RUN_TEST_CASE(common_res, get_res_count);
+    RUN_TEST_CASE(common_res, get_res_name);
+    RUN_TEST_CASE(common_res, get_res_path);
+    RUN_TEST_CASE(common_res, find_res_name);
+    RUN_TEST_CASE(common_res, refresh_res_index);
+    RUN_TEST_CASE(common_res, start_res_rescan);
+    RUN_TEST_CASE(common_res, quit_res_index);
+}
+#endif
+
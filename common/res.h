@@ -0,0 +1,64 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __COMMON_RES_H__
+#define __COMMON_RES_H__
+
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define RES_MAX_INDEX 8
+#define RES_MAX_NAME 128
+#define RES_MAX_ENTRY 1024
+#define RES_RESCAN_MS 5000
+
+#define RES_TYPE_FILE 0
+#define RES_TYPE_DIR 1
+
+typedef struct {
+    uint32_t hash;
+    char name[RES_MAX_NAME];
+} res_entry_t;
+
+typedef struct {
+    int used;
+    int type;
+    int count;
+    int hash_size;
+    time_t mtime;
+    long mtime_ns;
+    uint16_t *hash;
+    res_entry_t *entry;
+    char path[RES_MAX_NAME << 1];
+} res_index_t;
+
+int get_res_id(const char *path, int type);
+int get_res_count(int id);
+int get_res_name(int id, int idx, char *buf, int len);
+int get_res_path(int id, int idx, char *buf, int len);
+int find_res_name(int id, const char *name);
+int refresh_res_index(int id);
+int start_res_rescan(void);
+int stop_res_rescan(void);
+int quit_res_index(void);
+
+#endif
+
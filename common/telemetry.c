@@ -0,0 +1,421 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#define _GNU_SOURCE
+#include <time.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "log.h"
+#include "thread.h"
+#include "telemetry.h"
+
+typedef struct {
+    int bat_cur_fd;
+    int bat_max_fd;
+    int sar_fd;
+    int temp_fd;
+    int freq_fd;
+    int bat_max;
+    int use_axp;
+
+    int running;
+    pthread_t thread;
+    pthread_cond_t cond;
+    pthread_mutex_t mutex;
+
+    uint32_t seq;
+    telemetry_t data;
+} telemetry_ctx_t;
+
+static telemetry_ctx_t tm = {
+    .bat_cur_fd = -1,
+    .bat_max_fd = -1,
+    .sar_fd = -1,
+    .temp_fd = -1,
+    .freq_fd = -1,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+#if defined(UT)
+static int write_fake_value(const char *path, int v)
+{
+    FILE *f = fopen(path, "w+");
+
+    if (!f) {
+        return -1;
+    }
+    fprintf(f, "%d\n", v);
+    fclose(f);
+    return 0;
+}
+
+TEST_GROUP(common_telemetry);
+
+TEST_SETUP(common_telemetry)
+{
+    write_fake_value(TM_BAT_MAX_PATH, 4200000);
+    write_fake_value(TM_BAT_CUR_PATH, 3600000);
+    write_fake_value(TM_TEMP_PATH, 45000);
+    write_fake_value(TM_FREQ_PATH, 1200000);
+}
+
+TEST_TEAR_DOWN(common_telemetry)
+{
+    quit_telemetry();
+    unlink(TM_BAT_MAX_PATH);
+    unlink(TM_BAT_CUR_PATH);
+    unlink(TM_TEMP_PATH);
+    unlink(TM_FREQ_PATH);
+}
+#endif
+
+static int read_sysfs_int(int fd, int *val)
+{
+    ssize_t r = 0;
+    char buf[32] = { 0 };
+
+    if ((fd < 0) || !val) {
+        return -1;
+    }
+
+    r = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (r <= 0) {
+        return -1;
+    }
+
+    buf[r] = 0;
+    *val = atoi(buf);
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_telemetry, read_sysfs_int)
+{
+    int v = 0;
+    int fd = open(TM_TEMP_PATH, O_RDONLY);
+
+    TEST_ASSERT_EQUAL_INT(-1, read_sysfs_int(-1, &v));
+    TEST_ASSERT_EQUAL_INT(-1, read_sysfs_int(fd, NULL));
+    TEST_ASSERT_EQUAL_INT(0, read_sysfs_int(fd, &v));
+    TEST_ASSERT_EQUAL_INT(45000, v);
+
+    write_fake_value(TM_TEMP_PATH, 51000);
+    TEST_ASSERT_EQUAL_INT(0, read_sysfs_int(fd, &v));
+    TEST_ASSERT_EQUAL_INT(51000, v);
+    close(fd);
+}
+#endif
+
+static int limit_percent(int v)
+{
+    if (v > 100) {
+        v = 100;
+    }
+    if (v < 0) {
+        v = 0;
+    }
+    return v;
+}
+
+#if defined(MINI)
+static int read_battery(int *percent, int *voltage)
+{
+    char buf[255] = { 0 };
+    uint32_t v[2] = { 0 };
+    FILE *fd = NULL;
+
+    if (tm.use_axp) {
+        // {"battery":99, "voltage":4254, "charging":3}
+        fd = popen(TM_AXP_PATH, "r");
+        if (!fd) {
+            return -1;
+        }
+
+        fgets(buf, sizeof(buf), fd);
+        pclose(fd);
+        *percent = limit_percent(atoi(&buf[11]));
+        *voltage = strstr(buf, "voltage\":") ? atoi(strstr(buf, "voltage\":") + 9) : 0;
+        return 0;
+    }
+
+    if (tm.sar_fd < 0) {
+        return -1;
+    }
+
+    ioctl(tm.sar_fd, 0x6100, 0);
+    ioctl(tm.sar_fd, 0x6101, v);
+    *percent = limit_percent(100 - (((TM_SAR_MAX_VAL - (int)v[1]) * 100) / (TM_SAR_MAX_VAL - TM_SAR_MIN_VAL)));
+    *voltage = v[1];
+    return 0;
+}
+#else
+static int read_battery(int *percent, int *voltage)
+{
+    int cur = 0;
+
+    if (tm.bat_max <= 0) {
+        read_sysfs_int(tm.bat_max_fd, &tm.bat_max);
+    }
+
+    if (read_sysfs_int(tm.bat_cur_fd, &cur) < 0) {
+        return -1;
+    }
+
+    *percent = limit_percent(100 - (((tm.bat_max - cur) * 100) / TM_BAT_RANGE));
+    *voltage = cur / 1000;
+    return 0;
+}
+#endif
+
+static void open_telemetry_fds(void)
+{
+#if defined(MINI)
+    struct stat st = { 0 };
+
+    tm.use_axp = (stat(TM_AXP_PATH, &st) == 0);
+    if (!tm.use_axp && (tm.sar_fd < 0)) {
+        tm.sar_fd = open(TM_SAR_PATH, O_RDWR | O_CLOEXEC);
+    }
+#else
+    if (tm.bat_cur_fd < 0) {
+        tm.bat_cur_fd = open(TM_BAT_CUR_PATH, O_RDONLY | O_CLOEXEC);
+    }
+    if (tm.bat_max_fd < 0) {
+        tm.bat_max_fd = open(TM_BAT_MAX_PATH, O_RDONLY | O_CLOEXEC);
+    }
+#endif
+
+    if (tm.temp_fd < 0) {
+        tm.temp_fd = open(TM_TEMP_PATH, O_RDONLY | O_CLOEXEC);
+    }
+    if (tm.freq_fd < 0) {
+        tm.freq_fd = open(TM_FREQ_PATH, O_RDONLY | O_CLOEXEC);
+    }
+}
+
+static void close_fd(int *fd)
+{
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+int update_telemetry(void)
+{
+    int v = 0;
+    telemetry_t t = { 0 };
+
+    t.battery = -1;
+    t.voltage = -1;
+    t.temp = -1;
+    t.freq = -1;
+
+    read_battery(&t.battery, &t.voltage);
+    if (read_sysfs_int(tm.temp_fd, &v) == 0) {
+        t.temp = (v > 1000) ? (v / 1000) : v;
+    }
+    if (read_sysfs_int(tm.freq_fd, &v) == 0) {
+        t.freq = v / 1000;
+    }
+
+    __atomic_add_fetch(&tm.seq, 1, __ATOMIC_ACQ_REL);
+    tm.data = t;
+    __atomic_add_fetch(&tm.seq, 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_telemetry, update_telemetry)
+{
+    telemetry_t t = { 0 };
+
+    open_telemetry_fds();
+    TEST_ASSERT_EQUAL_INT(0, update_telemetry());
+    TEST_ASSERT_EQUAL_INT(0, get_telemetry(&t));
+    TEST_ASSERT_EQUAL_INT(50, t.battery);
+    TEST_ASSERT_EQUAL_INT(3600, t.voltage);
+    TEST_ASSERT_EQUAL_INT(45, t.temp);
+    TEST_ASSERT_EQUAL_INT(1200, t.freq);
+    TEST_ASSERT_EQUAL_INT(0, tm.seq & 1);
+}
+#endif
+
+int get_telemetry(telemetry_t *t)
+{
+    uint32_t seq = 0;
+
+    if (!t) {
+        err(COM"invalid parameter(0x%x) in %s\n", t, __func__);
+        return -1;
+    }
+
+    do {
+        seq = __atomic_load_n(&tm.seq, __ATOMIC_ACQUIRE);
+        *t = tm.data;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || (seq != __atomic_load_n(&tm.seq, __ATOMIC_RELAXED)));
+
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_telemetry, get_telemetry)
+{
+    telemetry_t t = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, get_telemetry(NULL));
+    TEST_ASSERT_EQUAL_INT(0, get_telemetry(&t));
+}
+#endif
+
+int get_battery_level(void)
+{
+    telemetry_t t = { 0 };
+
+    get_telemetry(&t);
+    return (t.battery < 0) ? 0 : t.battery;
+}
+
+#if defined(UT)
+TEST(common_telemetry, get_battery_level)
+{
+    open_telemetry_fds();
+    update_telemetry();
+    TEST_ASSERT_EQUAL_INT(50, get_battery_level());
+}
+#endif
+
+static void *telemetry_handler(void *param)
+{
+    struct timespec ts = { 0 };
+
+    register_thread("telemetry", THREAD_ROLE_IDLE);
+
+    pthread_mutex_lock(&tm.mutex);
+    while (tm.running) {
+        pthread_mutex_unlock(&tm.mutex);
+        update_telemetry();
+        pthread_mutex_lock(&tm.mutex);
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += TM_INTERVAL_MS / 1000;
+        ts.tv_nsec += (TM_INTERVAL_MS % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec += 1;
+            ts.tv_nsec -= 1000000000;
+        }
+
+        if (tm.running) {
+            pthread_cond_timedwait(&tm.cond, &tm.mutex, &ts);
+        }
+    }
+    pthread_mutex_unlock(&tm.mutex);
+
+    unregister_thread();
+    return NULL;
+}
+
+int init_telemetry(void)
+{
+    if (tm.running) {
+        return 0;
+    }
+
+    open_telemetry_fds();
+    update_telemetry();
+
+    tm.running = 1;
+    if (pthread_create(&tm.thread, NULL, telemetry_handler, NULL) != 0) {
+        err(COM"failed to create telemetry thread in %s\n", __func__);
+        tm.running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_telemetry, init_telemetry)
+{
+    TEST_ASSERT_EQUAL_INT(0, init_telemetry());
+    TEST_ASSERT_EQUAL_INT(1, tm.running);
+    TEST_ASSERT_EQUAL_INT(0, init_telemetry());
+    TEST_ASSERT_EQUAL_INT(50, get_battery_level());
+}
+#endif
+
+int quit_telemetry(void)
+{
+    pthread_mutex_lock(&tm.mutex);
+    if (!tm.running) {
+        pthread_mutex_unlock(&tm.mutex);
+    }
+    else {
+        tm.running = 0;
+        pthread_cond_signal(&tm.cond);
+        pthread_mutex_unlock(&tm.mutex);
+        pthread_join(tm.thread, NULL);
+    }
+
+    close_fd(&tm.bat_cur_fd);
+    close_fd(&tm.bat_max_fd);
+    close_fd(&tm.sar_fd);
+    close_fd(&tm.temp_fd);
+    close_fd(&tm.freq_fd);
+    tm.bat_max = 0;
+    return 0;
+}
+
+#if defined(UT)
+TEST(common_telemetry, quit_telemetry)
+{
+    TEST_ASSERT_EQUAL_INT(0, init_telemetry());
+    TEST_ASSERT_EQUAL_INT(0, quit_telemetry());
+    TEST_ASSERT_EQUAL_INT(0, tm.running);
+    TEST_ASSERT_EQUAL_INT(-1, tm.temp_fd);
+    TEST_ASSERT_EQUAL_INT(0, quit_telemetry());
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(common_telemetry)
+{
+    RUN_TEST_CASE(common_telemetry, read_sysfs_int);
+    RUN_TEST_CASE(common_telemetry, update_telemetry);
+    RUN_TEST_CASE(common_telemetry, get_telemetry);
+    RUN_TEST_CASE(common_telemetry, get_battery_level);
+    RUN_TEST_CASE(common_telemetry, init_telemetry);
+    RUN_TEST_CASE(common_telemetry, quit_telemetry);
+}
+#endif
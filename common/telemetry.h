@@ -0,0 +1,66 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __COMMON_TELEMETRY_H__
+#define __COMMON_TELEMETRY_H__
+
+#include <stdint.h>
+
+#if defined(A30)
+#define TM_BAT_CUR_PATH "/sys/class/power_supply/battery/voltage_now"
+#define TM_BAT_MAX_PATH "/sys/class/power_supply/battery/voltage_max_design"
+#define TM_TEMP_PATH "/sys/class/thermal/thermal_zone0/temp"
+#define TM_FREQ_PATH "/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq"
+#define TM_BAT_RANGE 1200000
+#endif
+
+#if defined(MINI)
+#define TM_SAR_PATH "/dev/sar"
+#define TM_AXP_PATH "/customer/app/axp_test"
+#define TM_TEMP_PATH "/sys/class/thermal/thermal_zone0/temp"
+#define TM_FREQ_PATH "/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq"
+#define TM_SAR_MAX_VAL 630
+#define TM_SAR_MIN_VAL 420
+#endif
+
+#if defined(UT)
+#define TM_BAT_CUR_PATH "./tm_bat_cur"
+#define TM_BAT_MAX_PATH "./tm_bat_max"
+#define TM_TEMP_PATH "./tm_temp"
+#define TM_FREQ_PATH "./tm_freq"
+#define TM_BAT_RANGE 1200000
+#endif
+
+#define TM_INTERVAL_MS 2000
+
+typedef struct {
+    int32_t battery;
+    int32_t voltage;
+    int32_t temp;
+    int32_t freq;
+} telemetry_t;
+
+int init_telemetry(void);
+int quit_telemetry(void);
+int update_telemetry(void);
+int get_telemetry(telemetry_t *t);
+int get_battery_level(void);
+
+#endif
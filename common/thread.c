@@ -0,0 +1,454 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#define _GNU_SOURCE
+#include <time.h>
+#include <stdio.h>
+#include <sched.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "log.h"
+#include "thread.h"
+
+static thread_info_t thread_list[THREAD_MAX] = { 0 };
+static pthread_mutex_t thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+static thread_policy_t thread_policy[THREAD_ROLE_MAX] = {
+    [THREAD_ROLE_EMU] = { THREAD_CPU_FIRST, 0, -5 },
+    [THREAD_ROLE_AUDIO] = { THREAD_CPU_ANY, 1, 20 },
+    [THREAD_ROLE_INPUT] = { THREAD_CPU_ANY, 1, 10 },
+    [THREAD_ROLE_VIDEO] = { THREAD_CPU_LAST, 0, -5 },
+    [THREAD_ROLE_IDLE] = { THREAD_CPU_ANY, 0, 19 },
+};
+
+#if defined(UT)
+TEST_GROUP(common_thread);
+
+TEST_SETUP(common_thread)
+{
+}
+
+TEST_TEAR_DOWN(common_thread)
+{
+    memset(thread_list, 0, sizeof(thread_list));
+}
+#endif
+
+static int get_online_count(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (n < 1) {
+        n = 1;
+    }
+    if (n > 32) {
+        n = 32;
+    }
+    return (int)n;
+}
+
+static uint32_t get_cpu_mask(uint32_t cpu, int online)
+{
+    uint32_t all = (online >= 32) ? 0xffffffff : ((1u << online) - 1);
+
+    if (online <= 1) {
+        return all;
+    }
+
+    if (cpu == THREAD_CPU_LAST) {
+        return 1u << (online - 1);
+    }
+
+    if ((cpu & all) == 0) {
+        return all;
+    }
+    return cpu & all;
+}
+
+#if defined(UT)
+TEST(common_thread, get_cpu_mask)
+{
+    TEST_ASSERT_EQUAL_HEX32(0x01, get_cpu_mask(THREAD_CPU_LAST, 1));
+    TEST_ASSERT_EQUAL_HEX32(0x02, get_cpu_mask(THREAD_CPU_LAST, 2));
+    TEST_ASSERT_EQUAL_HEX32(0x08, get_cpu_mask(THREAD_CPU_LAST, 4));
+    TEST_ASSERT_EQUAL_HEX32(0x01, get_cpu_mask(THREAD_CPU_FIRST, 4));
+    TEST_ASSERT_EQUAL_HEX32(0x0f, get_cpu_mask(THREAD_CPU_ANY, 4));
+    TEST_ASSERT_EQUAL_HEX32(0x03, get_cpu_mask(0x30, 2));
+}
+#endif
+
+// start time in clock ticks from /proc, 0 once the thread is gone
+static uint64_t get_start_time(pid_t tid)
+{
+    FILE *f = NULL;
+    char *p = NULL;
+    char buf[512] = { 0 };
+    unsigned long long start = 0;
+
+    snprintf(buf, sizeof(buf), "/proc/self/task/%d/stat", tid);
+    f = fopen(buf, "r");
+    if (!f) {
+        return 0;
+    }
+
+    if (!fgets(buf, sizeof(buf), f)) {
+        buf[0] = 0;
+    }
+    fclose(f);
+
+    // the name in field 2 may hold spaces, so count the fields from the last ')'
+    p = strrchr(buf, ')');
+    if (!p || (sscanf(p + 1,
+        " %*c %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %llu",
+        &start) != 1))
+    {
+        return 0;
+    }
+    return start;
+}
+
+#if defined(UT)
+TEST(common_thread, get_start_time)
+{
+    TEST_ASSERT_TRUE(get_start_time(syscall(SYS_gettid)) > 0);
+    TEST_ASSERT_EQUAL_INT(0, get_start_time(-1));
+}
+#endif
+
+static int apply_policy(thread_info_t *t, int online)
+{
+    int cc = 0;
+    int ret = 0;
+    cpu_set_t set = { 0 };
+    uint32_t mask = 0;
+    struct sched_param param = { 0 };
+    const thread_policy_t *p = NULL;
+
+    if (!t || (t->role < 0) || (t->role >= THREAD_ROLE_MAX)) {
+        err(COM"invalid parameter(0x%x) in %s\n", t, __func__);
+        return -1;
+    }
+
+    p = &thread_policy[t->role];
+    mask = get_cpu_mask(p->cpu, online);
+
+    CPU_ZERO(&set);
+    for (cc = 0; cc < 32; cc++) {
+        if (mask & (1u << cc)) {
+            CPU_SET(cc, &set);
+        }
+    }
+
+    if (sched_setaffinity(t->tid, sizeof(set), &set) < 0) {
+        warn(COM"failed to set affinity(0x%x) for \"%s\" in %s\n", mask, t->name, __func__);
+        ret = -1;
+    }
+
+    if (p->fifo) {
+        param.sched_priority = p->prio;
+        if (sched_setscheduler(t->tid, SCHED_FIFO, &param) < 0) {
+            warn(COM"failed to set SCHED_FIFO(%d) for \"%s\" in %s\n", p->prio, t->name, __func__);
+            ret = -1;
+        }
+    }
+    else {
+        param.sched_priority = 0;
+        sched_setscheduler(t->tid, SCHED_OTHER, &param);
+        if (setpriority(PRIO_PROCESS, t->tid, p->prio) < 0) {
+            warn(COM"failed to set nice(%d) for \"%s\" in %s\n", p->prio, t->name, __func__);
+            ret = -1;
+        }
+    }
+
+    debug(COM"thread \"%s\"(%d) cpu:0x%x fifo:%d prio:%d in %s\n", t->name, t->tid, mask, p->fifo, p->prio, __func__);
+    return ret;
+}
+
+int register_thread(const char *name, int role)
+{
+    int cc = 0;
+    int idx = -1;
+    pid_t tid = syscall(SYS_gettid);
+    thread_info_t *t = NULL;
+
+    if (!name || (role < 0) || (role >= THREAD_ROLE_MAX)) {
+        err(COM"invalid parameters(0x%x, %d) in %s\n", name, role, __func__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&thread_mutex);
+    for (cc = 0; cc < THREAD_MAX; cc++) {
+        if (thread_list[cc].used && (thread_list[cc].tid == tid)) {
+            idx = cc;
+            break;
+        }
+        if (!thread_list[cc].used && (idx < 0)) {
+            idx = cc;
+        }
+    }
+
+    if (idx < 0) {
+        pthread_mutex_unlock(&thread_mutex);
+        err(COM"thread registry is full in %s\n", __func__);
+        return -1;
+    }
+
+    t = &thread_list[idx];
+    t->used = 1;
+    t->role = role;
+    t->tid = tid;
+    t->pth = pthread_self();
+    // the clock id is only valid to ask for while the thread is alive
+    if (pthread_getcpuclockid(t->pth, &t->cid) != 0) {
+        t->cid = (clockid_t)-1;
+    }
+    t->start = get_start_time(tid);
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    pthread_mutex_unlock(&thread_mutex);
+
+    prctl(PR_SET_NAME, t->name, 0, 0, 0);
+    apply_policy(t, get_online_count());
+    info(COM"registered thread \"%s\"(%d) as role %d in %s\n", t->name, tid, role, __func__);
+    return idx;
+}
+
+#if defined(UT)
+TEST(common_thread, register_thread)
+{
+    char buf[THREAD_NAME_LEN] = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, register_thread(NULL, 0));
+    TEST_ASSERT_EQUAL_INT(-1, register_thread("ut", THREAD_ROLE_MAX));
+    TEST_ASSERT_EQUAL_INT(0, register_thread("ut", THREAD_ROLE_IDLE));
+    TEST_ASSERT_EQUAL_INT(0, register_thread("ut_again", THREAD_ROLE_IDLE));
+    TEST_ASSERT_EQUAL_STRING("ut_again", thread_list[0].name);
+
+    prctl(PR_GET_NAME, buf, 0, 0, 0);
+    TEST_ASSERT_EQUAL_STRING("ut_again", buf);
+    TEST_ASSERT_EQUAL_INT(0, unregister_thread());
+    TEST_ASSERT_EQUAL_INT(0, thread_list[0].used);
+}
+#endif
+
+int unregister_thread(void)
+{
+    int cc = 0;
+    pid_t tid = syscall(SYS_gettid);
+
+    pthread_mutex_lock(&thread_mutex);
+    for (cc = 0; cc < THREAD_MAX; cc++) {
+        if (thread_list[cc].used && (thread_list[cc].tid == tid)) {
+            memset(&thread_list[cc], 0, sizeof(thread_list[cc]));
+            break;
+        }
+    }
+    pthread_mutex_unlock(&thread_mutex);
+
+    return (cc < THREAD_MAX) ? 0 : -1;
+}
+
+int set_thread_policy(int role, uint32_t cpu, int fifo, int prio)
+{
+    if ((role < 0) || (role >= THREAD_ROLE_MAX)) {
+        err(COM"invalid parameter(%d) in %s\n", role, __func__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&thread_mutex);
+    thread_policy[role].cpu = cpu;
+    thread_policy[role].fifo = fifo;
+    thread_policy[role].prio = prio;
+    pthread_mutex_unlock(&thread_mutex);
+
+    return apply_thread_policy();
+}
+
+#if defined(UT)
+TEST(common_thread, set_thread_policy)
+{
+    TEST_ASSERT_EQUAL_INT(-1, set_thread_policy(-1, 0, 0, 0));
+    TEST_ASSERT_EQUAL_INT(0, register_thread("ut", THREAD_ROLE_IDLE));
+    TEST_ASSERT_EQUAL_INT(0, set_thread_policy(THREAD_ROLE_IDLE, THREAD_CPU_ANY, 0, 19));
+    TEST_ASSERT_EQUAL_INT(19, thread_policy[THREAD_ROLE_IDLE].prio);
+    unregister_thread();
+}
+#endif
+
+int apply_thread_policy(void)
+{
+    int cc = 0;
+    int ret = 0;
+    int online = get_online_count();
+
+    pthread_mutex_lock(&thread_mutex);
+    for (cc = 0; cc < THREAD_MAX; cc++) {
+        if (thread_list[cc].used) {
+            if (apply_policy(&thread_list[cc], online) < 0) {
+                ret = -1;
+            }
+        }
+    }
+    pthread_mutex_unlock(&thread_mutex);
+
+    return ret;
+}
+
+#if defined(UT)
+TEST(common_thread, apply_thread_policy)
+{
+    TEST_ASSERT_EQUAL_INT(0, apply_thread_policy());
+}
+#endif
+
+int get_thread_cpu_us(const char *name, uint64_t *us)
+{
+    int cc = 0;
+    int ret = -1;
+    struct timespec ts = { 0 };
+
+    if (!name || !us) {
+        err(COM"invalid parameters(0x%x, 0x%x) in %s\n", name, us, __func__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&thread_mutex);
+    for (cc = 0; cc < THREAD_MAX; cc++) {
+        if (thread_list[cc].used && !strcmp(thread_list[cc].name, name)) {
+            // exited without unregister_thread() or the tid has been recycled,
+            // the stored clock id must not be read for either, so the slot is dropped
+            if (!thread_list[cc].start ||
+                (get_start_time(thread_list[cc].tid) != thread_list[cc].start) ||
+                (clock_gettime(thread_list[cc].cid, &ts) != 0))
+            {
+                info(COM"drop exited thread \"%s\" in %s\n", thread_list[cc].name, __func__);
+                memset(&thread_list[cc], 0, sizeof(thread_list[cc]));
+                break;
+            }
+
+            *us = ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+            ret = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&thread_mutex);
+
+    return ret;
+}
+
+#if defined(UT)
+TEST(common_thread, get_thread_cpu_us)
+{
+    int cc = 0;
+    uint64_t us = 0;
+    volatile uint32_t sum = 0;
+
+    TEST_ASSERT_EQUAL_INT(-1, get_thread_cpu_us(NULL, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, get_thread_cpu_us("not_exist", &us));
+
+    TEST_ASSERT_EQUAL_INT(0, register_thread("ut", THREAD_ROLE_IDLE));
+    for (cc = 0; cc < 1000000; cc++) {
+        sum += cc;
+    }
+    TEST_ASSERT_EQUAL_INT(0, get_thread_cpu_us("ut", &us));
+    TEST_ASSERT_TRUE(us > 0);
+    unregister_thread();
+}
+#endif
+
+int dump_thread_stats(void)
+{
+    int cc = 0;
+    int cnt = 0;
+    uint64_t us = 0;
+    char name[THREAD_NAME_LEN] = { 0 };
+
+    for (cc = 0; cc < THREAD_MAX; cc++) {
+        pthread_mutex_lock(&thread_mutex);
+        if (!thread_list[cc].used) {
+            pthread_mutex_unlock(&thread_mutex);
+            continue;
+        }
+        strcpy(name, thread_list[cc].name);
+        pthread_mutex_unlock(&thread_mutex);
+
+        if (get_thread_cpu_us(name, &us) == 0) {
+            info(COM"thread \"%s\" used %llu ms cpu time in %s\n", name, (unsigned long long)(us / 1000), __func__);
+            cnt += 1;
+        }
+    }
+    return cnt;
+}
+
+#if defined(UT)
+static void *exit_without_unregister(void *arg)
+{
+    register_thread("ut_exit", THREAD_ROLE_IDLE);
+    return NULL;
+}
+
+TEST(common_thread, dump_thread_stats)
+{
+    int cc = 0;
+    pthread_t t = 0;
+    uint64_t us = 0;
+
+    TEST_ASSERT_EQUAL_INT(0, dump_thread_stats());
+    TEST_ASSERT_EQUAL_INT(0, register_thread("ut", THREAD_ROLE_IDLE));
+    TEST_ASSERT_EQUAL_INT(1, dump_thread_stats());
+    unregister_thread();
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&t, NULL, exit_without_unregister, NULL));
+    TEST_ASSERT_EQUAL_INT(0, pthread_join(t, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, get_thread_cpu_us("ut_exit", &us));
+    for (cc = 0; cc < THREAD_MAX; cc++) {
+        TEST_ASSERT_FALSE(thread_list[cc].used);
+    }
+    TEST_ASSERT_EQUAL_INT(0, dump_thread_stats());
+
+    // a recycled tid has another start time, the slot must not be read
+    TEST_ASSERT_EQUAL_INT(0, register_thread("ut", THREAD_ROLE_IDLE));
+    thread_list[0].start += 1;
+    TEST_ASSERT_EQUAL_INT(-1, get_thread_cpu_us("ut", &us));
+    TEST_ASSERT_FALSE(thread_list[0].used);
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(common_thread)
+{
+    RUN_TEST_CASE(common_thread, get_cpu_mask);
+    RUN_TEST_CASE(common_thread, get_start_time);
+    RUN_TEST_CASE(common_thread, register_thread);
+    RUN_TEST_CASE(common_thread, set_thread_policy);
+    RUN_TEST_CASE(common_thread, apply_thread_policy);
+    RUN_TEST_CASE(common_thread, get_thread_cpu_us);
+    RUN_TEST_CASE(common_thread, dump_thread_stats);
+}
+#endif
@@ -0,0 +1,66 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __COMMON_THREAD_H__
+#define __COMMON_THREAD_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define THREAD_MAX 16
+#define THREAD_NAME_LEN 16
+
+#define THREAD_ROLE_EMU 0
+#define THREAD_ROLE_AUDIO 1
+#define THREAD_ROLE_INPUT 2
+#define THREAD_ROLE_VIDEO 3
+#define THREAD_ROLE_IDLE 4
+#define THREAD_ROLE_MAX 5
+
+#define THREAD_CPU_FIRST 0x01
+#define THREAD_CPU_LAST 0x80000000
+#define THREAD_CPU_ANY 0xffffffff
+
+typedef struct {
+    uint32_t cpu;
+    int fifo;
+    int prio;
+} thread_policy_t;
+
+typedef struct {
+    int used;
+    int role;
+    pid_t tid;
+    pthread_t pth;
+    clockid_t cid;
+    uint64_t start;
+    char name[THREAD_NAME_LEN];
+} thread_info_t;
+
+int register_thread(const char *name, int role);
+int unregister_thread(void);
+int set_thread_policy(int role, uint32_t cpu, int fifo, int prio);
+int apply_thread_policy(void);
+int get_thread_cpu_us(const char *name, uint64_t *us);
+int dump_thread_stats(void);
+
+#endif
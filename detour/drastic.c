@@ -33,6 +33,7 @@
 #include "cfg.h"
 #include "log.h"
 #include "hook.h"
+#include "mprof.h"
 #include "drastic.h"
 
 int drastic_save_load_state_hook = 0;
@@ -63,8 +64,8 @@ int invoke_drastic_save_state(int slot)
     char buf[255] = {0};
     nds_screen_copy16 _func0 = (nds_screen_copy16)myhook.fun.screen_copy16;
 
-    void *d0 = malloc(0x18000);
-    void *d1 = malloc(0x18000);
+    void *d0 = miyoo_malloc(0x18000);
+    void *d1 = miyoo_malloc(0x18000);
 
     if ((d0 != NULL) && (d1 != NULL)) {
         _func0(d0, 0);
@@ -84,10 +85,10 @@ int invoke_drastic_save_state(int slot)
     }
 
     if (d0 != NULL) {
-        free(d0);
+        miyoo_free(d0);
     }
     if (d1 != NULL) {
-        free(d1);
+        miyoo_free(d1);
     }
 #endif
 
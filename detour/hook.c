@@ -36,6 +36,9 @@
 #include "drastic.h"
 
 static size_t page_size = 4096;
+static uint32_t *tramp_pool = NULL;
+static int tramp_used = 0;
+static hook_point_t hook_points[MAX_HOOK_POINT] = { 0 };
 miyoo_hook myhook = { 0 };
 
 extern int drastic_save_load_state_hook;
@@ -61,7 +64,9 @@ int unlock_protected_area(uintptr_t addr)
     }
 
 #if !defined(UT)
-    mprotect(ALIGN_ADDR(addr), page_size, PROT_READ | PROT_WRITE);
+    // the patch may straddle two pages
+    uintptr_t end = (uintptr_t)ALIGN_ADDR(addr + HOOK_PATCH_SIZE - 1) + page_size;
+    mprotect(ALIGN_ADDR(addr), end - (uintptr_t)ALIGN_ADDR(addr), PROT_READ | PROT_WRITE | PROT_EXEC);
 #endif
 
     return 0;
@@ -75,6 +80,283 @@ TEST(detour_hook, unlock_protected_area)
 }
 #endif
 
+static uint32_t *alloc_trampoline(void)
+{
+    uint32_t *p = NULL;
+
+    if (!tramp_pool) {
+        tramp_pool = mmap(NULL, MAX_HOOK_POINT * HOOK_TRAMP_WORDS * sizeof(uint32_t),
+            PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (tramp_pool == MAP_FAILED) {
+            tramp_pool = NULL;
+            err(DTR"failed to allocate trampoline pool in %s\n", __func__);
+            return NULL;
+        }
+    }
+
+    // slots are never reused since a thread may still be running inside one
+    if (tramp_used >= MAX_HOOK_POINT) {
+        return NULL;
+    }
+
+    p = &tramp_pool[tramp_used * HOOK_TRAMP_WORDS];
+    tramp_used += 1;
+    return p;
+}
+
+static int relocate_insn(uint32_t ins, uintptr_t pc, uint32_t *dst)
+{
+    int32_t off = 0;
+    uint32_t imm = 0;
+    uint32_t rot = 0;
+    uint32_t cond = ins & 0xf0000000;
+    uint32_t rd = (ins >> 12) & 0xf;
+    uint32_t rn = (ins >> 16) & 0xf;
+    uint32_t rm = ins & 0xf;
+
+    if (cond == 0xf0000000) {
+        // only neon data processing and neon load/store with a non-pc base
+        if (((ins & 0x0e000000) == 0x02000000) ||
+            (((ins & 0x0f100000) == 0x04000000) && (rn != 15)))
+        {
+            dst[0] = ins;
+            return 1;
+        }
+        return -1;
+    }
+
+    // b/bl <label>
+    if ((ins & 0x0e000000) == 0x0a000000) {
+        off = (int32_t)(ins << 8) >> 6;
+        if (ins & 0x01000000) {
+            dst[0] = cond | 0x028fe008;
+            dst[1] = cond | 0x059ff000;
+            dst[2] = 0xea000000;
+            dst[3] = pc + 8 + off;
+            return 4;
+        }
+        dst[0] = cond | 0x059ff000;
+        dst[1] = 0xea000000;
+        dst[2] = pc + 8 + off;
+        return 3;
+    }
+
+    // ldr rt, [pc, #+/-imm]
+    if ((ins & 0x0f7f0000) == 0x051f0000) {
+        if (rd == 15) {
+            return -1;
+        }
+        off = (ins & 0x00800000) ? (int32_t)(ins & 0xfff) : -(int32_t)(ins & 0xfff);
+        dst[0] = cond | 0x059f0000 | (rd << 12);
+        dst[1] = 0xea000000;
+        dst[2] = pc + 8 + off;
+        dst[3] = cond | 0x05900000 | (rd << 16) | (rd << 12);
+        return 4;
+    }
+
+    // add/sub rd, pc, #imm (adr)
+    if (((ins & 0x0fff0000) == 0x028f0000) || ((ins & 0x0fff0000) == 0x024f0000)) {
+        if (rd == 15) {
+            return -1;
+        }
+        rot = ((ins >> 8) & 0xf) << 1;
+        imm = ins & 0xff;
+        imm = rot ? ((imm >> rot) | (imm << (32 - rot))) : imm;
+        dst[0] = cond | 0x059f0000 | (rd << 12);
+        dst[1] = 0xea000000;
+        dst[2] = (ins & 0x00800000) ? (pc + 8 + imm) : (pc + 8 - imm);
+        return 3;
+    }
+
+    // bx/blx rm
+    if ((ins & 0x0fffffd0) == 0x012fff10) {
+        if (rm == 15) {
+            return -1;
+        }
+        dst[0] = ins;
+        return 1;
+    }
+
+    // ldm/stm (push/pop)
+    if ((ins & 0x0e000000) == 0x08000000) {
+        if ((rn == 15) || (!(ins & 0x00100000) && (ins & 0x8000))) {
+            return -1;
+        }
+        dst[0] = ins;
+        return 1;
+    }
+
+    // vfp load/store (vpush/vpop/vldr/vstr)
+    if ((ins & 0x0e000000) == 0x0c000000) {
+        if (rn == 15) {
+            return -1;
+        }
+        dst[0] = ins;
+        return 1;
+    }
+
+    // coprocessor data processing and register transfer, svc
+    if ((ins & 0x0e000000) == 0x0e000000) {
+        dst[0] = ins;
+        return 1;
+    }
+
+    // movw/movt
+    if ((ins & 0x0fb00000) == 0x03000000) {
+        if (rd == 15) {
+            return -1;
+        }
+        dst[0] = ins;
+        return 1;
+    }
+
+    // data processing immediate and load/store immediate
+    if (((ins & 0x0e000000) == 0x02000000) || ((ins & 0x0e000000) == 0x04000000)) {
+        if ((rn == 15) || (rd == 15)) {
+            return -1;
+        }
+        dst[0] = ins;
+        return 1;
+    }
+
+    // everything else, be conservative about any pc operand
+    if ((rn == 15) || (rd == 15) || (rm == 15) || (((ins >> 8) & 0xf) == 15)) {
+        return -1;
+    }
+    dst[0] = ins;
+    return 1;
+}
+
+#if defined(UT)
+TEST(detour_hook, relocate_insn)
+{
+    uint32_t dst[HOOK_TRAMP_WORDS] = { 0 };
+
+    // push {r4, lr}
+    TEST_ASSERT_EQUAL_INT(1, relocate_insn(0xe92d4010, 0x1000, dst));
+    TEST_ASSERT_EQUAL_HEX32(0xe92d4010, dst[0]);
+
+    // sub sp, sp, #0x1f
+    TEST_ASSERT_EQUAL_INT(1, relocate_insn(0xe24dd01f, 0x1000, dst));
+
+    // vpush {d8-d15}
+    TEST_ASSERT_EQUAL_INT(1, relocate_insn(0xed2d8b10, 0x1000, dst));
+
+    // b 0x1100
+    TEST_ASSERT_EQUAL_INT(3, relocate_insn(0xea00003e, 0x1000, dst));
+    TEST_ASSERT_EQUAL_HEX32(0xe59ff000, dst[0]);
+    TEST_ASSERT_EQUAL_HEX32(0xea000000, dst[1]);
+    TEST_ASSERT_EQUAL_HEX32(0x1100, dst[2]);
+
+    // blne 0x0f00
+    TEST_ASSERT_EQUAL_INT(4, relocate_insn(0x1bffffbe, 0x1000, dst));
+    TEST_ASSERT_EQUAL_HEX32(0x128fe008, dst[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x159ff000, dst[1]);
+    TEST_ASSERT_EQUAL_HEX32(0x0f00, dst[3]);
+
+    // ldr r3, [pc, #16]
+    TEST_ASSERT_EQUAL_INT(4, relocate_insn(0xe59f3010, 0x1000, dst));
+    TEST_ASSERT_EQUAL_HEX32(0xe59f3000, dst[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x1018, dst[2]);
+    TEST_ASSERT_EQUAL_HEX32(0xe5933000, dst[3]);
+
+    // sub r0, pc, #4
+    TEST_ASSERT_EQUAL_INT(3, relocate_insn(0xe24f0004, 0x1000, dst));
+    TEST_ASSERT_EQUAL_HEX32(0x1004, dst[2]);
+
+    // add r1, pc, #0x400
+    TEST_ASSERT_EQUAL_INT(3, relocate_insn(0xe28f1b01, 0x1000, dst));
+    TEST_ASSERT_EQUAL_HEX32(0x1408, dst[2]);
+
+    // add r0, r1, pc / ldr pc, [pc, #-4] / blx 0x1000 / vldr d0, [pc, #8]
+    TEST_ASSERT_EQUAL_INT(-1, relocate_insn(0xe081000f, 0x1000, dst));
+    TEST_ASSERT_EQUAL_INT(-1, relocate_insn(0xe51ff004, 0x1000, dst));
+    TEST_ASSERT_EQUAL_INT(-1, relocate_insn(0xfa000000, 0x1000, dst));
+    TEST_ASSERT_EQUAL_INT(-1, relocate_insn(0xed9f0b02, 0x1000, dst));
+}
+#endif
+
+static hook_point_t *find_hook_point(uintptr_t func)
+{
+    int cc = 0;
+
+    for (cc = 0; cc < MAX_HOOK_POINT; cc++) {
+        if (hook_points[cc].func == func) {
+            return &hook_points[cc];
+        }
+    }
+    return NULL;
+}
+
+static int write_code(uintptr_t func, const uint32_t *code)
+{
+    volatile uint32_t *base = (volatile uint32_t *)func;
+
+    unlock_protected_area(func);
+    base[0] = code[0];
+    base[1] = code[1];
+    __builtin___clear_cache((char *)func, (char *)(func + HOOK_PATCH_SIZE));
+    return 0;
+}
+
+static int install_hook(uintptr_t func, void *cb, void **orig)
+{
+    int cc = 0;
+    int len = 0;
+    int r = 0;
+    uint32_t code[HOOK_PATCH_SIZE >> 2] = { 0 };
+    uint32_t tmp[HOOK_TRAMP_WORDS] = { 0 };
+    hook_point_t *hp = NULL;
+
+    if (func & 3) {
+        err(DTR"thumb function(0x%x) is not supported in %s\n", func, __func__);
+        return -1;
+    }
+
+    if (find_hook_point(func)) {
+        err(DTR"function(0x%x) is already hooked in %s\n", func, __func__);
+        return -1;
+    }
+
+    hp = find_hook_point(0);
+    if (!hp) {
+        err(DTR"too many hook points in %s\n", __func__);
+        return -1;
+    }
+
+    memcpy(hp->orig, (void *)func, HOOK_PATCH_SIZE);
+    hp->tramp = NULL;
+    if (orig) {
+        for (cc = 0; cc < (HOOK_PATCH_SIZE >> 2); cc++) {
+            r = relocate_insn(hp->orig[cc], func + (cc << 2), &tmp[len]);
+            if (r < 0) {
+                err(DTR"failed to relocate 0x%08x at 0x%x in %s\n", hp->orig[cc], func + (cc << 2), __func__);
+                return -1;
+            }
+            len += r;
+        }
+
+        // ldr pc, [pc, #-4] back to the rest of the original function
+        tmp[len++] = 0xe51ff004;
+        tmp[len++] = func + HOOK_PATCH_SIZE;
+
+        hp->tramp = alloc_trampoline();
+        if (!hp->tramp) {
+            return -1;
+        }
+        memcpy(hp->tramp, tmp, len * sizeof(uint32_t));
+        __builtin___clear_cache((char *)hp->tramp, (char *)(hp->tramp + len));
+        *orig = hp->tramp;
+    }
+
+    // ldr pc, [pc, #-4]
+    code[0] = 0xe51ff004;
+    code[1] = (uintptr_t)cb;
+    hp->func = func;
+    hp->cb = cb;
+    return write_code(func, code);
+}
+
 int add_hook_point(uintptr_t func, void *cb)
 {
     if (!func || !cb) {
@@ -83,18 +365,7 @@ int add_hook_point(uintptr_t func, void *cb)
     }
 
 #if !defined(UT)
-    uintptr_t addr = (uintptr_t)cb;
-    volatile uint8_t *base = (uint8_t *)func;
-
-    unlock_protected_area(func);
-    base[0] = 0x04;
-    base[1] = 0xf0;
-    base[2] = 0x1f;
-    base[3] = 0xe5;
-    base[4] = addr >> 0;
-    base[5] = addr >> 8;
-    base[6] = addr >> 16;
-    base[7] = addr >> 24;
+    return install_hook(func, cb, NULL);
 #endif
 
     return 0;
@@ -108,6 +379,83 @@ TEST(detour_hook, add_hook_point)
 }
 #endif
 
+int add_detour_hook(uintptr_t func, void *cb, void **orig)
+{
+    if (!func || !cb || !orig) {
+        err(DTR"invalid parameters(0x%x, 0x%x, 0x%x) in %s\n", func, cb, orig, __func__);
+        return -1;
+    }
+    return install_hook(func, cb, orig);
+}
+
+#if defined(UT)
+TEST(detour_hook, add_detour_hook)
+{
+    void *orig = NULL;
+    uint32_t code[4] __attribute__((aligned(8))) = { 0xe92d4010, 0xe59f3010, 0xe1a00000, 0xe8bd8010 };
+    uint32_t bad[4] __attribute__((aligned(8))) = { 0xe51ff004, 0x00000000, 0xe1a00000, 0xe1a00000 };
+
+    TEST_ASSERT_EQUAL_INT(-1, add_detour_hook(0, (void *)0xdeadbeef, &orig));
+    TEST_ASSERT_EQUAL_INT(-1, add_detour_hook((uintptr_t)code, (void *)0xdeadbeef, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, add_detour_hook((uintptr_t)code + 2, (void *)0xdeadbeef, &orig));
+
+    TEST_ASSERT_EQUAL_INT(0, add_detour_hook((uintptr_t)code, (void *)0xdeadbeef, &orig));
+    TEST_ASSERT_EQUAL_HEX32(0xe51ff004, code[0]);
+    TEST_ASSERT_EQUAL_HEX32(0xdeadbeef, code[1]);
+    TEST_ASSERT_EQUAL_HEX32(0xe1a00000, code[2]);
+    TEST_ASSERT_NOT_NULL(orig);
+    TEST_ASSERT_EQUAL_HEX32(0xe92d4010, ((uint32_t *)orig)[0]);
+    TEST_ASSERT_EQUAL_HEX32(0xe59f3000, ((uint32_t *)orig)[1]);
+    TEST_ASSERT_EQUAL_HEX32((uintptr_t)&code[1] + 8 + 0x10, ((uint32_t *)orig)[3]);
+    TEST_ASSERT_EQUAL_HEX32(0xe51ff004, ((uint32_t *)orig)[5]);
+    TEST_ASSERT_EQUAL_HEX32((uintptr_t)&code[2], ((uint32_t *)orig)[6]);
+    TEST_ASSERT_EQUAL_INT(-1, add_detour_hook((uintptr_t)code, (void *)0xdeadbeef, &orig));
+
+    TEST_ASSERT_EQUAL_INT(-1, add_detour_hook((uintptr_t)bad, (void *)0xdeadbeef, &orig));
+    TEST_ASSERT_EQUAL_HEX32(0xe51ff004, bad[0]);
+    TEST_ASSERT_EQUAL_HEX32(0, bad[1]);
+
+    TEST_ASSERT_EQUAL_INT(0, remove_hook_point((uintptr_t)code));
+    TEST_ASSERT_EQUAL_HEX32(0xe92d4010, code[0]);
+    TEST_ASSERT_EQUAL_HEX32(0xe59f3010, code[1]);
+}
+#endif
+
+int remove_hook_point(uintptr_t func)
+{
+    hook_point_t *hp = NULL;
+
+    if (!func) {
+        err(DTR"invalid parameter(0x%x) in %s\n", func, __func__);
+        return -1;
+    }
+
+    hp = find_hook_point(func);
+    if (!hp) {
+        return -1;
+    }
+
+    write_code(func, hp->orig);
+    memset(hp, 0, sizeof(hook_point_t));
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_hook, remove_hook_point)
+{
+    uint32_t code[2] __attribute__((aligned(8))) = { 0xe92d4010, 0xe1a00000 };
+
+    TEST_ASSERT_EQUAL_INT(-1, remove_hook_point(0));
+    TEST_ASSERT_EQUAL_INT(-1, remove_hook_point((uintptr_t)code));
+    TEST_ASSERT_EQUAL_INT(0, install_hook((uintptr_t)code, (void *)0xdeadbeef, NULL));
+    TEST_ASSERT_EQUAL_HEX32(0xe51ff004, code[0]);
+    TEST_ASSERT_EQUAL_INT(0, remove_hook_point((uintptr_t)code));
+    TEST_ASSERT_EQUAL_HEX32(0xe92d4010, code[0]);
+    TEST_ASSERT_EQUAL_HEX32(0xe1a00000, code[1]);
+    TEST_ASSERT_NULL(find_hook_point((uintptr_t)code));
+}
+#endif
+
 static int init_hook_table(void)
 {
     myhook.var.system.base = (uint32_t*)0x083f4000;
@@ -193,15 +541,44 @@ TEST(detour_hook, init_detour_hook)
 }
 #endif
 
+static int is_allocator(uintptr_t func)
+{
+    return (func == myhook.fun.malloc) || (func == myhook.fun.realloc) || (func == myhook.fun.free);
+}
+
 int restore_detour_hook(void)
 {
+    int cc = 0;
+
+    // DraStic threads keep running after this, a screen handed out from MI_SYS
+    // by the allocator hooks must never reach libc free(), so those stay
+    // installed until the process exits
+    for (cc = MAX_HOOK_POINT - 1; cc >= 0; cc--) {
+        if (hook_points[cc].func && !is_allocator(hook_points[cc].func)) {
+            remove_hook_point(hook_points[cc].func);
+        }
+    }
     return 0;
 }
 
 #if defined(UT)
 TEST(detour_hook, restore_detour_hook)
 {
+    uintptr_t free_addr = myhook.fun.free;
+    uint32_t code[2] __attribute__((aligned(8))) = { 0xe92d4010, 0xe1a00000 };
+    uint32_t alloc[2] __attribute__((aligned(8))) = { 0xe92d4010, 0xe1a00000 };
+
+    myhook.fun.free = (uintptr_t)alloc;
+    TEST_ASSERT_EQUAL_INT(0, install_hook((uintptr_t)code, (void *)0xdeadbeef, NULL));
+    TEST_ASSERT_EQUAL_INT(0, install_hook((uintptr_t)alloc, (void *)0xdeadbeef, NULL));
     TEST_ASSERT_EQUAL_INT(0, restore_detour_hook());
+    TEST_ASSERT_EQUAL_HEX32(0xe92d4010, code[0]);
+    TEST_ASSERT_NULL(find_hook_point((uintptr_t)code));
+    TEST_ASSERT_EQUAL_HEX32(0xe51ff004, alloc[0]);
+    TEST_ASSERT_NOT_NULL(find_hook_point((uintptr_t)alloc));
+
+    TEST_ASSERT_EQUAL_INT(0, remove_hook_point((uintptr_t)alloc));
+    myhook.fun.free = free_addr;
 }
 #endif
 
@@ -281,7 +658,10 @@ TEST(detour_hook, add_save_load_state_handler)
 TEST_GROUP_RUNNER(detour_hook)
 {
     RUN_TEST_CASE(detour_hook, unlock_protected_area);
+    RUN_TEST_CASE(detour_hook, relocate_insn);
     RUN_TEST_CASE(detour_hook, add_hook_point);
+    RUN_TEST_CASE(detour_hook, add_detour_hook);
+    RUN_TEST_CASE(detour_hook, remove_hook_point);
     RUN_TEST_CASE(detour_hook, init_hook_table);
     RUN_TEST_CASE(detour_hook, init_detour_hook);
     RUN_TEST_CASE(detour_hook, restore_detour_hook);
@@ -23,6 +23,10 @@
 
     #define ALIGN_ADDR(addr) ((void*)((size_t)(addr) & ~(page_size - 1)))
 
+    #define MAX_HOOK_POINT 64
+    #define HOOK_PATCH_SIZE 8
+    #define HOOK_TRAMP_WORDS 16
+
     typedef struct _system {
         uint32_t *base;
         uint32_t *gamecard_name;
@@ -86,6 +90,13 @@
         uintptr_t render_polygon_setup_perspective_steps;
     } fun_t;
 
+    typedef struct _hook_point {
+        uintptr_t func;
+        void *cb;
+        uint32_t orig[HOOK_PATCH_SIZE >> 2];
+        uint32_t *tramp;
+    } hook_point_t;
+
     typedef struct _miyoo_hook {
         fun_t fun;
         var_t var;
@@ -97,6 +108,8 @@
     int unlock_protected_area(uintptr_t addr);
     int add_save_load_state_handler(const char *path);
     int add_hook_point(uintptr_t func, void *cb);
+    int add_detour_hook(uintptr_t func, void *cb, void **orig);
+    int remove_hook_point(uintptr_t func);
 
 #endif
 
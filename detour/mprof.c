@@ -0,0 +1,625 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "log.h"
+#include "hook.h"
+#include "governor.h"
+#include "mprof.h"
+
+extern miyoo_hook myhook;
+
+typedef struct _mprof_ctx {
+    pthread_mutex_t lock;
+    int running;
+    int hooked;
+    uint32_t frame;
+    uint64_t start_ns;
+    uint64_t untracked;
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+    uint64_t steady_sum;
+    uint64_t steady_max;
+    uint32_t frame_allocs;
+    uint32_t max_frame_allocs;
+    uint64_t frame_bytes;
+    uint64_t max_frame_bytes;
+} mprof_ctx_t;
+
+static mprof_ctx_t mprof = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static mprof_site_t mprof_site[MPROF_MAX_SITE] = { 0 };
+static mprof_ptr_t mprof_ptr[MPROF_MAX_PTR] = { 0 };
+static const char *mprof_src_name[MPROF_SRC_MAX] = { "drastic", "sdl", "miyoo" };
+
+#if defined(UT)
+TEST_GROUP(detour_mprof);
+
+TEST_SETUP(detour_mprof)
+{
+}
+
+TEST_TEAR_DOWN(detour_mprof)
+{
+    quit_mem_profiler(NULL);
+    unlink(MPROF_REPORT_FILE);
+}
+#endif
+
+static inline uint32_t hash_ptr(uintptr_t v)
+{
+    return ((uint32_t)(v >> 3) * 2654435761u) & (MPROF_MAX_PTR - 1);
+}
+
+static mprof_site_t *get_site(uint32_t src, uintptr_t addr, uint32_t size)
+{
+    int cc = 0;
+    uint32_t h = 0;
+    mprof_site_t *s = NULL;
+
+    size = (src == MPROF_SRC_SDL) ? size : 0;
+    h = ((uint32_t)(addr ^ (size * 31) ^ src) * 2654435761u) >> 23;
+    for (cc = 0; cc < MPROF_MAX_SITE; cc++) {
+        s = &mprof_site[(h + cc) & (MPROF_MAX_SITE - 1)];
+        if (!s->addr) {
+            s->addr = addr;
+            s->src = src;
+            s->size = size;
+            return s;
+        }
+        if ((s->addr == addr) && (s->src == src) && (s->size == size)) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+#if defined(UT)
+TEST(detour_mprof, get_site)
+{
+    mprof_site_t *s = NULL;
+
+    s = get_site(MPROF_SRC_MIYOO, 0x1000, 32);
+    TEST_ASSERT_NOT_NULL(s);
+    TEST_ASSERT_EQUAL_INT(0, s->size);
+    TEST_ASSERT_EQUAL_PTR(s, get_site(MPROF_SRC_MIYOO, 0x1000, 64));
+    TEST_ASSERT_TRUE(s != get_site(MPROF_SRC_DRASTIC, 0x1000, 32));
+    TEST_ASSERT_TRUE(get_site(MPROF_SRC_SDL, 0x1000, 32) != get_site(MPROF_SRC_SDL, 0x1000, 64));
+}
+#endif
+
+static mprof_ptr_t *find_ptr(uintptr_t ptr)
+{
+    int cc = 0;
+    mprof_ptr_t *p = NULL;
+    uint32_t h = hash_ptr(ptr);
+
+    for (cc = 0; cc < MPROF_MAX_PTR; cc++) {
+        p = &mprof_ptr[(h + cc) & (MPROF_MAX_PTR - 1)];
+        if (!p->ptr || (p->ptr == ptr)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// backward shift deletion keeps the probe chains intact without tombstones
+static void remove_ptr(mprof_ptr_t *p)
+{
+    uint32_t i = p - mprof_ptr;
+    uint32_t j = i;
+    uint32_t h = 0;
+
+    while (1) {
+        j = (j + 1) & (MPROF_MAX_PTR - 1);
+        if (!mprof_ptr[j].ptr) {
+            break;
+        }
+
+        h = hash_ptr(mprof_ptr[j].ptr);
+        if (((j - h) & (MPROF_MAX_PTR - 1)) >= ((j - i) & (MPROF_MAX_PTR - 1))) {
+            mprof_ptr[i] = mprof_ptr[j];
+            i = j;
+        }
+    }
+    memset(&mprof_ptr[i], 0, sizeof(mprof_ptr_t));
+}
+
+#if defined(UT)
+TEST(detour_mprof, remove_ptr)
+{
+    int cc = 0;
+    mprof_ptr_t *p = NULL;
+    const uintptr_t base = 0x10000;
+    const uintptr_t step = (uintptr_t)MPROF_MAX_PTR << 3;
+
+    // same bucket, the chain must survive removing its head
+    memset(mprof_ptr, 0, sizeof(mprof_ptr));
+    for (cc = 0; cc < 3; cc++) {
+        p = find_ptr(base + (cc * step));
+        TEST_ASSERT_NOT_NULL(p);
+        p->ptr = base + (cc * step);
+    }
+
+    remove_ptr(find_ptr(base));
+    TEST_ASSERT_EQUAL_HEX32(base + step, find_ptr(base + step)->ptr);
+    TEST_ASSERT_EQUAL_HEX32(base + (2 * step), find_ptr(base + (2 * step))->ptr);
+    TEST_ASSERT_EQUAL_HEX32(0, find_ptr(base)->ptr);
+    memset(mprof_ptr, 0, sizeof(mprof_ptr));
+}
+#endif
+
+static void roll_site_frame(mprof_site_t *s)
+{
+    if (s->frame != mprof.frame) {
+        s->frame = mprof.frame;
+        s->frame_allocs = 0;
+    }
+}
+
+void mprof_alloc(uint32_t src, uintptr_t site, void *ptr, size_t size)
+{
+    mprof_ptr_t *p = NULL;
+    mprof_site_t *s = NULL;
+
+    if (!mprof.running || !ptr || (src >= MPROF_SRC_MAX)) {
+        return;
+    }
+
+    pthread_mutex_lock(&mprof.lock);
+    s = get_site(src, site, size);
+    p = find_ptr((uintptr_t)ptr);
+    if (!s || !p) {
+        mprof.untracked += 1;
+        pthread_mutex_unlock(&mprof.lock);
+        return;
+    }
+
+    roll_site_frame(s);
+    s->allocs += 1;
+    s->bytes += size;
+    s->live_bytes += size;
+    s->live_cnt += 1;
+    s->frame_allocs += 1;
+    if (s->frame_allocs > s->max_frame_allocs) {
+        s->max_frame_allocs = s->frame_allocs;
+    }
+
+    p->ptr = (uintptr_t)ptr;
+    p->size = size;
+    p->site = s - mprof_site;
+    p->frame = mprof.frame;
+    p->t0 = get_clock_ns(CLOCK_MONOTONIC_RAW);
+
+    mprof.frame_allocs += 1;
+    mprof.frame_bytes += size;
+    mprof.live_bytes += size;
+    if (mprof.live_bytes > mprof.peak_bytes) {
+        mprof.peak_bytes = mprof.live_bytes;
+    }
+    pthread_mutex_unlock(&mprof.lock);
+}
+
+void mprof_release(void *ptr)
+{
+    mprof_ptr_t *p = NULL;
+    mprof_site_t *s = NULL;
+
+    if (!mprof.running || !ptr) {
+        return;
+    }
+
+    pthread_mutex_lock(&mprof.lock);
+    p = find_ptr((uintptr_t)ptr);
+    if (p && p->ptr) {
+        s = &mprof_site[p->site];
+        s->frees += 1;
+        s->live_bytes -= p->size;
+        s->live_cnt -= 1;
+        s->life_ns += get_clock_ns(CLOCK_MONOTONIC_RAW) - p->t0;
+        if (p->frame == mprof.frame) {
+            s->transient += 1;
+        }
+        mprof.live_bytes -= p->size;
+        remove_ptr(p);
+    }
+    pthread_mutex_unlock(&mprof.lock);
+}
+
+void mprof_resize(uint32_t src, uintptr_t site, void *old, void *ptr, size_t size)
+{
+    if (old) {
+        mprof_release(old);
+    }
+    mprof_alloc(src, site, ptr, size);
+}
+
+#if defined(UT)
+TEST(detour_mprof, mprof_alloc)
+{
+    mprof_site_t *s = NULL;
+
+    mprof_alloc(MPROF_SRC_MIYOO, 0x1000, (void *)0x2000, 32);
+    TEST_ASSERT_EQUAL_INT(0, mprof.live_bytes);
+
+    TEST_ASSERT_EQUAL_INT(0, init_mem_profiler(0));
+    mprof_alloc(MPROF_SRC_MIYOO, 0x1000, (void *)0x2000, 32);
+    mprof_alloc(MPROF_SRC_MIYOO, 0x1000, (void *)0x3000, 64);
+    mprof_alloc(MPROF_SRC_MAX, 0x1000, (void *)0x4000, 64);
+    mprof_alloc(MPROF_SRC_MIYOO, 0x1000, NULL, 64);
+    s = get_site(MPROF_SRC_MIYOO, 0x1000, 0);
+    TEST_ASSERT_EQUAL_INT(2, s->allocs);
+    TEST_ASSERT_EQUAL_INT(96, s->live_bytes);
+    TEST_ASSERT_EQUAL_INT(96, mprof.live_bytes);
+    TEST_ASSERT_EQUAL_INT(2, s->max_frame_allocs);
+
+    mprof_release((void *)0x2000);
+    mprof_release((void *)0x5000);
+    TEST_ASSERT_EQUAL_INT(1, s->frees);
+    TEST_ASSERT_EQUAL_INT(1, s->transient);
+    TEST_ASSERT_EQUAL_INT(64, mprof.live_bytes);
+    TEST_ASSERT_EQUAL_INT(96, mprof.peak_bytes);
+
+    mprof_next_frame();
+    mprof_resize(MPROF_SRC_MIYOO, 0x1000, (void *)0x3000, (void *)0x6000, 128);
+    TEST_ASSERT_EQUAL_INT(2, s->frees);
+    TEST_ASSERT_EQUAL_INT(1, s->transient);
+    TEST_ASSERT_EQUAL_INT(128, mprof.live_bytes);
+    TEST_ASSERT_EQUAL_INT(1, s->frame_allocs);
+    TEST_ASSERT_EQUAL_INT(2, s->max_frame_allocs);
+}
+#endif
+
+int mprof_next_frame(void)
+{
+    if (!mprof.running) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&mprof.lock);
+    if (mprof.frame_allocs > mprof.max_frame_allocs) {
+        mprof.max_frame_allocs = mprof.frame_allocs;
+    }
+    if (mprof.frame_bytes > mprof.max_frame_bytes) {
+        mprof.max_frame_bytes = mprof.frame_bytes;
+    }
+
+    // loading a game allocates most of the footprint, skip it
+    if (mprof.frame >= MPROF_WARMUP_FRAME) {
+        mprof.steady_sum += mprof.live_bytes;
+        if (mprof.live_bytes > mprof.steady_max) {
+            mprof.steady_max = mprof.live_bytes;
+        }
+    }
+
+    mprof.frame += 1;
+    mprof.frame_allocs = 0;
+    mprof.frame_bytes = 0;
+    pthread_mutex_unlock(&mprof.lock);
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_mprof, mprof_next_frame)
+{
+    TEST_ASSERT_EQUAL_INT(-1, mprof_next_frame());
+    TEST_ASSERT_EQUAL_INT(0, init_mem_profiler(0));
+    mprof_alloc(MPROF_SRC_DRASTIC, 0x1000, (void *)0x2000, 32);
+    mprof_alloc(MPROF_SRC_DRASTIC, 0x1000, (void *)0x3000, 32);
+    TEST_ASSERT_EQUAL_INT(0, mprof_next_frame());
+    mprof_alloc(MPROF_SRC_DRASTIC, 0x1000, (void *)0x4000, 32);
+    TEST_ASSERT_EQUAL_INT(0, mprof_next_frame());
+    TEST_ASSERT_EQUAL_INT(2, mprof.frame);
+    TEST_ASSERT_EQUAL_INT(2, mprof.max_frame_allocs);
+    TEST_ASSERT_EQUAL_INT(64, mprof.max_frame_bytes);
+    TEST_ASSERT_EQUAL_INT(0, mprof.frame_allocs);
+}
+#endif
+
+void *miyoo_malloc(size_t size)
+{
+    void *r = malloc(size);
+
+    mprof_alloc(MPROF_SRC_MIYOO, (uintptr_t)__builtin_return_address(0), r, size);
+    return r;
+}
+
+void miyoo_free(void *ptr)
+{
+    mprof_release(ptr);
+    free(ptr);
+}
+
+#if defined(UT)
+TEST(detour_mprof, miyoo_malloc)
+{
+    void *p = NULL;
+
+    TEST_ASSERT_EQUAL_INT(0, init_mem_profiler(0));
+    p = miyoo_malloc(48);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL_INT(48, mprof.live_bytes);
+    miyoo_free(p);
+    miyoo_free(NULL);
+    TEST_ASSERT_EQUAL_INT(0, mprof.live_bytes);
+}
+#endif
+
+#if !defined(UT)
+// DraStic calls these through its own PLT entries, libc does the work and
+// nothing is recorded unless all three hooks are in place
+static void *hook_malloc(size_t size)
+{
+    void *r = malloc(size);
+
+    if (mprof.hooked > 0) {
+        mprof_alloc(MPROF_SRC_DRASTIC, (uintptr_t)__builtin_return_address(0), r, size);
+    }
+    return r;
+}
+
+static void *hook_realloc(void *ptr, size_t size)
+{
+    void *r = realloc(ptr, size);
+
+    if ((mprof.hooked > 0) && (r || !size)) {
+        mprof_resize(MPROF_SRC_DRASTIC, (uintptr_t)__builtin_return_address(0), ptr, r, size);
+    }
+    return r;
+}
+
+static void hook_free(void *ptr)
+{
+    if (mprof.hooked > 0) {
+        mprof_release(ptr);
+    }
+    free(ptr);
+}
+#endif
+
+static int cmp_site(const void *a, const void *b)
+{
+    const mprof_site_t *s0 = &mprof_site[*(const uint16_t *)a];
+    const mprof_site_t *s1 = &mprof_site[*(const uint16_t *)b];
+
+    if (s0->allocs != s1->allocs) {
+        return (s0->allocs < s1->allocs) ? 1 : -1;
+    }
+    return (s0->live_bytes < s1->live_bytes) ? 1 : -1;
+}
+
+int dump_mem_profiler(const char *path)
+{
+    int cc = 0;
+    int cnt = 0;
+    FILE *f = NULL;
+    uint32_t steady = 0;
+    uint64_t allocs = 0;
+    uint64_t frees = 0;
+    mprof_site_t *s = NULL;
+    uint16_t idx[MPROF_MAX_SITE] = { 0 };
+
+    if (!path) {
+        err(DTR"invalid parameter(0x%x) in %s\n", path, __func__);
+        return -1;
+    }
+
+    if (!mprof.start_ns) {
+        return -1;
+    }
+
+    f = fopen(path, "w");
+    if (!f) {
+        err(DTR"failed to create \"%s\" in %s\n", path, __func__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&mprof.lock);
+    for (cc = 0; cc < MPROF_MAX_SITE; cc++) {
+        if (mprof_site[cc].addr) {
+            allocs += mprof_site[cc].allocs;
+            frees += mprof_site[cc].frees;
+            idx[cnt++] = cc;
+        }
+    }
+    qsort(idx, cnt, sizeof(idx[0]), cmp_site);
+
+    steady = (mprof.frame > MPROF_WARMUP_FRAME) ? (mprof.frame - MPROF_WARMUP_FRAME) : 0;
+    fprintf(f, "# %u frames in %llu ms, %llu allocs, %llu frees, %llu untracked\n",
+        mprof.frame,
+        (unsigned long long)((get_clock_ns(CLOCK_MONOTONIC_RAW) - mprof.start_ns) / 1000000),
+        (unsigned long long)allocs,
+        (unsigned long long)frees,
+        (unsigned long long)mprof.untracked);
+    fprintf(f, "# live %llu KB, peak %llu KB, steady avg %llu KB max %llu KB after %d frames\n",
+        (unsigned long long)(mprof.live_bytes >> 10),
+        (unsigned long long)(mprof.peak_bytes >> 10),
+        (unsigned long long)(steady ? ((mprof.steady_sum / steady) >> 10) : 0),
+        (unsigned long long)(mprof.steady_max >> 10),
+        MPROF_WARMUP_FRAME);
+    fprintf(f, "# per frame max %u allocs, %llu KB\n",
+        mprof.max_frame_allocs, (unsigned long long)(mprof.max_frame_bytes >> 10));
+    fprintf(f, "# %-7s %-10s %8s %10s %9s %7s %10s %7s %9s %6s %9s\n",
+        "src", "site", "size", "allocs", "allocs/frm", "max/frm", "total_KB", "live", "live_KB", "trans%", "life_ms");
+    for (cc = 0; (cc < cnt) && (cc < MPROF_TOP); cc++) {
+        s = &mprof_site[idx[cc]];
+        fprintf(f, "  %-7s 0x%08lx %8u %10llu %9.2f %7u %10llu %7u %9llu %6.1f %9.2f\n",
+            mprof_src_name[s->src],
+            (unsigned long)s->addr,
+            s->size,
+            (unsigned long long)s->allocs,
+            mprof.frame ? ((double)s->allocs / mprof.frame) : 0.0,
+            s->max_frame_allocs,
+            (unsigned long long)(s->bytes >> 10),
+            s->live_cnt,
+            (unsigned long long)(s->live_bytes >> 10),
+            s->frees ? ((double)s->transient * 100.0 / s->frees) : 0.0,
+            s->frees ? ((double)s->life_ns / s->frees / 1000000.0) : 0.0);
+    }
+    pthread_mutex_unlock(&mprof.lock);
+
+    fclose(f);
+    info(DTR"wrote memory profile to \"%s\" in %s\n", path, __func__);
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_mprof, dump_mem_profiler)
+{
+    int cc = 0;
+    FILE *f = NULL;
+    char buf[256] = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, dump_mem_profiler(NULL));
+    TEST_ASSERT_EQUAL_INT(-1, dump_mem_profiler(MPROF_REPORT_FILE));
+
+    TEST_ASSERT_EQUAL_INT(0, init_mem_profiler(0));
+    mprof_alloc(MPROF_SRC_SDL, 0x1000, (void *)0x2000, 32);
+    for (cc = 0; cc < 4; cc++) {
+        mprof_alloc(MPROF_SRC_DRASTIC, 0x8000, (void *)(uintptr_t)(0x3000 + (cc * 16)), 16);
+    }
+    TEST_ASSERT_EQUAL_INT(0, dump_mem_profiler(MPROF_REPORT_FILE));
+
+    f = fopen(MPROF_REPORT_FILE, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    for (cc = 0; cc < 5; cc++) {
+        TEST_ASSERT_NOT_NULL(fgets(buf, sizeof(buf), f));
+    }
+    TEST_ASSERT_NOT_NULL(strstr(buf, "drastic"));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "0x00008000"));
+    TEST_ASSERT_NOT_NULL(fgets(buf, sizeof(buf), f));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "sdl"));
+    fclose(f);
+}
+#endif
+
+// may be called again to add the DraStic hooks later on, they are only tried
+// once and stay until the process exits, restore_detour_hook skips them
+int init_mem_profiler(int hook)
+{
+#if !defined(UT)
+    if (hook && !mprof.hooked) {
+        if (!myhook.fun.malloc) {
+            init_detour_hook();
+        }
+
+        mprof.hooked = -1;
+        if ((add_hook_point(myhook.fun.malloc, hook_malloc) < 0) ||
+            (add_hook_point(myhook.fun.realloc, hook_realloc) < 0) ||
+            (add_hook_point(myhook.fun.free, hook_free) < 0))
+        {
+            warn(DTR"failed to hook DraStic allocator in %s\n", __func__);
+        }
+        else {
+            mprof.hooked = 1;
+        }
+    }
+#endif
+
+    if (mprof.running) {
+        return 0;
+    }
+
+    mprof.start_ns = get_clock_ns(CLOCK_MONOTONIC_RAW);
+    mprof.running = 1;
+    info(DTR"memory profiler started in %s\n", __func__);
+    return 0;
+}
+
+int quit_mem_profiler(const char *path)
+{
+    if (path && mprof.start_ns) {
+        dump_mem_profiler(path);
+    }
+
+    // the hooks keep calling libc, only the bookkeeping stops, DraStic
+    // threads may still be inside them so they are not removed here
+    mprof.running = 0;
+
+    pthread_mutex_lock(&mprof.lock);
+    memset(mprof_site, 0, sizeof(mprof_site));
+    memset(mprof_ptr, 0, sizeof(mprof_ptr));
+    mprof.frame = 0;
+    mprof.start_ns = 0;
+    mprof.untracked = 0;
+    mprof.live_bytes = 0;
+    mprof.peak_bytes = 0;
+    mprof.steady_sum = 0;
+    mprof.steady_max = 0;
+    mprof.frame_allocs = 0;
+    mprof.max_frame_allocs = 0;
+    mprof.frame_bytes = 0;
+    mprof.max_frame_bytes = 0;
+    pthread_mutex_unlock(&mprof.lock);
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_mprof, init_mem_profiler)
+{
+    TEST_ASSERT_EQUAL_INT(0, init_mem_profiler(0));
+    mprof_alloc(MPROF_SRC_SDL, 0x1000, (void *)0x2000, 32);
+    TEST_ASSERT_EQUAL_INT(0, init_mem_profiler(1));
+    TEST_ASSERT_EQUAL_INT(1, mprof.running);
+    TEST_ASSERT_EQUAL_INT(32, mprof.live_bytes);
+}
+#endif
+
+#if defined(UT)
+TEST(detour_mprof, quit_mem_profiler)
+{
+    TEST_ASSERT_EQUAL_INT(0, quit_mem_profiler(NULL));
+    TEST_ASSERT_EQUAL_INT(0, init_mem_profiler(0));
+    mprof_alloc(MPROF_SRC_MIYOO, 0x1000, (void *)0x2000, 32);
+    TEST_ASSERT_EQUAL_INT(0, quit_mem_profiler(MPROF_REPORT_FILE));
+    TEST_ASSERT_EQUAL_INT(0, access(MPROF_REPORT_FILE, F_OK));
+    TEST_ASSERT_EQUAL_INT(0, mprof.running);
+    TEST_ASSERT_EQUAL_INT(0, mprof.live_bytes);
+    TEST_ASSERT_EQUAL_HEX32(0, find_ptr(0x2000)->ptr);
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(detour_mprof)
+{
+    RUN_TEST_CASE(detour_mprof, get_site);
+    RUN_TEST_CASE(detour_mprof, remove_ptr);
+    RUN_TEST_CASE(detour_mprof, mprof_alloc);
+    RUN_TEST_CASE(detour_mprof, mprof_next_frame);
+    RUN_TEST_CASE(detour_mprof, miyoo_malloc);
+    RUN_TEST_CASE(detour_mprof, dump_mem_profiler);
+    RUN_TEST_CASE(detour_mprof, init_mem_profiler);
+    RUN_TEST_CASE(detour_mprof, quit_mem_profiler);
+}
+#endif
+
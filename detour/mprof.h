@@ -0,0 +1,75 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __DETOUR_MPROF_H__
+#define __DETOUR_MPROF_H__
+
+    #define MPROF_MAX_SITE 512
+    #define MPROF_MAX_PTR 16384
+    #define MPROF_TOP 32
+    #define MPROF_WARMUP_FRAME 120
+    #define MPROF_ENABLE_FILE "miyoo_mem_prof"
+    #define MPROF_REPORT_FILE "miyoo_mem_prof.txt"
+
+    typedef enum _mprof_src {
+        MPROF_SRC_DRASTIC = 0,
+        MPROF_SRC_SDL,
+        MPROF_SRC_MIYOO,
+        MPROF_SRC_MAX
+    } mprof_src_t;
+
+    // SDL sites are also keyed by size since every SDL allocation returns
+    // into SDL_malloc rather than into the caller
+    typedef struct _mprof_site {
+        uintptr_t addr;
+        uint32_t src;
+        uint32_t size;
+        uint64_t allocs;
+        uint64_t frees;
+        uint64_t bytes;
+        uint64_t live_bytes;
+        uint64_t life_ns;
+        uint64_t transient;
+        uint32_t live_cnt;
+        uint32_t frame;
+        uint32_t frame_allocs;
+        uint32_t max_frame_allocs;
+    } mprof_site_t;
+
+    typedef struct _mprof_ptr {
+        uintptr_t ptr;
+        uint32_t size;
+        uint32_t site;
+        uint32_t frame;
+        uint64_t t0;
+    } mprof_ptr_t;
+
+    int init_mem_profiler(int hook);
+    int quit_mem_profiler(const char *path);
+    int dump_mem_profiler(const char *path);
+    int mprof_next_frame(void);
+    void mprof_alloc(uint32_t src, uintptr_t site, void *ptr, size_t size);
+    void mprof_release(void *ptr);
+    void mprof_resize(uint32_t src, uintptr_t site, void *old, void *ptr, size_t size);
+    void *miyoo_malloc(size_t size);
+    void miyoo_free(void *ptr);
+
+#endif
+
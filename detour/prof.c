@@ -0,0 +1,365 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#define _GNU_SOURCE
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "cfg.h"
+#include "log.h"
+#include "hook.h"
+#include "governor.h"
+#include "prof.h"
+
+extern miyoo_hook myhook;
+
+#if !defined(UT)
+extern void fprof_thunk_0(void);
+extern void fprof_thunk_1(void);
+extern void fprof_thunk_2(void);
+extern void fprof_thunk_3(void);
+extern void fprof_thunk_4(void);
+extern void fprof_thunk_5(void);
+extern void fprof_thunk_6(void);
+extern void fprof_thunk_7(void);
+extern void fprof_thunk_8(void);
+extern void fprof_thunk_9(void);
+extern void fprof_thunk_10(void);
+extern void fprof_thunk_11(void);
+
+static void (*fprof_thunk[FPROF_MAX_FUNC])(void) = {
+    fprof_thunk_0, fprof_thunk_1, fprof_thunk_2, fprof_thunk_3,
+    fprof_thunk_4, fprof_thunk_5, fprof_thunk_6, fprof_thunk_7,
+    fprof_thunk_8, fprof_thunk_9, fprof_thunk_10, fprof_thunk_11,
+};
+#endif
+
+static int fprof_running = 0;
+static uint64_t fprof_start_ns = 0;
+static uint64_t fprof_frames = 0;
+static __thread int fprof_depth = 0;
+static __thread fprof_frame_t fprof_stack[FPROF_MAX_DEPTH] = { 0 };
+
+// update_screen must stay first since every call of it closes one frame
+static fprof_func_t fprof_func[FPROF_MAX_FUNC] = {
+    { .name = "update_screen", .addr = &myhook.fun.update_screen },
+    { .name = "spu_adpcm_decode_block", .addr = &myhook.fun.spu_adpcm_decode_block },
+    { .name = "render_scanline_tiled_4bpp", .addr = &myhook.fun.render_scanline_tiled_4bpp },
+    { .name = "render_polygon_setup_perspective_steps", .addr = &myhook.fun.render_polygon_setup_perspective_steps },
+    { .name = "screen_copy16", .addr = &myhook.fun.screen_copy16 },
+    { .name = "get_screen_ptr", .addr = &myhook.fun.get_screen_ptr },
+    { .name = "blit_screen_menu", .addr = &myhook.fun.blit_screen_menu },
+    { .name = "print_string", .addr = &myhook.fun.print_string },
+    { .name = "save_state", .addr = &myhook.fun.save_state },
+    { .name = "load_state", .addr = &myhook.fun.load_state },
+    { .name = "savestate_pre", .addr = &myhook.fun.savestate_pre },
+    { .name = "savestate_post", .addr = &myhook.fun.savestate_post },
+};
+
+#if defined(UT)
+TEST_GROUP(detour_prof);
+
+TEST_SETUP(detour_prof)
+{
+}
+
+TEST_TEAR_DOWN(detour_prof)
+{
+    quit_func_profiler(NULL);
+    unlink(FPROF_REPORT_FILE);
+}
+#endif
+
+static void end_frame(void)
+{
+    int cc = 0;
+    fprof_func_t *f = NULL;
+
+    for (cc = 0; cc < FPROF_MAX_FUNC; cc++) {
+        f = &fprof_func[cc];
+        if (f->frame_ns > f->max_frame_ns) {
+            f->max_frame_ns = f->frame_ns;
+        }
+
+        if (f->frame_calls > f->max_frame_calls) {
+            f->max_frame_calls = f->frame_calls;
+        }
+        f->frame_ns = 0;
+        f->frame_calls = 0;
+    }
+    fprof_frames += 1;
+}
+
+uintptr_t fprof_enter(uint32_t idx, uintptr_t lr)
+{
+    fprof_frame_t *s = NULL;
+    uintptr_t orig = 0;
+
+    // orig is never cleared once published, so a late call still gets a valid trampoline
+    orig = (uintptr_t)__atomic_load_n(&fprof_func[idx].orig, __ATOMIC_ACQUIRE);
+
+    // no room to keep the return address, so let the thunk tail call untimed
+    if (!fprof_running || (fprof_depth >= FPROF_MAX_DEPTH)) {
+        return orig | 1;
+    }
+
+    s = &fprof_stack[fprof_depth++];
+    s->idx = idx;
+    s->lr = lr;
+    s->t0 = get_clock_ns(CLOCK_MONOTONIC_RAW);
+    return orig;
+}
+
+uintptr_t fprof_leave(uint32_t idx)
+{
+    uint64_t ns = 0;
+    fprof_func_t *f = &fprof_func[idx];
+    fprof_frame_t *s = &fprof_stack[--fprof_depth];
+
+    ns = get_clock_ns(CLOCK_MONOTONIC_RAW) - s->t0;
+    __atomic_fetch_add(&f->calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&f->total_ns, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&f->frame_ns, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&f->frame_calls, 1, __ATOMIC_RELAXED);
+
+    if (idx == FPROF_FRAME_FUNC) {
+        end_frame();
+    }
+    return s->lr;
+}
+
+#if defined(UT)
+TEST(detour_prof, fprof_enter)
+{
+    int cc = 0;
+
+    fprof_func[1].orig = (void *)0x1000;
+    TEST_ASSERT_EQUAL_HEX32(0x1001, fprof_enter(1, 0x2000));
+
+    fprof_running = 1;
+    TEST_ASSERT_EQUAL_HEX32(0x1000, fprof_enter(1, 0x2000));
+    TEST_ASSERT_EQUAL_INT(1, fprof_depth);
+    TEST_ASSERT_EQUAL_HEX32(0x1000, fprof_enter(1, 0x3000));
+    usleep(1000);
+    TEST_ASSERT_EQUAL_HEX32(0x3000, fprof_leave(1));
+    TEST_ASSERT_EQUAL_HEX32(0x2000, fprof_leave(1));
+    TEST_ASSERT_EQUAL_INT(0, fprof_depth);
+    TEST_ASSERT_EQUAL_INT(2, fprof_func[1].calls);
+    TEST_ASSERT_EQUAL_INT(2, fprof_func[1].frame_calls);
+    TEST_ASSERT_TRUE(fprof_func[1].total_ns >= 2000000);
+
+    fprof_func[0].orig = (void *)0x4000;
+    TEST_ASSERT_EQUAL_HEX32(0x4000, fprof_enter(0, 0x5000));
+    TEST_ASSERT_EQUAL_HEX32(0x5000, fprof_leave(0));
+    TEST_ASSERT_EQUAL_INT(1, fprof_frames);
+    TEST_ASSERT_EQUAL_INT(0, fprof_func[1].frame_calls);
+    TEST_ASSERT_EQUAL_INT(2, fprof_func[1].max_frame_calls);
+
+    for (cc = 0; cc < FPROF_MAX_DEPTH; cc++) {
+        fprof_enter(1, 0x2000);
+    }
+    TEST_ASSERT_EQUAL_HEX32(0x1001, fprof_enter(1, 0x2000));
+    fprof_depth = 0;
+}
+#endif
+
+int dump_func_profiler(const char *path)
+{
+    int cc = 0;
+    FILE *f = NULL;
+    uint64_t wall = 0;
+    fprof_func_t *p = NULL;
+
+    if (!path) {
+        err(DTR"invalid parameter(0x%x) in %s\n", path, __func__);
+        return -1;
+    }
+
+    if (!fprof_start_ns) {
+        return -1;
+    }
+
+    f = fopen(path, "w");
+    if (!f) {
+        err(DTR"failed to create \"%s\" in %s\n", path, __func__);
+        return -1;
+    }
+
+    wall = get_clock_ns(CLOCK_MONOTONIC_RAW) - fprof_start_ns;
+    fprintf(f, "# %llu frames in %llu ms\n", (unsigned long long)fprof_frames, (unsigned long long)(wall / 1000000));
+    fprintf(f, "# %-38s %10s %9s %10s %9s %9s %9s %6s\n",
+        "function", "calls", "calls/frm", "total_ms", "avg_ns", "max_calls", "max_us", "wall%");
+    for (cc = 0; cc < FPROF_MAX_FUNC; cc++) {
+        p = &fprof_func[cc];
+        if (!p->hooked) {
+            continue;
+        }
+
+        fprintf(f, "  %-38s %10llu %9.2f %10.2f %9llu %9u %9llu %6.2f\n",
+            p->name,
+            (unsigned long long)p->calls,
+            fprof_frames ? ((double)p->calls / fprof_frames) : 0.0,
+            (double)p->total_ns / 1000000.0,
+            (unsigned long long)(p->calls ? (p->total_ns / p->calls) : 0),
+            p->max_frame_calls,
+            (unsigned long long)(p->max_frame_ns / 1000),
+            wall ? ((double)p->total_ns * 100.0 / wall) : 0.0);
+    }
+    fclose(f);
+    info(DTR"wrote function profile to \"%s\" in %s\n", path, __func__);
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_prof, dump_func_profiler)
+{
+    FILE *f = NULL;
+    char buf[256] = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, dump_func_profiler(NULL));
+    TEST_ASSERT_EQUAL_INT(-1, dump_func_profiler(FPROF_REPORT_FILE));
+
+    TEST_ASSERT_EQUAL_INT(0, init_func_profiler());
+    fprof_func[2].orig = (void *)0x1000;
+    fprof_func[2].hooked = 1;
+    fprof_enter(2, 0x2000);
+    fprof_leave(2);
+    TEST_ASSERT_EQUAL_INT(0, dump_func_profiler(FPROF_REPORT_FILE));
+
+    f = fopen(FPROF_REPORT_FILE, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_NOT_NULL(fgets(buf, sizeof(buf), f));
+    TEST_ASSERT_NOT_NULL(fgets(buf, sizeof(buf), f));
+    TEST_ASSERT_NOT_NULL(fgets(buf, sizeof(buf), f));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "render_scanline_tiled_4bpp"));
+    fclose(f);
+}
+#endif
+
+int init_func_profiler(void)
+{
+    int cc = 0;
+    fprof_func_t *f = NULL;
+
+    quit_func_profiler(NULL);
+#if !defined(UT)
+    if (!myhook.fun.update_screen) {
+        init_detour_hook();
+    }
+#endif
+
+    for (cc = 0; cc < FPROF_MAX_FUNC; cc++) {
+        f = &fprof_func[cc];
+        if (!*f->addr) {
+            continue;
+        }
+
+#if !defined(UT)
+        // on failure orig keeps whatever trampoline an earlier run published
+        if (add_detour_hook(*f->addr, fprof_thunk[cc], &f->orig) < 0) {
+            warn(DTR"skipped profiling %s in %s\n", f->name, __func__);
+            continue;
+        }
+        f->hooked = 1;
+#endif
+    }
+
+    fprof_frames = 0;
+    fprof_start_ns = get_clock_ns(CLOCK_MONOTONIC_RAW);
+    fprof_running = 1;
+    info(DTR"function profiler started in %s\n", __func__);
+    return 0;
+}
+
+int quit_func_profiler(const char *path)
+{
+    int cc = 0;
+    fprof_func_t *f = NULL;
+
+    if (path && fprof_start_ns) {
+        dump_func_profiler(path);
+    }
+
+    // restore the original code first so no new call can enter a thunk
+    fprof_running = 0;
+#if !defined(UT)
+    for (cc = 0; cc < FPROF_MAX_FUNC; cc++) {
+        f = &fprof_func[cc];
+        if (f->hooked) {
+            remove_hook_point(*f->addr);
+        }
+    }
+#endif
+
+    // a thread may still sit between the patched entry and fprof_enter(), so
+    // orig is left alone, the trampoline pool is never reused and that thread
+    // tail calls into a valid trampoline however long it was preempted
+    for (cc = 0; cc < FPROF_MAX_FUNC; cc++) {
+        f = &fprof_func[cc];
+        f->hooked = 0;
+        f->calls = 0;
+        f->total_ns = 0;
+        f->frame_ns = 0;
+        f->max_frame_ns = 0;
+        f->frame_calls = 0;
+        f->max_frame_calls = 0;
+    }
+    fprof_start_ns = 0;
+    fprof_frames = 0;
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_prof, quit_func_profiler)
+{
+
+    TEST_ASSERT_EQUAL_INT(0, quit_func_profiler(NULL));
+    TEST_ASSERT_EQUAL_INT(0, init_func_profiler());
+    TEST_ASSERT_EQUAL_INT(1, fprof_running);
+    TEST_ASSERT_EQUAL_INT(0, quit_func_profiler(FPROF_REPORT_FILE));
+    TEST_ASSERT_EQUAL_INT(0, fprof_running);
+    TEST_ASSERT_EQUAL_INT(0, access(FPROF_REPORT_FILE, F_OK));
+
+    fprof_func[1].orig = (void *)0x1000;
+    fprof_func[1].hooked = 1;
+    TEST_ASSERT_EQUAL_INT(0, quit_func_profiler(NULL));
+    TEST_ASSERT_EQUAL_INT(0, fprof_func[1].hooked);
+    TEST_ASSERT_EQUAL_HEX32(0x1000, (uintptr_t)fprof_func[1].orig);
+    TEST_ASSERT_EQUAL_HEX32(0x1001, fprof_enter(1, 0x2000));
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(detour_prof)
+{
+    RUN_TEST_CASE(detour_prof, fprof_enter);
+    RUN_TEST_CASE(detour_prof, dump_func_profiler);
+    RUN_TEST_CASE(detour_prof, quit_func_profiler);
+}
+#endif
+
@@ -0,0 +1,56 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __DETOUR_PROF_H__
+#define __DETOUR_PROF_H__
+
+    #define FPROF_MAX_FUNC 12
+    #define FPROF_MAX_DEPTH 64
+    #define FPROF_FRAME_FUNC 0
+    #define FPROF_ENABLE_FILE "miyoo_func_prof"
+    #define FPROF_REPORT_FILE "miyoo_func_prof.txt"
+
+    typedef struct _fprof_func {
+        const char *name;
+        uintptr_t *addr;
+        void *orig;
+        int hooked;
+        uint64_t calls;
+        uint64_t total_ns;
+        uint64_t frame_ns;
+        uint64_t max_frame_ns;
+        uint32_t frame_calls;
+        uint32_t max_frame_calls;
+    } fprof_func_t;
+
+    typedef struct _fprof_frame {
+        uint32_t idx;
+        uintptr_t lr;
+        uint64_t t0;
+    } fprof_frame_t;
+
+    int init_func_profiler(void);
+    int quit_func_profiler(const char *path);
+    int dump_func_profiler(const char *path);
+    uintptr_t fprof_enter(uint32_t idx, uintptr_t lr);
+    uintptr_t fprof_leave(uint32_t idx);
+
+#endif
+
@@ -0,0 +1,1441 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "log.h"
+#include "hook.h"
+#include "governor.h"
+#include "render.h"
+
+extern miyoo_hook myhook;
+
+#if defined(UT)
+#define UT_TILE_CNT 64
+#define UT_PERSP_CAPTURE "./persp_capture_ut.bin"
+
+static uint16_t ut_map[RENDER_BLOCK_ENTRY * 4] = { 0 };
+static uint8_t ut_tile[RENDER_MAX_TILE * RENDER_TILE_BYTES] = { 0 };
+static uint16_t ut_pal[256] = { 0 };
+static uint32_t ut_seed = 0;
+
+static uint32_t ut_rand(void)
+{
+    ut_seed = (ut_seed * 1103515245) + 12345;
+    return ut_seed >> 8;
+}
+
+static void ut_fill_bg(render_bg_t *bg, uint32_t map_w, uint32_t map_h)
+{
+    int cc = 0;
+
+    for (cc = 0; cc < (int)(sizeof(ut_map) / sizeof(ut_map[0])); cc++) {
+        ut_map[cc] = (ut_rand() & 0xfc00) | (ut_rand() % UT_TILE_CNT);
+    }
+
+    for (cc = 0; cc < (UT_TILE_CNT * RENDER_TILE_BYTES); cc++) {
+        ut_tile[cc] = ut_rand();
+    }
+
+    for (cc = 0; cc < 256; cc++) {
+        ut_pal[cc] = ut_rand() & 0x7fff;
+    }
+
+    memset(bg, 0, sizeof(render_bg_t));
+    bg->map = ut_map;
+    bg->tile = ut_tile;
+    bg->pal = ut_pal;
+    bg->map_w = map_w;
+    bg->map_h = map_h;
+}
+
+TEST_GROUP(detour_render);
+
+TEST_SETUP(detour_render)
+{
+    ut_seed = 0x1234;
+}
+
+TEST_TEAR_DOWN(detour_render)
+{
+}
+#endif
+
+static int is_valid_bg(const render_bg_t *bg)
+{
+    if (!bg || !bg->map || !bg->tile || !bg->pal) {
+        return 0;
+    }
+
+    if (((bg->map_w != 32) && (bg->map_w != 64)) || ((bg->map_h != 32) && (bg->map_h != 64))) {
+        return 0;
+    }
+    return 1;
+}
+
+static inline uint16_t get_map_entry(const render_bg_t *bg, uint32_t tx, uint32_t ty)
+{
+    uint32_t sb = ((ty >> 5) * (bg->map_w >> 5)) + (tx >> 5);
+
+    return bg->map[(sb * RENDER_BLOCK_ENTRY) + ((ty & 31) << 5) + (tx & 31)];
+}
+
+int render_scanline_tiled_4bpp_c(const render_bg_t *bg, uint32_t line, uint16_t *dst)
+{
+    int x = 0;
+    uint32_t y = 0;
+    uint32_t sx = 0;
+    uint32_t row = 0;
+    uint32_t col = 0;
+    uint32_t idx = 0;
+    uint16_t e = 0;
+
+    if (!is_valid_bg(bg) || !dst) {
+        err(DTR"invalid parameters(0x%x, %d, 0x%x) in %s\n", bg, line, dst, __func__);
+        return -1;
+    }
+
+    y = (line + bg->voff) & ((bg->map_h << 3) - 1);
+    for (x = 0; x < RENDER_LINE_W; x++) {
+        sx = (x + bg->hoff) & ((bg->map_w << 3) - 1);
+        e = get_map_entry(bg, sx >> 3, y >> 3);
+        row = (e & 0x0800) ? (7 - (y & 7)) : (y & 7);
+        col = (e & 0x0400) ? (7 - (sx & 7)) : (sx & 7);
+        idx = bg->tile[((e & 0x03ff) * RENDER_TILE_BYTES) + (row << 2) + (col >> 1)];
+        idx = (col & 1) ? (idx >> 4) : (idx & 0x0f);
+        if (idx) {
+            dst[x] = bg->pal[((e >> 12) << 4) + idx] | RENDER_OPAQUE;
+        }
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_render, render_scanline_tiled_4bpp_c)
+{
+    render_bg_t bg = { 0 };
+    uint16_t dst[RENDER_LINE_W] = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, render_scanline_tiled_4bpp_c(NULL, 0, dst));
+    ut_fill_bg(&bg, 32, 32);
+    TEST_ASSERT_EQUAL_INT(-1, render_scanline_tiled_4bpp_c(&bg, 0, NULL));
+    bg.map_w = 48;
+    TEST_ASSERT_EQUAL_INT(-1, render_scanline_tiled_4bpp_c(&bg, 0, dst));
+
+    // tile 1 row 0 is 0x21 0x43 0x00 0xf0, palette bank 2
+    memset(ut_map, 0, sizeof(ut_map));
+    memset(ut_tile, 0, sizeof(ut_tile));
+    ut_map[0] = 0x2001;
+    ut_tile[32] = 0x21;
+    ut_tile[33] = 0x43;
+    ut_tile[35] = 0xf0;
+    ut_pal[33] = 0x0011;
+    ut_pal[34] = 0x0022;
+    ut_pal[47] = 0x7fff;
+    bg.map_w = 32;
+
+    memset(dst, 0xaa, sizeof(dst));
+    TEST_ASSERT_EQUAL_INT(0, render_scanline_tiled_4bpp_c(&bg, 0, dst));
+    TEST_ASSERT_EQUAL_HEX16(0x8011, dst[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x8022, dst[1]);
+    TEST_ASSERT_EQUAL_HEX16(0xaaaa, dst[4]);
+    TEST_ASSERT_EQUAL_HEX16(0xaaaa, dst[6]);
+    TEST_ASSERT_EQUAL_HEX16(0xffff, dst[7]);
+    TEST_ASSERT_EQUAL_HEX16(0xaaaa, dst[8]);
+
+    // hflip
+    ut_map[0] = 0x2401;
+    TEST_ASSERT_EQUAL_INT(0, render_scanline_tiled_4bpp_c(&bg, 0, dst));
+    TEST_ASSERT_EQUAL_HEX16(0xffff, dst[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x8011, dst[7]);
+
+    // vflip moves row 0 to line 7
+    ut_map[0] = 0x2801;
+    memset(dst, 0xaa, sizeof(dst));
+    TEST_ASSERT_EQUAL_INT(0, render_scanline_tiled_4bpp_c(&bg, 0, dst));
+    TEST_ASSERT_EQUAL_HEX16(0xaaaa, dst[0]);
+    TEST_ASSERT_EQUAL_INT(0, render_scanline_tiled_4bpp_c(&bg, 7, dst));
+    TEST_ASSERT_EQUAL_HEX16(0x8011, dst[0]);
+
+    // scrolling wraps around the map
+    ut_map[0] = 0x2001;
+    bg.hoff = 255;
+    TEST_ASSERT_EQUAL_INT(0, render_scanline_tiled_4bpp_c(&bg, 0, dst));
+    TEST_ASSERT_EQUAL_HEX16(0x8011, dst[1]);
+}
+#endif
+
+#if defined(__ARM_NEON)
+static inline void expand_tile_row(uint16_t *out, const uint8_t *src, uint16_t e, uint8x8x2_t lo, uint8x8x2_t hi)
+{
+    uint8x8_t v = vreinterpret_u8_u32(vld1_dup_u32((const uint32_t *)src));
+    uint8x8x2_t z = vzip_u8(vand_u8(v, vdup_n_u8(0x0f)), vshr_n_u8(v, 4));
+    uint8x8_t idx = (e & 0x0400) ? vrev64_u8(z.val[0]) : z.val[0];
+    uint16x8_t c = vorrq_u16(vmovl_u8(vtbl2_u8(lo, idx)), vshlq_n_u16(vmovl_u8(vtbl2_u8(hi, idx)), 8));
+    uint16x8_t m = vreinterpretq_u16_s16(vmovl_s8(vreinterpret_s8_u8(vceq_u8(idx, vdup_n_u8(0)))));
+
+    vst1q_u16(out, vbicq_u16(vorrq_u16(c, vdupq_n_u16(RENDER_OPAQUE)), m));
+}
+#else
+static inline void expand_tile_row(uint16_t *out, const uint8_t *src, uint16_t e, const uint16_t *pal)
+{
+    int cc = 0;
+    uint8_t idx[8] = { 0 };
+
+    for (cc = 0; cc < 4; cc++) {
+        idx[(cc << 1) + 0] = src[cc] & 0x0f;
+        idx[(cc << 1) + 1] = src[cc] >> 4;
+    }
+
+    for (cc = 0; cc < 8; cc++) {
+        out[cc] = idx[(e & 0x0400) ? (7 - cc) : cc];
+        out[cc] = out[cc] ? (pal[out[cc]] | RENDER_OPAQUE) : 0;
+    }
+}
+#endif
+
+// tile rows are expanded 8 pixels at a time into a line buffer, then merged
+// over dst with the fine scroll applied, transparent pixels keep dst
+int render_scanline_tiled_4bpp_neon(const render_bg_t *bg, uint32_t line, uint16_t *dst)
+{
+    int x = 0;
+    int bank = -1;
+    uint32_t y = 0;
+    uint32_t tx = 0;
+    uint32_t row = 0;
+    uint32_t fine = 0;
+    uint16_t e = 0;
+    uint16_t buf[RENDER_LINE_W + 8] __attribute__((aligned(16)));
+
+#if defined(__ARM_NEON)
+    uint8x8x2_t lo;
+    uint8x8x2_t hi;
+    uint8x8x2_t p0;
+    uint8x8x2_t p1;
+#else
+    const uint16_t *pal = NULL;
+#endif
+
+    if (!is_valid_bg(bg) || !dst) {
+        err(DTR"invalid parameters(0x%x, %d, 0x%x) in %s\n", bg, line, dst, __func__);
+        return -1;
+    }
+
+    y = (line + bg->voff) & ((bg->map_h << 3) - 1);
+    tx = (bg->hoff >> 3) & (bg->map_w - 1);
+    fine = bg->hoff & 7;
+    for (x = 0; x < (RENDER_LINE_W + 8); x += 8) {
+        e = get_map_entry(bg, tx, y >> 3);
+        tx = (tx + 1) & (bg->map_w - 1);
+        row = (e & 0x0800) ? (7 - (y & 7)) : (y & 7);
+
+        if ((e >> 12) != bank) {
+            bank = e >> 12;
+#if defined(__ARM_NEON)
+            p0 = vld2_u8((const uint8_t *)&bg->pal[bank << 4]);
+            p1 = vld2_u8((const uint8_t *)&bg->pal[(bank << 4) + 8]);
+            lo.val[0] = p0.val[0];
+            lo.val[1] = p1.val[0];
+            hi.val[0] = p0.val[1];
+            hi.val[1] = p1.val[1];
+#else
+            pal = &bg->pal[bank << 4];
+#endif
+        }
+
+#if defined(__ARM_NEON)
+        expand_tile_row(&buf[x], &bg->tile[((e & 0x03ff) * RENDER_TILE_BYTES) + (row << 2)], e, lo, hi);
+#else
+        expand_tile_row(&buf[x], &bg->tile[((e & 0x03ff) * RENDER_TILE_BYTES) + (row << 2)], e, pal);
+#endif
+    }
+
+    for (x = 0; x < RENDER_LINE_W; x += 8) {
+#if defined(__ARM_NEON)
+        uint16x8_t s = vld1q_u16(&buf[x + fine]);
+        uint16x8_t m = vtstq_u16(s, vdupq_n_u16(RENDER_OPAQUE));
+
+        vst1q_u16(&dst[x], vbslq_u16(m, s, vld1q_u16(&dst[x])));
+#else
+        int cc = 0;
+
+        for (cc = 0; cc < 8; cc++) {
+            if (buf[x + fine + cc] & RENDER_OPAQUE) {
+                dst[x + cc] = buf[x + fine + cc];
+            }
+        }
+#endif
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_render, render_scanline_tiled_4bpp_neon)
+{
+    int cc = 0;
+    int line = 0;
+    render_bg_t bg = { 0 };
+    uint16_t ref[RENDER_LINE_W] = { 0 };
+    uint16_t dst[RENDER_LINE_W] = { 0 };
+    const uint32_t size[][2] = { { 32, 32 }, { 64, 32 }, { 32, 64 }, { 64, 64 } };
+
+    TEST_ASSERT_EQUAL_INT(-1, render_scanline_tiled_4bpp_neon(NULL, 0, dst));
+
+    // differential check against the per-pixel reference on random vram,
+    // every fine scroll and map size, with a random background underneath
+    for (cc = 0; cc < 64; cc++) {
+        ut_fill_bg(&bg, size[cc & 3][0], size[cc & 3][1]);
+        bg.hoff = ut_rand() & 511;
+        bg.voff = ut_rand() & 511;
+        bg.hoff = (bg.hoff & ~7) | (cc & 7);
+
+        for (line = 0; line < 192; line += 7) {
+            memset(ref, cc, sizeof(ref));
+            memset(dst, cc, sizeof(dst));
+            TEST_ASSERT_EQUAL_INT(0, render_scanline_tiled_4bpp_c(&bg, line, ref));
+            TEST_ASSERT_EQUAL_INT(0, render_scanline_tiled_4bpp_neon(&bg, line, dst));
+            TEST_ASSERT_EQUAL_HEX16_ARRAY(ref, dst, RENDER_LINE_W);
+        }
+    }
+}
+#endif
+
+static pthread_mutex_t tiled_lock = PTHREAD_MUTEX_INITIALIZER;
+static tiled_fn tiled_orig = NULL;
+static int tiled_state = TILED_STATE_VERIFY;
+static uint32_t tiled_verified = 0;
+static uintptr_t tiled_lo = UINTPTR_MAX;
+static uintptr_t tiled_hi = 0;
+
+// a wrongly assumed layout must not fault while it is being checked, so every
+// range the kernel may read is looked up in the page tables first
+static int is_mapped(const void *p, size_t len)
+{
+    long ps = sysconf(_SC_PAGESIZE);
+    uintptr_t s = 0;
+    uintptr_t e = 0;
+    unsigned char vec[16] = { 0 };
+
+    if (!p || !len || (ps <= 0)) {
+        return 0;
+    }
+
+    s = (uintptr_t)p & ~(uintptr_t)(ps - 1);
+    e = ((uintptr_t)p + len + ps - 1) & ~(uintptr_t)(ps - 1);
+    if (((e - s) / ps) > sizeof(vec)) {
+        return 0;
+    }
+    return mincore((void *)s, e - s, vec) == 0;
+}
+
+#if defined(UT)
+TEST(detour_render, is_mapped)
+{
+    TEST_ASSERT_EQUAL_INT(0, is_mapped(NULL, 4));
+    TEST_ASSERT_EQUAL_INT(0, is_mapped(ut_map, 0));
+    TEST_ASSERT_EQUAL_INT(0, is_mapped((void *)0x10, 4));
+    TEST_ASSERT_EQUAL_INT(1, is_mapped(ut_tile, sizeof(ut_tile)));
+}
+#endif
+
+static void add_verified_range(const void *p, size_t len)
+{
+    if ((uintptr_t)p < tiled_lo) {
+        tiled_lo = (uintptr_t)p;
+    }
+
+    if (((uintptr_t)p + len) > tiled_hi) {
+        tiled_hi = (uintptr_t)p + len;
+    }
+}
+
+static int is_verified_range(const void *p, size_t len)
+{
+    return ((uintptr_t)p >= tiled_lo) && (((uintptr_t)p + len) <= tiled_hi);
+}
+
+// check looks the tables up in the page tables while the layout is still
+// being verified, afterwards they only have to stay where verified ones were
+static int get_tiled_bg(const drastic_bg_t *d, render_bg_t *bg, int check)
+{
+    if (!d || (check && !is_mapped(d, sizeof(drastic_bg_t)))) {
+        return -1;
+    }
+
+    memset(bg, 0, sizeof(render_bg_t));
+    bg->map = d->map;
+    bg->tile = d->tile;
+    bg->pal = d->pal;
+    bg->map_w = (d->cnt & 0x4000) ? 64 : 32;
+    bg->map_h = (d->cnt & 0x8000) ? 64 : 32;
+    bg->hoff = d->hoff;
+    bg->voff = d->voff;
+    if (!is_valid_bg(bg)) {
+        return -1;
+    }
+
+    if (check) {
+        if (!is_mapped(bg->map, bg->map_w * bg->map_h * sizeof(uint16_t)) ||
+            !is_mapped(bg->tile, RENDER_MAX_TILE * RENDER_TILE_BYTES) ||
+            !is_mapped(bg->pal, 256 * sizeof(uint16_t)))
+        {
+            return -1;
+        }
+    }
+    else if (!is_verified_range(bg->map, bg->map_w * bg->map_h * sizeof(uint16_t)) ||
+        !is_verified_range(bg->tile, RENDER_MAX_TILE * RENDER_TILE_BYTES) ||
+        !is_verified_range(bg->pal, 256 * sizeof(uint16_t)))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+// installed over DraStic's render_scanline_tiled_4bpp, the NEON kernel runs
+// next to DraStic's own renderer until TILED_VERIFY_CALLS lines came out the
+// same, one different line hands every later call back to DraStic
+static void hook_scanline_tiled_4bpp(const drastic_bg_t *d, uint16_t *dst, uint32_t line)
+{
+    int state = __atomic_load_n(&tiled_state, __ATOMIC_ACQUIRE);
+    int verify = (state == TILED_STATE_VERIFY);
+    render_bg_t bg = { 0 };
+    uint16_t buf[RENDER_LINE_W] __attribute__((aligned(16)));
+
+    if ((state == TILED_STATE_ORIG) || (get_tiled_bg(d, &bg, verify) < 0) ||
+        !dst || (verify && !is_mapped(dst, sizeof(buf))))
+    {
+        tiled_orig(d, dst, line);
+        return;
+    }
+
+    if (!verify) {
+        render_scanline_tiled_4bpp_neon(&bg, line, dst);
+        return;
+    }
+
+    memcpy(buf, dst, sizeof(buf));
+    render_scanline_tiled_4bpp_neon(&bg, line, buf);
+    tiled_orig(d, dst, line);
+    if (memcmp(buf, dst, sizeof(buf))) {
+        __atomic_store_n(&tiled_state, TILED_STATE_ORIG, __ATOMIC_RELEASE);
+        warn(DTR"tiled 4bpp line %d differs from DraStic, keep DraStic's renderer in %s\n", line, __func__);
+        return;
+    }
+
+    pthread_mutex_lock(&tiled_lock);
+    add_verified_range(bg.map, bg.map_w * bg.map_h * sizeof(uint16_t));
+    add_verified_range(bg.tile, RENDER_MAX_TILE * RENDER_TILE_BYTES);
+    add_verified_range(bg.pal, 256 * sizeof(uint16_t));
+    pthread_mutex_unlock(&tiled_lock);
+
+    if (__atomic_add_fetch(&tiled_verified, 1, __ATOMIC_ACQ_REL) == TILED_VERIFY_CALLS) {
+        if (__atomic_compare_exchange_n(&tiled_state, &state, TILED_STATE_NEON, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            info(DTR"tiled 4bpp matched DraStic for %d lines, use NEON in %s\n", TILED_VERIFY_CALLS, __func__);
+        }
+    }
+}
+
+#if defined(UT)
+static int ut_orig_calls = 0;
+
+static void ut_orig_tiled(const drastic_bg_t *d, uint16_t *dst, uint32_t line)
+{
+    render_bg_t bg = { 0 };
+
+    ut_orig_calls += 1;
+    if (get_tiled_bg(d, &bg, 1) == 0) {
+        render_scanline_tiled_4bpp_c(&bg, line, dst);
+    }
+}
+
+static void ut_wrong_tiled(const drastic_bg_t *d, uint16_t *dst, uint32_t line)
+{
+    ut_orig_calls += 1;
+    dst[line & (RENDER_LINE_W - 1)] ^= 1;
+}
+
+TEST(detour_render, hook_scanline_tiled_4bpp)
+{
+    int cc = 0;
+    render_bg_t bg = { 0 };
+    drastic_bg_t d = { 0 };
+    uint16_t ref[RENDER_LINE_W] = { 0 };
+    uint16_t dst[RENDER_LINE_W] = { 0 };
+
+    ut_fill_bg(&bg, 64, 32);
+    d.map = ut_map;
+    d.tile = ut_tile;
+    d.pal = ut_pal;
+    d.cnt = 0x4000;
+    d.hoff = 13;
+    d.voff = 100;
+
+    // matches DraStic, so it switches over once enough lines were checked
+    ut_orig_calls = 0;
+    tiled_orig = ut_orig_tiled;
+    tiled_state = TILED_STATE_VERIFY;
+    tiled_verified = 0;
+    tiled_lo = UINTPTR_MAX;
+    tiled_hi = 0;
+    for (cc = 0; cc < TILED_VERIFY_CALLS; cc++) {
+        memset(ref, cc, sizeof(ref));
+        memset(dst, cc, sizeof(dst));
+        bg.hoff = d.hoff;
+        bg.voff = d.voff;
+        render_scanline_tiled_4bpp_c(&bg, cc % 192, ref);
+        hook_scanline_tiled_4bpp(&d, dst, cc % 192);
+        TEST_ASSERT_EQUAL_HEX16_ARRAY(ref, dst, RENDER_LINE_W);
+    }
+    TEST_ASSERT_EQUAL_INT(TILED_VERIFY_CALLS, ut_orig_calls);
+    TEST_ASSERT_EQUAL_INT(TILED_STATE_NEON, tiled_state);
+    hook_scanline_tiled_4bpp(&d, dst, 5);
+    TEST_ASSERT_EQUAL_INT(TILED_VERIFY_CALLS, ut_orig_calls);
+
+    // anything the kernel can not take or tables outside of the verified
+    // ones go to DraStic
+    d.map = (const uint16_t *)0x10;
+    hook_scanline_tiled_4bpp(&d, dst, 5);
+    TEST_ASSERT_EQUAL_INT(TILED_VERIFY_CALLS + 1, ut_orig_calls);
+    hook_scanline_tiled_4bpp(NULL, dst, 5);
+    TEST_ASSERT_EQUAL_INT(TILED_VERIFY_CALLS + 2, ut_orig_calls);
+
+    // an unmapped table must not be read while verifying
+    tiled_state = TILED_STATE_VERIFY;
+    tiled_verified = 0;
+    hook_scanline_tiled_4bpp(&d, dst, 5);
+    TEST_ASSERT_EQUAL_INT(TILED_VERIFY_CALLS + 3, ut_orig_calls);
+    TEST_ASSERT_EQUAL_INT(0, tiled_verified);
+
+    // one different line and DraStic keeps the layer for good
+    d.map = ut_map;
+    tiled_orig = ut_wrong_tiled;
+    memset(dst, 0, sizeof(dst));
+    hook_scanline_tiled_4bpp(&d, dst, 5);
+    TEST_ASSERT_EQUAL_INT(TILED_STATE_ORIG, tiled_state);
+    TEST_ASSERT_EQUAL_HEX16(1, dst[5]);
+    hook_scanline_tiled_4bpp(&d, dst, 5);
+    TEST_ASSERT_EQUAL_HEX16(0, dst[5]);
+    TEST_ASSERT_EQUAL_INT(TILED_VERIFY_CALLS + 5, ut_orig_calls);
+
+    tiled_orig = NULL;
+    tiled_state = TILED_STATE_VERIFY;
+    tiled_verified = 0;
+    tiled_lo = UINTPTR_MAX;
+    tiled_hi = 0;
+}
+#endif
+
+int init_tiled_hook(void)
+{
+#if !defined(UT)
+    if (!myhook.fun.render_scanline_tiled_4bpp) {
+        init_detour_hook();
+    }
+#endif
+
+    pthread_mutex_lock(&tiled_lock);
+    tiled_lo = UINTPTR_MAX;
+    tiled_hi = 0;
+    pthread_mutex_unlock(&tiled_lock);
+    __atomic_store_n(&tiled_verified, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&tiled_state, TILED_STATE_VERIFY, __ATOMIC_RELEASE);
+#if !defined(UT)
+    if (add_detour_hook(myhook.fun.render_scanline_tiled_4bpp, hook_scanline_tiled_4bpp, (void **)&tiled_orig) < 0) {
+        err(DTR"failed to add tiled 4bpp hook in %s\n", __func__);
+        return -1;
+    }
+#endif
+    info(DTR"verifying tiled 4bpp against DraStic in %s\n", __func__);
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_render, init_tiled_hook)
+{
+    tiled_state = TILED_STATE_ORIG;
+    tiled_verified = 3;
+    TEST_ASSERT_EQUAL_INT(0, init_tiled_hook());
+    TEST_ASSERT_EQUAL_INT(TILED_STATE_VERIFY, tiled_state);
+    TEST_ASSERT_EQUAL_INT(0, tiled_verified);
+}
+#endif
+
+static pthread_mutex_t persp_lock = PTHREAD_MUTEX_INITIALIZER;
+static persp_step_fn persp_orig = NULL;
+static int persp_state = PERSP_STATE_VERIFY;
+static uint32_t persp_verified = 0;
+static persp_stat_t persp_stat = { 0 };
+static FILE *persp_capture = NULL;
+static int16_t persp_buf[PERSP_MAX_STEP + PERSP_BATCH] __attribute__((aligned(16))) = { 0 };
+static int16_t persp_ref[PERSP_MAX_STEP + PERSP_BATCH] __attribute__((aligned(16))) = { 0 };
+static float persp_src[PERSP_MAX_STEP + PERSP_BATCH] __attribute__((aligned(16))) = { 0 };
+static float persp_w[PERSP_MAX_STEP + PERSP_BATCH] __attribute__((aligned(16))) = { 0 };
+
+// NEON always runs in flush-to-zero mode
+static inline float flush_denormal(float v)
+{
+    uint32_t u = 0;
+
+    memcpy(&u, &v, sizeof(u));
+    if (!(u & 0x7f800000)) {
+        u &= 0x80000000;
+        memcpy(&v, &u, sizeof(v));
+    }
+    return v;
+}
+
+// same as vcvt.s32.f32 #15, round toward zero and saturate, NaN is 0
+static int32_t to_fixed(double v)
+{
+    if (v != v) {
+        return 0;
+    }
+
+    v *= (double)(1 << PERSP_FRAC_BITS);
+    if (v >= 2147483647.0) {
+        return INT32_MAX;
+    }
+    if (v <= -2147483648.0) {
+        return INT32_MIN;
+    }
+    return (int32_t)v;
+}
+
+int32_t get_perspective_step(float x, float w)
+{
+    return to_fixed((double)flush_denormal(x) / (double)flush_denormal(w));
+}
+
+#if defined(UT)
+TEST(detour_render, get_perspective_step)
+{
+    float denorm = 0;
+    uint32_t u = 0x00000100;
+
+    memcpy(&denorm, &u, sizeof(denorm));
+    TEST_ASSERT_EQUAL_INT(0x8000, get_perspective_step(1.0f, 1.0f));
+    TEST_ASSERT_EQUAL_INT(-0x4000, get_perspective_step(1.0f, -2.0f));
+    TEST_ASSERT_EQUAL_INT(0x2aaa, get_perspective_step(1.0f, 3.0f));
+    TEST_ASSERT_EQUAL_INT(INT32_MAX, get_perspective_step(1.0f, 0.0f));
+    TEST_ASSERT_EQUAL_INT(INT32_MIN, get_perspective_step(-1.0f, 0.0f));
+    TEST_ASSERT_EQUAL_INT(0, get_perspective_step(0.0f, 0.0f));
+    TEST_ASSERT_EQUAL_INT(INT32_MAX, get_perspective_step(1.0f, denorm));
+    TEST_ASSERT_EQUAL_INT(0, get_perspective_step(denorm, 1.0f));
+    TEST_ASSERT_EQUAL_INT(0, get_perspective_step(1.0f, 3.0e38f));
+    TEST_ASSERT_EQUAL_INT(0, get_perspective_step(1.0f, __builtin_inff()));
+    TEST_ASSERT_EQUAL_INT(0, get_perspective_step(__builtin_nanf(""), 1.0f));
+}
+#endif
+
+// the kernel has about 2^-22 relative error after two Newton-Raphson steps
+// and the truncation may land on either side, so 1 LSB plus 2^-19 of the
+// magnitude covers both the NEON and the original output, compared after
+// narrowing to 16 bits
+int is_perspective_step_close(int16_t v, int32_t ref)
+{
+    int64_t mag = ref;
+    int32_t diff = (int16_t)(uint16_t)((uint32_t)v - (uint32_t)ref);
+
+    mag = (mag < 0) ? -mag : mag;
+    diff = (diff < 0) ? -diff : diff;
+    return diff <= (1 + (mag >> 19));
+}
+
+#if defined(UT)
+TEST(detour_render, is_perspective_step_close)
+{
+    TEST_ASSERT_EQUAL_INT(1, is_perspective_step_close(0x1000, 0x1000));
+    TEST_ASSERT_EQUAL_INT(1, is_perspective_step_close(0x1001, 0x1000));
+    TEST_ASSERT_EQUAL_INT(0, is_perspective_step_close(0x1002, 0x1000));
+    TEST_ASSERT_EQUAL_INT(1, is_perspective_step_close(-1, INT32_MAX));
+    TEST_ASSERT_EQUAL_INT(1, is_perspective_step_close(-100, INT32_MAX - 90));
+    TEST_ASSERT_EQUAL_INT(0, is_perspective_step_close(0x1234, INT32_MAX));
+}
+#endif
+
+int render_polygon_setup_perspective_steps_c(int16_t *dst, const float *src, const float *w, int32_t cnt)
+{
+    int cc = 0;
+
+    if (!dst || !src || !w || (cnt < 0)) {
+        err(DTR"invalid parameters(0x%x, 0x%x, 0x%x, %d) in %s\n", dst, src, w, cnt, __func__);
+        return -1;
+    }
+
+    for (cc = 0; cc < cnt; cc++) {
+        dst[cc] = (int16_t)get_perspective_step(src[cc], w[cc]);
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_render, render_polygon_setup_perspective_steps_c)
+{
+    int16_t dst[4] = { 0 };
+    const float src[4] = { 1.0f, 1.0f, 2.0f, 0.5f };
+    const float w[4] = { 1.0f, 4.0f, 0.0f, -1.0f };
+
+    TEST_ASSERT_EQUAL_INT(-1, render_polygon_setup_perspective_steps_c(NULL, src, w, 4));
+    TEST_ASSERT_EQUAL_INT(-1, render_polygon_setup_perspective_steps_c(dst, src, w, -1));
+    TEST_ASSERT_EQUAL_INT(0, render_polygon_setup_perspective_steps_c(dst, src, w, 4));
+    TEST_ASSERT_EQUAL_INT16(-0x8000, dst[0]);
+    TEST_ASSERT_EQUAL_INT16(0x2000, dst[1]);
+    TEST_ASSERT_EQUAL_INT16(-1, dst[2]);
+    TEST_ASSERT_EQUAL_INT16(-0x4000, dst[3]);
+}
+#endif
+
+#if defined(UT)
+// bit exact model of the drastic.S kernel, vrecpe/vrecps/vmul/vcvt as
+// described in the ARMv7 ARM with the standard NEON FPSCR
+static float recip_estimate(float v)
+{
+    uint32_t u = 0;
+    uint32_t e = 0;
+    uint32_t q = 0;
+    uint32_t s = 0;
+
+    v = flush_denormal(v);
+    memcpy(&u, &v, sizeof(u));
+    e = (u >> 23) & 0xff;
+    if (v != v) {
+        return v;
+    }
+    if (e == 0) {
+        return __builtin_copysignf(__builtin_inff(), v);
+    }
+    if (e >= 253) {
+        return __builtin_copysignf(0.0f, v);
+    }
+
+    q = 0x100 | ((u >> 15) & 0xff);
+    s = (uint32_t)((256.0 / (((double)q + 0.5) / 512.0)) + 0.5);
+    if (s >= 512) {
+        u = (u & 0x80000000) | ((254 - e) << 23);
+    }
+    else {
+        u = (u & 0x80000000) | ((253 - e) << 23) | ((s - 256) << 15);
+    }
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+static float recip_step(float a, float b)
+{
+    a = flush_denormal(a);
+    b = flush_denormal(b);
+    if (((a == 0) && __builtin_isinf(b)) || (__builtin_isinf(a) && (b == 0))) {
+        return 2.0f;
+    }
+    return flush_denormal(2.0f - flush_denormal(a * b));
+}
+
+static float neon_mul(float a, float b)
+{
+    return flush_denormal(flush_denormal(a) * flush_denormal(b));
+}
+
+static float get_recip(float w)
+{
+    float r = recip_estimate(w);
+
+    r = neon_mul(r, recip_step(r, w));
+    return neon_mul(r, recip_step(r, w));
+}
+
+void render_polygon_setup_perspective_steps(int16_t *dst, const float *src, const float *w, int32_t cnt)
+{
+    int cc = 0;
+
+    do {
+        for (cc = 0; cc < PERSP_BATCH; cc++) {
+            *dst++ = (int16_t)to_fixed(neon_mul(*src++, get_recip(*w++)));
+        }
+        cnt -= PERSP_BATCH;
+    } while (cnt > 0);
+}
+
+static float ut_float(void)
+{
+    uint32_t u = 0;
+    float v = 0;
+
+    // random sign and mantissa, exponent within 2^-24..2^24
+    u = (ut_rand() << 9) ^ ut_rand();
+    u = (u & 0x807fffff) | ((103 + (ut_rand() % 48)) << 23);
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+TEST(detour_render, get_recip)
+{
+    int cc = 0;
+    float w = 0;
+    double err = 0;
+    double est_err = 0;
+    double max_err = 0;
+    double max_est_err = 0;
+
+    for (cc = 0; cc < 100000; cc++) {
+        w = ut_float();
+        est_err = (recip_estimate(w) * (double)w) - 1.0;
+        err = (get_recip(w) * (double)w) - 1.0;
+        est_err = (est_err < 0) ? -est_err : est_err;
+        err = (err < 0) ? -err : err;
+        max_est_err = (est_err > max_est_err) ? est_err : max_est_err;
+        max_err = (err > max_err) ? err : max_err;
+    }
+
+    // 8 bits from the estimate, about 22 bits after two steps
+    TEST_ASSERT_TRUE(max_est_err < (1.0 / 256.0));
+    TEST_ASSERT_TRUE(max_err < (1.0 / (1 << 22)));
+
+    TEST_ASSERT_EQUAL_FLOAT(0.5f, get_recip(2.0f));
+    TEST_ASSERT_TRUE(__builtin_isinf(get_recip(0.0f)));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, get_recip(3.0e38f));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, get_recip(__builtin_inff()));
+}
+
+TEST(detour_render, render_polygon_setup_perspective_steps)
+{
+    int cc = 0;
+    int32_t ref = 0;
+    float denorm = 0;
+    uint32_t u = 0x00000100;
+    int16_t dst[PERSP_BATCH * 64] __attribute__((aligned(16))) = { 0 };
+    float src[PERSP_BATCH * 64] __attribute__((aligned(16))) = { 0 };
+    float w[PERSP_BATCH * 64] __attribute__((aligned(16))) = { 0 };
+    const float edge[][2] = {
+        { 1.0f, 0.0f }, { -1.0f, 0.0f }, { 0.0f, 0.0f }, { 1.0f, -0.0f },
+        { 1.0f, 3.0e38f }, { -1.0f, 3.0e38f }, { 1.0f, 1.0e38f }, { 1.0f, __builtin_inff() },
+        { 65536.0f, 1.0f }, { 65535.99f, 1.0f }, { 1.0f, 1.0e-30f }, { 0.0f, 1.0f },
+    };
+
+    memcpy(&denorm, &u, sizeof(denorm));
+    for (cc = 0; cc < (int)(sizeof(edge) / sizeof(edge[0])); cc++) {
+        src[cc] = edge[cc][0];
+        w[cc] = edge[cc][1];
+    }
+    src[cc] = 1.0f;
+    w[cc++] = denorm;
+    src[cc] = denorm;
+    w[cc++] = 1.0f;
+    src[cc] = __builtin_nanf("");
+    w[cc++] = 1.0f;
+    src[cc] = 1.0f;
+    w[cc++] = __builtin_nanf("");
+
+    for (; cc < (PERSP_BATCH * 64); cc++) {
+        src[cc] = ut_float();
+        w[cc] = ut_float();
+    }
+
+    render_polygon_setup_perspective_steps(dst, src, w, PERSP_BATCH * 64);
+    for (cc = 0; cc < (PERSP_BATCH * 64); cc++) {
+        ref = get_perspective_step(src[cc], w[cc]);
+        if (!is_perspective_step_close(dst[cc], ref)) {
+            TEST_FAIL_MESSAGE("perspective step is out of tolerance");
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT16(-1, dst[0]);
+    TEST_ASSERT_EQUAL_INT16(0, dst[1]);
+    TEST_ASSERT_EQUAL_INT16(0, dst[2]);
+    TEST_ASSERT_EQUAL_INT16(0, dst[3]);
+    TEST_ASSERT_EQUAL_INT16(0, dst[4]);
+    TEST_ASSERT_EQUAL_INT16(0, dst[7]);
+    TEST_ASSERT_EQUAL_INT16(-1, dst[12]);
+    TEST_ASSERT_EQUAL_INT16(0, dst[13]);
+    TEST_ASSERT_EQUAL_INT16(0, dst[14]);
+    TEST_ASSERT_EQUAL_INT16(0, dst[15]);
+}
+#endif
+
+static int write_capture(const int16_t *dst, const float *src, const float *w, int32_t cnt)
+{
+    uint32_t n = cnt;
+
+    if (!persp_capture || (persp_stat.capture >= PERSP_MAX_CAPTURE)) {
+        return -1;
+    }
+
+    if ((fwrite(&n, sizeof(n), 1, persp_capture) != 1) ||
+        (fwrite(src, sizeof(float), n, persp_capture) != n) ||
+        (fwrite(w, sizeof(float), n, persp_capture) != n) ||
+        (fwrite(dst, sizeof(int16_t), n, persp_capture) != n))
+    {
+        err(DTR"failed to write capture in %s\n", __func__);
+        fclose(persp_capture);
+        persp_capture = NULL;
+        return -1;
+    }
+    persp_stat.capture += 1;
+    return 0;
+}
+
+static void compare_steps(persp_stat_t *st, const int16_t *neon, const int16_t *orig, const float *src, const float *w, int32_t cnt)
+{
+    int cc = 0;
+    int32_t ref = 0;
+    int32_t diff = 0;
+
+    st->call += 1;
+    st->step += cnt;
+    for (cc = 0; cc < cnt; cc++) {
+        ref = get_perspective_step(src[cc], w[cc]);
+        if (!is_perspective_step_close(neon[cc], ref) || !is_perspective_step_close(orig[cc], ref)) {
+            st->mismatch += 1;
+        }
+
+        diff = abs((int16_t)(uint16_t)((uint32_t)neon[cc] - (uint32_t)ref));
+        st->max_diff = (diff > (int32_t)st->max_diff) ? (uint32_t)diff : st->max_diff;
+        diff = abs((int16_t)(uint16_t)((uint32_t)orig[cc] - (uint32_t)ref));
+        st->orig_max_diff = (diff > (int32_t)st->orig_max_diff) ? (uint32_t)diff : st->orig_max_diff;
+    }
+}
+
+// installed instead of the NEON kernel in verify mode, DraStic keeps its own
+// output and the kernel runs on the same inputs for comparison
+static void verify_perspective_steps(int16_t *dst, const float *src, const float *w, int32_t cnt)
+{
+    persp_orig(dst, src, w, cnt);
+    if ((cnt <= 0) || (cnt > PERSP_MAX_STEP)) {
+        return;
+    }
+
+    pthread_mutex_lock(&persp_lock);
+    render_polygon_setup_perspective_steps(persp_buf, src, w, cnt);
+    compare_steps(&persp_stat, persp_buf, dst, src, w, cnt);
+    write_capture(dst, src, w, cnt);
+    pthread_mutex_unlock(&persp_lock);
+}
+
+#if defined(UT)
+static void ut_orig_steps(int16_t *dst, const float *src, const float *w, int32_t cnt)
+{
+    render_polygon_setup_perspective_steps_c(dst, src, w, cnt);
+}
+
+TEST(detour_render, verify_perspective_steps)
+{
+    int cc = 0;
+    int16_t dst[PERSP_BATCH * 2] __attribute__((aligned(16))) = { 0 };
+    float src[PERSP_BATCH * 2] __attribute__((aligned(16))) = { 0 };
+    float w[PERSP_BATCH * 2] __attribute__((aligned(16))) = { 0 };
+
+    for (cc = 0; cc < (PERSP_BATCH * 2); cc++) {
+        src[cc] = ut_float();
+        w[cc] = ut_float();
+    }
+
+    memset(&persp_stat, 0, sizeof(persp_stat));
+    persp_orig = ut_orig_steps;
+    persp_capture = fopen(PERSP_CAPTURE_FILE, "wb");
+    TEST_ASSERT_NOT_NULL(persp_capture);
+    verify_perspective_steps(dst, src, w, PERSP_BATCH * 2);
+    verify_perspective_steps(dst, src, w, 20);
+    verify_perspective_steps(dst, src, w, 0);
+    fclose(persp_capture);
+    persp_capture = NULL;
+    persp_orig = NULL;
+
+    TEST_ASSERT_EQUAL_INT(2, persp_stat.call);
+    TEST_ASSERT_EQUAL_INT((PERSP_BATCH * 2) + 20, persp_stat.step);
+    TEST_ASSERT_EQUAL_INT(0, persp_stat.mismatch);
+    TEST_ASSERT_EQUAL_INT(0, persp_stat.orig_max_diff);
+    TEST_ASSERT_EQUAL_INT(2, persp_stat.capture);
+    memset(&persp_stat, 0, sizeof(persp_stat));
+}
+#endif
+
+// the kernel is only given whole batches of DraStic's buffers, the tail goes
+// through a padded copy so nothing past cnt is read or written
+static int run_perspective_steps(int16_t *dst, const float *src, const float *w, int32_t cnt)
+{
+    int32_t full = cnt & ~(PERSP_BATCH - 1);
+    int16_t tail_dst[PERSP_BATCH] __attribute__((aligned(16))) = { 0 };
+    float tail_src[PERSP_BATCH] __attribute__((aligned(16))) = { 0 };
+    float tail_w[PERSP_BATCH] __attribute__((aligned(16))) = { 0 };
+
+    if ((cnt <= 0) || (cnt > PERSP_MAX_STEP) || (((uintptr_t)dst | (uintptr_t)src | (uintptr_t)w) & 15)) {
+        return -1;
+    }
+
+    if (full) {
+        render_polygon_setup_perspective_steps(dst, src, w, full);
+    }
+
+    if (cnt > full) {
+        memcpy(tail_src, &src[full], (cnt - full) * sizeof(float));
+        memcpy(tail_w, &w[full], (cnt - full) * sizeof(float));
+        render_polygon_setup_perspective_steps(tail_dst, tail_src, tail_w, PERSP_BATCH);
+        memcpy(&dst[full], tail_dst, (cnt - full) * sizeof(int16_t));
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_render, run_perspective_steps)
+{
+    int cc = 0;
+    int16_t ref[PERSP_BATCH * 2] __attribute__((aligned(16))) = { 0 };
+    int16_t dst[PERSP_BATCH * 3] __attribute__((aligned(16))) = { 0 };
+    float src[PERSP_BATCH * 2] __attribute__((aligned(16))) = { 0 };
+    float w[PERSP_BATCH * 2] __attribute__((aligned(16))) = { 0 };
+
+    for (cc = 0; cc < (PERSP_BATCH * 2); cc++) {
+        src[cc] = ut_float();
+        w[cc] = ut_float();
+    }
+    render_polygon_setup_perspective_steps(ref, src, w, PERSP_BATCH * 2);
+
+    TEST_ASSERT_EQUAL_INT(-1, run_perspective_steps(dst, src, w, 0));
+    TEST_ASSERT_EQUAL_INT(-1, run_perspective_steps(dst, src, w, PERSP_MAX_STEP + 1));
+    TEST_ASSERT_EQUAL_INT(-1, run_perspective_steps(&dst[1], src, w, PERSP_BATCH));
+    TEST_ASSERT_EQUAL_INT(-1, run_perspective_steps(dst, &src[1], w, PERSP_BATCH));
+
+    // the tail matches a whole batch and the step past it is left alone
+    memset(dst, 0x5a, sizeof(dst));
+    TEST_ASSERT_EQUAL_INT(0, run_perspective_steps(dst, src, w, PERSP_BATCH + 5));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(ref, dst, PERSP_BATCH + 5);
+    TEST_ASSERT_EQUAL_HEX16(0x5a5a, (uint16_t)dst[PERSP_BATCH + 5]);
+
+    memset(dst, 0x5a, sizeof(dst));
+    TEST_ASSERT_EQUAL_INT(0, run_perspective_steps(dst, src, w, 3));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(ref, dst, 3);
+    TEST_ASSERT_EQUAL_HEX16(0x5a5a, (uint16_t)dst[3]);
+}
+#endif
+
+// both may land on either side of the exact value, so the kernel is as good
+// as DraStic when it is close to DraStic's step or both are close to exact
+static int is_step_same(int16_t neon, int16_t orig, int32_t ref)
+{
+    return is_perspective_step_close(neon, orig) ||
+        (is_perspective_step_close(neon, ref) && is_perspective_step_close(orig, ref));
+}
+
+// installed over DraStic's render_polygon_setup_perspective_steps, the NEON
+// kernel runs next to DraStic's own one until PERSP_VERIFY_CALLS calls came
+// out the same, one different step hands every later call back to DraStic
+static void hook_perspective_steps(int16_t *dst, const float *src, const float *w, int32_t cnt)
+{
+    int cc = 0;
+    int same = 1;
+    int state = __atomic_load_n(&persp_state, __ATOMIC_ACQUIRE);
+
+    if (state == PERSP_STATE_NEON) {
+        if (run_perspective_steps(dst, src, w, cnt) < 0) {
+            persp_orig(dst, src, w, cnt);
+        }
+        return;
+    }
+
+    persp_orig(dst, src, w, cnt);
+    if (state == PERSP_STATE_ORIG) {
+        return;
+    }
+
+    pthread_mutex_lock(&persp_lock);
+    if (run_perspective_steps(persp_buf, src, w, cnt) < 0) {
+        pthread_mutex_unlock(&persp_lock);
+        return;
+    }
+
+    compare_steps(&persp_stat, persp_buf, dst, src, w, cnt);
+    for (cc = 0; same && (cc < cnt); cc++) {
+        same = is_step_same(persp_buf[cc], dst[cc], get_perspective_step(src[cc], w[cc]));
+    }
+    pthread_mutex_unlock(&persp_lock);
+
+    if (!same) {
+        __atomic_store_n(&persp_state, PERSP_STATE_ORIG, __ATOMIC_RELEASE);
+        warn(DTR"perspective step %d differs from DraStic, keep DraStic's one in %s\n", cc - 1, __func__);
+        return;
+    }
+
+    if (__atomic_add_fetch(&persp_verified, 1, __ATOMIC_ACQ_REL) == PERSP_VERIFY_CALLS) {
+        if (__atomic_compare_exchange_n(&persp_state, &state, PERSP_STATE_NEON, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            info(DTR"perspective steps matched DraStic for %d calls, use NEON in %s\n", PERSP_VERIFY_CALLS, __func__);
+        }
+    }
+}
+
+#if defined(UT)
+static int ut_orig_step_calls = 0;
+
+static void ut_count_steps(int16_t *dst, const float *src, const float *w, int32_t cnt)
+{
+    ut_orig_step_calls += 1;
+    render_polygon_setup_perspective_steps_c(dst, src, w, cnt);
+}
+
+static void ut_wrong_steps(int16_t *dst, const float *src, const float *w, int32_t cnt)
+{
+    ut_orig_step_calls += 1;
+    render_polygon_setup_perspective_steps_c(dst, src, w, cnt);
+    dst[cnt - 1] += 0x100;
+}
+
+TEST(detour_render, hook_perspective_steps)
+{
+    int cc = 0;
+    int16_t ref[PERSP_BATCH * 2] __attribute__((aligned(16))) = { 0 };
+    int16_t dst[PERSP_BATCH * 2] __attribute__((aligned(16))) = { 0 };
+    float src[PERSP_BATCH * 2] __attribute__((aligned(16))) = { 0 };
+    float w[PERSP_BATCH * 2] __attribute__((aligned(16))) = { 0 };
+
+    for (cc = 0; cc < (PERSP_BATCH * 2); cc++) {
+        src[cc] = ut_float();
+        w[cc] = ut_float();
+    }
+    render_polygon_setup_perspective_steps(ref, src, w, PERSP_BATCH * 2);
+
+    // matches DraStic, so it switches over once enough calls were checked
+    ut_orig_step_calls = 0;
+    persp_orig = ut_count_steps;
+    persp_state = PERSP_STATE_VERIFY;
+    persp_verified = 0;
+    memset(&persp_stat, 0, sizeof(persp_stat));
+    for (cc = 0; cc < PERSP_VERIFY_CALLS; cc++) {
+        hook_perspective_steps(dst, src, w, (cc & 1) ? (PERSP_BATCH * 2) : 7);
+    }
+    TEST_ASSERT_EQUAL_INT(PERSP_VERIFY_CALLS, ut_orig_step_calls);
+    TEST_ASSERT_EQUAL_INT(PERSP_STATE_NEON, persp_state);
+    TEST_ASSERT_EQUAL_INT(PERSP_VERIFY_CALLS, persp_stat.call);
+
+    memset(dst, 0, sizeof(dst));
+    hook_perspective_steps(dst, src, w, PERSP_BATCH * 2);
+    TEST_ASSERT_EQUAL_INT(PERSP_VERIFY_CALLS, ut_orig_step_calls);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(ref, dst, PERSP_BATCH * 2);
+
+    // buffers the kernel can not take go to DraStic
+    hook_perspective_steps(dst, &src[1], &w[1], PERSP_BATCH);
+    TEST_ASSERT_EQUAL_INT(PERSP_VERIFY_CALLS + 1, ut_orig_step_calls);
+    hook_perspective_steps(dst, src, w, 0);
+    TEST_ASSERT_EQUAL_INT(PERSP_VERIFY_CALLS + 2, ut_orig_step_calls);
+
+    // one different step and DraStic keeps it for good
+    persp_orig = ut_wrong_steps;
+    persp_state = PERSP_STATE_VERIFY;
+    persp_verified = 0;
+    hook_perspective_steps(dst, src, w, PERSP_BATCH);
+    TEST_ASSERT_EQUAL_INT(PERSP_STATE_ORIG, persp_state);
+    TEST_ASSERT_EQUAL_INT16((int16_t)(ref[PERSP_BATCH - 1] + 0x100), dst[PERSP_BATCH - 1]);
+    hook_perspective_steps(dst, src, w, PERSP_BATCH);
+    TEST_ASSERT_EQUAL_INT(PERSP_VERIFY_CALLS + 4, ut_orig_step_calls);
+    TEST_ASSERT_EQUAL_INT(0, persp_verified);
+
+    persp_orig = NULL;
+    persp_state = PERSP_STATE_VERIFY;
+    persp_verified = 0;
+    memset(&persp_stat, 0, sizeof(persp_stat));
+}
+#endif
+
+int replay_perspective_capture(const char *path, persp_stat_t *st)
+{
+    int r = 0;
+    FILE *f = NULL;
+    uint32_t n = 0;
+
+    if (!path || !st) {
+        err(DTR"invalid parameters(0x%x, 0x%x) in %s\n", path, st, __func__);
+        return -1;
+    }
+
+    f = fopen(path, "rb");
+    if (!f) {
+        err(DTR"failed to open \"%s\" in %s\n", path, __func__);
+        return -1;
+    }
+
+    memset(st, 0, sizeof(persp_stat_t));
+    pthread_mutex_lock(&persp_lock);
+    while (fread(&n, sizeof(n), 1, f) == 1) {
+        if (!n || (n > PERSP_MAX_STEP) ||
+            (fread(persp_src, sizeof(float), n, f) != n) ||
+            (fread(persp_w, sizeof(float), n, f) != n) ||
+            (fread(persp_ref, sizeof(int16_t), n, f) != n))
+        {
+            err(DTR"truncated capture \"%s\" in %s\n", path, __func__);
+            r = -1;
+            break;
+        }
+
+        // the kernel reads a whole batch, pad the tail like DraStic does
+        memset(&persp_src[n], 0, PERSP_BATCH * sizeof(float));
+        memset(&persp_w[n], 0, PERSP_BATCH * sizeof(float));
+        render_polygon_setup_perspective_steps(persp_buf, persp_src, persp_w, n);
+        compare_steps(st, persp_buf, persp_ref, persp_src, persp_w, n);
+    }
+    pthread_mutex_unlock(&persp_lock);
+    fclose(f);
+    return r;
+}
+
+#if defined(UT)
+TEST(detour_render, replay_perspective_capture)
+{
+    FILE *f = NULL;
+    uint32_t n = 0;
+    persp_stat_t st = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, replay_perspective_capture(NULL, &st));
+    TEST_ASSERT_EQUAL_INT(-1, replay_perspective_capture("/NOT_EXIST", &st));
+
+    // written by the verify_perspective_steps test
+    TEST_ASSERT_EQUAL_INT(0, replay_perspective_capture(PERSP_CAPTURE_FILE, &st));
+    TEST_ASSERT_EQUAL_INT(2, st.call);
+    TEST_ASSERT_EQUAL_INT((PERSP_BATCH * 2) + 20, st.step);
+    TEST_ASSERT_EQUAL_INT(0, st.mismatch);
+
+    f = fopen(PERSP_CAPTURE_FILE, "ab");
+    TEST_ASSERT_NOT_NULL(f);
+    n = 8;
+    fwrite(&n, sizeof(n), 1, f);
+    fclose(f);
+    TEST_ASSERT_EQUAL_INT(-1, replay_perspective_capture(PERSP_CAPTURE_FILE, &st));
+    unlink(PERSP_CAPTURE_FILE);
+}
+
+// miyoo_persp_capture.bin recorded on device in verify mode, not checked in,
+// the kernel checks itself against DraStic on device before it takes over
+TEST(detour_render, replay_device_capture)
+{
+    persp_stat_t st = { 0 };
+
+    if (access(UT_PERSP_CAPTURE, F_OK) != 0) {
+        TEST_IGNORE_MESSAGE("no device capture in " UT_PERSP_CAPTURE);
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, replay_perspective_capture(UT_PERSP_CAPTURE, &st));
+    TEST_ASSERT_TRUE(st.call > 0);
+    TEST_ASSERT_EQUAL_INT(0, st.mismatch);
+}
+#endif
+
+int bench_perspective_steps(uint32_t cnt, uint32_t loop, uint64_t *c_ns, uint64_t *neon_ns)
+{
+    uint32_t cc = 0;
+    uint64_t t0 = 0;
+
+    if (!cnt || (cnt > PERSP_MAX_STEP) || (cnt % PERSP_BATCH) || !loop || !c_ns || !neon_ns) {
+        err(DTR"invalid parameters(%d, %d, 0x%x, 0x%x) in %s\n", cnt, loop, c_ns, neon_ns, __func__);
+        return -1;
+    }
+
+    // typical polygon setup values, x within the edge length and w positive
+    pthread_mutex_lock(&persp_lock);
+    for (cc = 0; cc < cnt; cc++) {
+        persp_src[cc] = (float)((cc * 37) % 4096) / 16.0f;
+        persp_w[cc] = 1.0f + (float)((cc * 101) % 8192) / 8.0f;
+    }
+
+    render_polygon_setup_perspective_steps_c(persp_ref, persp_src, persp_w, cnt);
+    t0 = get_clock_ns(CLOCK_MONOTONIC_RAW);
+    for (cc = 0; cc < loop; cc++) {
+        render_polygon_setup_perspective_steps_c(persp_ref, persp_src, persp_w, cnt);
+    }
+    *c_ns = get_clock_ns(CLOCK_MONOTONIC_RAW) - t0;
+
+    render_polygon_setup_perspective_steps(persp_buf, persp_src, persp_w, cnt);
+    t0 = get_clock_ns(CLOCK_MONOTONIC_RAW);
+    for (cc = 0; cc < loop; cc++) {
+        render_polygon_setup_perspective_steps(persp_buf, persp_src, persp_w, cnt);
+    }
+    *neon_ns = get_clock_ns(CLOCK_MONOTONIC_RAW) - t0;
+    pthread_mutex_unlock(&persp_lock);
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_render, bench_perspective_steps)
+{
+    uint64_t c_ns = 0;
+    uint64_t neon_ns = 0;
+
+    TEST_ASSERT_EQUAL_INT(-1, bench_perspective_steps(20, 1, &c_ns, &neon_ns));
+    TEST_ASSERT_EQUAL_INT(-1, bench_perspective_steps(PERSP_MAX_STEP + PERSP_BATCH, 1, &c_ns, &neon_ns));
+    TEST_ASSERT_EQUAL_INT(-1, bench_perspective_steps(PERSP_BATCH, 0, &c_ns, &neon_ns));
+    TEST_ASSERT_EQUAL_INT(0, bench_perspective_steps(PERSP_BATCH * 16, 4, &c_ns, &neon_ns));
+    TEST_ASSERT_TRUE(c_ns > 0);
+    TEST_ASSERT_TRUE(neon_ns > 0);
+}
+#endif
+
+int init_perspective_hook(void)
+{
+    uint64_t c_ns = 0;
+    uint64_t neon_ns = 0;
+    uintptr_t addr = 0;
+
+#if !defined(UT)
+    if (!myhook.fun.render_polygon_setup_perspective_steps) {
+        init_detour_hook();
+    }
+#endif
+
+    addr = myhook.fun.render_polygon_setup_perspective_steps;
+    memset(&persp_stat, 0, sizeof(persp_stat));
+    if (access(PERSP_VERIFY_FILE, F_OK) != 0) {
+        if (access(PERSP_DISABLE_FILE, F_OK) == 0) {
+            info(DTR"keep DraStic's perspective steps in %s\n", __func__);
+            return 0;
+        }
+
+        __atomic_store_n(&persp_verified, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&persp_state, PERSP_STATE_VERIFY, __ATOMIC_RELEASE);
+#if !defined(UT)
+        if (add_detour_hook(addr, hook_perspective_steps, (void **)&persp_orig) < 0) {
+            err(DTR"failed to add perspective hook in %s\n", __func__);
+            return -1;
+        }
+#endif
+        info(DTR"checking perspective steps against DraStic in %s\n", __func__);
+        return 0;
+    }
+
+    if (bench_perspective_steps(PERSP_MAX_STEP, 256, &c_ns, &neon_ns) == 0) {
+        info(DTR"perspective steps, c %llu ns, neon %llu ns per %d steps in %s\n",
+            (unsigned long long)(c_ns / 256), (unsigned long long)(neon_ns / 256), PERSP_MAX_STEP, __func__);
+    }
+
+    persp_capture = fopen(PERSP_CAPTURE_FILE, "wb");
+    if (add_detour_hook(addr, verify_perspective_steps, (void **)&persp_orig) < 0) {
+        err(DTR"failed to add verify hook in %s\n", __func__);
+        return -1;
+    }
+    info(DTR"verifying perspective steps against DraStic in %s\n", __func__);
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_render, init_perspective_hook)
+{
+    FILE *f = NULL;
+
+    TEST_ASSERT_EQUAL_INT(0, init_detour_hook());
+    persp_state = PERSP_STATE_ORIG;
+    persp_verified = 3;
+    TEST_ASSERT_EQUAL_INT(0, init_perspective_hook());
+    TEST_ASSERT_EQUAL_INT(PERSP_STATE_VERIFY, persp_state);
+    TEST_ASSERT_EQUAL_INT(0, persp_verified);
+
+    f = fopen(PERSP_DISABLE_FILE, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fclose(f);
+    persp_state = PERSP_STATE_ORIG;
+    TEST_ASSERT_EQUAL_INT(0, init_perspective_hook());
+    TEST_ASSERT_EQUAL_INT(PERSP_STATE_ORIG, persp_state);
+    unlink(PERSP_DISABLE_FILE);
+    persp_state = PERSP_STATE_VERIFY;
+}
+#endif
+
+int quit_perspective_hook(const char *path)
+{
+    FILE *f = NULL;
+
+    pthread_mutex_lock(&persp_lock);
+    if (persp_capture) {
+        fclose(persp_capture);
+        persp_capture = NULL;
+    }
+
+    if (path && persp_orig) {
+        f = fopen(path, "w");
+        if (f) {
+            fprintf(f, "calls=%llu\n", (unsigned long long)persp_stat.call);
+            fprintf(f, "steps=%llu\n", (unsigned long long)persp_stat.step);
+            fprintf(f, "mismatch=%llu\n", (unsigned long long)persp_stat.mismatch);
+            fprintf(f, "neon_max_diff=%u\n", persp_stat.max_diff);
+            fprintf(f, "orig_max_diff=%u\n", persp_stat.orig_max_diff);
+            fprintf(f, "captured=%u\n", persp_stat.capture);
+            fprintf(f, "state=%d\n", __atomic_load_n(&persp_state, __ATOMIC_ACQUIRE));
+            fclose(f);
+        }
+    }
+    pthread_mutex_unlock(&persp_lock);
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_render, quit_perspective_hook)
+{
+    FILE *f = NULL;
+    char buf[64] = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(0, quit_perspective_hook(NULL));
+
+    persp_orig = ut_orig_steps;
+    persp_stat.call = 3;
+    TEST_ASSERT_EQUAL_INT(0, quit_perspective_hook(PERSP_REPORT_FILE));
+    persp_orig = NULL;
+    memset(&persp_stat, 0, sizeof(persp_stat));
+
+    f = fopen(PERSP_REPORT_FILE, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_NOT_NULL(fgets(buf, sizeof(buf), f));
+    TEST_ASSERT_EQUAL_STRING("calls=3\n", buf);
+    fclose(f);
+    unlink(PERSP_REPORT_FILE);
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(detour_render)
+{
+    RUN_TEST_CASE(detour_render, render_scanline_tiled_4bpp_c);
+    RUN_TEST_CASE(detour_render, render_scanline_tiled_4bpp_neon);
+    RUN_TEST_CASE(detour_render, is_mapped);
+    RUN_TEST_CASE(detour_render, hook_scanline_tiled_4bpp);
+    RUN_TEST_CASE(detour_render, init_tiled_hook);
+    RUN_TEST_CASE(detour_render, get_perspective_step);
+    RUN_TEST_CASE(detour_render, is_perspective_step_close);
+    RUN_TEST_CASE(detour_render, render_polygon_setup_perspective_steps_c);
+    RUN_TEST_CASE(detour_render, get_recip);
+    RUN_TEST_CASE(detour_render, render_polygon_setup_perspective_steps);
+    RUN_TEST_CASE(detour_render, verify_perspective_steps);
+    RUN_TEST_CASE(detour_render, run_perspective_steps);
+    RUN_TEST_CASE(detour_render, hook_perspective_steps);
+    RUN_TEST_CASE(detour_render, replay_perspective_capture);
+    RUN_TEST_CASE(detour_render, replay_device_capture);
+    RUN_TEST_CASE(detour_render, bench_perspective_steps);
+    RUN_TEST_CASE(detour_render, init_perspective_hook);
+    RUN_TEST_CASE(detour_render, quit_perspective_hook);
+}
+#endif
+
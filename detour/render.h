@@ -0,0 +1,104 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __DETOUR_RENDER_H__
+#define __DETOUR_RENDER_H__
+
+    #include <stdint.h>
+
+    #define RENDER_LINE_W 256
+    #define RENDER_TILE_BYTES 32
+    #define RENDER_MAX_TILE 1024
+    #define RENDER_BLOCK_ENTRY 1024
+    #define RENDER_OPAQUE 0x8000
+
+    #define TILED_VERIFY_CALLS 4096
+    #define TILED_STATE_VERIFY 0
+    #define TILED_STATE_NEON 1
+    #define TILED_STATE_ORIG 2
+
+    #define PERSP_FRAC_BITS 15
+    #define PERSP_BATCH 16
+    #define PERSP_MAX_STEP 4096
+    #define PERSP_MAX_CAPTURE 1024
+    #define PERSP_VERIFY_CALLS 1024
+    #define PERSP_STATE_VERIFY 0
+    #define PERSP_STATE_NEON 1
+    #define PERSP_STATE_ORIG 2
+    #define PERSP_DISABLE_FILE "miyoo_persp_orig"
+    #define PERSP_VERIFY_FILE "miyoo_persp_verify"
+    #define PERSP_CAPTURE_FILE "miyoo_persp_capture.bin"
+    #define PERSP_REPORT_FILE "miyoo_persp_verify.txt"
+
+    // one 4bpp text background, screen blocks are 32x32 entries like on the DS
+    typedef struct _render_bg {
+        const uint16_t *map;
+        const uint8_t *tile;
+        const uint16_t *pal;
+        uint32_t map_w;
+        uint32_t map_h;
+        uint32_t hoff;
+        uint32_t voff;
+    } render_bg_t;
+
+    // layer DraStic is assumed to pass to render_scanline_tiled_4bpp in r0,
+    // with the 256 pixel line in r1 and the screen line in r2, cnt is BGxCNT
+    // for the screen size, the hook checks this against DraStic's own output
+    // for TILED_VERIFY_CALLS lines before the NEON kernel takes over
+    typedef struct _drastic_bg {
+        const uint16_t *map;
+        const uint8_t *tile;
+        const uint16_t *pal;
+        uint16_t cnt;
+        uint16_t hoff;
+        uint16_t voff;
+    } drastic_bg_t;
+
+    typedef void (*tiled_fn)(const drastic_bg_t *bg, uint16_t *dst, uint32_t line);
+
+    typedef struct _persp_stat {
+        uint64_t call;
+        uint64_t step;
+        uint64_t mismatch;
+        uint32_t max_diff;
+        uint32_t orig_max_diff;
+        uint32_t capture;
+    } persp_stat_t;
+
+    typedef void (*persp_step_fn)(int16_t *dst, const float *src, const float *w, int32_t cnt);
+
+    // NEON kernel in drastic.S, processes PERSP_BATCH steps per loop and
+    // needs 16 bytes aligned buffers padded to a multiple of PERSP_BATCH
+    void render_polygon_setup_perspective_steps(int16_t *dst, const float *src, const float *w, int32_t cnt);
+
+    int render_scanline_tiled_4bpp_c(const render_bg_t *bg, uint32_t line, uint16_t *dst);
+    int render_scanline_tiled_4bpp_neon(const render_bg_t *bg, uint32_t line, uint16_t *dst);
+    int init_tiled_hook(void);
+
+    int32_t get_perspective_step(float x, float w);
+    int is_perspective_step_close(int16_t v, int32_t ref);
+    int render_polygon_setup_perspective_steps_c(int16_t *dst, const float *src, const float *w, int32_t cnt);
+    int replay_perspective_capture(const char *path, persp_stat_t *st);
+    int bench_perspective_steps(uint32_t cnt, uint32_t loop, uint64_t *c_ns, uint64_t *neon_ns);
+    int init_perspective_hook(void);
+    int quit_perspective_hook(const char *path);
+
+#endif
+
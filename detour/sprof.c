@@ -0,0 +1,408 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#define _GNU_SOURCE
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "log.h"
+#include "sprof.h"
+#include "thread.h"
+#include "governor.h"
+
+static struct sigaction sprof_old_act = { 0 };
+static sprof_ctx_t sprof = {
+    .cond = PTHREAD_COND_INITIALIZER,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+#if defined(UT)
+TEST_GROUP(detour_sprof);
+
+TEST_SETUP(detour_sprof)
+{
+}
+
+TEST_TEAR_DOWN(detour_sprof)
+{
+    stop_sampling_profiler();
+    unlink(SPROF_SAMPLE_FILE);
+    unlink(SPROF_MAPS_FILE);
+}
+#endif
+
+// runs in signal context, so no locks, no allocation and no tls
+static int push_sample(uint32_t tid, uint32_t pc, uint32_t lr)
+{
+    int cc = 0;
+    uint32_t head = 0;
+    sprof_ring_t *r = NULL;
+
+    for (cc = 0; cc < SPROF_MAX_THREAD; cc++) {
+        if (__atomic_load_n(&sprof.ring[cc].tid, __ATOMIC_ACQUIRE) == tid) {
+            r = &sprof.ring[cc];
+            break;
+        }
+    }
+
+    for (cc = 0; !r && (cc < SPROF_MAX_THREAD); cc++) {
+        if (__sync_bool_compare_and_swap(&sprof.ring[cc].tid, 0, tid)) {
+            r = &sprof.ring[cc];
+        }
+    }
+
+    if (!r) {
+        __atomic_fetch_add(&sprof.lost, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    head = r->head;
+    if ((head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)) >= SPROF_RING_SIZE) {
+        r->dropped += 1;
+        return -1;
+    }
+
+    r->buf[head & (SPROF_RING_SIZE - 1)].tid = tid;
+    r->buf[head & (SPROF_RING_SIZE - 1)].pc = pc;
+    r->buf[head & (SPROF_RING_SIZE - 1)].lr = lr;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_sprof, push_sample)
+{
+    int cc = 0;
+
+    memset(sprof.ring, 0, sizeof(sprof.ring));
+    sprof.lost = 0;
+
+    TEST_ASSERT_EQUAL_INT(0, push_sample(100, 0x08001000, 0x08002000));
+    TEST_ASSERT_EQUAL_INT(0, push_sample(101, 0x08003000, 0x08004000));
+    TEST_ASSERT_EQUAL_INT(100, sprof.ring[0].tid);
+    TEST_ASSERT_EQUAL_INT(101, sprof.ring[1].tid);
+    TEST_ASSERT_EQUAL_INT(1, sprof.ring[0].head);
+    TEST_ASSERT_EQUAL_HEX32(0x08003000, sprof.ring[1].buf[0].pc);
+
+    for (cc = 1; cc < SPROF_RING_SIZE; cc++) {
+        TEST_ASSERT_EQUAL_INT(0, push_sample(100, cc, cc));
+    }
+    TEST_ASSERT_EQUAL_INT(-1, push_sample(100, 0, 0));
+    TEST_ASSERT_EQUAL_INT(1, sprof.ring[0].dropped);
+
+    for (cc = 2; cc < SPROF_MAX_THREAD; cc++) {
+        TEST_ASSERT_EQUAL_INT(0, push_sample(100 + cc, 0, 0));
+    }
+    TEST_ASSERT_EQUAL_INT(-1, push_sample(999, 0, 0));
+    TEST_ASSERT_EQUAL_INT(1, sprof.lost);
+    memset(sprof.ring, 0, sizeof(sprof.ring));
+    sprof.lost = 0;
+}
+#endif
+
+static void sprof_handler(int sig, siginfo_t *info, void *ctx)
+{
+    int e = errno;
+    uint32_t pc = 0;
+    uint32_t lr = 0;
+    ucontext_t *uc = (ucontext_t *)ctx;
+
+#if defined(__arm__)
+    pc = uc->uc_mcontext.arm_pc;
+    lr = uc->uc_mcontext.arm_lr;
+#elif defined(__x86_64__)
+    pc = uc->uc_mcontext.gregs[REG_RIP];
+#endif
+
+    push_sample(syscall(SYS_gettid), pc, lr);
+    errno = e;
+}
+
+// the thread is gone, so nothing can push into its ring while it is reset
+static int release_ring(sprof_ring_t *r)
+{
+    if (syscall(SYS_tgkill, getpid(), r->tid, 0) == 0) {
+        return -1;
+    }
+
+    if (errno != ESRCH) {
+        return -1;
+    }
+
+    sprof.dropped += r->dropped;
+    r->head = 0;
+    r->dropped = 0;
+    r->named = 0;
+    __atomic_store_n(&r->tail, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&r->tid, 0, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static int flush_samples(void)
+{
+    int cc = 0;
+    int cnt = 0;
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    sprof_ring_t *r = NULL;
+    char buf[64] = { 0 };
+    char name[32] = { 0 };
+    FILE *f = NULL;
+
+    for (cc = 0; cc < SPROF_MAX_THREAD; cc++) {
+        r = &sprof.ring[cc];
+        if (!__atomic_load_n(&r->tid, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+
+        if (!r->named && sprof.maps) {
+            strcpy(name, "unknown");
+            snprintf(buf, sizeof(buf), "/proc/self/task/%u/comm", r->tid);
+            f = fopen(buf, "r");
+            if (f) {
+                if (fgets(name, sizeof(name), f)) {
+                    name[strcspn(name, "\n")] = 0;
+                }
+                fclose(f);
+            }
+            fprintf(sprof.maps, "thread %u %s\n", r->tid, name);
+            r->named = 1;
+        }
+
+        head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        for (tail = r->tail; tail != head; tail++) {
+            if (sprof.bin) {
+                fwrite(&r->buf[tail & (SPROF_RING_SIZE - 1)], sizeof(sprof_sample_t), 1, sprof.bin);
+            }
+            cnt += 1;
+        }
+        __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+        release_ring(r);
+    }
+
+    sprof.samples += cnt;
+    if (sprof.bin) {
+        fflush(sprof.bin);
+    }
+    if (sprof.maps) {
+        fflush(sprof.maps);
+    }
+    return cnt;
+}
+
+#if defined(UT)
+TEST(detour_sprof, flush_samples)
+{
+    memset(sprof.ring, 0, sizeof(sprof.ring));
+    TEST_ASSERT_EQUAL_INT(0, flush_samples());
+
+    push_sample(getpid(), 1, 2);
+    push_sample(getpid(), 3, 4);
+    push_sample(12345, 5, 6);
+    TEST_ASSERT_EQUAL_INT(3, flush_samples());
+    TEST_ASSERT_EQUAL_INT(0, flush_samples());
+    TEST_ASSERT_EQUAL_INT(2, sprof.ring[0].tail);
+    TEST_ASSERT_EQUAL_INT(getpid(), sprof.ring[0].tid);
+    TEST_ASSERT_EQUAL_INT(0, sprof.ring[1].tid);
+    TEST_ASSERT_EQUAL_INT(0, push_sample(getpid(), 7, 8));
+    TEST_ASSERT_EQUAL_INT(1, flush_samples());
+    memset(sprof.ring, 0, sizeof(sprof.ring));
+}
+#endif
+
+static void *sprof_handler_thread(void *param)
+{
+    struct timespec ts = { 0 };
+
+    register_thread("sprof", THREAD_ROLE_IDLE);
+    pthread_mutex_lock(&sprof.mutex);
+    while (sprof.running) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += SPROF_FLUSH_MS / 1000;
+        ts.tv_nsec += (SPROF_FLUSH_MS % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec += 1;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&sprof.cond, &sprof.mutex, &ts);
+        flush_samples();
+    }
+    pthread_mutex_unlock(&sprof.mutex);
+    unregister_thread();
+    return NULL;
+}
+
+static int dump_maps(FILE *dst)
+{
+    FILE *f = NULL;
+    char buf[256] = { 0 };
+
+    f = fopen("/proc/self/maps", "r");
+    if (!f) {
+        return -1;
+    }
+
+    while (fgets(buf, sizeof(buf), f)) {
+        // only executable mappings can own a sampled pc
+        if (strstr(buf, " r-xp ") || strstr(buf, " rwxp ")) {
+            fprintf(dst, "map %s", buf);
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+int start_sampling_profiler(const char *bin, const char *maps, int hz)
+{
+    struct sigaction act = { 0 };
+    struct itimerval it = { 0 };
+
+    if (!bin || !maps || (hz <= 0) || (hz > 10000)) {
+        err(DTR"invalid parameters(0x%x, 0x%x, %d) in %s\n", bin, maps, hz, __func__);
+        return -1;
+    }
+
+    if (sprof.running) {
+        return 0;
+    }
+
+    memset(sprof.ring, 0, sizeof(sprof.ring));
+    sprof.lost = 0;
+    sprof.dropped = 0;
+    sprof.samples = 0;
+    sprof.hz = hz;
+    sprof.bin = fopen(bin, "wb");
+    sprof.maps = fopen(maps, "w");
+    if (!sprof.bin || !sprof.maps) {
+        err(DTR"failed to create \"%s\" or \"%s\" in %s\n", bin, maps, __func__);
+        stop_sampling_profiler();
+        return -1;
+    }
+    fprintf(sprof.maps, "hz %d\n", hz);
+    dump_maps(sprof.maps);
+    fflush(sprof.maps);
+
+    sprof.running = 1;
+    if (pthread_create(&sprof.thread, NULL, sprof_handler_thread, NULL) != 0) {
+        sprof.running = 0;
+        stop_sampling_profiler();
+        return -1;
+    }
+
+    act.sa_sigaction = sprof_handler;
+    act.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&act.sa_mask);
+    sigaction(SIGPROF, &act, &sprof_old_act);
+
+    it.it_interval.tv_usec = 1000000 / hz;
+    it.it_value = it.it_interval;
+    setitimer(ITIMER_PROF, &it, NULL);
+    info(DTR"sampling profiler started at %dHz in %s\n", hz, __func__);
+    return 0;
+}
+
+int stop_sampling_profiler(void)
+{
+    int cc = 0;
+    uint32_t dropped = 0;
+    struct itimerval it = { 0 };
+
+    if (sprof.running) {
+        setitimer(ITIMER_PROF, &it, NULL);
+        sigaction(SIGPROF, &sprof_old_act, NULL);
+
+        pthread_mutex_lock(&sprof.mutex);
+        sprof.running = 0;
+        pthread_cond_signal(&sprof.cond);
+        pthread_mutex_unlock(&sprof.mutex);
+        pthread_join(sprof.thread, NULL);
+        flush_samples();
+
+        dropped = sprof.dropped;
+        for (cc = 0; cc < SPROF_MAX_THREAD; cc++) {
+            dropped += sprof.ring[cc].dropped;
+        }
+        info(DTR"sampling profiler stopped, %llu samples, %u dropped, %u lost in %s\n",
+            (unsigned long long)sprof.samples, dropped, sprof.lost, __func__);
+    }
+
+    if (sprof.bin) {
+        fclose(sprof.bin);
+        sprof.bin = NULL;
+    }
+
+    if (sprof.maps) {
+        fclose(sprof.maps);
+        sprof.maps = NULL;
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(detour_sprof, start_sampling_profiler)
+{
+    FILE *f = NULL;
+    uint64_t t0 = 0;
+    sprof_sample_t s = { 0 };
+    volatile uint32_t spin = 0;
+
+    TEST_ASSERT_EQUAL_INT(-1, start_sampling_profiler(NULL, SPROF_MAPS_FILE, SPROF_HZ));
+    TEST_ASSERT_EQUAL_INT(-1, start_sampling_profiler(SPROF_SAMPLE_FILE, SPROF_MAPS_FILE, 0));
+    TEST_ASSERT_EQUAL_INT(0, stop_sampling_profiler());
+
+    TEST_ASSERT_EQUAL_INT(0, start_sampling_profiler(SPROF_SAMPLE_FILE, SPROF_MAPS_FILE, SPROF_HZ));
+    t0 = get_clock_us(CLOCK_MONOTONIC);
+    do {
+        spin += 1;
+    } while ((get_clock_us(CLOCK_MONOTONIC) - t0) < 100000);
+    TEST_ASSERT_EQUAL_INT(0, stop_sampling_profiler());
+    TEST_ASSERT_TRUE(sprof.samples > 0);
+
+    f = fopen(SPROF_SAMPLE_FILE, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL_INT(1, fread(&s, sizeof(s), 1, f));
+    TEST_ASSERT_TRUE(s.tid > 0);
+    TEST_ASSERT_TRUE(s.pc != 0);
+    fclose(f);
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(detour_sprof)
+{
+    RUN_TEST_CASE(detour_sprof, push_sample);
+    RUN_TEST_CASE(detour_sprof, flush_samples);
+    RUN_TEST_CASE(detour_sprof, start_sampling_profiler);
+}
+#endif
+
@@ -0,0 +1,68 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __DETOUR_SPROF_H__
+#define __DETOUR_SPROF_H__
+
+    #include <stdint.h>
+    #include <pthread.h>
+
+    #define SPROF_HZ 1000
+    #define SPROF_MAX_THREAD 16
+    #define SPROF_RING_SIZE 2048
+    #define SPROF_FLUSH_MS 500
+    #define SPROF_ENABLE_FILE "miyoo_sprof"
+    #define SPROF_SAMPLE_FILE "miyoo_sprof.bin"
+    #define SPROF_MAPS_FILE "miyoo_sprof.maps"
+
+    typedef struct _sprof_sample {
+        uint32_t tid;
+        uint32_t pc;
+        uint32_t lr;
+    } sprof_sample_t;
+
+    typedef struct _sprof_ring {
+        uint32_t tid;
+        uint32_t head;
+        uint32_t tail;
+        uint32_t dropped;
+        int named;
+        sprof_sample_t buf[SPROF_RING_SIZE];
+    } sprof_ring_t;
+
+    typedef struct _sprof_ctx {
+        int running;
+        int hz;
+        uint32_t lost;
+        uint32_t dropped;
+        uint64_t samples;
+        FILE *bin;
+        FILE *maps;
+        pthread_t thread;
+        pthread_cond_t cond;
+        pthread_mutex_t mutex;
+        sprof_ring_t ring[SPROF_MAX_THREAD];
+    } sprof_ctx_t;
+
+    int start_sampling_profiler(const char *bin, const char *maps, int hz);
+    int stop_sampling_profiler(void);
+
+#endif
+
@@ -0,0 +1,63 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "log.h"
+#include "gamedb.h"
+#include "governor.h"
+
+int main(int argc, char **argv)
+{
+    int cc = 0;
+    uint64_t t0 = 0;
+    gamedb_info_t info = { 0 };
+
+    if (argc < 3) {
+        printf("usage: %s <game_database.xml> <game_database.bin> [rom...]\n", argv[0]);
+        return -1;
+    }
+
+    if (compile_gamedb(argv[1], argv[2]) < 0) {
+        return -1;
+    }
+
+    if (open_gamedb(argv[2]) < 0) {
+        return -1;
+    }
+
+    for (cc = 3; cc < argc; cc++) {
+        t0 = get_clock_us(CLOCK_MONOTONIC);
+        if (identify_game(argv[cc], NULL, &info) < 0) {
+            printf("%s: unknown\n", argv[cc]);
+            continue;
+        }
+        printf("%s: %s, %s, crc32 0x%08x, save 0x%x, %dus\n",
+            argv[cc], info.code, info.title, info.crc32, info.save_size,
+            (int)(get_clock_us(CLOCK_MONOTONIC) - t0));
+    }
+    close_gamedb();
+    return 0;
+}
+
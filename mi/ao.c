@@ -0,0 +1,610 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "mi.h"
+#include "mi_ao.h"
+
+// Host stand-in of MI_AO. The I2S output drains at the configured sample
+// rate on the host clock, u32FrmNum * u32PtNumPerFrm samples can be queued
+// before MI_AO_SendFrame() blocks. What is played goes to a WAV file when
+// MI_AO_WAV names one
+
+#define AO_MIN_VOL      -60
+#define AO_MAX_VOL      30
+#define AO_WAV_HDR      44
+
+typedef struct {
+    int cfg;
+    int enable;
+    int chn;
+    int mute;
+    int vol;
+    int started;
+    uint64_t play_end;
+    uint32_t wav_len;
+    FILE *wav;
+    MI_AUDIO_Attr_t attr;
+} ao_dev_t;
+
+static ao_dev_t ao[MI_AO_DEV_NUM_MAX] = { 0 };
+
+#if defined(UT)
+#define UT_WAV  "mi_ao_ut.wav"
+
+TEST_GROUP(mi_ao);
+
+TEST_SETUP(mi_ao)
+{
+    memset(ao, 0, sizeof(ao));
+    mi_reset_stat();
+}
+
+TEST_TEAR_DOWN(mi_ao)
+{
+    unsetenv(MI_ENV_WAV);
+    unlink(UT_WAV);
+}
+
+static void ut_attr(MI_AUDIO_Attr_t *attr)
+{
+    memset(attr, 0, sizeof(MI_AUDIO_Attr_t));
+    attr->eSamplerate = E_MI_AUDIO_SAMPLE_RATE_48000;
+    attr->eBitwidth = E_MI_AUDIO_BIT_WIDTH_16;
+    attr->eWorkmode = E_MI_AUDIO_MODE_I2S_MASTER;
+    attr->eSoundmode = E_MI_AUDIO_SOUND_MODE_STEREO;
+    attr->u32FrmNum = 6;
+    attr->u32PtNumPerFrm = 480;
+    attr->u32ChnCnt = 2;
+}
+#endif
+
+static int get_channels(const MI_AUDIO_Attr_t *attr)
+{
+    return (attr->eSoundmode == E_MI_AUDIO_SOUND_MODE_MONO) ? 1 : 2;
+}
+
+static int is_rate_valid(MI_AUDIO_SampleRate_e rate)
+{
+    switch (rate) {
+    case E_MI_AUDIO_SAMPLE_RATE_8000:
+    case E_MI_AUDIO_SAMPLE_RATE_11025:
+    case E_MI_AUDIO_SAMPLE_RATE_12000:
+    case E_MI_AUDIO_SAMPLE_RATE_16000:
+    case E_MI_AUDIO_SAMPLE_RATE_22050:
+    case E_MI_AUDIO_SAMPLE_RATE_24000:
+    case E_MI_AUDIO_SAMPLE_RATE_32000:
+    case E_MI_AUDIO_SAMPLE_RATE_44100:
+    case E_MI_AUDIO_SAMPLE_RATE_48000:
+    case E_MI_AUDIO_SAMPLE_RATE_96000:
+        return 1;
+    default:
+        break;
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(mi_ao, is_rate_valid)
+{
+    TEST_ASSERT_EQUAL_INT(1, is_rate_valid(E_MI_AUDIO_SAMPLE_RATE_48000));
+    TEST_ASSERT_EQUAL_INT(1, is_rate_valid(E_MI_AUDIO_SAMPLE_RATE_44100));
+    TEST_ASSERT_EQUAL_INT(0, is_rate_valid(44000));
+}
+#endif
+
+static void put_le(uint8_t *p, uint32_t v, int len)
+{
+    int cc = 0;
+
+    for (cc = 0; cc < len; cc++) {
+        p[cc] = (v >> (cc * 8)) & 0xff;
+    }
+}
+
+static int write_wav_header(ao_dev_t *d)
+{
+    uint8_t hdr[AO_WAV_HDR] = { 0 };
+    int ch = get_channels(&d->attr);
+
+    memcpy(&hdr[0], "RIFF", 4);
+    put_le(&hdr[4], 36 + d->wav_len, 4);
+    memcpy(&hdr[8], "WAVEfmt ", 8);
+    put_le(&hdr[16], 16, 4);
+    put_le(&hdr[20], 1, 2);
+    put_le(&hdr[22], ch, 2);
+    put_le(&hdr[24], d->attr.eSamplerate, 4);
+    put_le(&hdr[28], d->attr.eSamplerate * ch * 2, 4);
+    put_le(&hdr[32], ch * 2, 2);
+    put_le(&hdr[34], 16, 2);
+    memcpy(&hdr[36], "data", 4);
+    put_le(&hdr[40], d->wav_len, 4);
+
+    fseek(d->wav, 0, SEEK_SET);
+    if (fwrite(hdr, 1, sizeof(hdr), d->wav) != sizeof(hdr)) {
+        return -1;
+    }
+    fseek(d->wav, 0, SEEK_END);
+    return 0;
+}
+
+static void open_wav(ao_dev_t *d)
+{
+    const char *path = getenv(MI_ENV_WAV);
+
+    if (!path || !path[0] || d->wav) {
+        return;
+    }
+
+    d->wav_len = 0;
+    d->wav = fopen(path, "wb");
+    if (d->wav) {
+        write_wav_header(d);
+    }
+}
+
+static void close_wav(ao_dev_t *d)
+{
+    if (d->wav) {
+        write_wav_header(d);
+        fclose(d->wav);
+        d->wav = NULL;
+    }
+}
+
+MI_S32 MI_AO_SetPubAttr(MI_AUDIO_DEV AoDevId, MI_AUDIO_Attr_t *pstAttr)
+{
+    if ((AoDevId < 0) || (AoDevId >= MI_AO_DEV_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_DEVID;
+    }
+
+    if (!pstAttr) {
+        return MI_AO_ERR_NULL_PTR;
+    }
+
+    if (ao[AoDevId].enable) {
+        return MI_AO_ERR_NOT_PERM;
+    }
+
+    if (pstAttr->eBitwidth != E_MI_AUDIO_BIT_WIDTH_16) {
+        return MI_AO_ERR_NOT_SUPPORT;
+    }
+
+    if (!is_rate_valid(pstAttr->eSamplerate) ||
+        (pstAttr->eSoundmode >= E_MI_AUDIO_SOUND_MODE_QUEUE) ||
+        !pstAttr->u32PtNumPerFrm)
+    {
+        return MI_AO_ERR_ILLEGAL_PARAM;
+    }
+
+    ao[AoDevId].cfg = 1;
+    ao[AoDevId].attr = *pstAttr;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_AO_GetPubAttr(MI_AUDIO_DEV AoDevId, MI_AUDIO_Attr_t *pstAttr)
+{
+    if ((AoDevId < 0) || (AoDevId >= MI_AO_DEV_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_DEVID;
+    }
+
+    if (!pstAttr) {
+        return MI_AO_ERR_NULL_PTR;
+    }
+
+    if (!ao[AoDevId].cfg) {
+        return MI_AO_ERR_NOT_CONFIG;
+    }
+
+    *pstAttr = ao[AoDevId].attr;
+    return MI_SUCCESS;
+}
+
+#if defined(UT)
+TEST(mi_ao, MI_AO_SetPubAttr)
+{
+    MI_AUDIO_Attr_t attr = { 0 };
+    MI_AUDIO_Attr_t get = { 0 };
+
+    ut_attr(&attr);
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_INVALID_DEVID, MI_AO_SetPubAttr(MI_AO_DEV_NUM_MAX, &attr));
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_NULL_PTR, MI_AO_SetPubAttr(0, NULL));
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_NOT_CONFIG, MI_AO_GetPubAttr(0, &get));
+
+    attr.eSamplerate = 44000;
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_ILLEGAL_PARAM, MI_AO_SetPubAttr(0, &attr));
+    attr.eSamplerate = E_MI_AUDIO_SAMPLE_RATE_48000;
+    attr.eBitwidth = E_MI_AUDIO_BIT_WIDTH_24;
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_NOT_SUPPORT, MI_AO_SetPubAttr(0, &attr));
+    attr.eBitwidth = E_MI_AUDIO_BIT_WIDTH_16;
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_SetPubAttr(0, &attr));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_GetPubAttr(0, &get));
+    TEST_ASSERT_EQUAL_INT(48000, get.eSamplerate);
+    TEST_ASSERT_EQUAL_INT(480, get.u32PtNumPerFrm);
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_Enable(0));
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_NOT_PERM, MI_AO_SetPubAttr(0, &attr));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_Disable(0));
+}
+#endif
+
+MI_S32 MI_AO_Enable(MI_AUDIO_DEV AoDevId)
+{
+    if ((AoDevId < 0) || (AoDevId >= MI_AO_DEV_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_DEVID;
+    }
+
+    if (!ao[AoDevId].cfg) {
+        return MI_AO_ERR_NOT_CONFIG;
+    }
+
+    ao[AoDevId].enable = 1;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_AO_Disable(MI_AUDIO_DEV AoDevId)
+{
+    if ((AoDevId < 0) || (AoDevId >= MI_AO_DEV_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_DEVID;
+    }
+
+    close_wav(&ao[AoDevId]);
+    ao[AoDevId].chn = 0;
+    ao[AoDevId].enable = 0;
+    ao[AoDevId].started = 0;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_AO_EnableChn(MI_AUDIO_DEV AoDevId, MI_AO_CHN AoChn)
+{
+    if ((AoDevId < 0) || (AoDevId >= MI_AO_DEV_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_DEVID;
+    }
+
+    if ((AoChn < 0) || (AoChn >= MI_AO_CHAN_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_CHNID;
+    }
+
+    if (!ao[AoDevId].enable) {
+        return MI_AO_ERR_NOT_ENABLED;
+    }
+
+    ao[AoDevId].chn = 1;
+    ao[AoDevId].started = 0;
+    open_wav(&ao[AoDevId]);
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_AO_DisableChn(MI_AUDIO_DEV AoDevId, MI_AO_CHN AoChn)
+{
+    if ((AoDevId < 0) || (AoDevId >= MI_AO_DEV_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_DEVID;
+    }
+
+    if ((AoChn < 0) || (AoChn >= MI_AO_CHAN_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_CHNID;
+    }
+
+    close_wav(&ao[AoDevId]);
+    ao[AoDevId].chn = 0;
+    return MI_SUCCESS;
+}
+
+#if defined(UT)
+TEST(mi_ao, MI_AO_Enable)
+{
+    MI_AUDIO_Attr_t attr = { 0 };
+
+    ut_attr(&attr);
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_INVALID_DEVID, MI_AO_Enable(-1));
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_NOT_CONFIG, MI_AO_Enable(0));
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_NOT_ENABLED, MI_AO_EnableChn(0, 0));
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_SetPubAttr(0, &attr));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_Enable(0));
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_INVALID_CHNID, MI_AO_EnableChn(0, MI_AO_CHAN_NUM_MAX));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_EnableChn(0, 0));
+    TEST_ASSERT_EQUAL_INT(1, ao[0].chn);
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_DisableChn(0, 0));
+    TEST_ASSERT_EQUAL_INT(0, ao[0].chn);
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_Disable(0));
+    TEST_ASSERT_EQUAL_INT(0, ao[0].enable);
+}
+#endif
+
+static void apply_gain(ao_dev_t *d, int16_t *buf, int cnt)
+{
+    int cc = 0;
+    float gain = powf(10.0f, (float)d->vol / 20.0f);
+
+    for (cc = 0; cc < cnt; cc++) {
+        float v = d->mute ? 0 : (buf[cc] * gain);
+
+        buf[cc] = (v > 32767) ? 32767 : ((v < -32768) ? -32768 : (int16_t)v);
+    }
+}
+
+#if defined(UT)
+TEST(mi_ao, apply_gain)
+{
+    ao_dev_t d = { 0 };
+    int16_t buf[] = { 1000, -1000, 30000 };
+
+    apply_gain(&d, buf, 3);
+    TEST_ASSERT_EQUAL_INT16(1000, buf[0]);
+    TEST_ASSERT_EQUAL_INT16(-1000, buf[1]);
+
+    d.vol = 6;
+    apply_gain(&d, buf, 3);
+    TEST_ASSERT_INT16_WITHIN(5, 1995, buf[0]);
+    TEST_ASSERT_INT16_WITHIN(5, -1995, buf[1]);
+    TEST_ASSERT_EQUAL_INT16(32767, buf[2]);
+
+    d.mute = 1;
+    apply_gain(&d, buf, 3);
+    TEST_ASSERT_EQUAL_INT16(0, buf[0]);
+}
+#endif
+
+static MI_S32 play_frame(ao_dev_t *d, const MI_AUDIO_Frame_t *frm, MI_S32 ms)
+{
+    uint64_t now = mi_now();
+    uint64_t wait = 0;
+    uint64_t rate = d->attr.eSamplerate;
+    uint64_t bps = rate * get_channels(&d->attr) * 2;
+    uint64_t dur = ((uint64_t)frm->u32Len * 1000000000ULL) / bps;
+    uint64_t depth = ((uint64_t)d->attr.u32PtNumPerFrm * (d->attr.u32FrmNum ? d->attr.u32FrmNum : 1) * 1000000000ULL) / rate;
+
+    if (!d->started) {
+        d->started = 1;
+        d->play_end = now;
+    }
+    else if (d->play_end < now) {
+        // I2S ran dry before this frame came in
+        mi_stat.ao_underrun += 1;
+        d->play_end = now;
+    }
+
+    if ((d->play_end + dur) > (now + depth)) {
+        wait = (d->play_end + dur) - (now + depth);
+        if ((ms >= 0) && (wait > ((uint64_t)ms * 1000000ULL))) {
+            mi_delay((uint64_t)ms * 1000000ULL);
+            mi_stat.ao_drop += 1;
+            return MI_AO_ERR_BUF_FULL;
+        }
+        mi_delay(wait);
+        mi_stat.ao_block_ns += wait;
+    }
+
+    d->play_end += dur;
+    mi_stat.ao_frame += 1;
+    mi_stat.ao_byte += frm->u32Len;
+    return MI_SUCCESS;
+}
+
+static void write_wav(ao_dev_t *d, const MI_AUDIO_Frame_t *frm)
+{
+    int16_t *buf = NULL;
+
+    if (!d->wav) {
+        return;
+    }
+
+    buf = malloc(frm->u32Len);
+    if (!buf) {
+        return;
+    }
+
+    memcpy(buf, frm->apVirAddr[0], frm->u32Len);
+    apply_gain(d, buf, frm->u32Len / sizeof(int16_t));
+    if (fwrite(buf, 1, frm->u32Len, d->wav) == frm->u32Len) {
+        d->wav_len += frm->u32Len;
+    }
+    free(buf);
+}
+
+MI_S32 MI_AO_SendFrame(MI_AUDIO_DEV AoDevId, MI_AO_CHN AoChn, MI_AUDIO_Frame_t *pstData, MI_S32 s32MilliSec)
+{
+    MI_S32 r = MI_SUCCESS;
+    ao_dev_t *d = NULL;
+
+    if ((AoDevId < 0) || (AoDevId >= MI_AO_DEV_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_DEVID;
+    }
+
+    if ((AoChn < 0) || (AoChn >= MI_AO_CHAN_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_CHNID;
+    }
+
+    if (!pstData || !pstData->apVirAddr[0]) {
+        return MI_AO_ERR_NULL_PTR;
+    }
+
+    d = &ao[AoDevId];
+    if (!d->enable || !d->chn) {
+        return MI_AO_ERR_NOT_ENABLED;
+    }
+
+    // interleaved samples in the first buffer, whole sample frames only
+    if ((pstData->eBitwidth != d->attr.eBitwidth) ||
+        (pstData->eSoundmode != d->attr.eSoundmode) ||
+        !pstData->u32Len ||
+        (pstData->u32Len % (get_channels(&d->attr) * 2)))
+    {
+        return MI_AO_ERR_ILLEGAL_PARAM;
+    }
+
+    r = play_frame(d, pstData, s32MilliSec);
+    if (r == MI_SUCCESS) {
+        write_wav(d, pstData);
+    }
+    return r;
+}
+
+#if defined(UT)
+TEST(mi_ao, MI_AO_SendFrame)
+{
+    int cc = 0;
+    FILE *f = NULL;
+    uint8_t hdr[AO_WAV_HDR] = { 0 };
+    int16_t pcm[480 * 2] = { 0 };
+    MI_AUDIO_Attr_t attr = { 0 };
+    MI_AUDIO_Frame_t frm = { 0 };
+
+    ut_attr(&attr);
+    for (cc = 0; cc < (sizeof(pcm) / sizeof(pcm[0])); cc++) {
+        pcm[cc] = cc;
+    }
+    frm.eBitwidth = E_MI_AUDIO_BIT_WIDTH_16;
+    frm.eSoundmode = E_MI_AUDIO_SOUND_MODE_STEREO;
+    frm.apVirAddr[0] = pcm;
+    frm.u32Len = sizeof(pcm);
+
+    setenv(MI_ENV_WAV, UT_WAV, 1);
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_NULL_PTR, MI_AO_SendFrame(0, 0, NULL, -1));
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_NOT_ENABLED, MI_AO_SendFrame(0, 0, &frm, -1));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_SetPubAttr(0, &attr));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_Enable(0));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_EnableChn(0, 0));
+
+    frm.u32Len = 6;
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_ILLEGAL_PARAM, MI_AO_SendFrame(0, 0, &frm, -1));
+    frm.u32Len = sizeof(pcm);
+
+    // 6 frames of 10ms fit in the queue, the 7th has to wait for the I2S
+    for (cc = 0; cc < 6; cc++) {
+        TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_SendFrame(0, 0, &frm, 0));
+    }
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_BUF_FULL, MI_AO_SendFrame(0, 0, &frm, 0));
+    TEST_ASSERT_EQUAL_INT(1, mi_stat.ao_drop);
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_SendFrame(0, 0, &frm, -1));
+    TEST_ASSERT_TRUE(mi_stat.ao_block_ns > 0);
+    TEST_ASSERT_EQUAL_INT(7, mi_stat.ao_frame);
+    TEST_ASSERT_EQUAL_UINT64(7 * sizeof(pcm), mi_stat.ao_byte);
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_DisableChn(0, 0));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_Disable(0));
+
+    f = fopen(UT_WAV, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL_INT(sizeof(hdr), fread(hdr, 1, sizeof(hdr), f));
+    TEST_ASSERT_EQUAL_MEMORY("RIFF", hdr, 4);
+    TEST_ASSERT_EQUAL_MEMORY("data", &hdr[36], 4);
+    TEST_ASSERT_EQUAL_UINT32(7 * sizeof(pcm), hdr[40] | (hdr[41] << 8) | (hdr[42] << 16) | (hdr[43] << 24));
+    TEST_ASSERT_EQUAL_UINT32(48000, hdr[24] | (hdr[25] << 8) | (hdr[26] << 16));
+    TEST_ASSERT_EQUAL_INT(sizeof(pcm[0]), fread(&pcm[0], 1, sizeof(pcm[0]), f));
+    TEST_ASSERT_EQUAL_INT(sizeof(pcm[0]), fread(&pcm[0], 1, sizeof(pcm[0]), f));
+    TEST_ASSERT_EQUAL_INT16(1, pcm[0]);
+    fclose(f);
+}
+#endif
+
+MI_S32 MI_AO_SetVolume(MI_AUDIO_DEV AoDevId, MI_S32 s32VolumeDb)
+{
+    if ((AoDevId < 0) || (AoDevId >= MI_AO_DEV_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_DEVID;
+    }
+
+    if ((s32VolumeDb < AO_MIN_VOL) || (s32VolumeDb > AO_MAX_VOL)) {
+        return MI_AO_ERR_ILLEGAL_PARAM;
+    }
+
+    ao[AoDevId].vol = s32VolumeDb;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_AO_GetVolume(MI_AUDIO_DEV AoDevId, MI_S32 *ps32VolumeDb)
+{
+    if ((AoDevId < 0) || (AoDevId >= MI_AO_DEV_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_DEVID;
+    }
+
+    if (!ps32VolumeDb) {
+        return MI_AO_ERR_NULL_PTR;
+    }
+
+    *ps32VolumeDb = ao[AoDevId].vol;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_AO_SetMute(MI_AUDIO_DEV AoDevId, MI_BOOL bEnable)
+{
+    if ((AoDevId < 0) || (AoDevId >= MI_AO_DEV_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_DEVID;
+    }
+
+    ao[AoDevId].mute = bEnable ? 1 : 0;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_AO_GetMute(MI_AUDIO_DEV AoDevId, MI_BOOL *pbEnable)
+{
+    if ((AoDevId < 0) || (AoDevId >= MI_AO_DEV_NUM_MAX)) {
+        return MI_AO_ERR_INVALID_DEVID;
+    }
+
+    if (!pbEnable) {
+        return MI_AO_ERR_NULL_PTR;
+    }
+
+    *pbEnable = ao[AoDevId].mute ? TRUE : FALSE;
+    return MI_SUCCESS;
+}
+
+#if defined(UT)
+TEST(mi_ao, MI_AO_SetVolume)
+{
+    MI_S32 vol = 0;
+    MI_BOOL mute = FALSE;
+
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_ILLEGAL_PARAM, MI_AO_SetVolume(0, AO_MAX_VOL + 1));
+    TEST_ASSERT_EQUAL_INT(MI_AO_ERR_NULL_PTR, MI_AO_GetVolume(0, NULL));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_SetVolume(0, -10));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_GetVolume(0, &vol));
+    TEST_ASSERT_EQUAL_INT(-10, vol);
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_SetMute(0, TRUE));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_AO_GetMute(0, &mute));
+    TEST_ASSERT_EQUAL_INT(TRUE, mute);
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(mi_ao)
+{
+    RUN_TEST_CASE(mi_ao, is_rate_valid);
+    RUN_TEST_CASE(mi_ao, MI_AO_SetPubAttr);
+    RUN_TEST_CASE(mi_ao, MI_AO_Enable);
+    RUN_TEST_CASE(mi_ao, apply_gain);
+    RUN_TEST_CASE(mi_ao, MI_AO_SendFrame);
+    RUN_TEST_CASE(mi_ao, MI_AO_SetVolume);
+}
+#endif
+
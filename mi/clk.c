@@ -0,0 +1,173 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "mi.h"
+
+// Everything here runs in host time. Costs are always accounted in
+// mi_stat, they are only slept for when realtime is enabled (MI_REALTIME=1
+// or mi_set_realtime()), which is what the benchmarks want
+
+mi_stat_t mi_stat = { 0 };
+static int realtime = -1;
+
+#if defined(UT)
+TEST_GROUP(mi_clk);
+
+TEST_SETUP(mi_clk)
+{
+    mi_reset_stat();
+}
+
+TEST_TEAR_DOWN(mi_clk)
+{
+    mi_set_realtime(0);
+}
+#endif
+
+uint64_t mi_now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+#if defined(UT)
+TEST(mi_clk, mi_now)
+{
+    uint64_t t0 = mi_now();
+
+    TEST_ASSERT_TRUE(t0 > 0);
+    TEST_ASSERT_TRUE(mi_now() >= t0);
+}
+#endif
+
+uint64_t mi_cost(uint64_t bytes, uint32_t mbps)
+{
+    if (!mbps) {
+        return 0;
+    }
+    return (bytes * 1000) / mbps;
+}
+
+#if defined(UT)
+TEST(mi_clk, mi_cost)
+{
+    TEST_ASSERT_EQUAL_UINT64(0, mi_cost(1000, 0));
+    TEST_ASSERT_EQUAL_UINT64(1000000, mi_cost(1000000, 1000));
+    TEST_ASSERT_EQUAL_UINT64(2048000, mi_cost(640 * 480 * 4, 600));
+}
+#endif
+
+static int is_realtime(void)
+{
+    const char *env = NULL;
+
+    if (realtime < 0) {
+        env = getenv(MI_ENV_REALTIME);
+        realtime = (env && (atoi(env) > 0)) ? 1 : 0;
+    }
+    return realtime;
+}
+
+int mi_set_realtime(int enable)
+{
+    realtime = enable ? 1 : 0;
+    return 0;
+}
+
+int mi_delay(uint64_t ns)
+{
+    struct timespec ts = { 0 };
+
+    if (!ns || !is_realtime()) {
+        return 0;
+    }
+
+    ts.tv_sec = ns / 1000000000ULL;
+    ts.tv_nsec = ns % 1000000000ULL;
+    while (nanosleep(&ts, &ts) < 0);
+    return 1;
+}
+
+#if defined(UT)
+TEST(mi_clk, mi_delay)
+{
+    uint64_t t0 = 0;
+
+    mi_set_realtime(0);
+    TEST_ASSERT_EQUAL_INT(0, mi_delay(1000000000ULL));
+
+    mi_set_realtime(1);
+    TEST_ASSERT_EQUAL_INT(0, mi_delay(0));
+    t0 = mi_now();
+    TEST_ASSERT_EQUAL_INT(1, mi_delay(2000000));
+    TEST_ASSERT_TRUE((mi_now() - t0) >= 2000000);
+}
+#endif
+
+int mi_get_stat(mi_stat_t *stat)
+{
+    if (!stat) {
+        return -1;
+    }
+
+    *stat = mi_stat;
+    return 0;
+}
+
+int mi_reset_stat(void)
+{
+    memset(&mi_stat, 0, sizeof(mi_stat));
+    return 0;
+}
+
+#if defined(UT)
+TEST(mi_clk, mi_get_stat)
+{
+    mi_stat_t s = { 0 };
+
+    mi_stat.gfx_job = 3;
+    TEST_ASSERT_EQUAL_INT(-1, mi_get_stat(NULL));
+    TEST_ASSERT_EQUAL_INT(0, mi_get_stat(&s));
+    TEST_ASSERT_EQUAL_INT(3, s.gfx_job);
+    TEST_ASSERT_EQUAL_INT(0, mi_reset_stat());
+    TEST_ASSERT_EQUAL_INT(0, mi_stat.gfx_job);
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(mi_clk)
+{
+    RUN_TEST_CASE(mi_clk, mi_now);
+    RUN_TEST_CASE(mi_clk, mi_cost);
+    RUN_TEST_CASE(mi_clk, mi_delay);
+    RUN_TEST_CASE(mi_clk, mi_get_stat);
+}
+#endif
+
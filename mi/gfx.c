@@ -0,0 +1,758 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "mi.h"
+#include "mi_gfx.h"
+
+// Host stand-in of the SigmaStar 2D engine. Physical addresses are plain
+// host pointers. Jobs are only executed when a fence is waited on (or the
+// job ring is full), so code that forgets to wait reads stale pixels here
+// the same way it would on the device. Each job is also scheduled on a
+// modelled engine timeline (see mi.h), waiting on a fence that is still
+// in flight costs the remaining time
+
+#define GFX_MAX_JOB     256
+
+#define GFX_JOB_FILL    0
+#define GFX_JOB_BLIT    1
+
+typedef struct {
+    int type;
+    MI_U16 fence;
+    MI_U32 color;
+    uint64_t end;
+    MI_GFX_Surface_t src;
+    MI_GFX_Rect_t srt;
+    MI_GFX_Surface_t dst;
+    MI_GFX_Rect_t drt;
+    MI_GFX_Opt_t opt;
+} gfx_job_t;
+
+typedef struct {
+    int open;
+    int head;
+    int cnt;
+    MI_U16 fence;
+    MI_U16 done;
+    uint64_t busy;
+    MI_U8 threshold;
+    MI_GFX_Palette_t palette;
+    gfx_job_t job[GFX_MAX_JOB];
+} gfx_engine_t;
+
+static gfx_engine_t gfx = { 0 };
+
+#if defined(UT)
+TEST_GROUP(mi_gfx);
+
+TEST_SETUP(mi_gfx)
+{
+    memset(&gfx, 0, sizeof(gfx));
+    mi_reset_stat();
+}
+
+TEST_TEAR_DOWN(mi_gfx)
+{
+}
+#endif
+
+static int get_bpp(MI_GFX_ColorFmt_e fmt)
+{
+    switch (fmt) {
+    case E_MI_GFX_FMT_RGB565:
+    case E_MI_GFX_FMT_ARGB1555:
+    case E_MI_GFX_FMT_ARGB4444:
+        return 2;
+    case E_MI_GFX_FMT_ARGB8888:
+    case E_MI_GFX_FMT_ABGR8888:
+        return 4;
+    default:
+        break;
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(mi_gfx, get_bpp)
+{
+    TEST_ASSERT_EQUAL_INT(2, get_bpp(E_MI_GFX_FMT_RGB565));
+    TEST_ASSERT_EQUAL_INT(4, get_bpp(E_MI_GFX_FMT_ARGB8888));
+    TEST_ASSERT_EQUAL_INT(0, get_bpp(E_MI_GFX_FMT_YUV422));
+}
+#endif
+
+static uint32_t expand(uint32_t v, int bits)
+{
+    return (v << (8 - bits)) | (v >> ((2 * bits) - 8));
+}
+
+static uint32_t read_pixel(const MI_GFX_Surface_t *s, int x, int y)
+{
+    const uint8_t *p = (const uint8_t *)(uintptr_t)s->phyAddr + (y * s->u32Stride);
+    uint32_t v = 0;
+
+    switch (s->eColorFmt) {
+    case E_MI_GFX_FMT_RGB565:
+        v = ((const uint16_t *)p)[x];
+        return 0xff000000 |
+            (expand((v >> 11) & 0x1f, 5) << 16) |
+            (expand((v >> 5) & 0x3f, 6) << 8) |
+            expand(v & 0x1f, 5);
+    case E_MI_GFX_FMT_ARGB1555:
+        v = ((const uint16_t *)p)[x];
+        return ((v & 0x8000) ? 0xff000000 : 0) |
+            (expand((v >> 10) & 0x1f, 5) << 16) |
+            (expand((v >> 5) & 0x1f, 5) << 8) |
+            expand(v & 0x1f, 5);
+    case E_MI_GFX_FMT_ARGB4444:
+        v = ((const uint16_t *)p)[x];
+        return (((v >> 12) & 0xf) * 0x11000000) |
+            (((v >> 8) & 0xf) * 0x110000) |
+            (((v >> 4) & 0xf) * 0x1100) |
+            ((v & 0xf) * 0x11);
+    case E_MI_GFX_FMT_ABGR8888:
+        v = ((const uint32_t *)p)[x];
+        return (v & 0xff00ff00) | ((v >> 16) & 0xff) | ((v & 0xff) << 16);
+    default:
+        break;
+    }
+    return ((const uint32_t *)p)[x];
+}
+
+static void write_pixel(const MI_GFX_Surface_t *s, int x, int y, uint32_t v)
+{
+    uint8_t *p = (uint8_t *)(uintptr_t)s->phyAddr + (y * s->u32Stride);
+
+    switch (s->eColorFmt) {
+    case E_MI_GFX_FMT_RGB565:
+        ((uint16_t *)p)[x] = ((v >> 8) & 0xf800) | ((v >> 5) & 0x07e0) | ((v >> 3) & 0x001f);
+        break;
+    case E_MI_GFX_FMT_ARGB1555:
+        ((uint16_t *)p)[x] = ((v >> 16) & 0x8000) | ((v >> 9) & 0x7c00) | ((v >> 6) & 0x03e0) | ((v >> 3) & 0x001f);
+        break;
+    case E_MI_GFX_FMT_ARGB4444:
+        ((uint16_t *)p)[x] = ((v >> 16) & 0xf000) | ((v >> 12) & 0x0f00) | ((v >> 8) & 0x00f0) | ((v >> 4) & 0x000f);
+        break;
+    case E_MI_GFX_FMT_ABGR8888:
+        ((uint32_t *)p)[x] = (v & 0xff00ff00) | ((v >> 16) & 0xff) | ((v & 0xff) << 16);
+        break;
+    default:
+        ((uint32_t *)p)[x] = v;
+        break;
+    }
+}
+
+#if defined(UT)
+TEST(mi_gfx, read_write_pixel)
+{
+    uint32_t buf[2] = { 0 };
+    MI_GFX_Surface_t s = { 0 };
+
+    s.phyAddr = (uintptr_t)buf;
+    s.u32Width = 2;
+    s.u32Height = 1;
+    s.u32Stride = sizeof(buf);
+
+    s.eColorFmt = E_MI_GFX_FMT_ARGB8888;
+    write_pixel(&s, 1, 0, 0x80112233);
+    TEST_ASSERT_EQUAL_HEX32(0x80112233, buf[1]);
+    TEST_ASSERT_EQUAL_HEX32(0x80112233, read_pixel(&s, 1, 0));
+
+    s.eColorFmt = E_MI_GFX_FMT_ABGR8888;
+    write_pixel(&s, 0, 0, 0x80112233);
+    TEST_ASSERT_EQUAL_HEX32(0x80332211, buf[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x80112233, read_pixel(&s, 0, 0));
+
+    s.eColorFmt = E_MI_GFX_FMT_RGB565;
+    write_pixel(&s, 0, 0, 0x00ff00ff);
+    TEST_ASSERT_EQUAL_HEX16(0xf81f, ((uint16_t *)buf)[0]);
+    TEST_ASSERT_EQUAL_HEX32(0xffff00ff, read_pixel(&s, 0, 0));
+
+    s.eColorFmt = E_MI_GFX_FMT_ARGB1555;
+    write_pixel(&s, 0, 0, 0x80ff0000);
+    TEST_ASSERT_EQUAL_HEX16(0xfc00, ((uint16_t *)buf)[0]);
+
+    s.eColorFmt = E_MI_GFX_FMT_ARGB4444;
+    write_pixel(&s, 0, 0, 0xf0a0b0c0);
+    TEST_ASSERT_EQUAL_HEX32(0xffaabbcc, read_pixel(&s, 0, 0));
+}
+#endif
+
+static uint32_t get_factor(MI_GFX_DfbBldOp_e op, uint32_t sa, uint32_t da)
+{
+    switch (op) {
+    case E_MI_GFX_DFB_BLD_ONE:
+        return 255;
+    case E_MI_GFX_DFB_BLD_SRCALPHA:
+        return sa;
+    case E_MI_GFX_DFB_BLD_INVSRCALPHA:
+        return 255 - sa;
+    case E_MI_GFX_DFB_BLD_DESTALPHA:
+        return da;
+    case E_MI_GFX_DFB_BLD_INVDESTALPHA:
+        return 255 - da;
+    default:
+        break;
+    }
+    return 0;
+}
+
+static int is_copy(const MI_GFX_Opt_t *opt)
+{
+    return (opt->eSrcDfbBldOp == E_MI_GFX_DFB_BLD_ONE) &&
+        (opt->eDstDfbBldOp == E_MI_GFX_DFB_BLD_ZERO) &&
+        !(opt->eDFBBlendFlag & E_MI_GFX_DFB_BLEND_SRC_PREMULTIPLY);
+}
+
+static uint32_t blend_pixel(uint32_t s, uint32_t d, const MI_GFX_Opt_t *opt)
+{
+    int cc = 0;
+    uint32_t r = 0;
+    uint32_t sa = 255;
+    uint32_t da = d >> 24;
+    uint32_t sf = 0;
+    uint32_t df = 0;
+    uint32_t flag = opt->eDFBBlendFlag;
+
+    // plain copy unless the caller asked for blending
+    if (is_copy(opt)) {
+        return s;
+    }
+
+    if (flag & E_MI_GFX_DFB_BLEND_ALPHACHANNEL) {
+        sa = s >> 24;
+    }
+
+    if (flag & E_MI_GFX_DFB_BLEND_COLORALPHA) {
+        sa = (sa * (opt->u32GlobalSrcConstColor >> 24)) / 255;
+    }
+
+    if (flag & E_MI_GFX_DFB_BLEND_SRC_PREMULTIPLY) {
+        for (cc = 0; cc < 24; cc += 8) {
+            uint32_t c = (((s >> cc) & 0xff) * sa) / 255;
+
+            s = (s & ~(0xff << cc)) | (c << cc);
+        }
+    }
+    s = (s & 0x00ffffff) | (sa << 24);
+
+    sf = get_factor(opt->eSrcDfbBldOp, sa, da);
+    df = get_factor(opt->eDstDfbBldOp, sa, da);
+    for (cc = 0; cc < 32; cc += 8) {
+        uint32_t c = ((((s >> cc) & 0xff) * sf) + (((d >> cc) & 0xff) * df)) / 255;
+
+        r |= ((c > 255) ? 255 : c) << cc;
+    }
+    return r;
+}
+
+#if defined(UT)
+TEST(mi_gfx, blend_pixel)
+{
+    MI_GFX_Opt_t opt = { 0 };
+
+    opt.eSrcDfbBldOp = E_MI_GFX_DFB_BLD_ONE;
+    TEST_ASSERT_EQUAL_HEX32(0x11223344, blend_pixel(0x11223344, 0xffffffff, &opt));
+
+    opt.eSrcDfbBldOp = E_MI_GFX_DFB_BLD_SRCALPHA;
+    opt.eDstDfbBldOp = E_MI_GFX_DFB_BLD_INVSRCALPHA;
+    opt.eDFBBlendFlag = E_MI_GFX_DFB_BLEND_ALPHACHANNEL;
+    TEST_ASSERT_EQUAL_HEX32(0xffffffff, blend_pixel(0x00000000, 0xffffffff, &opt));
+    TEST_ASSERT_EQUAL_HEX32(0xff102030, blend_pixel(0xff102030, 0xffffffff, &opt));
+
+    opt.eSrcDfbBldOp = E_MI_GFX_DFB_BLD_ONE;
+    opt.eDFBBlendFlag = E_MI_GFX_DFB_BLEND_SRC_PREMULTIPLY | E_MI_GFX_DFB_BLEND_COLORALPHA | E_MI_GFX_DFB_BLEND_ALPHACHANNEL;
+    opt.u32GlobalSrcConstColor = 0xff000000;
+    TEST_ASSERT_EQUAL_HEX32(0xff808080, blend_pixel(0x80ffffff, 0xff000000, &opt));
+}
+#endif
+
+static void get_src_pos(const gfx_job_t *j, int dx, int dy, int *sx, int *sy)
+{
+    int x = 0;
+    int y = 0;
+    int sw = j->srt.u32Width;
+    int sh = j->srt.u32Height;
+    int dw = j->drt.u32Width;
+    int dh = j->drt.u32Height;
+
+    // rotation is clockwise, the source rect is scaled onto the rotated dst rect
+    switch (j->opt.eRotate) {
+    case E_MI_GFX_ROTATE_90:
+        x = (dy * sw) / dh;
+        y = ((dw - 1 - dx) * sh) / dw;
+        break;
+    case E_MI_GFX_ROTATE_180:
+        x = ((dw - 1 - dx) * sw) / dw;
+        y = ((dh - 1 - dy) * sh) / dh;
+        break;
+    case E_MI_GFX_ROTATE_270:
+        x = ((dh - 1 - dy) * sw) / dh;
+        y = (dx * sh) / dw;
+        break;
+    default:
+        x = (dx * sw) / dw;
+        y = (dy * sh) / dh;
+        break;
+    }
+
+    if (j->opt.eMirror & E_MI_GFX_MIRROR_HORIZONTAL) {
+        x = sw - 1 - x;
+    }
+
+    if (j->opt.eMirror & E_MI_GFX_MIRROR_VERTICAL) {
+        y = sh - 1 - y;
+    }
+
+    *sx = j->srt.s32Xpos + x;
+    *sy = j->srt.s32Ypos + y;
+}
+
+static void run_job(const gfx_job_t *j)
+{
+    int x = 0;
+    int y = 0;
+    int sx = 0;
+    int sy = 0;
+
+    for (y = 0; y < (int)j->drt.u32Height; y++) {
+        int dy = j->drt.s32Ypos + y;
+
+        for (x = 0; x < (int)j->drt.u32Width; x++) {
+            int dx = j->drt.s32Xpos + x;
+
+            if (j->type == GFX_JOB_FILL) {
+                write_pixel(&j->dst, dx, dy, j->color);
+                continue;
+            }
+
+            get_src_pos(j, x, y, &sx, &sy);
+            write_pixel(&j->dst, dx, dy, blend_pixel(read_pixel(&j->src, sx, sy), read_pixel(&j->dst, dx, dy), &j->opt));
+        }
+    }
+}
+
+static int is_fence_done(MI_U16 fence)
+{
+    return ((int16_t)(gfx.done - fence)) >= 0;
+}
+
+static uint64_t get_job_cost(const gfx_job_t *j)
+{
+    uint64_t px = (uint64_t)j->drt.u32Width * j->drt.u32Height;
+    uint64_t bytes = px * get_bpp(j->dst.eColorFmt);
+
+    if (j->type == GFX_JOB_BLIT) {
+        bytes += (uint64_t)j->srt.u32Width * j->srt.u32Height * get_bpp(j->src.eColorFmt);
+        if (!is_copy(&j->opt)) {
+            // read-modify-write of the destination
+            bytes += px * get_bpp(j->dst.eColorFmt);
+        }
+    }
+
+    mi_stat.gfx_byte += bytes;
+    return MI_GFX_SETUP_NS + mi_cost(bytes, MI_GFX_BW_MBPS);
+}
+
+#if defined(UT)
+TEST(mi_gfx, get_job_cost)
+{
+    gfx_job_t j = { 0 };
+
+    j.type = GFX_JOB_FILL;
+    j.dst.eColorFmt = E_MI_GFX_FMT_ARGB8888;
+    j.drt.u32Width = 100;
+    j.drt.u32Height = 10;
+    TEST_ASSERT_EQUAL_UINT64(MI_GFX_SETUP_NS + mi_cost(4000, MI_GFX_BW_MBPS), get_job_cost(&j));
+
+    j.type = GFX_JOB_BLIT;
+    j.src.eColorFmt = E_MI_GFX_FMT_RGB565;
+    j.srt.u32Width = 100;
+    j.srt.u32Height = 10;
+    j.opt.eSrcDfbBldOp = E_MI_GFX_DFB_BLD_ONE;
+    TEST_ASSERT_EQUAL_UINT64(MI_GFX_SETUP_NS + mi_cost(6000, MI_GFX_BW_MBPS), get_job_cost(&j));
+
+    j.opt.eDstDfbBldOp = E_MI_GFX_DFB_BLD_INVSRCALPHA;
+    TEST_ASSERT_EQUAL_UINT64(MI_GFX_SETUP_NS + mi_cost(10000, MI_GFX_BW_MBPS), get_job_cost(&j));
+}
+#endif
+
+static uint64_t retire_job(void)
+{
+    const gfx_job_t *j = &gfx.job[gfx.head];
+
+    run_job(j);
+    gfx.done = j->fence;
+    gfx.head = (gfx.head + 1) % GFX_MAX_JOB;
+    gfx.cnt -= 1;
+    return j->end;
+}
+
+// t0 is when the caller started waiting, the software blit itself eats
+// into the modelled time so only what is left of it is slept
+static void wait_engine(uint64_t t0, uint64_t end)
+{
+    uint64_t now = mi_now();
+
+    if (end > t0) {
+        mi_stat.gfx_wait_ns += end - t0;
+    }
+
+    if (end > now) {
+        mi_delay(end - now);
+    }
+}
+
+static int is_rect_valid(const MI_GFX_Surface_t *s, const MI_GFX_Rect_t *rt)
+{
+    if (!s || !rt || !s->phyAddr || !get_bpp(s->eColorFmt)) {
+        return 0;
+    }
+
+    if ((rt->s32Xpos < 0) || (rt->s32Ypos < 0) || !rt->u32Width || !rt->u32Height) {
+        return 0;
+    }
+
+    if (((rt->s32Xpos + rt->u32Width) > s->u32Width) || ((rt->s32Ypos + rt->u32Height) > s->u32Height)) {
+        return 0;
+    }
+    return (s->u32Stride >= (s->u32Width * get_bpp(s->eColorFmt))) ? 1 : 0;
+}
+
+static MI_S32 add_job(const gfx_job_t *j, MI_U16 *fence)
+{
+    gfx_job_t *q = NULL;
+    uint64_t now = mi_now();
+    uint64_t cost = 0;
+
+    if (!gfx.open) {
+        return MI_ERR_GFX_NOT_INIT;
+    }
+
+    if (gfx.cnt >= GFX_MAX_JOB) {
+        // command queue is full, the caller stalls until the oldest job is out
+        wait_engine(now, retire_job());
+    }
+
+    cost = get_job_cost(j);
+    gfx.busy = ((gfx.busy > now) ? gfx.busy : now) + cost;
+    gfx.fence += 1;
+
+    q = &gfx.job[(gfx.head + gfx.cnt) % GFX_MAX_JOB];
+    *q = *j;
+    q->fence = gfx.fence;
+    q->end = gfx.busy;
+    gfx.cnt += 1;
+
+    mi_stat.gfx_job += 1;
+    mi_stat.gfx_busy_ns += cost;
+
+    if (fence) {
+        *fence = gfx.fence;
+    }
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_GFX_Open(void)
+{
+    gfx.open = 1;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_GFX_Close(void)
+{
+    while (gfx.cnt) {
+        retire_job();
+    }
+    gfx.open = 0;
+    return MI_SUCCESS;
+}
+
+#if defined(UT)
+TEST(mi_gfx, MI_GFX_Open)
+{
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_Open());
+    TEST_ASSERT_EQUAL_INT(1, gfx.open);
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_Close());
+    TEST_ASSERT_EQUAL_INT(0, gfx.open);
+}
+#endif
+
+MI_S32 MI_GFX_WaitAllDone(MI_BOOL bWaitAllDone, MI_U16 u16TargetFence)
+{
+    uint64_t end = 0;
+    uint64_t t0 = mi_now();
+
+    if (!gfx.open) {
+        return MI_ERR_GFX_NOT_INIT;
+    }
+
+    while (gfx.cnt && (bWaitAllDone || !is_fence_done(u16TargetFence))) {
+        end = retire_job();
+    }
+    wait_engine(t0, end);
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_GFX_QuickFill(MI_GFX_Surface_t *pstDst, MI_GFX_Rect_t *pstDstRect, MI_U32 u32ColorVal, MI_U16 *pu16Fence)
+{
+    gfx_job_t j = { 0 };
+
+    if (!is_rect_valid(pstDst, pstDstRect)) {
+        return MI_ERR_GFX_INVALID_PARAM;
+    }
+
+    j.type = GFX_JOB_FILL;
+    j.dst = *pstDst;
+    j.drt = *pstDstRect;
+    j.color = u32ColorVal;
+    return add_job(&j, pu16Fence);
+}
+
+#if defined(UT)
+TEST(mi_gfx, MI_GFX_QuickFill)
+{
+    uint32_t buf[4][4] = { 0 };
+    MI_U16 fence = 0;
+    MI_GFX_Rect_t rt = { 1, 1, 2, 2 };
+    MI_GFX_Surface_t s = { 0 };
+
+    s.phyAddr = (uintptr_t)buf;
+    s.eColorFmt = E_MI_GFX_FMT_ARGB8888;
+    s.u32Width = 4;
+    s.u32Height = 4;
+    s.u32Stride = sizeof(buf[0]);
+
+    TEST_ASSERT_EQUAL_INT(MI_ERR_GFX_NOT_INIT, MI_GFX_QuickFill(&s, &rt, 0xff00ff00, &fence));
+    MI_GFX_Open();
+    TEST_ASSERT_EQUAL_INT(MI_ERR_GFX_INVALID_PARAM, MI_GFX_QuickFill(NULL, &rt, 0xff00ff00, &fence));
+    rt.s32Xpos = 3;
+    TEST_ASSERT_EQUAL_INT(MI_ERR_GFX_INVALID_PARAM, MI_GFX_QuickFill(&s, &rt, 0xff00ff00, &fence));
+    rt.s32Xpos = 1;
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_QuickFill(&s, &rt, 0xff00ff00, &fence));
+
+    // nothing lands before the fence is waited on
+    TEST_ASSERT_EQUAL_HEX32(0, buf[1][1]);
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_WaitAllDone(FALSE, fence));
+    TEST_ASSERT_EQUAL_HEX32(0xff00ff00, buf[1][1]);
+    TEST_ASSERT_EQUAL_HEX32(0xff00ff00, buf[2][2]);
+    TEST_ASSERT_EQUAL_HEX32(0, buf[3][3]);
+    TEST_ASSERT_EQUAL_INT(1, mi_stat.gfx_job);
+    TEST_ASSERT_TRUE(mi_stat.gfx_busy_ns >= MI_GFX_SETUP_NS);
+    MI_GFX_Close();
+}
+#endif
+
+MI_S32 MI_GFX_BitBlit(
+    MI_GFX_Surface_t *pstSrc,
+    MI_GFX_Rect_t *pstSrcRect,
+    MI_GFX_Surface_t *pstDst,
+    MI_GFX_Rect_t *pstDstRect,
+    MI_GFX_Opt_t *pstOpt,
+    MI_U16 *pu16Fence)
+{
+    gfx_job_t j = { 0 };
+
+    if (!is_rect_valid(pstSrc, pstSrcRect) || !is_rect_valid(pstDst, pstDstRect) || !pstOpt) {
+        return MI_ERR_GFX_INVALID_PARAM;
+    }
+
+    if (pstOpt->eRotate >= E_MI_GFX_ROTATE_MAX) {
+        return MI_ERR_GFX_DRV_NOT_SUPPORT;
+    }
+
+    j.type = GFX_JOB_BLIT;
+    j.src = *pstSrc;
+    j.srt = *pstSrcRect;
+    j.dst = *pstDst;
+    j.drt = *pstDstRect;
+    j.opt = *pstOpt;
+    return add_job(&j, pu16Fence);
+}
+
+#if defined(UT)
+TEST(mi_gfx, MI_GFX_BitBlit)
+{
+    uint16_t src[2][2] = { { 0xf800, 0x07e0 }, { 0x001f, 0xffff } };
+    uint32_t dst[4][4] = { 0 };
+    MI_U16 f0 = 0;
+    MI_U16 f1 = 0;
+    MI_GFX_Opt_t opt = { 0 };
+    MI_GFX_Rect_t srt = { 0, 0, 2, 2 };
+    MI_GFX_Rect_t drt = { 0, 0, 4, 4 };
+    MI_GFX_Surface_t s = { 0 };
+    MI_GFX_Surface_t d = { 0 };
+
+    s.phyAddr = (uintptr_t)src;
+    s.eColorFmt = E_MI_GFX_FMT_RGB565;
+    s.u32Width = 2;
+    s.u32Height = 2;
+    s.u32Stride = sizeof(src[0]);
+
+    d.phyAddr = (uintptr_t)dst;
+    d.eColorFmt = E_MI_GFX_FMT_ARGB8888;
+    d.u32Width = 4;
+    d.u32Height = 4;
+    d.u32Stride = sizeof(dst[0]);
+
+    MI_GFX_Open();
+    opt.eSrcDfbBldOp = E_MI_GFX_DFB_BLD_ONE;
+    TEST_ASSERT_EQUAL_INT(MI_ERR_GFX_INVALID_PARAM, MI_GFX_BitBlit(&s, &srt, &d, &drt, NULL, &f0));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_BitBlit(&s, &srt, &d, &drt, &opt, &f0));
+    TEST_ASSERT_EQUAL_HEX32(0, dst[0][0]);
+
+    // 2x upscale
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_WaitAllDone(FALSE, f0));
+    TEST_ASSERT_EQUAL_HEX32(0xffff0000, dst[0][0]);
+    TEST_ASSERT_EQUAL_HEX32(0xffff0000, dst[1][1]);
+    TEST_ASSERT_EQUAL_HEX32(0xff00ff00, dst[0][2]);
+    TEST_ASSERT_EQUAL_HEX32(0xff0000ff, dst[3][0]);
+    TEST_ASSERT_EQUAL_HEX32(0xffffffff, dst[3][3]);
+
+    // 180 degree rotation, as used for the upside down panel
+    drt.u32Width = 2;
+    drt.u32Height = 2;
+    opt.eRotate = E_MI_GFX_ROTATE_180;
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_BitBlit(&s, &srt, &d, &drt, &opt, &f0));
+
+    // 90 degree rotation into the next rect, queued behind the first one
+    drt.s32Xpos = 2;
+    opt.eRotate = E_MI_GFX_ROTATE_90;
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_BitBlit(&s, &srt, &d, &drt, &opt, &f1));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_WaitAllDone(FALSE, f0));
+    TEST_ASSERT_EQUAL_HEX32(0xffffffff, dst[0][0]);
+    TEST_ASSERT_EQUAL_HEX32(0xffff0000, dst[1][1]);
+    TEST_ASSERT_EQUAL_HEX32(0xff00ff00, dst[0][2]);
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_WaitAllDone(TRUE, 0));
+    TEST_ASSERT_EQUAL_HEX32(0xff0000ff, dst[0][2]);
+    TEST_ASSERT_EQUAL_HEX32(0xffff0000, dst[0][3]);
+    TEST_ASSERT_EQUAL_HEX32(0xffffffff, dst[1][2]);
+    TEST_ASSERT_EQUAL_HEX32(0xff00ff00, dst[1][3]);
+    MI_GFX_Close();
+}
+#endif
+
+#if defined(UT)
+TEST(mi_gfx, timing)
+{
+    int cc = 0;
+    MI_U16 fence = 0;
+    uint64_t t0 = 0;
+    uint64_t cost = 0;
+    uint32_t *buf = NULL;
+    MI_GFX_Rect_t rt = { 0, 0, 320, 240 };
+    MI_GFX_Surface_t s = { 0 };
+
+    buf = calloc(rt.u32Width * rt.u32Height, sizeof(uint32_t));
+    TEST_ASSERT_NOT_NULL(buf);
+    s.phyAddr = (uintptr_t)buf;
+    s.eColorFmt = E_MI_GFX_FMT_ARGB8888;
+    s.u32Width = rt.u32Width;
+    s.u32Height = rt.u32Height;
+    s.u32Stride = rt.u32Width * 4;
+
+    // back-to-back jobs queue up on the engine timeline
+    mi_set_realtime(1);
+    MI_GFX_Open();
+    t0 = mi_now();
+    for (cc = 0; cc < 3; cc++) {
+        TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_QuickFill(&s, &rt, cc, &fence));
+    }
+    cost = mi_stat.gfx_busy_ns;
+    TEST_ASSERT_EQUAL_UINT64(3 * (MI_GFX_SETUP_NS + mi_cost(320 * 240 * 4, MI_GFX_BW_MBPS)), cost);
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_WaitAllDone(FALSE, fence));
+    TEST_ASSERT_TRUE((mi_now() - t0) >= cost);
+    TEST_ASSERT_TRUE(mi_stat.gfx_wait_ns > 0);
+    TEST_ASSERT_EQUAL_HEX32(2, buf[0]);
+
+    // nothing in flight, nothing to wait for
+    mi_stat.gfx_wait_ns = 0;
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_WaitAllDone(TRUE, 0));
+    TEST_ASSERT_EQUAL_UINT64(0, mi_stat.gfx_wait_ns);
+
+    MI_GFX_Close();
+    mi_set_realtime(0);
+    free(buf);
+}
+#endif
+
+MI_S32 MI_GFX_GetAlphaThresholdValue(MI_U8 *pu8ThresholdValue)
+{
+    if (!pu8ThresholdValue) {
+        return MI_ERR_GFX_INVALID_PARAM;
+    }
+
+    *pu8ThresholdValue = gfx.threshold;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_GFX_SetAlphaThresholdValue(MI_U8 u8ThresholdValue)
+{
+    gfx.threshold = u8ThresholdValue;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_GFX_SetPalette(MI_GFX_ColorFmt_e eColorFmt, MI_GFX_Palette_t *pstPalette)
+{
+    if (!pstPalette) {
+        return MI_ERR_GFX_INVALID_PARAM;
+    }
+
+    gfx.palette = *pstPalette;
+    return MI_SUCCESS;
+}
+
+#if defined(UT)
+TEST(mi_gfx, MI_GFX_SetAlphaThresholdValue)
+{
+    MI_U8 v = 0;
+
+    TEST_ASSERT_EQUAL_INT(MI_ERR_GFX_INVALID_PARAM, MI_GFX_GetAlphaThresholdValue(NULL));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_SetAlphaThresholdValue(0x40));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_GetAlphaThresholdValue(&v));
+    TEST_ASSERT_EQUAL_INT(0x40, v);
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(mi_gfx)
+{
+    RUN_TEST_CASE(mi_gfx, get_bpp);
+    RUN_TEST_CASE(mi_gfx, read_write_pixel);
+    RUN_TEST_CASE(mi_gfx, blend_pixel);
+    RUN_TEST_CASE(mi_gfx, get_job_cost);
+    RUN_TEST_CASE(mi_gfx, MI_GFX_Open);
+    RUN_TEST_CASE(mi_gfx, MI_GFX_QuickFill);
+    RUN_TEST_CASE(mi_gfx, MI_GFX_BitBlit);
+    RUN_TEST_CASE(mi_gfx, timing);
+    RUN_TEST_CASE(mi_gfx, MI_GFX_SetAlphaThresholdValue);
+}
+#endif
+
@@ -0,0 +1,61 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+#ifndef __MI_H__
+#define __MI_H__
+
+#include <stdint.h>
+
+// Timing model of the Mini (SSD202D) blocks we use. The numbers are what
+// the device measured, close enough to see whether work overlaps or stalls
+#define MI_GFX_SETUP_NS     15000
+#define MI_GFX_BW_MBPS      600
+#define MI_CACHE_BW_MBPS    1600
+#define MI_MEMSET_BW_MBPS   1200
+
+#define MI_ENV_REALTIME     "MI_REALTIME"
+#define MI_ENV_WAV          "MI_AO_WAV"
+
+typedef struct {
+    uint32_t gfx_job;
+    uint64_t gfx_byte;
+    uint64_t gfx_busy_ns;
+    uint64_t gfx_wait_ns;
+    uint64_t flush_byte;
+    uint64_t flush_ns;
+    uint64_t memset_byte;
+    uint64_t memset_ns;
+    uint32_t ao_frame;
+    uint64_t ao_byte;
+    uint64_t ao_block_ns;
+    uint32_t ao_drop;
+    uint32_t ao_underrun;
+} mi_stat_t;
+
+extern mi_stat_t mi_stat;
+
+uint64_t mi_now(void);
+uint64_t mi_cost(uint64_t bytes, uint32_t mbps);
+int mi_delay(uint64_t ns);
+int mi_set_realtime(int enable);
+int mi_get_stat(mi_stat_t *stat);
+int mi_reset_stat(void);
+
+#endif
+
@@ -0,0 +1,331 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+#include "mi.h"
+#include "mi_sys.h"
+
+// Host stand-in of MI_SYS. MMA blocks are anonymous host pages and the
+// physical address is the host pointer, so Mmap is an identity mapping.
+// Addresses that were never allocated are rejected the way the kernel
+// driver would
+
+#define SYS_MAX_BLK     64
+#define SYS_PAGE_SIZE   4096
+
+typedef struct {
+    MI_PHY phy;
+    MI_U32 size;
+    int map;
+} sys_blk_t;
+
+typedef struct {
+    int init;
+    MI_U32 user_depth;
+    MI_U32 queue_depth;
+    sys_blk_t blk[SYS_MAX_BLK];
+} sys_t;
+
+static sys_t sys = { 0 };
+
+#if defined(UT)
+TEST_GROUP(mi_sys);
+
+TEST_SETUP(mi_sys)
+{
+    memset(&sys, 0, sizeof(sys));
+    mi_reset_stat();
+}
+
+TEST_TEAR_DOWN(mi_sys)
+{
+}
+#endif
+
+static sys_blk_t *find_blk(uintptr_t addr, MI_U32 size)
+{
+    int cc = 0;
+
+    for (cc = 0; cc < SYS_MAX_BLK; cc++) {
+        sys_blk_t *b = &sys.blk[cc];
+
+        if (b->phy && (addr >= b->phy) && ((addr + size) <= (b->phy + b->size))) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+#if defined(UT)
+TEST(mi_sys, find_blk)
+{
+    static uint8_t buf[32] = { 0 };
+
+    sys.blk[1].phy = (uintptr_t)buf;
+    sys.blk[1].size = sizeof(buf);
+    TEST_ASSERT_EQUAL_PTR(&sys.blk[1], find_blk((uintptr_t)buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_PTR(&sys.blk[1], find_blk((uintptr_t)&buf[8], 8));
+    TEST_ASSERT_NULL(find_blk((uintptr_t)&buf[8], sizeof(buf)));
+    TEST_ASSERT_NULL(find_blk(0, 1));
+}
+#endif
+
+MI_S32 MI_SYS_Init(void)
+{
+    sys.init = 1;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_SYS_Exit(void)
+{
+    sys.init = 0;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_SYS_MMA_Alloc(MI_U8 *pstMMAHeapName, MI_U32 u32BlkSize, MI_PHY *phyAddr)
+{
+    int cc = 0;
+    void *p = NULL;
+
+    if (!phyAddr || !u32BlkSize) {
+        return MI_ERR_SYS_ILLEGAL_PARAM;
+    }
+
+    for (cc = 0; cc < SYS_MAX_BLK; cc++) {
+        if (!sys.blk[cc].phy) {
+            break;
+        }
+    }
+
+    if (cc >= SYS_MAX_BLK) {
+        return MI_ERR_SYS_NOMEM;
+    }
+
+    u32BlkSize = (u32BlkSize + SYS_PAGE_SIZE - 1) & ~(SYS_PAGE_SIZE - 1);
+    p = mmap(NULL, u32BlkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return MI_ERR_SYS_NOMEM;
+    }
+
+    // MMA hands out whatever the last owner left behind
+    memset(p, 0xcd, u32BlkSize);
+    sys.blk[cc].phy = (uintptr_t)p;
+    sys.blk[cc].size = u32BlkSize;
+    sys.blk[cc].map = 0;
+    *phyAddr = sys.blk[cc].phy;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_SYS_MMA_Free(MI_PHY phyAddr)
+{
+    sys_blk_t *b = find_blk(phyAddr, 1);
+
+    if (!b || (b->phy != phyAddr)) {
+        return MI_ERR_SYS_ILLEGAL_PARAM;
+    }
+
+    munmap((void *)(uintptr_t)b->phy, b->size);
+    memset(b, 0, sizeof(sys_blk_t));
+    return MI_SUCCESS;
+}
+
+#if defined(UT)
+TEST(mi_sys, MI_SYS_MMA_Alloc)
+{
+    MI_PHY phy = 0;
+
+    TEST_ASSERT_EQUAL_INT(MI_ERR_SYS_ILLEGAL_PARAM, MI_SYS_MMA_Alloc(NULL, 100, NULL));
+    TEST_ASSERT_EQUAL_INT(MI_ERR_SYS_ILLEGAL_PARAM, MI_SYS_MMA_Alloc(NULL, 0, &phy));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_MMA_Alloc(NULL, 100, &phy));
+    TEST_ASSERT_TRUE(phy != 0);
+    TEST_ASSERT_EQUAL_INT(0, phy % SYS_PAGE_SIZE);
+    TEST_ASSERT_EQUAL_INT(SYS_PAGE_SIZE, find_blk(phy, 1)->size);
+
+    TEST_ASSERT_EQUAL_INT(MI_ERR_SYS_ILLEGAL_PARAM, MI_SYS_MMA_Free(phy + 4));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_MMA_Free(phy));
+    TEST_ASSERT_EQUAL_INT(MI_ERR_SYS_ILLEGAL_PARAM, MI_SYS_MMA_Free(phy));
+}
+#endif
+
+MI_S32 MI_SYS_Mmap(MI_U64 phyAddr, MI_U32 u32Size, void **ppVirtualAddress, MI_BOOL bCache)
+{
+    sys_blk_t *b = find_blk(phyAddr, u32Size);
+
+    if (!ppVirtualAddress || !b) {
+        return MI_ERR_SYS_ILLEGAL_PARAM;
+    }
+
+    b->map += 1;
+    *ppVirtualAddress = (void *)(uintptr_t)phyAddr;
+    return MI_SUCCESS;
+}
+
+MI_S32 MI_SYS_Munmap(void *pVirtualAddress, MI_U32 u32Size)
+{
+    sys_blk_t *b = find_blk((uintptr_t)pVirtualAddress, u32Size);
+
+    if (!b || !b->map) {
+        return MI_ERR_SYS_ILLEGAL_PARAM;
+    }
+
+    b->map -= 1;
+    return MI_SUCCESS;
+}
+
+#if defined(UT)
+TEST(mi_sys, MI_SYS_Mmap)
+{
+    MI_PHY phy = 0;
+    void *vir = NULL;
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_MMA_Alloc(NULL, SYS_PAGE_SIZE, &phy));
+    TEST_ASSERT_EQUAL_INT(MI_ERR_SYS_ILLEGAL_PARAM, MI_SYS_Mmap(phy, SYS_PAGE_SIZE, NULL, TRUE));
+    TEST_ASSERT_EQUAL_INT(MI_ERR_SYS_ILLEGAL_PARAM, MI_SYS_Mmap(phy, SYS_PAGE_SIZE + 1, &vir, TRUE));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_Mmap(phy, SYS_PAGE_SIZE, &vir, TRUE));
+    TEST_ASSERT_EQUAL_PTR((void *)(uintptr_t)phy, vir);
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_Munmap(vir, SYS_PAGE_SIZE));
+    TEST_ASSERT_EQUAL_INT(MI_ERR_SYS_ILLEGAL_PARAM, MI_SYS_Munmap(vir, SYS_PAGE_SIZE));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_MMA_Free(phy));
+}
+#endif
+
+MI_S32 MI_SYS_MemsetPa(MI_PHY phyPa, MI_U32 u32Val, MI_U32 u32Lenth)
+{
+    MI_U32 cc = 0;
+    uint8_t *p = (uint8_t *)(uintptr_t)phyPa;
+
+    if (!find_blk(phyPa, u32Lenth)) {
+        return MI_ERR_SYS_ILLEGAL_PARAM;
+    }
+
+    // 32-bit pattern fill done by the DMA engine, synchronous
+    for (cc = 0; (cc + 4) <= u32Lenth; cc += 4) {
+        memcpy(&p[cc], &u32Val, 4);
+    }
+    memcpy(&p[cc], &u32Val, u32Lenth - cc);
+
+    mi_stat.memset_byte += u32Lenth;
+    mi_stat.memset_ns += mi_cost(u32Lenth, MI_MEMSET_BW_MBPS);
+    mi_delay(mi_cost(u32Lenth, MI_MEMSET_BW_MBPS));
+    return MI_SUCCESS;
+}
+
+#if defined(UT)
+TEST(mi_sys, MI_SYS_MemsetPa)
+{
+    MI_PHY phy = 0;
+    uint8_t *p = NULL;
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_MMA_Alloc(NULL, SYS_PAGE_SIZE, &phy));
+    p = (uint8_t *)(uintptr_t)phy;
+    TEST_ASSERT_EQUAL_HEX8(0xcd, p[0]);
+
+    TEST_ASSERT_EQUAL_INT(MI_ERR_SYS_ILLEGAL_PARAM, MI_SYS_MemsetPa(phy, 0, SYS_PAGE_SIZE + 1));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_MemsetPa(phy, 0, SYS_PAGE_SIZE));
+    TEST_ASSERT_EQUAL_HEX8(0, p[0]);
+    TEST_ASSERT_EQUAL_HEX8(0, p[SYS_PAGE_SIZE - 1]);
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_MemsetPa(phy, 0x11223344, 6));
+    TEST_ASSERT_EQUAL_HEX32(0x11223344, *(uint32_t *)p);
+    TEST_ASSERT_EQUAL_HEX16(0x3344, *(uint16_t *)&p[4]);
+    TEST_ASSERT_EQUAL_HEX8(0, p[6]);
+    TEST_ASSERT_EQUAL_UINT64(SYS_PAGE_SIZE + 6, mi_stat.memset_byte);
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_MMA_Free(phy));
+}
+#endif
+
+MI_S32 MI_SYS_FlushInvCache(void *pVirtualAddress, MI_U32 u32Length)
+{
+    sys_blk_t *b = find_blk((uintptr_t)pVirtualAddress, u32Length);
+
+    if (!b || !b->map) {
+        return MI_ERR_SYS_ILLEGAL_PARAM;
+    }
+
+    mi_stat.flush_byte += u32Length;
+    mi_stat.flush_ns += mi_cost(u32Length, MI_CACHE_BW_MBPS);
+    mi_delay(mi_cost(u32Length, MI_CACHE_BW_MBPS));
+    return MI_SUCCESS;
+}
+
+#if defined(UT)
+TEST(mi_sys, MI_SYS_FlushInvCache)
+{
+    MI_PHY phy = 0;
+    void *vir = NULL;
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_MMA_Alloc(NULL, SYS_PAGE_SIZE, &phy));
+    TEST_ASSERT_EQUAL_INT(MI_ERR_SYS_ILLEGAL_PARAM, MI_SYS_FlushInvCache((void *)(uintptr_t)phy, 64));
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_Mmap(phy, SYS_PAGE_SIZE, &vir, TRUE));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_FlushInvCache(vir, 64));
+    TEST_ASSERT_EQUAL_UINT64(64, mi_stat.flush_byte);
+    TEST_ASSERT_EQUAL_UINT64(mi_cost(64, MI_CACHE_BW_MBPS), mi_stat.flush_ns);
+
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_Munmap(vir, SYS_PAGE_SIZE));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_MMA_Free(phy));
+}
+#endif
+
+MI_S32 MI_SYS_SetChnOutputPortDepth(MI_SYS_ChnPort_t *pstChnPort, MI_U32 u32UserFrameDepth, MI_U32 u32BufQueueDepth)
+{
+    if (!pstChnPort || (u32UserFrameDepth > u32BufQueueDepth)) {
+        return MI_ERR_SYS_ILLEGAL_PARAM;
+    }
+
+    sys.user_depth = u32UserFrameDepth;
+    sys.queue_depth = u32BufQueueDepth;
+    return MI_SUCCESS;
+}
+
+#if defined(UT)
+TEST(mi_sys, MI_SYS_SetChnOutputPortDepth)
+{
+    MI_SYS_ChnPort_t chn = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(MI_ERR_SYS_ILLEGAL_PARAM, MI_SYS_SetChnOutputPortDepth(NULL, 12, 13));
+    TEST_ASSERT_EQUAL_INT(MI_ERR_SYS_ILLEGAL_PARAM, MI_SYS_SetChnOutputPortDepth(&chn, 13, 12));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_SetChnOutputPortDepth(&chn, 12, 13));
+    TEST_ASSERT_EQUAL_INT(12, sys.user_depth);
+    TEST_ASSERT_EQUAL_INT(13, sys.queue_depth);
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(mi_sys)
+{
+    RUN_TEST_CASE(mi_sys, find_blk);
+    RUN_TEST_CASE(mi_sys, MI_SYS_MMA_Alloc);
+    RUN_TEST_CASE(mi_sys, MI_SYS_Mmap);
+    RUN_TEST_CASE(mi_sys, MI_SYS_MemsetPa);
+    RUN_TEST_CASE(mi_sys, MI_SYS_FlushInvCache);
+    RUN_TEST_CASE(mi_sys, MI_SYS_SetChnOutputPortDepth);
+}
+#endif
+
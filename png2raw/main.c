@@ -20,12 +20,20 @@
 
 #include <stdio.h>
 #include <fcntl.h>
+#include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
 #include <SDL/SDL.h>
 #include <SDL/SDL_image.h>
- 
-int main(int argc, char** argv)
+
+#include "log.h"
+#include "asset.h"
+
+static int convert_logo(void)
 {
     int cc = 0;
     char buf[255] = { 0 };
@@ -50,7 +58,7 @@ int main(int argc, char** argv)
             int fd = -1;
 
             sprintf(buf, "drastic_logo_%d.raw", cc);
-            fd = open(buf, O_CREAT | O_WRONLY);
+            fd = open(buf, O_CREAT | O_WRONLY, 0644);
             if (fd > 0) {
                 write(fd, t1->pixels, 400 * 150 * 2);
                 close(fd);
@@ -63,3 +71,236 @@ int main(int argc, char** argv)
     //SDL_Quit();
     return 0;
 }
+
+static uint32_t get_pixel(const SDL_Surface *s, int x, int y, int bpp)
+{
+    const uint8_t *p = (const uint8_t *)s->pixels + (y * s->pitch) + (x * bpp);
+
+    if (bpp == 2) {
+        return *(const uint16_t *)p;
+    }
+    return *(const uint32_t *)p;
+}
+
+static void put_pixel(uint8_t *dst, int pitch, int x, int y, int bpp, uint32_t v)
+{
+    uint8_t *p = dst + (y * pitch) + (x * bpp);
+
+    if (bpp == 2) {
+        *(uint16_t *)p = v;
+    }
+    else {
+        *(uint32_t *)p = v;
+    }
+}
+
+static int compile_asset(const char *src, int fmt, int rotate, int cw, int ch, int zoom)
+{
+    int x = 0;
+    int y = 0;
+    int w = 0;
+    int h = 0;
+    int fd = -1;
+    int bpp = 0;
+    int ret = -1;
+    uint8_t *pixels = NULL;
+    struct stat st = { 0 };
+    asset_hdr_t hdr = { 0 };
+    SDL_Surface *png = NULL;
+    SDL_Surface *tmp = NULL;
+    SDL_Surface *canvas = NULL;
+    char buf[255] = { 0 };
+
+    if (stat(src, &st) < 0) {
+        printf("failed to stat \"%s\"\n", src);
+        return -1;
+    }
+
+    png = IMG_Load(src);
+    if (!png) {
+        printf("failed to load \"%s\"\n", src);
+        return -1;
+    }
+
+    // the runtime blits every image onto a black canvas of this size
+    cw = cw ? cw : png->w;
+    ch = ch ? ch : png->h;
+    bpp = (fmt == ASSET_FMT_RGB565) ? 2 : 4;
+    canvas = SDL_CreateRGBSurface(SDL_SWSURFACE, cw, ch, bpp * 8,
+        (bpp == 2) ? 0xf800 : 0x00ff0000,
+        (bpp == 2) ? 0x07e0 : 0x0000ff00,
+        (bpp == 2) ? 0x001f : 0x000000ff,
+        (bpp == 2) ? 0x0000 : 0xff000000
+    );
+
+    do {
+        if (!canvas) {
+            break;
+        }
+
+        SDL_SetAlpha(png, 0, 0);
+        SDL_FillRect(canvas, NULL, SDL_MapRGBA(canvas->format, 0, 0, 0, 0xff));
+        if (zoom && ((png->w != cw) || (png->h != ch))) {
+            // nearest neighbour, e.g. the 640x480 splash on a 320x240 panel
+            tmp = SDL_ConvertSurface(png, canvas->format, SDL_SWSURFACE);
+            if (!tmp) {
+                break;
+            }
+
+            SDL_LockSurface(canvas);
+            for (y = 0; y < ch; y++) {
+                for (x = 0; x < cw; x++) {
+                    put_pixel(canvas->pixels, canvas->pitch, x, y, bpp,
+                        get_pixel(tmp, (x * tmp->w) / cw, (y * tmp->h) / ch, bpp));
+                }
+            }
+            SDL_UnlockSurface(canvas);
+            SDL_FreeSurface(tmp);
+        }
+        else {
+            SDL_BlitSurface(png, NULL, canvas, NULL);
+        }
+
+        w = ((rotate == ASSET_ROTATE_90) || (rotate == ASSET_ROTATE_270)) ? ch : cw;
+        h = ((rotate == ASSET_ROTATE_90) || (rotate == ASSET_ROTATE_270)) ? cw : ch;
+        pixels = malloc(w * h * bpp);
+        if (!pixels) {
+            break;
+        }
+
+        SDL_LockSurface(canvas);
+        for (y = 0; y < ch; y++) {
+            for (x = 0; x < cw; x++) {
+                uint32_t v = get_pixel(canvas, x, y, bpp);
+
+                switch (rotate) {
+                case ASSET_ROTATE_90:
+                    put_pixel(pixels, w * bpp, ch - y - 1, x, bpp, v);
+                    break;
+                case ASSET_ROTATE_180:
+                    put_pixel(pixels, w * bpp, cw - x - 1, ch - y - 1, bpp, v);
+                    break;
+                case ASSET_ROTATE_270:
+                    put_pixel(pixels, w * bpp, y, cw - x - 1, bpp, v);
+                    break;
+                default:
+                    put_pixel(pixels, w * bpp, x, y, bpp, v);
+                    break;
+                }
+            }
+        }
+        SDL_UnlockSurface(canvas);
+
+        hdr.magic = ASSET_MAGIC;
+        hdr.version = ASSET_VERSION;
+        hdr.hdr_size = ASSET_HDR_SIZE;
+        hdr.fmt = fmt;
+        hdr.rotate = rotate;
+        hdr.w = w;
+        hdr.h = h;
+        hdr.pitch = w * bpp;
+        hdr.size = hdr.pitch * h;
+        hdr.src_size = st.st_size;
+        hdr.src_mtime = st.st_mtime;
+
+        if (get_asset_path(src, buf, sizeof(buf)) < 0) {
+            break;
+        }
+
+        fd = open(buf, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+        if (fd < 0) {
+            printf("failed to create \"%s\"\n", buf);
+            break;
+        }
+
+        if ((write(fd, &hdr, sizeof(hdr)) == sizeof(hdr)) &&
+            (write(fd, pixels, hdr.size) == (ssize_t)hdr.size))
+        {
+            printf("%s -> %s (%dx%d, %s, rotate %d)\n",
+                src, buf, w, h, bpp == 2 ? "rgb565" : "argb8888", rotate * 90);
+            ret = 0;
+        }
+        close(fd);
+    } while (0);
+
+    if (pixels) {
+        free(pixels);
+    }
+
+    if (canvas) {
+        SDL_FreeSurface(canvas);
+    }
+    SDL_FreeSurface(png);
+    return ret;
+}
+
+// asset.c logs through libcommon, the host tool only needs stderr
+int write_log_to_file(int level, const char *msg, const char *fmt, ...)
+{
+    va_list va;
+
+    if (level < LOG_LEVEL_WARN) {
+        return 0;
+    }
+
+    va_start(va, fmt);
+    fprintf(stderr, "%s", msg);
+    vfprintf(stderr, fmt, va);
+    va_end(va);
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s                       convert logos to drastic_logo_N.raw\n", name);
+    printf("       %s [options] file.png ...\n", name);
+    printf("  -f argb8888|rgb565  pixel format (default argb8888)\n");
+    printf("  -r 0|90|180|270     pre-rotate clockwise (default 0)\n");
+    printf("  -s WxH              canvas size, e.g. 640x480 or 752x560 (default png size)\n");
+    printf("  -z                  scale the png to the canvas instead of cropping it\n");
+}
+ 
+int main(int argc, char** argv)
+{
+    int o = 0;
+    int cw = 0;
+    int ch = 0;
+    int err = 0;
+    int zoom = 0;
+    int fmt = ASSET_FMT_ARGB8888;
+    int rotate = ASSET_ROTATE_0;
+
+    if (argc <= 1) {
+        return convert_logo();
+    }
+
+    while ((o = getopt(argc, argv, "f:r:s:zh")) != -1) {
+        switch (o) {
+        case 'f':
+            fmt = strcmp(optarg, "rgb565") ? ASSET_FMT_ARGB8888 : ASSET_FMT_RGB565;
+            break;
+        case 'r':
+            rotate = (atoi(optarg) / 90) & 3;
+            break;
+        case 's':
+            if (sscanf(optarg, "%dx%d", &cw, &ch) != 2) {
+                usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 'z':
+            zoom = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    for (; optind < argc; optind++) {
+        if (compile_asset(argv[optind], fmt, rotate, cw, ch, zoom) < 0) {
+            err += 1;
+        }
+    }
+    return err ? -1 : 0;
+}
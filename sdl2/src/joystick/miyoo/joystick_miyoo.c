@@ -39,8 +39,8 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <poll.h>
 #include <pthread.h>
-#include <sys/select.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <linux/input.h>
@@ -48,6 +48,7 @@
 
 #include "log.h"
 #include "cfg.pb.h"
+#include "thread.h"
 #include "joystick_miyoo.h"
 
 #if defined(UT)
@@ -276,9 +277,8 @@ TEST(sdl2_joystick_miyoo, uart_init)
 
 static int uart_read(int fd, char *buf, int len)
 {
-    int f_sel = 0;
-    fd_set f_read = { 0 };
-    struct timeval time = { 0 };
+    int r = 0;
+    struct pollfd pfd = { 0 };
 
     if ((fd < 0) || !buf || (len <= 0)) {
         err(SDL"invalid parameters(0x%x, 0x%x, 0x%x) in %s\n", fd, buf, len, __func__);
@@ -289,16 +289,23 @@ static int uart_read(int fd, char *buf, int len)
     return 0;
 #endif
 
-    FD_ZERO(&f_read);
-    FD_SET(fd, &f_read);
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    r = poll(&pfd, 1, A30_POLL_TIMEOUT);
+    if (r <= 0) {
+        return 0;
+    }
 
-    time.tv_sec = 10;
-    time.tv_usec = 0;
-    f_sel = select(fd + 1, &f_read, NULL, NULL, &time);
-    if (f_sel) {
-        return read(fd, buf, len);
+    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        err(SDL"uart error(0x%x) in %s\n", pfd.revents, __func__);
+        return -1;
     }
-    return 0;
+
+    r = read(fd, buf, len);
+    if ((r < 0) && ((errno == EINTR) || (errno == EAGAIN))) {
+        return 0;
+    }
+    return r;
 }
 
 #if defined(UT)
@@ -313,6 +320,64 @@ TEST(sdl2_joystick_miyoo, uart_read)
 }
 #endif
 
+static int ring_count(void)
+{
+    return (int)(myjoy.ring_head - myjoy.ring_tail);
+}
+
+static uint8_t ring_peek(int off)
+{
+    return myjoy.ring[(myjoy.ring_tail + off) & (A30_RING_LEN - 1)];
+}
+
+static int ring_push(const char *buf, int len)
+{
+    int cc = 0;
+
+    if (!buf || (len <= 0)) {
+        err(SDL"invalid parameters(0x%x, 0x%x) in %s\n", buf, len, __func__);
+        return -1;
+    }
+
+    for (cc = 0; cc < len; cc++) {
+        if (ring_count() >= A30_RING_LEN) {
+            myjoy.ring_tail += 1;
+        }
+        myjoy.ring[myjoy.ring_head & (A30_RING_LEN - 1)] = buf[cc];
+        myjoy.ring_head += 1;
+    }
+    return 0;
+}
+
+#if defined(UT)
+TEST(sdl2_joystick_miyoo, ring_push)
+{
+    int cc = 0;
+    char buf[A30_RING_LEN + 8] = { 0 };
+
+    for (cc = 0; cc < sizeof(buf); cc++) {
+        buf[cc] = cc;
+    }
+
+    myjoy.ring_head = 0;
+    myjoy.ring_tail = 0;
+    TEST_ASSERT_EQUAL_INT(-1, ring_push(NULL, 0));
+    TEST_ASSERT_EQUAL_INT(-1, ring_push(buf, 0));
+    TEST_ASSERT_EQUAL_INT(0, ring_push(buf, 3));
+    TEST_ASSERT_EQUAL_INT(3, ring_count());
+    TEST_ASSERT_EQUAL_INT(2, ring_peek(2));
+
+    myjoy.ring_head = 0;
+    myjoy.ring_tail = 0;
+    TEST_ASSERT_EQUAL_INT(0, ring_push(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(A30_RING_LEN, ring_count());
+    TEST_ASSERT_EQUAL_INT(8, ring_peek(0));
+
+    myjoy.ring_head = 0;
+    myjoy.ring_tail = 0;
+}
+#endif
+
 static int filter_dead_zone(int idx, int newAxis, int oldAxis)
 {
     int dead = (idx == 0) ? mycfg.joy.left.x.dead : mycfg.joy.left.y.dead;
@@ -499,39 +564,40 @@ TEST(sdl2_joystick_miyoo, frame_to_axis_y)
 
 static int parse_serial_buf(const char *cmd, int len)
 {
-    int i = 0;
-    int p = 0;
-    int s = 0;
+    int cc = 0;
+    uint8_t *p = NULL;
 
-    if (!cmd || (len < A30_FRAME_LEN)) {
+    if (!cmd || (len <= 0)) {
         err(SDL"invalid parameters(0x%x, 0x%x) in %s\n", cmd, len, __func__);
         return - 1;
     }
 
-    s = len - A30_FRAME_LEN;
-    s += 1;
-    for (i = 0; i < s; i += A30_FRAME_LEN) {
-        for (p = 0; p < (A30_FRAME_LEN - 1); p++) {
-            int tail = i + (A30_FRAME_LEN - 1);
+    ring_push(cmd, len);
+    while (ring_count() > 0) {
+        if (ring_peek(0) != A30_FRAME_START) {
+            myjoy.ring_tail += 1;
+            continue;
+        }
 
-            if (tail >= len) {
-                break;
-            }
+        if (ring_count() < A30_FRAME_LEN) {
+            break;
+        }
 
-            if ((cmd[i] == (char)A30_FRAME_START) &&
-                (cmd[tail] == (char)A30_FRAME_STOP))
-            {
-                memcpy(&myjoy.cur_frame, cmd + i, sizeof(myjoy.cur_frame));
-                break;
-            }
-            else {
-                i += 1;
-            }
+        if (ring_peek(A30_FRAME_LEN - 1) != A30_FRAME_STOP) {
+            myjoy.ring_tail += 1;
+            continue;
         }
+
+        p = (uint8_t *)&myjoy.cur_frame;
+        for (cc = 0; cc < A30_FRAME_LEN; cc++) {
+            p[cc] = ring_peek(cc);
+        }
+        myjoy.ring_tail += A30_FRAME_LEN;
+
+        myjoy.cur_axis[ABS_X] = frame_to_axis_x(myjoy.cur_frame.axis0);
+        myjoy.cur_axis[ABS_Y] = frame_to_axis_y(myjoy.cur_frame.axis1);
+        update_axis_values();
     }
-    myjoy.cur_axis[ABS_X] = frame_to_axis_x(myjoy.cur_frame.axis0);
-    myjoy.cur_axis[ABS_Y] = frame_to_axis_y(myjoy.cur_frame.axis1);
-    update_axis_values();
     return 0;
 }
 
@@ -569,6 +635,38 @@ TEST(sdl2_joystick_miyoo, parse_serial_buf)
     TEST_ASSERT_EQUAL_INT(0, myjoy.cur_frame.axis0);
     TEST_ASSERT_EQUAL_INT(0, myjoy.cur_frame.axis1);
     TEST_ASSERT_EQUAL_INT(0, myjoy.cur_frame.magic_end);
+
+    myjoy.ring_head = 0;
+    myjoy.ring_tail = 0;
+}
+
+TEST(sdl2_joystick_miyoo, parse_serial_buf_split)
+{
+    char buf0[] = { 9, A30_FRAME_START, 1, 2 };
+    char buf1[] = { 55, 66, A30_FRAME_STOP, A30_FRAME_START, 3 };
+    char buf2[] = { A30_FRAME_START, 1, 2, 3, 4, 5, A30_FRAME_START, 1, 2, 77, 88, A30_FRAME_STOP };
+
+    myjoy.ring_head = 0;
+    myjoy.ring_tail = 0;
+    memset(&myjoy.cur_frame, 0, sizeof(myjoy.cur_frame));
+
+    TEST_ASSERT_EQUAL_INT(0, parse_serial_buf(buf0, sizeof(buf0)));
+    TEST_ASSERT_EQUAL_INT(0, myjoy.cur_frame.magic_start);
+    TEST_ASSERT_EQUAL_INT(3, ring_count());
+
+    TEST_ASSERT_EQUAL_INT(0, parse_serial_buf(buf1, sizeof(buf1)));
+    TEST_ASSERT_EQUAL_INT(A30_FRAME_START, myjoy.cur_frame.magic_start);
+    TEST_ASSERT_EQUAL_INT(55, myjoy.cur_frame.axis0);
+    TEST_ASSERT_EQUAL_INT(66, myjoy.cur_frame.axis1);
+    TEST_ASSERT_EQUAL_INT(A30_FRAME_STOP, myjoy.cur_frame.magic_end);
+    TEST_ASSERT_EQUAL_INT(2, ring_count());
+
+    myjoy.ring_head = 0;
+    myjoy.ring_tail = 0;
+    TEST_ASSERT_EQUAL_INT(0, parse_serial_buf(buf2, sizeof(buf2)));
+    TEST_ASSERT_EQUAL_INT(77, myjoy.cur_frame.axis0);
+    TEST_ASSERT_EQUAL_INT(88, myjoy.cur_frame.axis1);
+    TEST_ASSERT_EQUAL_INT(0, ring_count());
 }
 #endif
 
@@ -579,6 +677,8 @@ static int init_serial_input(void)
     memset(myjoy.cur_axis, 0, sizeof(myjoy.cur_axis));
     memset(myjoy.last_axis, 0, sizeof(myjoy.last_axis));
     memset(&(myjoy.cur_frame), 0, sizeof(myjoy.cur_frame));
+    myjoy.ring_head = 0;
+    myjoy.ring_tail = 0;
 
     myjoy.dev_fd = uart_open(A30_JOYSTICK_DEV);
     if (myjoy.dev_fd < 0) {
@@ -599,6 +699,7 @@ TEST(sdl2_joystick_miyoo, init_serial_input)
     TEST_ASSERT_EQUAL_INT(0, myjoy.cur_frame.magic_start);
     TEST_ASSERT_EQUAL_INT(0, myjoy.cur_axis[0]);
     TEST_ASSERT_EQUAL_INT(0, myjoy.last_axis[0]);
+    TEST_ASSERT_EQUAL_INT(0, ring_count());
 }
 #endif
 
@@ -659,21 +760,28 @@ TEST(sdl2_joystick_miyoo, read_joystick_config)
 int joystick_handler(void *param)
 {
     int len = 0;
-    char rcv_buf[255] = { 0 };
+    char rcv_buf[A30_READ_LEN] = { 0 };
 
 #if defined(UT)
     myjoy.running = 0;
+#else
+    register_thread("joystick", THREAD_ROLE_INPUT);
 #endif
 
     while (myjoy.running) {
-        len = uart_read(myjoy.dev_fd, rcv_buf, 99);
+        len = uart_read(myjoy.dev_fd, rcv_buf, sizeof(rcv_buf));
 
         if (len > 0) {
-            rcv_buf[len] = 0;
             parse_serial_buf(rcv_buf, len);
         }
-        usleep(1000);
+        else if (len < 0) {
+            usleep(100000);
+        }
     }
+
+#if !defined(UT)
+    unregister_thread();
+#endif
     return 0;
 }
 #endif
@@ -1071,12 +1179,14 @@ TEST_GROUP_RUNNER(sdl2_joystick_miyoo)
     RUN_TEST_CASE(sdl2_joystick_miyoo, uart_set);
     RUN_TEST_CASE(sdl2_joystick_miyoo, uart_init);
     RUN_TEST_CASE(sdl2_joystick_miyoo, uart_read);
+    RUN_TEST_CASE(sdl2_joystick_miyoo, ring_push);
     RUN_TEST_CASE(sdl2_joystick_miyoo, filter_dead_zone);
     RUN_TEST_CASE(sdl2_joystick_miyoo, limit_value);
     RUN_TEST_CASE(sdl2_joystick_miyoo, update_axis_values);
     RUN_TEST_CASE(sdl2_joystick_miyoo, frame_to_axis_x);
     RUN_TEST_CASE(sdl2_joystick_miyoo, frame_to_axis_y);
     RUN_TEST_CASE(sdl2_joystick_miyoo, parse_serial_buf);
+    RUN_TEST_CASE(sdl2_joystick_miyoo, parse_serial_buf_split);
     RUN_TEST_CASE(sdl2_joystick_miyoo, init_serial_input);
     RUN_TEST_CASE(sdl2_joystick_miyoo, read_joystick_config);
     RUN_TEST_CASE(sdl2_joystick_miyoo, joystick_handler);
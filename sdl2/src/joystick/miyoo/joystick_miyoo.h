@@ -36,6 +36,9 @@
 #define A30_FRAME_LEN 6
 #define A30_FRAME_START 0xff
 #define A30_FRAME_STOP 0xfe
+#define A30_RING_LEN 256
+#define A30_READ_LEN 64
+#define A30_POLL_TIMEOUT 100
 
 typedef struct a30_frame {
     uint8_t magic_start;
@@ -53,6 +56,9 @@ typedef struct miyoo_joystick {
     int last_x;
     int last_y;
     a30_frame_t cur_frame;
+    uint8_t ring[A30_RING_LEN];
+    uint32_t ring_head;
+    uint32_t ring_tail;
     int32_t cur_axis[A30_AXIS_MAX_LEN];
     int32_t last_axis[A30_AXIS_MAX_LEN];
 
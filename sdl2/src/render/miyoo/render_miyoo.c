@@ -19,6 +19,7 @@
 //
 
 #include <unistd.h>
+#include <string.h>
 #include <stdbool.h>
 
 #include "../../SDL_internal.h"
@@ -35,8 +36,13 @@
 #endif
 
 extern NDS nds;
+extern GFX gfx;
+extern int FB_W;
+extern int FB_H;
 extern int show_fps;
 
+static Miyoo_RenderData render = { 0 };
+
 static void DestroyRenderer(SDL_Renderer *renderer);
 static SDL_Renderer* CreateRenderer(SDL_Window *window, uint32_t flags);
 
@@ -52,6 +58,466 @@ TEST_TEAR_DOWN(sdl2_render_miyoo)
 }
 #endif
 
+static void get_frame_size(int *w, int *h)
+{
+    *w = FB_W ? FB_W : DEF_FB_W;
+    *h = FB_H ? FB_H : DEF_FB_H;
+}
+
+#if defined(UT)
+TEST(sdl2_render_miyoo, get_frame_size)
+{
+    int w = 0;
+    int h = 0;
+
+    get_frame_size(&w, &h);
+    TEST_ASSERT_EQUAL_INT(FB_W ? FB_W : DEF_FB_W, w);
+    TEST_ASSERT_EQUAL_INT(FB_H ? FB_H : DEF_FB_H, h);
+}
+#endif
+
+static uint32_t get_texture_pixel(const Miyoo_TextureData *m, int x, int y)
+{
+    const uint8_t *p = (const uint8_t *)m->pixels + (y * m->pitch);
+
+    if (m->bits == 16) {
+        uint16_t v = ((const uint16_t *)p)[x];
+        uint32_t r = (v >> 11) & 0x1f;
+        uint32_t g = (v >> 5) & 0x3f;
+        uint32_t b = v & 0x1f;
+
+        return 0xff000000 |
+            (((r << 3) | (r >> 2)) << 16) |
+            (((g << 2) | (g >> 4)) << 8) |
+            ((b << 3) | (b >> 2));
+    }
+    return ((const uint32_t *)p)[x];
+}
+
+#if defined(UT)
+TEST(sdl2_render_miyoo, get_texture_pixel)
+{
+    uint16_t p16[2] = { 0xf800, 0x07ff };
+    uint32_t p32[2] = { 0x12345678, 0x9abcdef0 };
+    Miyoo_TextureData m = { 0 };
+
+    m.bits = 16;
+    m.pitch = 4;
+    m.pixels = p16;
+    TEST_ASSERT_EQUAL_HEX32(0xffff0000, get_texture_pixel(&m, 0, 0));
+    TEST_ASSERT_EQUAL_HEX32(0xff00ffff, get_texture_pixel(&m, 1, 0));
+
+    m.bits = 32;
+    m.pitch = 8;
+    m.pixels = p32;
+    TEST_ASSERT_EQUAL_HEX32(0x9abcdef0, get_texture_pixel(&m, 1, 0));
+}
+#endif
+
+// rounded v / 255 for v up to 255 * 255 without a division
+static inline uint32_t div_255(uint32_t v)
+{
+    v += 128;
+    return (v + (v >> 8)) >> 8;
+}
+
+#if defined(UT)
+TEST(sdl2_render_miyoo, div_255)
+{
+    uint32_t v = 0;
+
+    for (v = 0; v <= (255 * 255); v++) {
+        TEST_ASSERT_EQUAL_UINT32((v + 127) / 255, div_255(v));
+    }
+}
+#endif
+
+static uint32_t blend_pixel(uint32_t src, uint32_t dst, uint32_t alpha)
+{
+    int cc = 0;
+    uint32_t r = 0;
+
+    // SDL_BLENDMODE_BLEND, destination alpha is src + dst * (1 - src)
+    for (cc = 0; cc < 32; cc += 8) {
+        uint32_t s = (cc == 24) ? 0xff : ((src >> cc) & 0xff);
+        uint32_t d = (dst >> cc) & 0xff;
+
+        r |= div_255((s * alpha) + (d * (255 - alpha))) << cc;
+    }
+    return r;
+}
+
+#if defined(UT)
+TEST(sdl2_render_miyoo, blend_pixel)
+{
+    TEST_ASSERT_EQUAL_HEX32(0xff112233, blend_pixel(0x00112233, 0x00ffffff, 255));
+    TEST_ASSERT_EQUAL_HEX32(0x00ffffff, blend_pixel(0xff112233, 0x00ffffff, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x80808080, blend_pixel(0xffffffff, 0x00000000, 128));
+}
+#endif
+
+static int clip_item(Miyoo_RenderItem *it, const SDL_Rect *clip)
+{
+    int x0 = 0;
+    int x1 = 0;
+    int y0 = 0;
+    int y1 = 0;
+    SDL_Rect rt = { 0 };
+
+    if (!it || !clip) {
+        err(SDL"invalid parameters(0x%x, 0x%x) in %s\n", it, clip, __func__);
+        return -1;
+    }
+
+    if ((it->dst.w <= 0) || (it->dst.h <= 0) || !SDL_IntersectRect(&it->dst, clip, &rt)) {
+        return -1;
+    }
+
+    if ((it->type == RENDER_ITEM_COPY) && !SDL_RectEquals(&rt, &it->dst)) {
+        x0 = rt.x - it->dst.x;
+        x1 = x0 + rt.w;
+        y0 = rt.y - it->dst.y;
+        y1 = y0 + rt.h;
+
+        if (it->flip & SDL_FLIP_HORIZONTAL) {
+            int t = x0;
+
+            x0 = it->dst.w - x1;
+            x1 = it->dst.w - t;
+        }
+
+        if (it->flip & SDL_FLIP_VERTICAL) {
+            int t = y0;
+
+            y0 = it->dst.h - y1;
+            y1 = it->dst.h - t;
+        }
+
+        x0 = (x0 * it->src.w) / it->dst.w;
+        x1 = (x1 * it->src.w) / it->dst.w;
+        y0 = (y0 * it->src.h) / it->dst.h;
+        y1 = (y1 * it->src.h) / it->dst.h;
+
+        it->src.x += x0;
+        it->src.y += y0;
+        it->src.w = SDL_max(x1 - x0, 1);
+        it->src.h = SDL_max(y1 - y0, 1);
+    }
+    it->dst = rt;
+    return 0;
+}
+
+#if defined(UT)
+TEST(sdl2_render_miyoo, clip_item)
+{
+    SDL_Rect clip = { 0, 0, 100, 100 };
+    Miyoo_RenderItem it = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, clip_item(NULL, NULL));
+
+    it.type = RENDER_ITEM_FILL;
+    it.dst.x = 200;
+    it.dst.w = 10;
+    it.dst.h = 10;
+    TEST_ASSERT_EQUAL_INT(-1, clip_item(&it, &clip));
+
+    it.type = RENDER_ITEM_COPY;
+    it.src.w = 40;
+    it.src.h = 40;
+    it.dst.x = -20;
+    it.dst.y = 80;
+    it.dst.w = 80;
+    it.dst.h = 80;
+    TEST_ASSERT_EQUAL_INT(0, clip_item(&it, &clip));
+    TEST_ASSERT_EQUAL_INT(0, it.dst.x);
+    TEST_ASSERT_EQUAL_INT(80, it.dst.y);
+    TEST_ASSERT_EQUAL_INT(60, it.dst.w);
+    TEST_ASSERT_EQUAL_INT(20, it.dst.h);
+    TEST_ASSERT_EQUAL_INT(10, it.src.x);
+    TEST_ASSERT_EQUAL_INT(0, it.src.y);
+    TEST_ASSERT_EQUAL_INT(30, it.src.w);
+    TEST_ASSERT_EQUAL_INT(10, it.src.h);
+}
+#endif
+
+#if !defined(MINI)
+static void fill_frame(uint32_t *frame, int pitch, const Miyoo_RenderItem *it)
+{
+    int x = 0;
+    int y = 0;
+    uint32_t alpha = it->color >> 24;
+
+    for (y = 0; y < it->dst.h; y++) {
+        uint32_t *d = (uint32_t *)((uint8_t *)frame + ((it->dst.y + y) * pitch)) + it->dst.x;
+
+        for (x = 0; x < it->dst.w; x++) {
+            d[x] = it->blend ? blend_pixel(it->color, d[x], alpha) : it->color;
+        }
+    }
+}
+
+// A30 has no 2D engine so this is the software path, the source column is
+// stepped with an error term instead of a division per pixel
+static void copy_frame(uint32_t *frame, int pitch, const Miyoo_RenderItem *it)
+{
+    int x = 0;
+    int y = 0;
+    int e = 0;
+    int sx = 0;
+    int sy = 0;
+    uint32_t alpha = it->color >> 24;
+    const Miyoo_TextureData *m = (const Miyoo_TextureData *)it->texture->driverdata;
+
+    for (y = 0; y < it->dst.h; y++) {
+        uint32_t *d = (uint32_t *)((uint8_t *)frame + ((it->dst.y + y) * pitch)) + it->dst.x;
+
+        sy = (y * it->src.h) / it->dst.h;
+        if (it->flip & SDL_FLIP_VERTICAL) {
+            sy = it->src.h - 1 - sy;
+        }
+        sy += it->src.y;
+
+        // sx is (x * src.w) / dst.w, e carries the remainder
+        for (x = 0, sx = 0, e = 0; x < it->dst.w; x++) {
+            uint32_t v = 0;
+            int tx = (it->flip & SDL_FLIP_HORIZONTAL) ? (it->src.w - 1 - sx) : sx;
+
+            v = get_texture_pixel(m, it->src.x + tx, sy);
+            if (it->blend) {
+                d[x] = blend_pixel(v, d[x], div_255((v >> 24) * alpha));
+            }
+            else {
+                d[x] = v;
+            }
+
+            e += it->src.w;
+            while (e >= it->dst.w) {
+                e -= it->dst.w;
+                sx += 1;
+            }
+        }
+    }
+}
+#endif
+
+#if defined(MINI)
+// slot is the pixel in render.fill holding the color of a blended fill
+static void blit_item(const Miyoo_RenderItem *it, int slot)
+{
+    MI_GFX_Opt_t opt = { 0 };
+    MI_GFX_Rect_t srt = { 0 };
+    MI_GFX_Rect_t drt = { 0 };
+    MI_GFX_Surface_t src = { 0 };
+    MI_GFX_Surface_t dst = { 0 };
+    const Miyoo_TextureData *m = NULL;
+
+    dst.phyAddr = render.phyAddr[render.cur_frame];
+    dst.eColorFmt = E_MI_GFX_FMT_ARGB8888;
+    dst.u32Width = render.width;
+    dst.u32Height = render.height;
+    dst.u32Stride = render.pitch;
+
+    // panel is mounted upside down
+    drt.s32Xpos = render.width - it->dst.x - it->dst.w;
+    drt.s32Ypos = render.height - it->dst.y - it->dst.h;
+    drt.u32Width = it->dst.w;
+    drt.u32Height = it->dst.h;
+
+    if (it->type == RENDER_ITEM_FILL) {
+        if (!it->blend) {
+            blit_fill(&gfx.blit, &dst, &drt, it->color);
+            return;
+        }
+
+        // engine fill has no blending, stretch one pixel of the color instead
+        src.phyAddr = render.fill_phyAddr;
+        src.eColorFmt = E_MI_GFX_FMT_ARGB8888;
+        src.u32Width = RENDER_MAX_ITEM;
+        src.u32Height = 1;
+        src.u32Stride = RENDER_MAX_ITEM * sizeof(uint32_t);
+        srt.s32Xpos = slot;
+        srt.u32Width = 1;
+        srt.u32Height = 1;
+
+        opt.eRotate = E_MI_GFX_ROTATE_0;
+        opt.eMirror = E_MI_GFX_MIRROR_NONE;
+        opt.eSrcDfbBldOp = E_MI_GFX_DFB_BLD_SRCALPHA;
+        opt.eDstDfbBldOp = E_MI_GFX_DFB_BLD_INVSRCALPHA;
+        opt.eDFBBlendFlag = E_MI_GFX_DFB_BLEND_ALPHACHANNEL;
+        blit_copy(&gfx.blit, &src, &srt, &dst, &drt, &opt);
+        return;
+    }
+
+    m = (const Miyoo_TextureData *)it->texture->driverdata;
+    src.phyAddr = m->phyAddr;
+    src.eColorFmt = (m->bits == 16) ? E_MI_GFX_FMT_RGB565 : E_MI_GFX_FMT_ARGB8888;
+    src.u32Width = m->width;
+    src.u32Height = m->height;
+    src.u32Stride = m->pitch;
+    srt.s32Xpos = it->src.x;
+    srt.s32Ypos = it->src.y;
+    srt.u32Width = it->src.w;
+    srt.u32Height = it->src.h;
+
+    // 180 degree rotation is the same as mirroring both axes
+    opt.eRotate = E_MI_GFX_ROTATE_0;
+    opt.eMirror = it->flip ^ E_MI_GFX_MIRROR_BOTH;
+    opt.eSrcDfbBldOp = E_MI_GFX_DFB_BLD_ONE;
+    if (it->blend) {
+        opt.eSrcDfbBldOp = E_MI_GFX_DFB_BLD_SRCALPHA;
+        opt.eDstDfbBldOp = E_MI_GFX_DFB_BLD_INVSRCALPHA;
+        opt.eDFBBlendFlag = E_MI_GFX_DFB_BLEND_ALPHACHANNEL;
+        if ((it->color >> 24) < 0xff) {
+            opt.u32GlobalSrcConstColor = it->color & 0xff000000;
+            opt.eDFBBlendFlag |= E_MI_GFX_DFB_BLEND_COLORALPHA;
+        }
+    }
+    blit_copy(&gfx.blit, &src, &srt, &dst, &drt, &opt);
+}
+#endif
+
+static int flush_items(void)
+{
+    int cc = 0;
+    uint32_t *frame = render.frame[render.cur_frame];
+#if defined(MINI)
+    int fill = 0;
+#endif
+
+    if (render.item_cnt == 0) {
+        return 0;
+    }
+
+#if defined(MINI)
+    for (cc = 0; cc < render.item_cnt; cc++) {
+        if ((render.item[cc].type == RENDER_ITEM_FILL) && render.item[cc].blend) {
+            fill += 1;
+        }
+    }
+
+    // colors of blended fills are read by the engine, last batch must be done
+    if (frame && fill) {
+        blit_wait(&gfx.blit);
+        for (cc = 0; cc < render.item_cnt; cc++) {
+            render.fill[cc] = render.item[cc].color;
+        }
+        MI_SYS_FlushInvCache(render.fill, RENDER_MAX_ITEM * sizeof(uint32_t));
+    }
+#endif
+
+    // submit the whole batch back-to-back, the video thread waits on the last fence
+    for (cc = 0; cc < render.item_cnt; cc++) {
+        const Miyoo_RenderItem *it = &render.item[cc];
+
+        if (!frame) {
+            break;
+        }
+
+#if defined(MINI)
+        blit_item(it, cc);
+#else
+        if (it->type == RENDER_ITEM_COPY) {
+            copy_frame(frame, render.pitch, it);
+        }
+        else {
+            fill_frame(frame, render.pitch, it);
+        }
+#endif
+    }
+
+#if defined(MINI)
+    blit_submit(&gfx.blit);
+#endif
+
+    render.flush += 1;
+    render.item_cnt = 0;
+    return 0;
+}
+
+static int add_item(Miyoo_RenderItem *it, const SDL_Rect *clip)
+{
+    if (it->type == RENDER_ITEM_COPY) {
+        const Miyoo_TextureData *m = (const Miyoo_TextureData *)it->texture->driverdata;
+
+        if (!m || !m->pixels) {
+            return -1;
+        }
+    }
+
+    if (clip_item(it, clip) < 0) {
+        return 0;
+    }
+
+    if (render.item_cnt >= RENDER_MAX_ITEM) {
+        flush_items();
+    }
+    render.item[render.item_cnt++] = *it;
+    return 0;
+}
+
+static void add_line(Miyoo_RenderItem *it, int x0, int y0, int x1, int y1, const SDL_Rect *clip)
+{
+    int dx = SDL_abs(x1 - x0);
+    int dy = -SDL_abs(y1 - y0);
+    int sx = (x0 < x1) ? 1 : -1;
+    int sy = (y0 < y1) ? 1 : -1;
+    int e = dx + dy;
+
+    if ((x0 == x1) || (y0 == y1)) {
+        it->dst.x = SDL_min(x0, x1);
+        it->dst.y = SDL_min(y0, y1);
+        it->dst.w = dx + 1;
+        it->dst.h = -dy + 1;
+        add_item(it, clip);
+        return;
+    }
+
+    while (1) {
+        int e2 = e * 2;
+
+        it->dst.x = x0;
+        it->dst.y = y0;
+        it->dst.w = 1;
+        it->dst.h = 1;
+        add_item(it, clip);
+
+        if ((x0 == x1) && (y0 == y1)) {
+            break;
+        }
+
+        if (e2 >= dy) {
+            e += dy;
+            x0 += sx;
+        }
+
+        if (e2 <= dx) {
+            e += dx;
+            y0 += sy;
+        }
+    }
+}
+
+#if defined(UT)
+TEST(sdl2_render_miyoo, add_line)
+{
+    SDL_Rect clip = { 0, 0, 100, 100 };
+    Miyoo_RenderItem it = { 0 };
+
+    render.item_cnt = 0;
+    add_line(&it, 1, 1, 10, 1, &clip);
+    TEST_ASSERT_EQUAL_INT(1, render.item_cnt);
+    TEST_ASSERT_EQUAL_INT(10, render.item[0].dst.w);
+    TEST_ASSERT_EQUAL_INT(1, render.item[0].dst.h);
+
+    render.item_cnt = 0;
+    add_line(&it, 0, 0, 3, 3, &clip);
+    TEST_ASSERT_EQUAL_INT(4, render.item_cnt);
+    TEST_ASSERT_EQUAL_INT(3, render.item[3].dst.x);
+    TEST_ASSERT_EQUAL_INT(3, render.item[3].dst.y);
+    render.item_cnt = 0;
+}
+#endif
+
 static void WindowEvent(SDL_Renderer *renderer, const SDL_WindowEvent *event)
 {
     if (!renderer || !event) {
@@ -83,7 +549,19 @@ static void DestroyTexture(SDL_Renderer *renderer, SDL_Texture *texture)
             }
 
             if (m->pixels) {
+#if defined(MINI)
+                if (m->phyAddr) {
+                    blit_wait(&gfx.blit);
+                    MI_SYS_Munmap(m->pixels, m->size);
+                    MI_SYS_MMA_Free(m->phyAddr);
+                    m->phyAddr = 0;
+                }
+                else {
+                    SDL_free(m->pixels);
+                }
+#else
                 SDL_free(m->pixels);
+#endif
                 m->pixels = NULL;
             }
 
@@ -141,12 +619,29 @@ static int CreateTexture(SDL_Renderer *renderer, SDL_Texture *texture)
             break;
         default:
             err(SDL"invalid pixel format(0x%x) in %s\n", m->format, __func__);
+            SDL_free(m);
             return -1;
         }
 
         m->pitch = m->width * SDL_BYTESPERPIXEL(texture->format);
         m->size = m->height * m->pitch;
+
+#if defined(MINI)
+        // MI_GFX blits straight from texture memory, no staging copy
+        if ((MI_SYS_MMA_Alloc(NULL, m->size, &m->phyAddr) != MI_SUCCESS) ||
+            (MI_SYS_Mmap(m->phyAddr, m->size, &m->pixels, TRUE) != MI_SUCCESS))
+        {
+            if (m->phyAddr) {
+                MI_SYS_MMA_Free(m->phyAddr);
+            }
+            m->pixels = NULL;
+        }
+        else {
+            MI_SYS_MemsetPa(m->phyAddr, 0, m->size);
+        }
+#else
         m->pixels = SDL_calloc(1, m->size);
+#endif
 
         if(!m->pixels) {
             err(SDL"failed to allocate texture data in %s\n", __func__);
@@ -155,7 +650,6 @@ static int CreateTexture(SDL_Renderer *renderer, SDL_Texture *texture)
         }
 
         texture->driverdata = m;
-        GFX_Clear();
     } while(0);
 
     return 0;
@@ -204,8 +698,12 @@ static int LockTexture(SDL_Renderer *renderer, SDL_Texture *texture, const SDL_R
         Miyoo_TextureData *m = (Miyoo_TextureData *)(texture->driverdata);
 
         if (m) {
+#if defined(MINI)
+            // engine may still be reading the last frame out of it
+            blit_wait(&gfx.blit);
+#endif
             *pitch = m->pitch;
-            *pixels = m->pixels;
+            *pixels = (uint8_t *)m->pixels + (rect->y * m->pitch) + (rect->x * (m->bits / 8));
         }
     } while (0);
     return 0;
@@ -253,6 +751,45 @@ static int UpdateTexture(SDL_Renderer *renderer, SDL_Texture *texture, const SDL
         err(SDL"invalid parameters(0x%x, 0x%x, 0x%x, 0x%x) in %s\n", renderer, texture, rect, pixels, __func__);
         return -1;
     }
+
+    do {
+        int y = 0;
+        int len = 0;
+        uint8_t *dst = NULL;
+        const uint8_t *src = pixels;
+        Miyoo_TextureData *m = (Miyoo_TextureData *)texture->driverdata;
+
+        if (!m || !m->pixels || (rect->w <= 0) || (rect->h <= 0)) {
+            break;
+        }
+
+        if ((rect->x < 0) || (rect->y < 0) ||
+            ((rect->x + rect->w) > m->width) ||
+            ((rect->y + rect->h) > m->height))
+        {
+            err(SDL"invalid rect(%d, %d, %d, %d) in %s\n", rect->x, rect->y, rect->w, rect->h, __func__);
+            return -1;
+        }
+
+        len = rect->w * (m->bits / 8);
+        dst = (uint8_t *)m->pixels + (rect->y * m->pitch) + (rect->x * (m->bits / 8));
+
+#if defined(MINI)
+        blit_wait(&gfx.blit);
+#endif
+
+        // UnlockTexture hands back the texture memory itself
+        if (src != dst) {
+            for (y = 0; y < rect->h; y++) {
+                memcpy(dst + (y * m->pitch), src + (y * pitch), len);
+            }
+        }
+
+#if defined(MINI)
+        MI_SYS_FlushInvCache((uint8_t *)m->pixels + (rect->y * m->pitch), rect->h * m->pitch);
+#endif
+    } while (0);
+
     return 0;
 }
 
@@ -262,6 +799,9 @@ TEST(sdl2_render_miyoo, UpdateTexture)
     SDL_Rect rt = { 0 };
     SDL_Texture t = { 0 };
     SDL_Renderer r = { 0 };
+    Miyoo_TextureData m = { 0 };
+    uint32_t buf[4][4] = { 0 };
+    uint32_t src[2][2] = { { 1, 2 }, { 3, 4 } };
 
     TEST_ASSERT_EQUAL_INT(-1, UpdateTexture(NULL, NULL, NULL, NULL, 0));
     TEST_ASSERT_EQUAL_INT(-1, UpdateTexture(&r, NULL, NULL, NULL, 0));
@@ -269,6 +809,29 @@ TEST(sdl2_render_miyoo, UpdateTexture)
     TEST_ASSERT_EQUAL_INT(-1, UpdateTexture(&r, &t, &rt, NULL, 0));
 
     TEST_ASSERT_EQUAL_INT(0, UpdateTexture(&r, &t, &rt, (void *)0xdeadbeef, 0));
+
+    m.bits = 32;
+    m.width = 4;
+    m.height = 4;
+    m.pitch = sizeof(buf[0]);
+    m.pixels = buf;
+    t.driverdata = &m;
+
+    rt.x = 3;
+    rt.y = 3;
+    rt.w = 2;
+    rt.h = 2;
+    TEST_ASSERT_EQUAL_INT(-1, UpdateTexture(&r, &t, &rt, src, sizeof(src[0])));
+
+    rt.x = 1;
+    rt.y = 2;
+    TEST_ASSERT_EQUAL_INT(0, UpdateTexture(&r, &t, &rt, src, sizeof(src[0])));
+    TEST_ASSERT_EQUAL_UINT32(0, buf[2][0]);
+    TEST_ASSERT_EQUAL_UINT32(1, buf[2][1]);
+    TEST_ASSERT_EQUAL_UINT32(2, buf[2][2]);
+    TEST_ASSERT_EQUAL_UINT32(3, buf[3][1]);
+    TEST_ASSERT_EQUAL_UINT32(4, buf[3][2]);
+    TEST_ASSERT_EQUAL_UINT32(0, buf[3][3]);
 }
 #endif
 
@@ -368,10 +931,25 @@ TEST(sdl2_render_miyoo, QueueSetViewport)
 
 static int QueueDrawPoints(SDL_Renderer *renderer, SDL_RenderCommand *cmd, const SDL_FPoint *points, int count)
 {
+    SDL_FPoint *v = NULL;
+
     if (!renderer || !cmd || !points) {
         err(SDL"invalid parameters(0x%x, 0x%x) in %s\n", renderer, cmd, __func__);
         return -1;
     }
+
+    cmd->data.draw.count = 0;
+    if (count <= 0) {
+        return 0;
+    }
+
+    v = (SDL_FPoint *)SDL_AllocateRenderVertices(renderer, count * sizeof(SDL_FPoint), 0, &cmd->data.draw.first);
+    if (!v) {
+        return -1;
+    }
+
+    cmd->data.draw.count = count;
+    memcpy(v, points, count * sizeof(SDL_FPoint));
     return 0;
 }
 
@@ -386,6 +964,13 @@ TEST(sdl2_render_miyoo, QueueDrawPoints)
     TEST_ASSERT_EQUAL_INT(-1, QueueDrawPoints(&r, NULL, NULL, 0));
     TEST_ASSERT_EQUAL_INT(-1, QueueDrawPoints(&r, &c, NULL, 0));
     TEST_ASSERT_EQUAL_INT(0, QueueDrawPoints(&r, &c, &f, 0));
+
+    f.x = 3;
+    f.y = 4;
+    TEST_ASSERT_EQUAL_INT(0, QueueDrawPoints(&r, &c, &f, 1));
+    TEST_ASSERT_EQUAL_INT(1, c.data.draw.count);
+    TEST_ASSERT_EQUAL_FLOAT(3, ((SDL_FPoint *)((uint8_t *)r.vertex_data + c.data.draw.first))->x);
+    SDL_free(r.vertex_data);
 }
 #endif
 
@@ -441,6 +1026,23 @@ static int QueueFillRects(SDL_Renderer *renderer, SDL_RenderCommand *cmd, const
         err(SDL"invalid parameter(0x%x, 0x%x, 0x%x, 0x%x) in %s\n", renderer, cmd, rects, count, __func__);
         return -1;
     }
+
+    do {
+        SDL_FRect *v = NULL;
+
+        cmd->data.draw.count = 0;
+        if (count <= 0) {
+            break;
+        }
+
+        v = (SDL_FRect *)SDL_AllocateRenderVertices(renderer, count * sizeof(SDL_FRect), 0, &cmd->data.draw.first);
+        if (!v) {
+            return -1;
+        }
+
+        cmd->data.draw.count = count;
+        memcpy(v, rects, count * sizeof(SDL_FRect));
+    } while (0);
     return 0;
 }
 
@@ -456,6 +1058,9 @@ TEST(sdl2_render_miyoo, QueueFillRects)
     TEST_ASSERT_EQUAL_INT(-1, QueueFillRects(&r, &cmd, NULL, 0));
 
     TEST_ASSERT_EQUAL_INT(0, QueueFillRects(&r, &cmd, &rt, 0));
+    TEST_ASSERT_EQUAL_INT(0, QueueFillRects(&r, &cmd, &rt, 1));
+    TEST_ASSERT_EQUAL_INT(1, cmd.data.draw.count);
+    SDL_free(r.vertex_data);
 }
 #endif
 
@@ -466,11 +1071,21 @@ static int QueueCopy(SDL_Renderer *renderer, SDL_RenderCommand *cmd, SDL_Texture
         return -1;
     }
 
-    show_fps = 0;
-    nds.menu.drastic.enable = 1;
-    usleep(100000);
+    do {
+        Miyoo_CopyVertex *v = (Miyoo_CopyVertex *)SDL_AllocateRenderVertices(renderer, sizeof(Miyoo_CopyVertex), 0, &cmd->data.draw.first);
 
-    process_drastic_menu();
+        if (!v) {
+            return -1;
+        }
+
+        cmd->data.draw.count = 1;
+        v->src.x = src_rect->x;
+        v->src.y = src_rect->y;
+        v->src.w = src_rect->w;
+        v->src.h = src_rect->h;
+        v->dst = *dst_rect;
+        v->flip = SDL_FLIP_NONE;
+    } while (0);
     return 0;
 }
 
@@ -490,6 +1105,8 @@ TEST(sdl2_render_miyoo, QueueCopy)
     TEST_ASSERT_EQUAL_INT(-1, QueueCopy(&r, &cmd, &t, &r1, NULL));
 
     TEST_ASSERT_EQUAL_INT(0, QueueCopy(&r, &cmd, &t, &r1, &r2));
+    TEST_ASSERT_EQUAL_INT(1, cmd.data.draw.count);
+    SDL_free(r.vertex_data);
 }
 #endif
 
@@ -507,6 +1124,28 @@ static int QueueCopyEx(
         err(SDL"invalid parameter(0x%x, 0x%x, 0x%x, 0x%x, 0x%x, 0x%x) in %s\n", renderer, cmd, texture, src_rect, dst_rect, center, __func__);
         return -1;
     }
+
+    do {
+        int rot = ((int)SDL_floor(angle / 90.0)) & 3;
+        Miyoo_CopyVertex *v = (Miyoo_CopyVertex *)SDL_AllocateRenderVertices(renderer, sizeof(Miyoo_CopyVertex), 0, &cmd->data.draw.first);
+
+        if (!v) {
+            return -1;
+        }
+
+        cmd->data.draw.count = 1;
+        v->src.x = src_rect->x;
+        v->src.y = src_rect->y;
+        v->src.w = src_rect->w;
+        v->src.h = src_rect->h;
+        v->dst = *dst_rect;
+        v->flip = flip & (SDL_FLIP_HORIZONTAL | SDL_FLIP_VERTICAL);
+
+        // only half turns map onto mirroring, quarter turns are drawn unrotated
+        if (rot == 2) {
+            v->flip ^= SDL_FLIP_HORIZONTAL | SDL_FLIP_VERTICAL;
+        }
+    } while (0);
     return 0;
 }
 
@@ -528,16 +1167,161 @@ TEST(sdl2_render_miyoo, QueueCopyEx)
     TEST_ASSERT_EQUAL_INT(-1, QueueCopyEx(&r, &cmd, &t, &r1, &r2, 0, NULL, 0));
 
     TEST_ASSERT_EQUAL_INT(0, QueueCopyEx(&r, &cmd, &t, &r1, &r2, 0, &c, 0));
+    TEST_ASSERT_EQUAL_INT(SDL_FLIP_NONE, ((Miyoo_CopyVertex *)((uint8_t *)r.vertex_data + cmd.data.draw.first))->flip);
+
+    TEST_ASSERT_EQUAL_INT(0, QueueCopyEx(&r, &cmd, &t, &r1, &r2, 180, &c, SDL_FLIP_HORIZONTAL));
+    TEST_ASSERT_EQUAL_INT(SDL_FLIP_VERTICAL, ((Miyoo_CopyVertex *)((uint8_t *)r.vertex_data + cmd.data.draw.first))->flip);
+    SDL_free(r.vertex_data);
 }
 #endif
 
+static void get_clip_rect(const SDL_Rect *viewport, SDL_bool enabled, const SDL_Rect *cliprect, SDL_Rect *clip)
+{
+    int w = 0;
+    int h = 0;
+    SDL_Rect rt = { 0 };
+    SDL_Rect frame = { 0 };
+
+    get_frame_size(&w, &h);
+    frame.w = w;
+    frame.h = h;
+
+    if (!SDL_IntersectRect(viewport, &frame, clip)) {
+        memset(clip, 0, sizeof(SDL_Rect));
+        return;
+    }
+
+    if (enabled) {
+        rt = *cliprect;
+        rt.x += viewport->x;
+        rt.y += viewport->y;
+        if (!SDL_IntersectRect(&rt, clip, clip)) {
+            memset(clip, 0, sizeof(SDL_Rect));
+        }
+    }
+}
+
 static int RunCommandQueue(SDL_Renderer *renderer, SDL_RenderCommand *cmd, void *vertices, size_t vertsize)
 {
+    int cc = 0;
+    int w = 0;
+    int h = 0;
+    SDL_Rect clip = { 0 };
+    SDL_Rect cliprect = { 0 };
+    SDL_Rect viewport = { 0 };
+    SDL_bool clip_enabled = SDL_FALSE;
+
     if (!renderer || !cmd || !vertices) {
         err(SDL"invalid parameter(0x%x, 0x%x, 0x%x) in %s\n", renderer, cmd, vertices, __func__);
         return -1;
     }
-    return 0;
+
+    get_frame_size(&w, &h);
+    viewport.w = w;
+    viewport.h = h;
+    clip = viewport;
+
+    while (cmd) {
+        Miyoo_RenderItem it = { 0 };
+        const uint8_t *v = (const uint8_t *)vertices + cmd->data.draw.first;
+
+        it.blend = (cmd->data.draw.blend == SDL_BLENDMODE_BLEND) ? 1 : 0;
+        it.color = ((uint32_t)cmd->data.draw.a << 24) |
+            ((uint32_t)cmd->data.draw.r << 16) |
+            ((uint32_t)cmd->data.draw.g << 8) |
+            cmd->data.draw.b;
+
+        switch (cmd->command) {
+        case SDL_RENDERCMD_SETVIEWPORT:
+            viewport = cmd->data.viewport.rect;
+            get_clip_rect(&viewport, clip_enabled, &cliprect, &clip);
+            break;
+        case SDL_RENDERCMD_SETCLIPRECT:
+            clip_enabled = cmd->data.cliprect.enabled;
+            cliprect = cmd->data.cliprect.rect;
+            get_clip_rect(&viewport, clip_enabled, &cliprect, &clip);
+            break;
+        case SDL_RENDERCMD_CLEAR:
+            it.type = RENDER_ITEM_FILL;
+            it.blend = 0;
+            it.color = ((uint32_t)cmd->data.color.a << 24) |
+                ((uint32_t)cmd->data.color.r << 16) |
+                ((uint32_t)cmd->data.color.g << 8) |
+                cmd->data.color.b;
+            it.dst.w = w;
+            it.dst.h = h;
+            add_item(&it, &it.dst);
+            break;
+        case SDL_RENDERCMD_DRAW_POINTS:
+            it.type = RENDER_ITEM_FILL;
+            for (cc = 0; cc < cmd->data.draw.count; cc++) {
+                const SDL_FPoint *p = (const SDL_FPoint *)v + cc;
+
+                it.dst.x = viewport.x + (int)p->x;
+                it.dst.y = viewport.y + (int)p->y;
+                it.dst.w = 1;
+                it.dst.h = 1;
+                add_item(&it, &clip);
+            }
+            break;
+        case SDL_RENDERCMD_DRAW_LINES:
+            it.type = RENDER_ITEM_FILL;
+            for (cc = 0; cc < cmd->data.draw.count; cc++) {
+                const SDL_FPoint *p = (const SDL_FPoint *)v + cc;
+
+                if ((cc + 1) < cmd->data.draw.count) {
+                    add_line(&it,
+                        viewport.x + (int)p[0].x, viewport.y + (int)p[0].y,
+                        viewport.x + (int)p[1].x, viewport.y + (int)p[1].y, &clip);
+                }
+                else if (cmd->data.draw.count == 1) {
+                    add_line(&it,
+                        viewport.x + (int)p->x, viewport.y + (int)p->y,
+                        viewport.x + (int)p->x, viewport.y + (int)p->y, &clip);
+                }
+            }
+            break;
+        case SDL_RENDERCMD_FILL_RECTS:
+            it.type = RENDER_ITEM_FILL;
+            for (cc = 0; cc < cmd->data.draw.count; cc++) {
+                const SDL_FRect *r = (const SDL_FRect *)v + cc;
+
+                it.dst.x = viewport.x + (int)r->x;
+                it.dst.y = viewport.y + (int)r->y;
+                it.dst.w = (int)r->w;
+                it.dst.h = (int)r->h;
+                add_item(&it, &clip);
+            }
+            break;
+        case SDL_RENDERCMD_COPY:
+        case SDL_RENDERCMD_COPY_EX:
+            do {
+                const Miyoo_CopyVertex *c = (const Miyoo_CopyVertex *)v;
+
+                if (!cmd->data.draw.texture || (cmd->data.draw.count == 0)) {
+                    break;
+                }
+
+                it.type = RENDER_ITEM_COPY;
+                it.flip = c->flip;
+                it.texture = cmd->data.draw.texture;
+                it.src.x = (int)c->src.x;
+                it.src.y = (int)c->src.y;
+                it.src.w = (int)c->src.w;
+                it.src.h = (int)c->src.h;
+                it.dst.x = viewport.x + (int)c->dst.x;
+                it.dst.y = viewport.y + (int)c->dst.y;
+                it.dst.w = (int)c->dst.w;
+                it.dst.h = (int)c->dst.h;
+                add_item(&it, &clip);
+            } while (0);
+            break;
+        default:
+            break;
+        }
+        cmd = cmd->next;
+    }
+    return flush_items();
 }
 
 #if defined(UT)
@@ -552,6 +1336,75 @@ TEST(sdl2_render_miyoo, RunCommandQueue)
 
     TEST_ASSERT_EQUAL_INT(0, RunCommandQueue(&r, &cmd, (void *)0xdeadbeef, 0));
 }
+
+TEST(sdl2_render_miyoo, RunCommandQueue_draw)
+{
+    int flush = 0;
+    uint32_t *fb = NULL;
+    SDL_Rect src = { 0, 0, 2, 2 };
+    SDL_Window w = { 0 };
+    SDL_Texture t = { 0 };
+    SDL_Renderer *r = NULL;
+    SDL_FRect fill = { 10, 10, 4, 4 };
+    SDL_FRect dst = { 20, 20, 4, 4 };
+    SDL_RenderCommand c[4] = { 0 };
+    uint32_t pixels[2][2] = { { 0xff0000ff, 0xff00ff00 }, { 0xffff0000, 0x00ffffff } };
+
+    r = CreateRenderer(&w, 0);
+    TEST_ASSERT_NOT_NULL(r);
+
+    t.w = 2;
+    t.h = 2;
+    t.format = SDL_PIXELFORMAT_ARGB8888;
+    TEST_ASSERT_EQUAL_INT(0, CreateTexture(r, &t));
+    TEST_ASSERT_EQUAL_INT(0, UpdateTexture(r, &t, &src, pixels, sizeof(pixels[0])));
+
+    c[0].command = SDL_RENDERCMD_CLEAR;
+    c[0].data.color.a = 0xff;
+    c[0].data.color.r = 0x10;
+    c[0].next = &c[1];
+
+    c[1].command = SDL_RENDERCMD_FILL_RECTS;
+    c[1].data.draw.a = 0xff;
+    c[1].data.draw.g = 0xff;
+    TEST_ASSERT_EQUAL_INT(0, QueueFillRects(r, &c[1], &fill, 1));
+    c[1].next = &c[2];
+
+    c[2].command = SDL_RENDERCMD_COPY;
+    c[2].data.draw.a = 0xff;
+    c[2].data.draw.blend = SDL_BLENDMODE_BLEND;
+    c[2].data.draw.texture = &t;
+    TEST_ASSERT_EQUAL_INT(0, QueueCopy(r, &c[2], &t, &src, &dst));
+    c[2].next = &c[3];
+
+    c[3].command = SDL_RENDERCMD_FILL_RECTS;
+    c[3].data.draw.a = 0xff;
+    c[3].data.draw.b = 0xff;
+    fill.x = -2;
+    fill.y = -2;
+    TEST_ASSERT_EQUAL_INT(0, QueueFillRects(r, &c[3], &fill, 1));
+
+    flush = render.flush;
+    TEST_ASSERT_EQUAL_INT(0, RunCommandQueue(r, c, r->vertex_data, r->vertex_data_used));
+    TEST_ASSERT_EQUAL_INT(flush + 1, render.flush);
+    TEST_ASSERT_EQUAL_INT(0, render.item_cnt);
+
+    fb = render.frame[render.cur_frame];
+    TEST_ASSERT_NOT_NULL(fb);
+    TEST_ASSERT_EQUAL_HEX32(0xff0000ff, fb[0]);
+    TEST_ASSERT_EQUAL_HEX32(0xff0000ff, fb[(1 * render.width) + 1]);
+    TEST_ASSERT_EQUAL_HEX32(0xff100000, fb[(2 * render.width) + 2]);
+    TEST_ASSERT_EQUAL_HEX32(0xff00ff00, fb[(10 * render.width) + 10]);
+    TEST_ASSERT_EQUAL_HEX32(0xff100000, fb[(14 * render.width) + 14]);
+    TEST_ASSERT_EQUAL_HEX32(0xff0000ff, fb[(20 * render.width) + 21]);
+    TEST_ASSERT_EQUAL_HEX32(0xff00ff00, fb[(20 * render.width) + 22]);
+    TEST_ASSERT_EQUAL_HEX32(0xffff0000, fb[(22 * render.width) + 20]);
+    TEST_ASSERT_EQUAL_HEX32(0xff100000, fb[(23 * render.width) + 23]);
+
+    DestroyTexture(r, &t);
+    SDL_free(r->vertex_data);
+    DestroyRenderer(r);
+}
 #endif
 
 static int RenderReadPixels(SDL_Renderer *renderer, const SDL_Rect *rect, uint32_t pixel_format, void *pixels, int pitch)
@@ -560,6 +1413,62 @@ static int RenderReadPixels(SDL_Renderer *renderer, const SDL_Rect *rect, uint32
         err(SDL"invalid parameter(0x%x, 0x%x, 0x%x) in %s\n", renderer, rect, pixels, __func__);
         return -1;
     }
+
+    do {
+        int w = 0;
+        int h = 0;
+        int ret = 0;
+        SDL_Rect rt = { 0 };
+#if defined(MINI)
+        int x = 0;
+        int y = 0;
+        uint32_t *buf = NULL;
+        const uint32_t *fb = render.frame[render.cur_frame];
+#endif
+
+        if ((rect->w <= 0) || (rect->h <= 0)) {
+            break;
+        }
+
+        get_frame_size(&w, &h);
+        rt.w = w;
+        rt.h = h;
+        if (!SDL_IntersectRect(rect, &rt, &rt) || !SDL_RectEquals(rect, &rt)) {
+            err(SDL"invalid rect(%d, %d, %d, %d) in %s\n", rect->x, rect->y, rect->w, rect->h, __func__);
+            return -1;
+        }
+
+#if defined(MINI)
+        if (!fb) {
+            return -1;
+        }
+
+        buf = SDL_malloc(rect->w * rect->h * sizeof(uint32_t));
+        if (!buf) {
+            return SDL_OutOfMemory();
+        }
+
+        // frame is upside down, same as what blit_item wrote
+        blit_wait(&gfx.blit);
+        MI_SYS_FlushInvCache((void *)fb, render.pitch * render.height);
+        for (y = 0; y < rect->h; y++) {
+            for (x = 0; x < rect->w; x++) {
+                buf[(y * rect->w) + x] = fb[((render.height - 1 - (rect->y + y)) * render.width) + (render.width - 1 - (rect->x + x))];
+            }
+        }
+        ret = SDL_ConvertPixels(rect->w, rect->h, SDL_PIXELFORMAT_ARGB8888, buf, rect->w * sizeof(uint32_t), pixel_format, pixels, pitch);
+        SDL_free(buf);
+#else
+        if (!render.frame[render.cur_frame]) {
+            return -1;
+        }
+
+        ret = SDL_ConvertPixels(rect->w, rect->h, SDL_PIXELFORMAT_ARGB8888,
+            (uint8_t *)render.frame[render.cur_frame] + (rect->y * render.pitch) + (rect->x * FB_BPP),
+            render.pitch, pixel_format, pixels, pitch);
+#endif
+        return ret;
+    } while (0);
     return 0;
 }
 
@@ -576,6 +1485,27 @@ TEST(sdl2_render_miyoo, RenderReadPixels)
 
     TEST_ASSERT_EQUAL_INT(0, RenderReadPixels(&r, &rt, 0, (void *)0xdeadbeef, 0));
 }
+
+TEST(sdl2_render_miyoo, RenderReadPixels_frame)
+{
+    SDL_Rect rt = { 1, 2, 2, 1 };
+    SDL_Window w = { 0 };
+    SDL_Renderer *r = NULL;
+    uint32_t buf[2] = { 0 };
+
+    r = CreateRenderer(&w, 0);
+    TEST_ASSERT_NOT_NULL(r);
+
+    render.frame[render.cur_frame][(2 * render.width) + 1] = 0x11223344;
+    render.frame[render.cur_frame][(2 * render.width) + 2] = 0x55667788;
+    TEST_ASSERT_EQUAL_INT(0, RenderReadPixels(r, &rt, SDL_PIXELFORMAT_ARGB8888, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_HEX32(0x11223344, buf[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x55667788, buf[1]);
+
+    rt.x = render.width - 1;
+    TEST_ASSERT_EQUAL_INT(-1, RenderReadPixels(r, &rt, SDL_PIXELFORMAT_ARGB8888, buf, sizeof(buf)));
+    DestroyRenderer(r);
+}
 #endif
 
 static void RenderPresent(SDL_Renderer *renderer)
@@ -583,6 +1513,28 @@ static void RenderPresent(SDL_Renderer *renderer)
     do {
         if (!renderer) {
             err(SDL"invalid parameter(0x%x) in %s\n", renderer, __func__);
+            break;
+        }
+
+        // DraStic menu is replaced by the custom one built from its strings
+        if (get_current_menu_layer() >= 0) {
+            show_fps = 0;
+            nds.menu.drastic.enable = 1;
+            process_drastic_menu();
+            break;
+        }
+
+        if (render.frame[render.cur_frame]) {
+#if defined(MINI)
+            GFX_Present(render.frame[render.cur_frame], render.phyAddr[render.cur_frame], render.width, render.height, render.pitch);
+#else
+            GFX_Present(render.frame[render.cur_frame], 0, render.width, render.height, render.pitch);
+#endif
+
+#if defined(A30) || defined(MINI)
+            // video thread copies the presented frame, draw the next one aside
+            render.cur_frame ^= 1;
+#endif
         }
     } while( 0 );
 }
@@ -595,13 +1547,114 @@ TEST(sdl2_render_miyoo, RenderPresent)
 }
 #endif
 
+static int alloc_frame(void)
+{
+    int cc = 0;
+    int size = render.pitch * render.height;
+
+    for (cc = 0; cc < 2; cc++) {
+        if (render.frame[cc]) {
+            continue;
+        }
+
+#if defined(MINI)
+        // frames live in MI_SYS memory so that MI_GFX can draw into them
+        if ((MI_SYS_MMA_Alloc(NULL, size, &render.phyAddr[cc]) != MI_SUCCESS) ||
+            (MI_SYS_Mmap(render.phyAddr[cc], size, (void **)&render.frame[cc], TRUE) != MI_SUCCESS))
+        {
+            if (render.phyAddr[cc]) {
+                MI_SYS_MMA_Free(render.phyAddr[cc]);
+                render.phyAddr[cc] = 0;
+            }
+            render.frame[cc] = NULL;
+            return -1;
+        }
+        MI_SYS_MemsetPa(render.phyAddr[cc], 0, size);
+#else
+        render.frame[cc] = SDL_calloc(1, size);
+        if (!render.frame[cc]) {
+            return -1;
+        }
+#endif
+    }
+
+#if defined(MINI)
+    if (!render.fill) {
+        size = RENDER_MAX_ITEM * sizeof(uint32_t);
+        if ((MI_SYS_MMA_Alloc(NULL, size, &render.fill_phyAddr) != MI_SUCCESS) ||
+            (MI_SYS_Mmap(render.fill_phyAddr, size, (void **)&render.fill, TRUE) != MI_SUCCESS))
+        {
+            if (render.fill_phyAddr) {
+                MI_SYS_MMA_Free(render.fill_phyAddr);
+                render.fill_phyAddr = 0;
+            }
+            render.fill = NULL;
+            return -1;
+        }
+    }
+#endif
+    return 0;
+}
+
+static void free_frame(void)
+{
+    int cc = 0;
+
+    // video thread must not read a frame after it is gone
+    GFX_DropPresent();
+
+    for (cc = 0; cc < 2; cc++) {
+        if (render.frame[cc]) {
+#if defined(MINI)
+            MI_SYS_Munmap(render.frame[cc], render.pitch * render.height);
+            MI_SYS_MMA_Free(render.phyAddr[cc]);
+            render.phyAddr[cc] = 0;
+#else
+            SDL_free(render.frame[cc]);
+#endif
+            render.frame[cc] = NULL;
+        }
+    }
+
+#if defined(MINI)
+    if (render.fill) {
+        MI_SYS_Munmap(render.fill, RENDER_MAX_ITEM * sizeof(uint32_t));
+        MI_SYS_MMA_Free(render.fill_phyAddr);
+        render.fill_phyAddr = 0;
+        render.fill = NULL;
+    }
+#endif
+}
+
+#if defined(UT)
+TEST(sdl2_render_miyoo, alloc_frame)
+{
+    get_frame_size(&render.width, &render.height);
+    render.pitch = render.width * FB_BPP;
+
+    TEST_ASSERT_EQUAL_INT(0, alloc_frame());
+    TEST_ASSERT_NOT_NULL(render.frame[0]);
+    TEST_ASSERT_NOT_NULL(render.frame[1]);
+    TEST_ASSERT_EQUAL_HEX32(0, render.frame[1][(render.width * render.height) - 1]);
+
+    free_frame();
+    TEST_ASSERT_NULL(render.frame[0]);
+    TEST_ASSERT_NULL(render.frame[1]);
+}
+#endif
+
 static void DestroyRenderer(SDL_Renderer *renderer)
 {
     do {
         if (!renderer) {
             err(SDL"invalid parameter(0x%x) in %s\n", renderer, __func__);
+            break;
         }
 
+        free_frame();
+        render.cur_frame = 0;
+        render.item_cnt = 0;
+
         SDL_free(renderer);
     } while( 0 );
 }
@@ -657,6 +1710,15 @@ static SDL_Renderer* CreateRenderer(SDL_Window *window, uint32_t flags)
     }
     memset(renderer, 0, sizeof(SDL_Renderer));
 
+    get_frame_size(&render.width, &render.height);
+    render.pitch = render.width * FB_BPP;
+    if (alloc_frame() < 0) {
+        err(SDL"failed to allocate frame buffer in %s\n", __func__);
+        DestroyRenderer(renderer);
+        SDL_OutOfMemory();
+        return NULL;
+    }
+
     renderer->WindowEvent = WindowEvent;
     renderer->CreateTexture = CreateTexture;
     renderer->UpdateTexture = UpdateTexture;
@@ -722,6 +1784,12 @@ SDL_RenderDriver Miyoo_RenderDriver = {
 #if defined(UT)
 TEST_GROUP_RUNNER(sdl2_render_miyoo)
 {
+    RUN_TEST_CASE(sdl2_render_miyoo, get_frame_size);
+    RUN_TEST_CASE(sdl2_render_miyoo, get_texture_pixel);
+    RUN_TEST_CASE(sdl2_render_miyoo, div_255);
+    RUN_TEST_CASE(sdl2_render_miyoo, blend_pixel);
+    RUN_TEST_CASE(sdl2_render_miyoo, clip_item);
+    RUN_TEST_CASE(sdl2_render_miyoo, add_line);
     RUN_TEST_CASE(sdl2_render_miyoo, WindowEvent);
     RUN_TEST_CASE(sdl2_render_miyoo, DestroyTexture);
     RUN_TEST_CASE(sdl2_render_miyoo, CreateTexture);
@@ -737,8 +1805,11 @@ TEST_GROUP_RUNNER(sdl2_render_miyoo)
     RUN_TEST_CASE(sdl2_render_miyoo, QueueCopy);
     RUN_TEST_CASE(sdl2_render_miyoo, QueueCopyEx);
     RUN_TEST_CASE(sdl2_render_miyoo, RunCommandQueue);
+    RUN_TEST_CASE(sdl2_render_miyoo, RunCommandQueue_draw);
     RUN_TEST_CASE(sdl2_render_miyoo, RenderReadPixels);
+    RUN_TEST_CASE(sdl2_render_miyoo, RenderReadPixels_frame);
     RUN_TEST_CASE(sdl2_render_miyoo, RenderPresent);
+    RUN_TEST_CASE(sdl2_render_miyoo, alloc_frame);
     RUN_TEST_CASE(sdl2_render_miyoo, DestroyRenderer);
     RUN_TEST_CASE(sdl2_render_miyoo, SetVSync);
     RUN_TEST_CASE(sdl2_render_miyoo, CreateRenderer);
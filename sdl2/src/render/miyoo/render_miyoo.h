@@ -21,6 +21,11 @@
 #ifndef __SDL_RENDER_MIYOO_H__
 #define __SDL_RENDER_MIYOO_H__
 
+#define RENDER_MAX_ITEM     256
+
+#define RENDER_ITEM_FILL    0
+#define RENDER_ITEM_COPY    1
+
 typedef struct Miyoo_TextureData {
     void *pixels;
     uint32_t size;
@@ -29,7 +34,42 @@ typedef struct Miyoo_TextureData {
     uint32_t bits;
     uint32_t format;
     uint32_t pitch;
+#if defined(MINI)
+    MI_PHY phyAddr;
+#endif
 } Miyoo_TextureData;
 
+typedef struct Miyoo_CopyVertex {
+    SDL_FRect src;
+    SDL_FRect dst;
+    int flip;
+} Miyoo_CopyVertex;
+
+typedef struct Miyoo_RenderItem {
+    int type;
+    int flip;
+    int blend;
+    uint32_t color;
+    SDL_Rect src;
+    SDL_Rect dst;
+    SDL_Texture *texture;
+} Miyoo_RenderItem;
+
+typedef struct Miyoo_RenderData {
+    uint32_t *frame[2];
+#if defined(MINI)
+    MI_PHY phyAddr[2];
+    uint32_t *fill;
+    MI_PHY fill_phyAddr;
+#endif
+    int cur_frame;
+    int width;
+    int height;
+    int pitch;
+    int flush;
+    int item_cnt;
+    Miyoo_RenderItem item[RENDER_MAX_ITEM];
+} Miyoo_RenderData;
+
 #endif
 
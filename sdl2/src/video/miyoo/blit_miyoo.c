@@ -0,0 +1,344 @@
+//
+//    NDS Emulator (DraStic) for Miyoo Handheld
+//
+//    This software is provided 'as-is', without any express or implied
+//    warranty.  In no event will the authors be held liable for any damages
+//    arising from the use of this software.
+//
+//    Permission is granted to anyone to use this software for any purpose,
+//    including commercial applications, and to alter it and redistribute it
+//    freely, subject to the following restrictions:
+//
+//    1. The origin of this software must not be misrepresented; you must not
+//       claim that you wrote the original software. If you use this software
+//       in a product, an acknowledgment in the product documentation would be
+//       appreciated but is not required.
+//    2. Altered source versions must be plainly marked as such, and must not be
+//       misrepresented as being the original software.
+//    3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#include <string.h>
+#include <sys/time.h>
+
+#include "../../SDL_internal.h"
+
+#include "log.h"
+#include "blit_miyoo.h"
+
+#if defined(UT)
+#include "unity_fixture.h"
+#endif
+
+// MI_GFX command list. Blits of a frame are queued and kicked without
+// waiting, the CPU only blocks on the last fence right before the page
+// flip or before it touches memory the engine may still be using
+
+#if defined(MINI) || defined(UT)
+
+#if defined(UT)
+TEST_GROUP(sdl2_blit_miyoo);
+
+TEST_SETUP(sdl2_blit_miyoo)
+{
+    MI_GFX_Open();
+}
+
+TEST_TEAR_DOWN(sdl2_blit_miyoo)
+{
+    MI_GFX_Close();
+}
+
+static uint32_t ut_dst[4][4] = { 0 };
+static uint32_t ut_src[2][2] = { { 1, 2 }, { 3, 4 } };
+
+static void ut_surface(MI_GFX_Surface_t *s, void *buf, int w, int h)
+{
+    memset(s, 0, sizeof(MI_GFX_Surface_t));
+    s->phyAddr = (uintptr_t)buf;
+    s->eColorFmt = E_MI_GFX_FMT_ARGB8888;
+    s->u32Width = w;
+    s->u32Height = h;
+    s->u32Stride = w * 4;
+}
+#endif
+
+static void submit_cmd(BLIT_QUEUE *q)
+{
+    int cc = 0;
+    int r = MI_SUCCESS;
+
+    // back-to-back, the engine executes in order so only the last fence matters
+    for (cc = 0; cc < q->cnt; cc++) {
+        BLIT_CMD *c = &q->cmd[cc];
+
+        if (c->type == BLIT_CMD_FILL) {
+            r = MI_GFX_QuickFill(&c->dst, &c->drt, c->color, &q->fence);
+        }
+        else {
+            r = MI_GFX_BitBlit(&c->src, &c->srt, &c->dst, &c->drt, &c->opt, &q->fence);
+        }
+
+        if (r != MI_SUCCESS) {
+            err(SDL"failed to submit blit command(%d, 0x%x) in %s\n", c->type, r, __func__);
+            continue;
+        }
+        q->busy = 1;
+    }
+
+    q->submit += q->cnt;
+    q->cnt = 0;
+}
+
+static int add_cmd(BLIT_QUEUE *q, const BLIT_CMD *c)
+{
+    pthread_mutex_lock(&q->lock);
+    if (q->cnt >= BLIT_MAX_CMD) {
+        submit_cmd(q);
+    }
+
+    q->cmd[q->cnt++] = *c;
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+int blit_copy(
+    BLIT_QUEUE *q,
+    const MI_GFX_Surface_t *src,
+    const MI_GFX_Rect_t *srt,
+    const MI_GFX_Surface_t *dst,
+    const MI_GFX_Rect_t *drt,
+    const MI_GFX_Opt_t *opt)
+{
+    BLIT_CMD c = { 0 };
+
+    if (!q || !src || !srt || !dst || !drt || !opt) {
+        err(SDL"invalid parameters(0x%x, 0x%x, 0x%x, 0x%x, 0x%x, 0x%x) in %s\n", q, src, srt, dst, drt, opt, __func__);
+        return -1;
+    }
+
+    c.type = BLIT_CMD_COPY;
+    c.src = *src;
+    c.srt = *srt;
+    c.dst = *dst;
+    c.drt = *drt;
+    c.opt = *opt;
+    return add_cmd(q, &c);
+}
+
+#if defined(UT)
+TEST(sdl2_blit_miyoo, blit_copy)
+{
+    BLIT_QUEUE q = { .lock = PTHREAD_MUTEX_INITIALIZER };
+    MI_GFX_Opt_t opt = { 0 };
+    MI_GFX_Rect_t rt = { 0, 0, 2, 2 };
+    MI_GFX_Surface_t s = { 0 };
+    MI_GFX_Surface_t d = { 0 };
+
+    ut_surface(&s, ut_src, 2, 2);
+    ut_surface(&d, ut_dst, 4, 4);
+    TEST_ASSERT_EQUAL_INT(-1, blit_copy(NULL, NULL, NULL, NULL, NULL, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, blit_copy(&q, &s, &rt, &d, &rt, NULL));
+    TEST_ASSERT_EQUAL_INT(0, blit_copy(&q, &s, &rt, &d, &rt, &opt));
+    TEST_ASSERT_EQUAL_INT(1, q.cnt);
+    TEST_ASSERT_EQUAL_INT(BLIT_CMD_COPY, q.cmd[0].type);
+    TEST_ASSERT_EQUAL_INT(0, q.busy);
+}
+#endif
+
+int blit_fill(BLIT_QUEUE *q, const MI_GFX_Surface_t *dst, const MI_GFX_Rect_t *drt, uint32_t color)
+{
+    BLIT_CMD c = { 0 };
+
+    if (!q || !dst || !drt) {
+        err(SDL"invalid parameters(0x%x, 0x%x, 0x%x) in %s\n", q, dst, drt, __func__);
+        return -1;
+    }
+
+    c.type = BLIT_CMD_FILL;
+    c.color = color;
+    c.dst = *dst;
+    c.drt = *drt;
+    return add_cmd(q, &c);
+}
+
+#if defined(UT)
+TEST(sdl2_blit_miyoo, blit_fill)
+{
+    BLIT_QUEUE q = { .lock = PTHREAD_MUTEX_INITIALIZER };
+    MI_GFX_Rect_t rt = { 0, 0, 2, 2 };
+    MI_GFX_Surface_t d = { 0 };
+
+    ut_surface(&d, ut_dst, 4, 4);
+    TEST_ASSERT_EQUAL_INT(-1, blit_fill(NULL, NULL, NULL, 0));
+    TEST_ASSERT_EQUAL_INT(0, blit_fill(&q, &d, &rt, 0xff000000));
+    TEST_ASSERT_EQUAL_INT(1, q.cnt);
+    TEST_ASSERT_EQUAL_INT(BLIT_CMD_FILL, q.cmd[0].type);
+    TEST_ASSERT_EQUAL_HEX32(0xff000000, q.cmd[0].color);
+}
+#endif
+
+int blit_submit(BLIT_QUEUE *q)
+{
+    if (!q) {
+        err(SDL"invalid parameter(0x%x) in %s\n", q, __func__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    submit_cmd(q);
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+#if defined(UT)
+TEST(sdl2_blit_miyoo, blit_submit)
+{
+    int cc = 0;
+    BLIT_QUEUE q = { .lock = PTHREAD_MUTEX_INITIALIZER };
+    MI_GFX_Rect_t rt = { 0, 0, 1, 1 };
+    MI_GFX_Surface_t d = { 0 };
+
+    memset(ut_dst, 0, sizeof(ut_dst));
+    ut_surface(&d, ut_dst, 4, 4);
+    TEST_ASSERT_EQUAL_INT(-1, blit_submit(NULL));
+
+    TEST_ASSERT_EQUAL_INT(0, blit_fill(&q, &d, &rt, 0xff00ff00));
+    TEST_ASSERT_EQUAL_INT(0, blit_submit(&q));
+    TEST_ASSERT_EQUAL_INT(0, q.cnt);
+    TEST_ASSERT_EQUAL_INT(1, q.busy);
+    TEST_ASSERT_EQUAL_INT(1, q.submit);
+
+    // submitted but not retired yet
+    TEST_ASSERT_EQUAL_HEX32(0, ut_dst[0][0]);
+
+    // a full list is kicked by itself
+    for (cc = 0; cc <= BLIT_MAX_CMD; cc++) {
+        TEST_ASSERT_EQUAL_INT(0, blit_fill(&q, &d, &rt, cc));
+    }
+    TEST_ASSERT_EQUAL_INT(1, q.cnt);
+    TEST_ASSERT_EQUAL_INT(BLIT_MAX_CMD + 1, q.submit);
+    TEST_ASSERT_EQUAL_INT(0, blit_wait(&q));
+}
+#endif
+
+int blit_wait(BLIT_QUEUE *q)
+{
+    struct timeval t0 = { 0 };
+    struct timeval t1 = { 0 };
+
+    if (!q) {
+        err(SDL"invalid parameter(0x%x) in %s\n", q, __func__);
+        return -1;
+    }
+
+    // held while waiting, commands queued by the other thread must not take
+    // a newer fence before this one retires
+    pthread_mutex_lock(&q->lock);
+    if (q->cnt) {
+        submit_cmd(q);
+    }
+
+    if (q->busy) {
+        gettimeofday(&t0, NULL);
+        MI_GFX_WaitAllDone(FALSE, q->fence);
+        gettimeofday(&t1, NULL);
+
+        q->busy = 0;
+        q->wait += 1;
+        q->wait_us += ((t1.tv_sec - t0.tv_sec) * 1000000) + (t1.tv_usec - t0.tv_usec);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+#if defined(UT)
+TEST(sdl2_blit_miyoo, blit_wait)
+{
+    BLIT_QUEUE q = { .lock = PTHREAD_MUTEX_INITIALIZER };
+    MI_GFX_Opt_t opt = { 0 };
+    MI_GFX_Rect_t srt = { 0, 0, 2, 2 };
+    MI_GFX_Rect_t drt = { 1, 1, 2, 2 };
+    MI_GFX_Surface_t s = { 0 };
+    MI_GFX_Surface_t d = { 0 };
+
+    memset(ut_dst, 0, sizeof(ut_dst));
+    ut_surface(&s, ut_src, 2, 2);
+    ut_surface(&d, ut_dst, 4, 4);
+    opt.eSrcDfbBldOp = E_MI_GFX_DFB_BLD_ONE;
+
+    TEST_ASSERT_EQUAL_INT(-1, blit_wait(NULL));
+    TEST_ASSERT_EQUAL_INT(0, blit_wait(&q));
+    TEST_ASSERT_EQUAL_INT(0, q.wait);
+
+    TEST_ASSERT_EQUAL_INT(0, blit_fill(&q, &d, &srt, 9));
+    TEST_ASSERT_EQUAL_INT(0, blit_copy(&q, &s, &srt, &d, &drt, &opt));
+    TEST_ASSERT_EQUAL_INT(0, blit_submit(&q));
+    TEST_ASSERT_EQUAL_HEX32(0, ut_dst[0][0]);
+
+    // one wait retires the whole list in order
+    TEST_ASSERT_EQUAL_INT(0, blit_wait(&q));
+    TEST_ASSERT_EQUAL_INT(1, q.wait);
+    TEST_ASSERT_EQUAL_INT(0, q.busy);
+    TEST_ASSERT_EQUAL_HEX32(9, ut_dst[0][0]);
+    TEST_ASSERT_EQUAL_HEX32(1, ut_dst[1][1]);
+    TEST_ASSERT_EQUAL_HEX32(4, ut_dst[2][2]);
+
+    TEST_ASSERT_EQUAL_INT(0, blit_wait(&q));
+    TEST_ASSERT_EQUAL_INT(1, q.wait);
+}
+#endif
+
+#if defined(UT)
+#define UT_BLIT_LOOP 200
+
+static BLIT_QUEUE ut_q = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void *ut_blit_thread(void *param)
+{
+    int cc = 0;
+    MI_GFX_Rect_t rt = { 0, 0, 1, 1 };
+    MI_GFX_Surface_t d = { 0 };
+
+    ut_surface(&d, ut_dst, 4, 4);
+    for (cc = 0; cc < UT_BLIT_LOOP; cc++) {
+        blit_fill(&ut_q, &d, &rt, cc);
+        if ((cc % 7) == 0) {
+            blit_wait(&ut_q);
+        }
+    }
+    return NULL;
+}
+
+TEST(sdl2_blit_miyoo, blit_thread)
+{
+    pthread_t t[2] = { 0 };
+
+    memset(ut_dst, 0, sizeof(ut_dst));
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&t[0], NULL, ut_blit_thread, NULL));
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&t[1], NULL, ut_blit_thread, NULL));
+    pthread_join(t[0], NULL);
+    pthread_join(t[1], NULL);
+
+    // no command is lost or submitted twice when both threads share it
+    TEST_ASSERT_EQUAL_INT(0, blit_wait(&ut_q));
+    TEST_ASSERT_EQUAL_INT(UT_BLIT_LOOP * 2, ut_q.submit);
+    TEST_ASSERT_EQUAL_INT(0, ut_q.cnt);
+    TEST_ASSERT_EQUAL_INT(0, ut_q.busy);
+}
+#endif
+
+#if defined(UT)
+TEST_GROUP_RUNNER(sdl2_blit_miyoo)
+{
+    RUN_TEST_CASE(sdl2_blit_miyoo, blit_copy);
+    RUN_TEST_CASE(sdl2_blit_miyoo, blit_fill);
+    RUN_TEST_CASE(sdl2_blit_miyoo, blit_submit);
+    RUN_TEST_CASE(sdl2_blit_miyoo, blit_wait);
+    RUN_TEST_CASE(sdl2_blit_miyoo, blit_thread);
+}
+#endif
+
+#endif
+
@@ -0,0 +1,65 @@
+//
+//    NDS Emulator (DraStic) for Miyoo Handheld
+//
+//    This software is provided 'as-is', without any express or implied
+//    warranty.  In no event will the authors be held liable for any damages
+//    arising from the use of this software.
+//
+//    Permission is granted to anyone to use this software for any purpose,
+//    including commercial applications, and to alter it and redistribute it
+//    freely, subject to the following restrictions:
+//
+//    1. The origin of this software must not be misrepresented; you must not
+//       claim that you wrote the original software. If you use this software
+//       in a product, an acknowledgment in the product documentation would be
+//       appreciated but is not required.
+//    2. Altered source versions must be plainly marked as such, and must not be
+//       misrepresented as being the original software.
+//    3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef __SDL_BLIT_MIYOO_H__
+#define __SDL_BLIT_MIYOO_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+#if defined(MINI) || defined(UT)
+#include "mi_gfx.h"
+
+#define BLIT_MAX_CMD    32
+
+#define BLIT_CMD_COPY   0
+#define BLIT_CMD_FILL   1
+
+typedef struct _BLIT_CMD {
+    int type;
+    uint32_t color;
+    MI_GFX_Surface_t src;
+    MI_GFX_Rect_t srt;
+    MI_GFX_Surface_t dst;
+    MI_GFX_Rect_t drt;
+    MI_GFX_Opt_t opt;
+} BLIT_CMD;
+
+// shared by the video thread and the SDL render driver, lock serializes
+// queueing, submitting and waiting so fences are retired in order
+typedef struct _BLIT_QUEUE {
+    pthread_mutex_t lock;
+    int cnt;
+    int busy;
+    MI_U16 fence;
+    uint32_t submit;
+    uint32_t wait;
+    uint64_t wait_us;
+    BLIT_CMD cmd[BLIT_MAX_CMD];
+} BLIT_QUEUE;
+
+int blit_copy(BLIT_QUEUE *q, const MI_GFX_Surface_t *src, const MI_GFX_Rect_t *srt, const MI_GFX_Surface_t *dst, const MI_GFX_Rect_t *drt, const MI_GFX_Opt_t *opt);
+int blit_fill(BLIT_QUEUE *q, const MI_GFX_Surface_t *dst, const MI_GFX_Rect_t *drt, uint32_t color);
+int blit_submit(BLIT_QUEUE *q);
+int blit_wait(BLIT_QUEUE *q);
+#endif
+
+#endif
+
@@ -38,8 +38,11 @@
 #include "snd.h"
 #include "log.h"
 #include "hook.h"
+#include "prof.h"
+#include "mprof.h"
 #include "cfg.pb.h"
 #include "drastic.h"
+#include "thread.h"
 
 #if defined(UT)
 #include "unity_fixture.h"
@@ -773,6 +776,8 @@ static int handle_hotkey(void)
     }
 
     if (hit_hotkey(KEY_BIT_X)) {
+        dump_func_profiler(FPROF_REPORT_FILE);
+        dump_mem_profiler(MPROF_REPORT_FILE);
         set_key_bit(KEY_BIT_X, 0);
     }
 
@@ -902,6 +907,10 @@ static int input_handler(void *data)
     uint32_t left = DEV_KEY_CODE_LEFT;
     uint32_t right = DEV_KEY_CODE_RIGHT;
 
+#if !defined(UT)
+    register_thread("input", THREAD_ROLE_INPUT);
+#endif
+
     myevent.running = 1;
     while (myevent.running) {
         SDL_SemWait(myevent.lock);
@@ -1091,7 +1100,10 @@ static int input_handler(void *data)
         SDL_SemPost(myevent.lock);
         usleep(150000);
     }
-    
+
+#if !defined(UT)
+    unregister_thread();
+#endif
     return 0;
 }
 
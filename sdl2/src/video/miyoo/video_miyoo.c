@@ -19,6 +19,7 @@
 //
 
 #include <time.h>
+#include <signal.h>
 #include <dirent.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -63,13 +64,39 @@
 #include "pen.h"
 #include "drastic.h"
 #include "cfg.pb.h"
+#include "telemetry.h"
+#include "governor.h"
+#include "thread.h"
+#include "hook.h"
+#include "prof.h"
+#include "sprof.h"
+#include "mprof.h"
+#include "render.h"
+#include "file.h"
+#include "res.h"
+#include "asset.h"
+#include "gamedb.h"
+#include "profile.h"
+#include "bench.h"
 
 NDS nds = {0};
+#if defined(A30)
+GFX gfx = {
+    .present.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+#elif defined(MINI)
+GFX gfx = {
+    .blit.lock = PTHREAD_MUTEX_INITIALIZER,
+    .present.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+#else
 GFX gfx = {0};
+#endif
 MiyooVideoInfo vid = {0};
 
 extern miyoo_event myevent;
 extern miyoo_settings mycfg;
+extern miyoo_hook myhook;
 
 int FB_W = 0;
 int FB_H = 0;
@@ -85,15 +112,30 @@ SDL_Surface *fps_info = NULL;
 static volatile int is_video_thread_running = 0;
 
 static pthread_t thread;
+static volatile uint32_t emu_frame_us = 0;
+static void (*update_screen_orig)(void) = NULL;
+static char gov_game[MAX_PATH] = {0};
+static char gov_profile[MAX_PATH << 1] = {0};
+static gamedb_info_t cur_game = {0};
+static profile_stat_t cur_stat = {0};
+static int def_filter = -1;
 static int need_reload_bg = RELOAD_BG_COUNT;
 static SDL_Surface *cvt = NULL;
 
 static int MiyooVideoInit(_THIS);
 static int MiyooSetDisplayMode(_THIS, SDL_VideoDisplay *display, SDL_DisplayMode *mode);
 static void MiyooVideoQuit(_THIS);
+static int reload_governor_profile(void);
+static int init_prefetch(void);
+static int quit_prefetch(void);
 
 static CUST_MENU drastic_menu = {0};
-static char *translate[MAX_LANG_LINE] = {0};
+static PREFETCH_CTX pf = {
+    .cond = PTHREAD_COND_INITIALIZER,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+static char *lang_pool = NULL;
+static LANG_ENTRY lang_hash[LANG_HASH_SIZE] = {0};
 
 #if defined(A30)
 GLfloat bgVertices[] = {
@@ -229,144 +271,415 @@ TEST_TEAR_DOWN(sdl2_video_miyoo)
 }
 #endif
 
-static void* sdl_malloc(size_t size)
+static uint32_t get_screen_bpp(void)
 {
-    static int idx = 0;
+#if !defined(UT)
+    if (myhook.var.sdl.bpp) {
+        return *myhook.var.sdl.bpp;
+    }
+#endif
+    return nds.screen.bpp;
+}
 
-    void *r = NULL;
-    uint32_t bpp = 0;//*((uint32_t *)VAR_SDL_SCREEN_BPP);
+static int is_screen_size(size_t size)
+{
+    uint32_t bpp = get_screen_bpp();
 
-    if ((size == (NDS_W * NDS_H * bpp)) ||
-        (size == (NDS_Wx2 * NDS_Hx2 * bpp)))
-    {
-        r = gfx.lcd.virAddr[0][idx];
-        idx += 1;
-        idx %= 2;
+    if (!bpp) {
+        return 0;
     }
-    else {
-        r = malloc(size);
+    return (size == (NDS_W * NDS_H * bpp)) || (size == (NDS_Wx2 * NDS_Hx2 * bpp));
+}
+
+static size_t get_screen_size(int idx)
+{
+    int hres = nds.screen.hres_mode[idx];
+
+#if !defined(UT)
+    if (myhook.var.sdl.screen[idx].hres_mode) {
+        hres = *((uint8_t *)myhook.var.sdl.screen[idx].hres_mode);
     }
-    return r;
+#endif
+    return (hres ? (NDS_Wx2 * NDS_Hx2) : (NDS_W * NDS_H)) * get_screen_bpp();
 }
 
-static void sdl_free(void *ptr)
+static int get_screen_slot(const void *ptr)
 {
     int c0 = 0;
     int c1 = 0;
-    int found = 0;
+
+    if (!ptr) {
+        return -1;
+    }
 
     for (c0 = 0; c0 < 2; c0++) {
         for (c1 = 0; c1 < 2; c1++) {
             if (ptr == gfx.lcd.virAddr[c0][c1]) {
-                found = 1;
-                break;
+                return c1;
             }
         }
     }
+    return -1;
+}
+
+// screen sized blocks handed out by sdl_malloc, only these may be moved to
+// the ping-pong buffers since nothing else is known to come from malloc
+static int add_screen_alloc(void *ptr)
+{
+    int cc = 0;
+    void *cur = NULL;
+
+    for (cc = 0; cc < MAX_SCREEN_ALLOC; cc++) {
+        cur = NULL;
+        if (__atomic_compare_exchange_n(&gfx.lcd.alloc[cc], &cur, ptr, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int del_screen_alloc(void *ptr)
+{
+    int cc = 0;
+    void *cur = NULL;
+
+    if (!ptr) {
+        return -1;
+    }
 
-    if (found == 0) {
-        free(ptr);
+    for (cc = 0; cc < MAX_SCREEN_ALLOC; cc++) {
+        cur = ptr;
+        if (__atomic_compare_exchange_n(&gfx.lcd.alloc[cc], &cur, NULL, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            return 0;
+        }
     }
+    return -1;
 }
 
-static void* sdl_realloc(void *ptr, size_t size)
+#if defined(UT)
+TEST(sdl2_video_miyoo, add_screen_alloc)
 {
-    void *r = NULL;
-    uint32_t bpp = 0;//*((uint32_t *)VAR_SDL_SCREEN_BPP);
+    int cc = 0;
+    uint8_t buf[MAX_SCREEN_ALLOC + 1] = { 0 };
 
-    if ((size == (NDS_W * NDS_H * bpp)) ||
-        (size == (NDS_Wx2 * NDS_Hx2 * bpp)))
-    {
-        r = sdl_malloc(size);
+    memset(&gfx.lcd, 0, sizeof(gfx.lcd));
+    for (cc = 0; cc < MAX_SCREEN_ALLOC; cc++) {
+        TEST_ASSERT_EQUAL_INT(0, add_screen_alloc(&buf[cc]));
     }
-    else {
-        r = realloc(ptr, size);
+    TEST_ASSERT_EQUAL_INT(-1, add_screen_alloc(&buf[cc]));
+
+    TEST_ASSERT_EQUAL_INT(-1, del_screen_alloc(NULL));
+    TEST_ASSERT_EQUAL_INT(-1, del_screen_alloc(&buf[cc]));
+    TEST_ASSERT_EQUAL_INT(0, del_screen_alloc(&buf[1]));
+    TEST_ASSERT_EQUAL_INT(-1, del_screen_alloc(&buf[1]));
+    TEST_ASSERT_EQUAL_INT(0, add_screen_alloc(&buf[cc]));
+    memset(&gfx.lcd, 0, sizeof(gfx.lcd));
+}
+#endif
+
+static void* sdl_malloc(size_t size)
+{
+    void *r = malloc(size);
+
+    mprof_alloc(MPROF_SRC_DRASTIC, (uintptr_t)__builtin_return_address(0), r, size);
+    if (r && is_screen_size(size)) {
+        add_screen_alloc(r);
     }
     return r;
 }
 
 #if defined(UT)
-int get_bat_val(void)
+TEST(sdl2_video_miyoo, sdl_malloc)
 {
-    return 0;
+    void *p = NULL;
+
+    memset(&gfx.lcd, 0, sizeof(gfx.lcd));
+    nds.screen.bpp = 0;
+    p = sdl_malloc(NDS_W * NDS_H * 2);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL_INT(-1, del_screen_alloc(p));
+    free(p);
+
+    nds.screen.bpp = 2;
+    p = sdl_malloc(NDS_W * NDS_H * 2);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL_INT(-1, get_screen_slot(p));
+    TEST_ASSERT_EQUAL_INT(0, del_screen_alloc(p));
+    free(p);
+
+    memset(&gfx.lcd, 0, sizeof(gfx.lcd));
+    nds.screen.bpp = 0;
 }
 #endif
 
-#if defined(MINI)
-static int get_bat_val(void)
+static void sdl_free(void *ptr)
 {
-    int r = 0;
-    char buf[255] = {0};
-    uint32_t v[2] = {0};
-    struct stat st = {0};
-    const char *AXP = "/customer/app/axp_test";
+    int idx = get_screen_slot(ptr);
+
+    if (idx >= 0) {
+        __atomic_store_n(&gfx.lcd.used[idx], 0, __ATOMIC_RELEASE);
+        return;
+    }
+
+    del_screen_alloc(ptr);
+    mprof_release(ptr);
+    free(ptr);
+}
+
+#if defined(UT)
+TEST(sdl2_video_miyoo, sdl_free)
+{
+    void *p = NULL;
+    uint8_t buf[2][2][16] = { 0 };
+
+    memset(&gfx.lcd, 0, sizeof(gfx.lcd));
+    gfx.lcd.virAddr[0][0] = buf[0][0];
+    gfx.lcd.virAddr[0][1] = buf[0][1];
+    gfx.lcd.virAddr[1][0] = buf[1][0];
+    gfx.lcd.virAddr[1][1] = buf[1][1];
+    gfx.lcd.used[1] = 1;
+
+    sdl_free(NULL);
+    sdl_free(buf[1][1]);
+    TEST_ASSERT_EQUAL_INT(0, gfx.lcd.used[1]);
+
+    p = malloc(32);
+    TEST_ASSERT_EQUAL_INT(0, add_screen_alloc(p));
+    sdl_free(p);
+    TEST_ASSERT_NULL(gfx.lcd.alloc[0]);
+
+    memset(&gfx.lcd, 0, sizeof(gfx.lcd));
+}
+#endif
 
-    if (stat (AXP, &st) == 0) {
-        // {"battery":99, "voltage":4254, "charging":3}
-        FILE *fd = popen(AXP, "r");
+static void* sdl_realloc(void *ptr, size_t size)
+{
+    void *r = NULL;
+    int idx = get_screen_slot(ptr);
 
-        if (fd) {
-            fgets(buf, sizeof(buf), fd);
-            pclose(fd);
-            return (atoi(&buf[11]));
+    if (idx < 0) {
+        if (!ptr) {
+            return sdl_malloc(size);
         }
-        return 0;
-    }
 
-    if (vid.sar_fd < 0) {
-        return 0;
+        r = realloc(ptr, size);
+        if (r || !size) {
+            del_screen_alloc(ptr);
+            mprof_resize(MPROF_SRC_DRASTIC, (uintptr_t)__builtin_return_address(0), ptr, r, size);
+            if (r && is_screen_size(size)) {
+                add_screen_alloc(r);
+            }
+        }
+        return r;
     }
 
-    ioctl(vid.sar_fd, 0x6100, 0);
-    ioctl(vid.sar_fd, 0x6101, v);
-    r = 100 - (((BAT_MAX_VAL - v[1]) * 100) / (BAT_MAX_VAL - BAT_MIN_VAL));
-    if (r > 100) {
-        r = 100;
+    // the screen buffers already fit the high resolution mode
+    if (size <= SCREEN_DMA_SIZE) {
+        return ptr;
     }
-    if (r < 0) {
-        r = 0;
+
+    r = malloc(size);
+    if (r) {
+        memcpy(r, ptr, SCREEN_DMA_SIZE);
+        __atomic_store_n(&gfx.lcd.used[idx], 0, __ATOMIC_RELEASE);
+        mprof_alloc(MPROF_SRC_DRASTIC, (uintptr_t)__builtin_return_address(0), r, size);
     }
     return r;
 }
+
+#if defined(UT)
+TEST(sdl2_video_miyoo, sdl_realloc)
+{
+    void *p = NULL;
+    uint8_t *buf = malloc(SCREEN_DMA_SIZE);
+
+    TEST_ASSERT_NOT_NULL(buf);
+    memset(&gfx.lcd, 0, sizeof(gfx.lcd));
+    gfx.lcd.virAddr[0][0] = buf;
+    gfx.lcd.used[0] = 1;
+    buf[0] = 0x5a;
+
+    TEST_ASSERT_EQUAL_PTR(buf, sdl_realloc(buf, NDS_Wx2 * NDS_Hx2 * 2));
+    p = sdl_realloc(buf, SCREEN_DMA_SIZE + 4);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL_HEX8(0x5a, ((uint8_t *)p)[0]);
+    TEST_ASSERT_EQUAL_INT(0, gfx.lcd.used[0]);
+    p = sdl_realloc(p, 8);
+    TEST_ASSERT_NOT_NULL(p);
+    free(p);
+
+    nds.screen.bpp = 2;
+    p = sdl_realloc(NULL, 8);
+    TEST_ASSERT_NOT_NULL(p);
+    p = sdl_realloc(p, NDS_W * NDS_H * 2);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL_PTR(p, gfx.lcd.alloc[0]);
+    p = sdl_realloc(p, 8);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_NULL(gfx.lcd.alloc[0]);
+    free(p);
+
+    memset(&gfx.lcd, 0, sizeof(gfx.lcd));
+    nds.screen.bpp = 0;
+    free(buf);
+}
 #endif
 
-#if defined(A30)
-static int get_bat_val(void)
+#if defined(MINI) || defined(UT)
+// runs on the emu thread once DraStic finished a frame in *pixels, the frame
+// goes to set prv for the video thread and DraStic continues in set cur, a
+// screen that is not backed by the ping-pong buffers is copied instead
+static int flip_screen(void **pixels, int idx, int prv, int cur)
 {
-    static int maxv = 0;
+    void *p = NULL;
+    size_t size = 0;
 
-    FILE *fd = NULL;
-    char buf[32] = {0};
-    int r = 0;
-    int curv = 0;
+    if (!pixels || !*pixels || (idx < 0) || (idx > 1)) {
+        return -1;
+    }
+
+    p = *pixels;
+    size = get_screen_size(idx);
+    if (!size || (size > SCREEN_DMA_SIZE) || !gfx.lcd.virAddr[prv][idx] || !gfx.lcd.virAddr[cur][idx]) {
+        return -1;
+    }
 
-    if (maxv == 0) {
-        fd = popen(BAT_MAX_CMD, "r");
-        if (fd) {
-            fgets(buf, sizeof(buf), fd);
-            pclose(fd);
-            maxv = atoi(buf);
+    if (get_screen_slot(p) == idx) {
+        if (p != gfx.lcd.virAddr[prv][idx]) {
+            neon_memcpy(gfx.lcd.virAddr[prv][idx], p, size);
         }
+        *pixels = gfx.lcd.virAddr[cur][idx];
+        return 0;
     }
 
-    fd = popen(BAT_CUR_CMD, "r");
-    if (fd) {
-        fgets(buf, sizeof(buf), fd);
-        pclose(fd);
-        curv = atoi(buf);
+    neon_memcpy(gfx.lcd.virAddr[prv][idx], p, size);
+    if (del_screen_alloc(p) < 0) {
+        return 0;
     }
 
-    r = 100 - (((maxv - curv) * 100) / 1200000);
-    if (r > 100) {
-        r = 100;
+    if (__atomic_exchange_n(&gfx.lcd.used[idx], 1, __ATOMIC_ACQ_REL)) {
+        add_screen_alloc(p);
+        return 0;
     }
-    if (r < 0) {
-        r = 0;
+
+    *pixels = gfx.lcd.virAddr[cur][idx];
+    mprof_release(p);
+    free(p);
+    return 0;
+}
+#endif
+
+#if defined(UT)
+TEST(sdl2_video_miyoo, flip_screen)
+{
+    void *p = NULL;
+    void *own = NULL;
+    uint8_t *buf = malloc(SCREEN_DMA_SIZE * 4);
+
+    TEST_ASSERT_NOT_NULL(buf);
+    memset(&gfx.lcd, 0, sizeof(gfx.lcd));
+    memset(buf, 0, SCREEN_DMA_SIZE * 4);
+    gfx.lcd.virAddr[0][0] = buf;
+    gfx.lcd.virAddr[0][1] = buf + SCREEN_DMA_SIZE;
+    gfx.lcd.virAddr[1][0] = buf + (SCREEN_DMA_SIZE * 2);
+    gfx.lcd.virAddr[1][1] = buf + (SCREEN_DMA_SIZE * 3);
+    nds.screen.bpp = 2;
+
+    TEST_ASSERT_EQUAL_INT(-1, flip_screen(NULL, 0, 0, 1));
+    TEST_ASSERT_EQUAL_INT(-1, flip_screen(&p, 0, 0, 1));
+
+    // unknown memory is only copied
+    own = malloc(NDS_W * NDS_H * 2);
+    TEST_ASSERT_NOT_NULL(own);
+    memset(own, 0x11, NDS_W * NDS_H * 2);
+    p = own;
+    TEST_ASSERT_EQUAL_INT(0, flip_screen(&p, 0, 0, 1));
+    TEST_ASSERT_EQUAL_PTR(own, p);
+    TEST_ASSERT_EQUAL_HEX8(0x11, buf[(NDS_W * NDS_H * 2) - 1]);
+    TEST_ASSERT_EQUAL_INT(0, gfx.lcd.used[0]);
+    free(own);
+
+    // a screen from sdl_malloc moves to the ping-pong buffers
+    p = sdl_malloc(NDS_W * NDS_H * 2);
+    TEST_ASSERT_NOT_NULL(p);
+    memset(p, 0x22, NDS_W * NDS_H * 2);
+    TEST_ASSERT_EQUAL_INT(0, flip_screen(&p, 0, 0, 1));
+    TEST_ASSERT_EQUAL_PTR(gfx.lcd.virAddr[1][0], p);
+    TEST_ASSERT_EQUAL_HEX8(0x22, buf[0]);
+    TEST_ASSERT_EQUAL_INT(1, gfx.lcd.used[0]);
+    TEST_ASSERT_NULL(gfx.lcd.alloc[0]);
+
+    // then only the pointer flips
+    buf[SCREEN_DMA_SIZE * 2] = 0x33;
+    TEST_ASSERT_EQUAL_INT(0, flip_screen(&p, 0, 1, 0));
+    TEST_ASSERT_EQUAL_PTR(gfx.lcd.virAddr[0][0], p);
+    TEST_ASSERT_EQUAL_HEX8(0x22, buf[0]);
+
+    // the slot of this screen is taken, keep copying
+    p = sdl_malloc(NDS_W * NDS_H * 2);
+    TEST_ASSERT_NOT_NULL(p);
+    own = p;
+    TEST_ASSERT_EQUAL_INT(0, flip_screen(&p, 0, 1, 0));
+    TEST_ASSERT_EQUAL_PTR(own, p);
+    TEST_ASSERT_EQUAL_PTR(own, gfx.lcd.alloc[0]);
+    sdl_free(own);
+
+    memset(&gfx.lcd, 0, sizeof(gfx.lcd));
+    nds.screen.bpp = 0;
+    free(buf);
+}
+#endif
+
+#if !defined(UT)
+// SDL allocations of our layer, see mprof.h for how they are keyed
+static void* SDLCALL sdl_prof_malloc(size_t size)
+{
+    void *r = malloc(size);
+
+    mprof_alloc(MPROF_SRC_SDL, (uintptr_t)__builtin_return_address(0), r, size);
+    return r;
+}
+
+static void* SDLCALL sdl_prof_calloc(size_t nmemb, size_t size)
+{
+    void *r = calloc(nmemb, size);
+
+    mprof_alloc(MPROF_SRC_SDL, (uintptr_t)__builtin_return_address(0), r, nmemb * size);
+    return r;
+}
+
+static void* SDLCALL sdl_prof_realloc(void *ptr, size_t size)
+{
+    void *r = realloc(ptr, size);
+
+    if (r || !size) {
+        mprof_resize(MPROF_SRC_SDL, (uintptr_t)__builtin_return_address(0), ptr, r, size);
     }
     return r;
 }
+
+static void SDLCALL sdl_prof_free(void *ptr)
+{
+    mprof_release(ptr);
+    free(ptr);
+}
+
+// SDL only takes a new allocator before its first allocation, so it is
+// installed when libSDL2 is loaded instead of in MiyooVideoInit
+static void __attribute__((constructor)) init_sdl_mem_profiler(void)
+{
+    if (access(MPROF_ENABLE_FILE, F_OK) == 0) {
+        init_mem_profiler(0);
+        SDL_SetMemoryFunctions(sdl_prof_malloc, sdl_prof_calloc, sdl_prof_realloc, sdl_prof_free);
+    }
+}
 #endif
 
+static int get_bat_val(void)
+{
+    return get_battery_level();
+}
+
 static void write_file(const char *fname, const void *buf, int len)
 {
     struct stat st = {0};
@@ -387,7 +700,7 @@ static void write_file(const char *fname, const void *buf, int len)
     }
 }
 
-static int get_current_menu_layer(void)
+int get_current_menu_layer(void)
 {
     int cc = 0;
     const char *P0 = "Change Options";
@@ -557,8 +870,8 @@ static int draw_drastic_menu_main(void)
 
     if (draw_shot) {
         const uint32_t len = NDS_W * NDS_H * 2;
-        uint16_t *top = malloc(len);
-        uint16_t *bottom = malloc(len);
+        uint16_t *top = miyoo_malloc(len);
+        uint16_t *bottom = miyoo_malloc(len);
 
         if (top && bottom) {
             SDL_Surface *t = NULL;
@@ -590,11 +903,11 @@ static int draw_drastic_menu_main(void)
         }
 
         if (top) {
-            free(top);
+            miyoo_free(top);
         }
 
         if (bottom) {
-            free(bottom);
+            miyoo_free(bottom);
         }
     }
     return 0;
@@ -1376,8 +1689,12 @@ static int process_screen(void)
         }
     }
 
-//    nds.screen.bpp = *((uint32_t *)VAR_SDL_SCREEN_BPP);
-//    nds.screen.init = *((uint32_t *)VAR_SDL_SCREEN_NEED_INIT);
+#if !defined(UT)
+    if (myhook.var.sdl.bpp) {
+        nds.screen.bpp = *myhook.var.sdl.bpp;
+        nds.screen.init = *myhook.var.sdl.need_init;
+    }
+#endif
 
     if (need_reload_bg) {
         reload_bg();
@@ -1393,9 +1710,11 @@ static int process_screen(void)
         SDL_Rect srt = {0, 0, NDS_W, NDS_H};
         SDL_Rect drt = {0, 0, 160, 120};
 
-//        nds.screen.hres_mode[idx] = idx ?
-//            *((uint8_t *)VAR_SDL_SCREEN1_HRES_MODE):
-//            *((uint8_t *)VAR_SDL_SCREEN0_HRES_MODE);
+#if !defined(UT)
+        if (myhook.var.sdl.screen[idx].hres_mode) {
+            nds.screen.hres_mode[idx] = *((uint8_t *)myhook.var.sdl.screen[idx].hres_mode);
+        }
+#endif
 
         nds.screen.pixels[idx] = gfx.lcd.virAddr[cur_sel][idx];
         if (nds.screen.hres_mode[idx]) {
@@ -1777,18 +2096,50 @@ void sdl_blit_screen_menu(uint16_t *src, uint32_t x, uint32_t y, uint32_t w, uin
 {
 }
 
+// runs on DraStic's thread once per frame, the first call names that thread
+// and the thread cpu time between two calls is what emulating the frame took
+static void mark_emu_frame(void)
+{
+    static uint64_t pre_us = 0;
+    uint64_t cur_us = get_clock_us(CLOCK_THREAD_CPUTIME_ID);
+
+    if (pre_us == 0) {
+        register_thread("emu", THREAD_ROLE_EMU);
+    }
+    else {
+        emu_frame_us = (uint32_t)(cur_us - pre_us);
+    }
+    pre_us = cur_us;
+}
+
+// replaces DraStic's update_screen, the video thread composes the screens
+// itself, DraStic's own path through the renderer is kept for the first
+// frames and for as long as the video thread is not running
 void sdl_update_screen(void)
 {
+#if defined(MINI)
+    int idx = 0;
+#endif
     static int prepare_time = 30;
 
-    if (prepare_time) {
-        process_screen();
-        prepare_time -= 1;
+    mark_emu_frame();
+    if (prepare_time || !is_video_thread_running) {
+        if (prepare_time) {
+            prepare_time -= 1;
+        }
+        if (update_screen_orig) {
+            update_screen_orig();
+        }
     }
     else if (nds.update_screen == 0) {
         gfx.lcd.cur_sel ^= 1;
-//        *((uint32_t *)VAR_SDL_SCREEN0_PIXELS) = (uintptr_t)(gfx.lcd.virAddr[gfx.lcd.cur_sel][0]);
-//        *((uint32_t *)VAR_SDL_SCREEN1_PIXELS) = (uintptr_t)(gfx.lcd.virAddr[gfx.lcd.cur_sel][1]);
+#if defined(MINI)
+        // DraStic renders the next frame into the other set while the
+        // video thread blits this one straight from MI_SYS memory
+        for (idx = 0; idx < 2; idx++) {
+            flip_screen((void **)myhook.var.sdl.screen[idx].pixels, idx, gfx.lcd.cur_sel ^ 1, gfx.lcd.cur_sel);
+        }
+#endif
 #if defined(A30)
         nds.menu.drastic.enable = 0;
 #endif
@@ -1854,7 +2205,7 @@ void sdl_print_string(char *p, uint32_t fg, uint32_t bg, uint32_t x, uint32_t y)
 
 void sdl_savestate_pre(void)
 {
-#ifndef UT
+#if !defined(UT) && defined(__arm__)
     asm volatile (
         "mov r1, %0                 \n"
         "mov r2, #1                 \n"
@@ -1868,7 +2219,7 @@ void sdl_savestate_pre(void)
 
 void sdl_savestate_post(void)
 {
-#ifndef UT
+#if !defined(UT) && defined(__arm__)
     asm volatile (
         "mov r1, %0                 \n"
         "mov r2, #0                 \n"
@@ -1903,6 +2254,19 @@ static void strip_newline(char *p)
     }
 }
 
+// closes one composed frame, emu_frame_us comes from DraStic's thread and
+// comp_us is what the video thread spent to put the frame on the panel
+static int account_frame(uint64_t comp_us)
+{
+    int clk = 0;
+
+    mprof_next_frame();
+    clk = update_governor(emu_frame_us, (uint32_t)comp_us);
+
+    record_profile_frame(&cur_stat, (emu_frame_us > comp_us) ? emu_frame_us : (uint32_t)comp_us, clk);
+    return clk;
+}
+
 static void *video_handler(void *threadid)
 {
 #if defined(A30)
@@ -1976,6 +2340,7 @@ static void *video_handler(void *threadid)
     printf(PREFIX"Ping-pong Buffer %p\n", gfx.lcd.virAddr[1][1]);
 #endif
 
+    register_thread("video", THREAD_ROLE_VIDEO);
     while (is_video_thread_running) {
 #if defined(A30)
         if (nds.menu.enable) {
@@ -1992,13 +2357,70 @@ static void *video_handler(void *threadid)
                 GFX_Flip();
             }
         }
+        else if (gfx.present.pending) {
+            SDL_Rect rt = { 0 };
+            uint64_t comp_us = 0;
+
+            reload_governor_profile();
+            comp_us = get_clock_us(CLOCK_MONOTONIC);
+            pthread_mutex_lock(&gfx.present.lock);
+            gfx.present.pending = 0;
+            rt.w = gfx.present.w;
+            rt.h = gfx.present.h;
+            GFX_Copy(-1, gfx.present.pixels, rt, rt, gfx.present.pitch, 0, 0);
+            pthread_mutex_unlock(&gfx.present.lock);
+            GFX_Flip();
+            account_frame(get_clock_us(CLOCK_MONOTONIC) - comp_us);
+        }
+        else if (nds.update_screen) {
+#elif defined(MINI)
+        if (gfx.present.pending) {
+            uint64_t comp_us = 0;
+            MI_GFX_Opt_t opt = { 0 };
+            MI_GFX_Rect_t rt = { 0 };
+            MI_GFX_Surface_t src = { 0 };
+            MI_GFX_Surface_t dst = { 0 };
+
+            reload_governor_profile();
+            comp_us = get_clock_us(CLOCK_MONOTONIC);
+
+            // frame is already upside down, only the back page is ours to write
+            pthread_mutex_lock(&gfx.present.lock);
+            gfx.present.pending = 0;
+            src.phyAddr = gfx.present.phy;
+            src.eColorFmt = E_MI_GFX_FMT_ARGB8888;
+            src.u32Width = gfx.present.w;
+            src.u32Height = gfx.present.h;
+            src.u32Stride = gfx.present.pitch;
+            rt.u32Width = gfx.present.w;
+            rt.u32Height = gfx.present.h;
+
+            dst.phyAddr = gfx.fb.phyAddr + (FB_W * gfx.vinfo.yoffset * FB_BPP);
+            dst.eColorFmt = E_MI_GFX_FMT_ARGB8888;
+            dst.u32Width = FB_W;
+            dst.u32Height = FB_H;
+            dst.u32Stride = FB_W * FB_BPP;
+
+            opt.eRotate = E_MI_GFX_ROTATE_0;
+            opt.eMirror = E_MI_GFX_MIRROR_NONE;
+            opt.eSrcDfbBldOp = E_MI_GFX_DFB_BLD_ONE;
+            blit_copy(&gfx.blit, &src, &rt, &dst, &rt, &opt);
+            blit_submit(&gfx.blit);
+            pthread_mutex_unlock(&gfx.present.lock);
+            GFX_Flip();
+            account_frame(get_clock_us(CLOCK_MONOTONIC) - comp_us);
+        }
         else if (nds.update_screen) {
 #else
         if (nds.update_screen) {
 #endif
+            uint64_t comp_us = 0;
 
+            reload_governor_profile();
+            comp_us = get_clock_us(CLOCK_MONOTONIC);
             process_screen();
             nds.update_screen = 0;
+            account_frame(get_clock_us(CLOCK_MONOTONIC) - comp_us);
         }
         else {
             usleep(0);
@@ -2017,61 +2439,107 @@ static void *video_handler(void *threadid)
     free(gfx.lcd.virAddr[1][0]);
     free(gfx.lcd.virAddr[1][1]);
 #endif
+    unregister_thread();
     pthread_exit(NULL);
 }
 
+static uint32_t lang_hash_key(const char *p)
+{
+    uint32_t h = 0x811c9dc5;
+
+    while (*p) {
+        h ^= (uint8_t)(*p++);
+        h *= 0x01000193;
+    }
+    return h;
+}
+
 static int lang_unload(void)
 {
-    int cc = 0;
+    if (lang_pool) {
+        free(lang_pool);
+        lang_pool = NULL;
+    }
+    memset(lang_hash, 0, sizeof(lang_hash));
+    return 0;
+}
+
+static int lang_insert(char *line)
+{
+    uint32_t h = 0;
+    uint32_t pos = 0;
+    char *val = strchr(line, '=');
+
+    if ((val == NULL) || (val == line)) {
+        return -1;
+    }
+    *val++ = 0;
 
-    for (cc=0; translate[cc]; cc++) {
-        if (translate[cc]) {
-            free(translate[cc]);
+    h = lang_hash_key(line);
+    pos = h & (LANG_HASH_SIZE - 1);
+    while (lang_hash[pos].key) {
+        if ((lang_hash[pos].hash == h) && !strcmp(lang_hash[pos].key, line)) {
+            // first definition wins, as the old linear search did
+            return 0;
         }
-        translate[cc] = NULL;
+        pos = (pos + 1) & (LANG_HASH_SIZE - 1);
     }
-    memset(translate, 0, sizeof(translate));
+
+    lang_hash[pos].hash = h;
+    lang_hash[pos].key = line;
+    lang_hash[pos].val = val;
     return 0;
 }
 
 static int lang_load(const char *lang)
 {
-    FILE *f = NULL;
+    int fd = -1;
+    int cc = 0;
+    char *p = NULL;
+    char *next = NULL;
+    struct stat st = {0};
     char buf[MAX_PATH << 1] = {0};
 
     if (strcasecmp(nds.lang.trans[DEF_LANG_SLOT], DEF_LANG_LANG)) {
+        lang_unload();
         snprintf(buf, sizeof(buf), "%s/%s", nds.lang.path, lang);
-        f = fopen(buf, "r");
 
-        if (f != NULL) {
-            int cc = 0, len = 0;
+        fd = open(buf, O_RDONLY);
+        if ((fd < 0) || (fstat(fd, &st) < 0)) {
+            printf(PREFIX"Failed to open lang folder \'%s\'\n", nds.lang.path);
+            if (fd >= 0) {
+                close(fd);
+            }
+            return 0;
+        }
+
+        // one pool holds every key and translation, the table points into it
+        lang_pool = malloc(st.st_size + 1);
+        if (lang_pool == NULL) {
+            close(fd);
+            return -1;
+        }
 
-            memset(buf, 0, sizeof(buf));
-            while (fgets(buf, sizeof(buf), f)) {
-                strip_newline(buf);
-                len = strlen(buf) + 2;
-                if (len == 0) {
-                    continue;
-                }
+        if (read(fd, lang_pool, st.st_size) != st.st_size) {
+            printf(PREFIX"Failed to read lang file \'%s\'\n", buf);
+            close(fd);
+            lang_unload();
+            return -1;
+        }
+        lang_pool[st.st_size] = 0;
+        close(fd);
 
-                if (translate[cc] != NULL) {
-                    free(translate[cc]);
-                }
-                translate[cc] = malloc(len);
-                if (translate[cc] != NULL) {
-                    memcpy(translate[cc], buf, len);
-                    //printf(PREFIX"Translate: \'%s\'(len=%d)\n", translate[cc], len);
-                }
+        for (p = lang_pool; p && *p && (cc < MAX_LANG_LINE); p = next) {
+            next = strchr(p, '\n');
+            if (next) {
+                *next++ = 0;
+            }
+            strip_newline(p);
+
+            if (lang_insert(p) == 0) {
+                //printf(PREFIX"Translate: \'%s\'\n", p);
                 cc+= 1;
-                if (cc >= MAX_LANG_LINE) {
-                    break;
-                }
-                memset(buf, 0, sizeof(buf));
             }
-            fclose(f);
-        }
-        else {
-            printf(PREFIX"Failed to open lang folder \'%s\'\n", nds.lang.path);
         }
     }
     return 0;
@@ -2079,33 +2547,18 @@ static int lang_load(const char *lang)
 
 static void lang_enum(void)
 {
+    int cc = 0;
     int idx = 2;
-    DIR *d = NULL;
-    struct dirent *dir = NULL;
+    int id = get_res_id(nds.lang.path, RES_TYPE_FILE);
 
     strcpy(nds.lang.trans[DEF_LANG_SLOT], DEF_LANG_LANG);
     strcpy(nds.lang.trans[DEF_LANG_SLOT + 1], DEF_LANG_LANG);
-    d = opendir(nds.lang.path);
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            if (dir->d_type == DT_DIR) {
-                continue;
-            }
-            if (strcmp(dir->d_name, ".") == 0) {
-                continue;
-            }
-            if (strcmp(dir->d_name, "..") == 0) {
-                continue;
-            }
-
-            //printf(PREFIX"found lang \'lang[%d]=%s\'\n", idx, dir->d_name);
-            strcpy(nds.lang.trans[idx], dir->d_name);
-            idx+= 1;
-            if (idx >= MAX_LANG_FILE) {
-                break;
-            }
+    for (cc = 0; idx < MAX_LANG_FILE; cc++) {
+        if (get_res_name(id, cc, nds.lang.trans[idx], sizeof(nds.lang.trans[idx])) < 0) {
+            break;
         }
-        closedir(d);
+        //printf(PREFIX"found lang \'lang[%d]=%s\'\n", idx, nds.lang.trans[idx]);
+        idx+= 1;
     }
 }
 
@@ -2526,121 +2979,31 @@ static int set_cpuclock(uint32_t newclock)
 
 int get_dir_path(const char *path, int desire, char *buf)
 {
-    DIR *d = NULL;
-    int count = 0, r = -1;
-    struct dirent *dir = NULL;
-
-    d = opendir(path);
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            if (strcmp(dir->d_name, ".") == 0) {
-                continue;
-            }
-
-            if (strcmp(dir->d_name, "..") == 0) {
-                continue;
-            }
-
-            if (dir->d_type != DT_DIR) {
-                continue;
-            }
-
-            if (count == desire) {
-                r = snprintf(buf, MAX_PATH, "%s/%s", path, dir->d_name) ? 0 : 1;
-                break;
-            }
-            count+= 1;
-        }
-        closedir(d);
-    }
-    return r;
+    return get_res_path(get_res_id(path, RES_TYPE_DIR), desire, buf, MAX_PATH);
 }
 
 static int get_file_path(const char *path, int desire, char *buf, int add_path)
 {
-    DIR *d = NULL;
-    int count = 0, r = -1;
-    struct dirent *dir = NULL;
-
-    d = opendir(path);
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            if (strcmp(dir->d_name, ".") == 0) {
-                continue;
-            }
-
-            if (strcmp(dir->d_name, "..") == 0) {
-                continue;
-            }
-
-            if (dir->d_type == DT_DIR) {
-                continue;
-            }
+    int id = get_res_id(path, RES_TYPE_FILE);
 
-            if (count == desire) {
-                if (add_path) {
-                    r = snprintf(buf, MAX_PATH, "%s/%s", path, dir->d_name) ? 0 : 1;
-                }
-                else {
-                    r = snprintf(buf, MAX_PATH, "%s", dir->d_name) ? 0 : 1;
-                }
-                break;
-            }
-            count+= 1;
-        }
-        closedir(d);
+    if (add_path) {
+        return get_res_path(id, desire, buf, MAX_PATH);
     }
-    return r;
+    return get_res_name(id, desire, buf, MAX_PATH);
 }
 
 static int get_dir_count(const char *path)
 {
-    DIR *d = NULL;
-    int count = 0;
-    struct dirent *dir = NULL;
+    int r = get_res_count(get_res_id(path, RES_TYPE_DIR));
 
-    d = opendir(path);
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            if (dir->d_type != DT_DIR) {
-                continue;
-            }
-            if (strcmp(dir->d_name, ".") == 0) {
-                continue;
-            }
-            if (strcmp(dir->d_name, "..") == 0) {
-                continue;
-            }
-            count+= 1;
-        }
-        closedir(d);
-    }
-    return count;
+    return (r < 0) ? 0 : r;
 }
 
 static int get_file_count(const char *path)
 {
-    DIR *d = NULL;
-    int count = 0;
-    struct dirent *dir = NULL;
+    int r = get_res_count(get_res_id(path, RES_TYPE_FILE));
 
-    d = opendir(path);
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            if (dir->d_type == DT_DIR) {
-                continue;
-            }
-            if (strcmp(dir->d_name, ".") == 0) {
-                continue;
-            }
-            if (strcmp(dir->d_name, "..") == 0) {
-                continue;
-            }
-            count+= 1;
-        }
-        closedir(d);
-    }
-    return count;
+    return (r < 0) ? 0 : r;
 }
 
 static int get_theme_count(void)
@@ -2650,7 +3013,7 @@ static int get_theme_count(void)
 
 static int get_menu_count(void)
 {
-    return get_dir_count(MENU_PATH);
+    return get_dir_count(nds.menu.path);
 }
 
 static int get_pen_count(void)
@@ -2731,13 +3094,13 @@ static void set_core(int n)
         check_before_set(2, 1);
         check_before_set(3, 1);
     }
+    apply_thread_policy();
 }
 
 static int set_best_match_cpu_clock(int clk)
 {
     int cc = 0;
 
-    system("echo performance > /sys/devices/system/cpu/cpu0/cpufreq/scaling_governor");
     for (cc = 0; cc < max_cpu_item; cc++) {
         if (cpu_clock[cc].clk >= clk) {
             printf(PREFIX"Set Best Match CPU %dMHz (0x%08x)\n", cpu_clock[cc].clk, cpu_clock[cc].reg);
@@ -2795,6 +3158,7 @@ int fb_init(void)
     printf(PREFIX"DAC MMap %p\n", vid.dac_mem);
     vid.vol_ptr = (uint32_t *)(&vid.dac_mem[0xc00 + 0x258]);
 
+    system("echo performance > /sys/devices/system/cpu/cpu0/cpufreq/scaling_governor");
     set_best_match_cpu_clock(INIT_CPU_CLOCK);
     set_core(INIT_CPU_CORE);
     return 0;
@@ -2901,12 +3265,12 @@ int fb_init(void)
     MI_SYS_FlushInvCache(gfx.mask.virAddr[0], MASK_SIZE);
 #endif
 
-    vid.sar_fd = open("/dev/sar", O_RDWR);
     return 0;
 }
 
 int fb_quit(void)
 {
+    blit_wait(&gfx.blit);
     MI_SYS_Munmap(gfx.fb.virAddr, TMP_SIZE);
 
     MI_SYS_Munmap(gfx.tmp.virAddr, TMP_SIZE);
@@ -2939,18 +3303,220 @@ int fb_quit(void)
     close(gfx.fb_dev);
     gfx.fb_dev = -1;
 
-    close(vid.sar_fd);
-    vid.sar_fd = -1;
     return 0;
 }
 #endif
 
+static int set_governor_clock(int clk)
+{
+#if defined(MINI)
+    return set_cpuclock(clk);
+#endif
+
+#if defined(A30)
+    return (set_best_match_cpu_clock(clk) < 0) ? -1 : 0;
+#endif
+
+    return 0;
+}
+
+static void get_game_profile_path(const char *ext, char *buf, int len)
+{
+    snprintf(buf, len, "%s/%s/%s%s", mycfg.home_folder, PROFILE_PATH,
+        cur_game.code[0] ? cur_game.code : gov_game, ext);
+}
+
+static int save_game_suggestion(void)
+{
+    profile_t p = {0};
+    char buf[MAX_PATH << 1] = {0};
+
+    if (!gov_game[0] || (suggest_profile(&cur_stat, &p) < 0)) {
+        return -1;
+    }
+
+    get_game_profile_path(PROFILE_SUGGEST_EXT, buf, sizeof(buf));
+    printf(PREFIX"Suggested profile %s (%d~%dMHz)\n", buf, p.cpu_min, p.cpu_max);
+    return save_profile(buf, &p);
+}
+
+#if !defined(UT)
+static int apply_game_profile(void)
+{
+    profile_t p = {0};
+    char buf[MAX_PATH << 1] = {0};
+
+    if (def_filter < 0) {
+        def_filter = pixel_filter;
+    }
+
+    get_game_profile_path(PROFILE_EXT, buf, sizeof(buf));
+    load_profile(buf, &p);
+
+    nds.mincpu = (p.cpu_min != PROFILE_UNSET) ? p.cpu_min : mycfg.cpu.freq.min;
+    nds.maxcpu = (p.cpu_max != PROFILE_UNSET) ? p.cpu_max : mycfg.cpu.freq.max;
+    nds.mincpu = (nds.mincpu < GOV_HW_MIN) ? GOV_HW_MIN : nds.mincpu;
+    nds.maxcpu = (nds.maxcpu > GOV_HW_MAX) ? GOV_HW_MAX : nds.maxcpu;
+    if (nds.maxcpu < nds.mincpu) {
+        nds.maxcpu = nds.mincpu;
+    }
+    set_governor_range(nds.mincpu, nds.maxcpu);
+
+#if defined(A30)
+    set_core((p.core != PROFILE_UNSET) ? p.core : mycfg.cpu.core.max);
+#endif
+
+    nds.fast_forward = (p.fast_forward != PROFILE_UNSET) ? p.fast_forward : mycfg.fast_forward;
+    set_fast_forward(nds.fast_forward);
+    set_audio_latency((p.audio_latency != PROFILE_UNSET) ? p.audio_latency : 0);
+    pixel_filter = (p.filter != PROFILE_UNSET) ? !!p.filter : def_filter;
+
+    if (nds.hres_mode == 0) {
+        nds.dis_mode = (p.layout != PROFILE_UNSET) ? p.layout : mycfg.display.layout;
+        if ((nds.dis_mode < 0) || (nds.dis_mode > NDS_SCREEN_LAYOUT_LAST)) {
+            nds.dis_mode = NDS_SCREEN_LAYOUT_0;
+        }
+    }
+
+    printf(PREFIX"Game profile %d~%dMHz, ff %d, latency %dms, filter %d, layout %d\n",
+        nds.mincpu, nds.maxcpu, nds.fast_forward, get_audio_latency(), pixel_filter, nds.dis_mode);
+    return 0;
+}
+#endif
+
+static int reload_governor_profile(void)
+{
+#if !defined(UT)
+    char buf[MAX_PATH << 1] = {0};
+    const char *name = (const char *)myhook.var.system.gamecard_name;
+
+    if (!name || !name[0] || !strncmp(name, gov_game, sizeof(gov_game))) {
+        return 0;
+    }
+
+    save_game_suggestion();
+    reset_profile_stat(&cur_stat);
+
+    strncpy(gov_game, name, sizeof(gov_game) - 1);
+    memset(&cur_game, 0, sizeof(cur_game));
+    if (identify_game(NULL, gov_game, &cur_game) == 0) {
+        printf(PREFIX"Game \"%s\" (%s, crc32 0x%08x)\n", cur_game.title, cur_game.code, cur_game.crc32);
+    }
+
+    snprintf(buf, sizeof(buf), "%s/%s/%s.txt", mycfg.home_folder, GOV_PROFILE_PATH, gov_game);
+    if (gov_profile[0]) {
+        save_governor_profile(gov_profile);
+    }
+    strcpy(gov_profile, buf);
+    load_governor_profile(gov_profile);
+    apply_game_profile();
+#endif
+    return 0;
+}
+
+static int init_cpu_governor(void)
+{
+    int clk = 0;
+    char buf[MAX_PATH << 1] = {0};
+
+    nds.mincpu = (mycfg.cpu.freq.min < GOV_HW_MIN) ? GOV_HW_MIN : mycfg.cpu.freq.min;
+    nds.maxcpu = (mycfg.cpu.freq.max > GOV_HW_MAX) ? GOV_HW_MAX : mycfg.cpu.freq.max;
+
+#if defined(MINI)
+    clk = get_cpuclock();
+#endif
+
+#if defined(A30)
+    clk = INIT_CPU_CLOCK;
+#endif
+
+    if (init_governor(nds.mincpu, nds.maxcpu, clk, set_governor_clock) < 0) {
+        return -1;
+    }
+
+    snprintf(buf, sizeof(buf), "%s/%s", mycfg.home_folder, GOV_PROFILE_PATH);
+    mkdir(buf, 0755);
+    snprintf(buf, sizeof(buf), "%s/%s", mycfg.home_folder, PROFILE_PATH);
+    mkdir(buf, 0755);
+    if (mycfg.debug_level <= LOG_LEVEL_DEBUG) {
+        open_governor_trace(GOV_TRACE_FILE);
+    }
+    return 0;
+}
+
+static int quit_cpu_governor(void)
+{
+    save_game_suggestion();
+    reset_profile_stat(&cur_stat);
+    if (gov_profile[0]) {
+        save_governor_profile(gov_profile);
+        gov_profile[0] = 0;
+    }
+    gov_game[0] = 0;
+    return quit_governor();
+}
+
+static void log_startup_phase(const char *name)
+{
+    uint64_t now = get_clock_us(CLOCK_MONOTONIC);
+    static uint64_t first_us = 0;
+    static uint64_t last_us = 0;
+
+    if (first_us == 0) {
+        first_us = last_us = now;
+    }
+
+    printf(PREFIX"Startup phase \"%s\" took %lluus (total %lluus)\n",
+        name,
+        (unsigned long long)(now - last_us),
+        (unsigned long long)(now - first_us)
+    );
+    last_us = now;
+}
+
+static void wait_splash(void)
+{
+    int pid = 0;
+    int left = SPLASH_WAIT_MS;
+    FILE *f = NULL;
+
+    // show_hotkeys owns the framebuffer until it drops the lock file, the
+    // rest of startup has already overlapped with it by now
+    while ((left > 0) && (access(SPLASH_LOCK, F_OK) == 0)) {
+        if (pid <= 0) {
+            f = fopen(SPLASH_LOCK, "r");
+            if (f) {
+                if (fscanf(f, "%d", &pid) != 1) {
+                    pid = 0;
+                }
+                fclose(f);
+            }
+        }
+
+        if ((pid > 0) && (kill(pid, 0) < 0)) {
+            unlink(SPLASH_LOCK);
+            break;
+        }
+        usleep(10000);
+        left -= 10;
+    }
+}
+
 void GFX_Init(void)
 {
     struct stat st = {0};
     char buf[MAX_PATH << 1] = {0};
 
+    wait_splash();
+    log_startup_phase("splash");
+
     fb_init();
+    log_startup_phase("fb_init");
+
+    init_telemetry();
+    init_cpu_governor();
+    log_startup_phase("telemetry");
+
     memset(nds.pen.path, 0, sizeof(nds.pen.path));
     if (getcwd(nds.pen.path, sizeof(nds.pen.path))) {
         strcat(nds.pen.path, "/");
@@ -2991,22 +3557,15 @@ void GFX_Init(void)
     if (getcwd(nds.bios.path, sizeof(nds.bios.path))) {
         strcat(nds.bios.path, "/");
         strcat(nds.bios.path, BIOS_PATH);
-//
-//        snprintf(buf, sizeof(buf), "%s/drastic_bios_arm7.bin", nds.bios.path);
-//        write_file(buf, drastic_bios_arm7, sizeof(drastic_bios_arm7));
-//
-//        snprintf(buf, sizeof(buf), "%s/drastic_bios_arm9.bin", nds.bios.path);
-//        write_file(buf, drastic_bios_arm9, sizeof(drastic_bios_arm9));
-//
-//        snprintf(buf, sizeof(buf), "%s/nds_bios_arm7.bin", nds.bios.path);
-//        write_file(buf, nds_bios_arm7, sizeof(nds_bios_arm7));
-//
-//        snprintf(buf, sizeof(buf), "%s/nds_bios_arm9.bin", nds.bios.path);
-//        write_file(buf, nds_bios_arm9, sizeof(nds_bios_arm9));
-//
-//        snprintf(buf, sizeof(buf), "%s/nds_firmware.bin", nds.bios.path);
-//        write_file(buf, nds_firmware, sizeof(nds_firmware));
     }
+    log_startup_phase("paths");
+
+    create_bios_files();
+    log_startup_phase("bios");
+
+    snprintf(buf, sizeof(buf), "%s/%s", mycfg.home_folder, GAMEDB_FILE);
+    open_gamedb(buf);
+    log_startup_phase("gamedb");
 
     cvt = SDL_CreateRGBSurface(SDL_SWSURFACE, FB_W, FB_H, 32, 0, 0, 0, 0);
 
@@ -3020,6 +3579,9 @@ void GFX_Init(void)
 
     nds.menu.sel = 0;
     nds.menu.max = get_menu_count();
+    start_res_rescan();
+    init_prefetch();
+    log_startup_phase("resources");
 
     nds.menu.drastic.main = SDL_CreateRGBSurface(SDL_SWSURFACE, FB_W, FB_H, 32, 0, 0, 0, 0);
     if (nds.menu.drastic.main) {
@@ -3039,6 +3601,7 @@ void GFX_Init(void)
     if (nds.enable_752x560) {
         //TTF_SetFontStyle(nds.font, TTF_STYLE_BOLD);
     }
+    log_startup_phase("font");
 
     is_video_thread_running = 1;
     pthread_create(&thread, NULL, video_handler, (void *)NULL);
@@ -3052,9 +3615,15 @@ void GFX_Quit(void)
     is_video_thread_running = 0;
     pthread_join(thread, &ret);
 
+    quit_cpu_governor();
+    close_gamedb();
+    quit_prefetch();
+    quit_res_index();
+    dump_thread_stats();
     GFX_Clear();
     printf(PREFIX"Free FB resources\n");
     fb_quit();
+    quit_telemetry();
 
     if (cvt) {
         SDL_FreeSurface(cvt);
@@ -3065,6 +3634,7 @@ void GFX_Quit(void)
 void GFX_Clear(void)
 {
 #if defined(MINI)
+    blit_wait(&gfx.blit);
     MI_SYS_MemsetPa(gfx.fb.phyAddr, 0, FB_SIZE);
     MI_SYS_MemsetPa(gfx.tmp.phyAddr, 0, TMP_SIZE);
     MI_SYS_MemsetPa(gfx.lcd.phyAddr[0][0], 0, SCREEN_DMA_SIZE);
@@ -3076,7 +3646,6 @@ void GFX_Clear(void)
 
 int draw_pen(void *pixels, int width, int pitch)
 {
-#ifndef UT
     int c0 = 0;
     int c1 = 0;
     int w = 28;
@@ -3092,6 +3661,11 @@ int draw_pen(void *pixels, int width, int pitch)
     uint16_t *d_565 = (uint16_t*)pixels;
     uint32_t *d_888 = (uint32_t*)pixels;
 
+    if (!pixels || (width <= 0) || (myevent.pen.max_x <= 0) || (myevent.pen.max_y <= 0)) {
+        err(SDL"invalid parameters(0x%x, %d) in %s\n", pixels, width, __func__);
+        return -1;
+    }
+
     if ((pitch / width) == 2) {
         is_565 = 1;
     }
@@ -3155,10 +3729,10 @@ int draw_pen(void *pixels, int width, int pitch)
     glUniform1f(vid.alphaLoc, 0.0);
 #endif
 
-    asm ("PLD [%0, #128]"::"r" (s));
+    __builtin_prefetch((const uint8_t *)s + 128);
     for (c1=0; c1<h; c1++) {
-        asm ("PLD [%0, #128]"::"r" (d_565));
-        asm ("PLD [%0, #128]"::"r" (d_888));
+        __builtin_prefetch((const uint8_t *)d_565 + 128);
+        __builtin_prefetch((const uint8_t *)d_888 + 128);
         for (c0=0; c0<w; c0++) {
             x0 = x1 = (c0 * scale) + x;
             y0 = y1 = (c1 * scale) + (y - sub);
@@ -3193,10 +3767,652 @@ int draw_pen(void *pixels, int width, int pitch)
             s+= 1;
         }
     }
-#endif
     return 0;
 }
 
+#if defined(UT)
+TEST(sdl2_video_miyoo, draw_pen)
+{
+    int cc = 0;
+    int cnt = 0;
+    uint32_t *buf = NULL;
+    miyoo_event e = myevent;
+    SDL_Surface *img = nds.pen.img;
+
+    buf = malloc(NDS_W * NDS_H * 4);
+    TEST_ASSERT_NOT_NULL(buf);
+    memset(buf, 0, NDS_W * NDS_H * 4);
+
+    myevent.pen.max_x = 0;
+    TEST_ASSERT_EQUAL_INT(-1, draw_pen(buf, NDS_W, NDS_W * 4));
+
+    myevent.pen.x = 100;
+    myevent.pen.y = 100;
+    myevent.pen.max_x = NDS_W;
+    myevent.pen.max_y = NDS_H;
+    nds.pen.img = NULL;
+    nds.pen.type = PEN_LT;
+    TEST_ASSERT_EQUAL_INT(-1, draw_pen(NULL, NDS_W, NDS_W * 4));
+    TEST_ASSERT_EQUAL_INT(0, draw_pen(buf, NDS_W, NDS_W * 4));
+    for (cc = 0; cc < (NDS_W * NDS_H); cc++) {
+        cnt += buf[cc] ? 1 : 0;
+    }
+    TEST_ASSERT_TRUE(cnt > 0);
+    TEST_ASSERT_EQUAL_INT(0, buf[0]);
+
+    myevent = e;
+    nds.pen.img = img;
+    free(buf);
+}
+#endif
+
+#if defined(MINI) || defined(UT)
+static void blend_alpha(uint32_t *d, const uint32_t *s0, const void *pixels, SDL_Rect srcrect, int is_rgb565)
+{
+    float m0 = (float)nds.alpha.val / 10;
+    float m1 = 1.0 - m0;
+    uint32_t r0 = 0, g0 = 0, b0 = 0;
+    uint32_t r1 = 0, g1 = 0, b1 = 0;
+    int x = 0, y = 0, ax = 0, ay = 0, sw = 0, sh = 0;
+    const uint16_t *s1_565 = pixels;
+    const uint32_t *s1_888 = pixels;
+    uint32_t col[] = {
+        0x000000, 0xa0a0a0, 0x400000, 0x004000, 0x000040, 0x000000, 0xa0a000, 0x00a0a0
+    };
+
+    switch (nds.dis_mode) {
+    case NDS_SCREEN_LAYOUT_0:
+        sw = 170;
+        sh = 128;
+        break;
+    case NDS_SCREEN_LAYOUT_1:
+        sw = srcrect.w;
+        sh = srcrect.h;
+        break;
+    }
+
+    ay = 0;
+    for (y=0; y<sh; y++) {
+        switch (nds.dis_mode) {
+        case NDS_SCREEN_LAYOUT_0:
+            if (y && ((y % 2) == 0)) {
+                ay+= 1;
+            }
+            break;
+        }
+
+        ax = 0;
+        for (x=0; x<sw; x++) {
+            __builtin_prefetch((const uint8_t *)s0 + 128);
+            if ((nds.alpha.border > 0) && ((y == 0) || (y == (sh - 1)) || (x == 0) || (x == (sw - 1)))) {
+                *d++ = col[nds.alpha.border];
+            }
+            else {
+                switch (nds.dis_mode) {
+                case NDS_SCREEN_LAYOUT_0:
+                    if (x && ((x % 2) == 0)) {
+                        ax+= 1;
+                    }
+                    break;
+                }
+
+                if (is_rgb565) {
+                    __builtin_prefetch((const uint8_t *)s1_565 + 128);
+                    r1 = (s1_565[((y + ay) * srcrect.w) + x + ax] & 0xf800) >> 8;
+                    g1 = (s1_565[((y + ay) * srcrect.w) + x + ax] & 0x07e0) >> 3;
+                    b1 = (s1_565[((y + ay) * srcrect.w) + x + ax] & 0x001f) << 3;
+                }
+                else {
+                    __builtin_prefetch((const uint8_t *)s1_888 + 128);
+                    r1 = (s1_888[((y + ay) * srcrect.w) + x + ax] & 0xff0000) >> 16;
+                    g1 = (s1_888[((y + ay) * srcrect.w) + x + ax] & 0x00ff00) >> 8;
+                    b1 = (s1_888[((y + ay) * srcrect.w) + x + ax] & 0x0000ff) >> 0;
+                }
+
+                switch (nds.alpha.pos % 4) {
+                case 0:
+                    r0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x - 1)] & 0xff0000) >> 16;
+                    g0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x - 1)] & 0x00ff00) >> 8;
+                    b0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x - 1)] & 0x0000ff) >> 0;
+                    break;
+                case 1:
+                    r0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0xff0000) >> 16;
+                    g0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0x00ff00) >> 8;
+                    b0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0x0000ff) >> 0;
+                    break;
+                case 2:
+                    r0 = (s0[((sh - y - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0xff0000) >> 16;
+                    g0 = (s0[((sh - y - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0x00ff00) >> 8;
+                    b0 = (s0[((sh - y - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0x0000ff) >> 0;
+                    break;
+                case 3:
+                    r0 = (s0[((sh - y - 1) * FB_W) + (sw - x - 1)] & 0xff0000) >> 16;
+                    g0 = (s0[((sh - y - 1) * FB_W) + (sw - x - 1)] & 0x00ff00) >> 8;
+                    b0 = (s0[((sh - y - 1) * FB_W) + (sw - x - 1)] & 0x0000ff) >> 0;
+                    break;
+                }
+
+                r0 = (uint8_t)((r0 * m0) + (r1 * m1));
+                g0 = (uint8_t)((g0 * m0) + (g1 * m1));
+                b0 = (uint8_t)((b0 * m0) + (b1 * m1));
+                *d++ = ((r0 << 16) | (g0 << 8) | b0);
+            }
+        }
+    }
+}
+
+#if defined(UT)
+// GFX_Copy() alpha loop as it was before blend_alpha() was split out of it
+static void ut_blend_alpha_ref(uint32_t *d, const uint32_t *s0, const void *pixels, SDL_Rect srcrect, int is_rgb565)
+{
+    float m0 = (float)nds.alpha.val / 10;
+    float m1 = 1.0 - m0;
+    uint32_t r0 = 0, g0 = 0, b0 = 0;
+    uint32_t r1 = 0, g1 = 0, b1 = 0;
+    int x = 0, y = 0, ax = 0, ay = 0, sw = 0, sh = 0;
+    const uint16_t *s1_565 = pixels;
+    const uint32_t *s1_888 = pixels;
+    uint32_t col[] = {
+        0x000000, 0xa0a0a0, 0x400000, 0x004000, 0x000040, 0x000000, 0xa0a000, 0x00a0a0
+    };
+
+    switch (nds.dis_mode) {
+    case NDS_SCREEN_LAYOUT_0:
+        sw = 170;
+        sh = 128;
+        break;
+    case NDS_SCREEN_LAYOUT_1:
+        sw = srcrect.w;
+        sh = srcrect.h;
+        break;
+    }
+
+    ay = 0;
+    for (y=0; y<sh; y++) {
+        switch (nds.dis_mode) {
+        case NDS_SCREEN_LAYOUT_0:
+            if (y && ((y % 2) == 0)) {
+                ay+= 1;
+            }
+            break;
+        }
+
+        ax = 0;
+        for (x=0; x<sw; x++) {
+            __builtin_prefetch((const uint8_t *)s0 + 128);
+            if ((nds.alpha.border > 0) && ((y == 0) || (y == (sh - 1)) || (x == 0) || (x == (sw - 1)))) {
+                *d++ = col[nds.alpha.border];
+            }
+            else {
+                switch (nds.dis_mode) {
+                case NDS_SCREEN_LAYOUT_0:
+                    if (x && ((x % 2) == 0)) {
+                        ax+= 1;
+                    }
+                    break;
+                }
+
+                if (is_rgb565) {
+                    __builtin_prefetch((const uint8_t *)s1_565 + 128);
+                    r1 = (s1_565[((y + ay) * srcrect.w) + x + ax] & 0xf800) >> 8;
+                    g1 = (s1_565[((y + ay) * srcrect.w) + x + ax] & 0x07e0) >> 3;
+                    b1 = (s1_565[((y + ay) * srcrect.w) + x + ax] & 0x001f) << 3;
+                }
+                else {
+                    __builtin_prefetch((const uint8_t *)s1_888 + 128);
+                    r1 = (s1_888[((y + ay) * srcrect.w) + x + ax] & 0xff0000) >> 16;
+                    g1 = (s1_888[((y + ay) * srcrect.w) + x + ax] & 0x00ff00) >> 8;
+                    b1 = (s1_888[((y + ay) * srcrect.w) + x + ax] & 0x0000ff) >> 0;
+                }
+
+                switch (nds.alpha.pos % 4) {
+                case 0:
+                    r0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x - 1)] & 0xff0000) >> 16;
+                    g0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x - 1)] & 0x00ff00) >> 8;
+                    b0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x - 1)] & 0x0000ff) >> 0;
+                    break;
+                case 1:
+                    r0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0xff0000) >> 16;
+                    g0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0x00ff00) >> 8;
+                    b0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0x0000ff) >> 0;
+                    break;
+                case 2:
+                    r0 = (s0[((sh - y - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0xff0000) >> 16;
+                    g0 = (s0[((sh - y - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0x00ff00) >> 8;
+                    b0 = (s0[((sh - y - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0x0000ff) >> 0;
+                    break;
+                case 3:
+                    r0 = (s0[((sh - y - 1) * FB_W) + (sw - x - 1)] & 0xff0000) >> 16;
+                    g0 = (s0[((sh - y - 1) * FB_W) + (sw - x - 1)] & 0x00ff00) >> 8;
+                    b0 = (s0[((sh - y - 1) * FB_W) + (sw - x - 1)] & 0x0000ff) >> 0;
+                    break;
+                }
+
+                r0 = (uint8_t)((r0 * m0) + (r1 * m1));
+                g0 = (uint8_t)((g0 * m0) + (g1 * m1));
+                b0 = (uint8_t)((b0 * m0) + (b1 * m1));
+                *d++ = ((r0 << 16) | (g0 << 8) | b0);
+            }
+        }
+    }
+}
+
+TEST(sdl2_video_miyoo, blend_alpha)
+{
+    int cc = 0;
+    int pos = 0;
+    int mode = 0;
+    int is_565 = 0;
+    int border = 0;
+    int fb_w = FB_W;
+    int fb_h = FB_H;
+    SDL_Rect rt = { 0, 0, NDS_W, NDS_H };
+    const int modes[] = { NDS_SCREEN_LAYOUT_0, NDS_SCREEN_LAYOUT_1 };
+    const int borders[] = { 0, 2 };
+    uint32_t *fb = malloc(DEF_FB_W * DEF_FB_H * 4);
+    uint32_t *src = malloc(NDS_W * NDS_H * 4);
+    uint32_t *d0 = malloc(NDS_W * NDS_H * 4);
+    uint32_t *d1 = malloc(NDS_W * NDS_H * 4);
+
+    TEST_ASSERT_NOT_NULL(fb);
+    TEST_ASSERT_NOT_NULL(src);
+    TEST_ASSERT_NOT_NULL(d0);
+    TEST_ASSERT_NOT_NULL(d1);
+
+    srand(0x5a5a);
+    for (cc = 0; cc < (DEF_FB_W * DEF_FB_H); cc++) {
+        fb[cc] = ((uint32_t)rand() << 8) ^ (uint32_t)rand();
+    }
+    for (cc = 0; cc < (NDS_W * NDS_H); cc++) {
+        src[cc] = ((uint32_t)rand() << 8) ^ (uint32_t)rand();
+    }
+
+    FB_W = DEF_FB_W;
+    FB_H = DEF_FB_H;
+    nds.alpha.val = 7;
+    for (mode = 0; mode < 2; mode++) {
+        nds.dis_mode = modes[mode];
+        for (is_565 = 0; is_565 < 2; is_565++) {
+            for (pos = 0; pos < 4; pos++) {
+                for (border = 0; border < 2; border++) {
+                    nds.alpha.pos = pos;
+                    nds.alpha.border = borders[border];
+                    memset(d0, 0, NDS_W * NDS_H * 4);
+                    memset(d1, 0xff, NDS_W * NDS_H * 4);
+                    ut_blend_alpha_ref(d0, fb, src, rt, is_565);
+                    blend_alpha(d1, fb, src, rt, is_565);
+                    TEST_ASSERT_EQUAL_MEMORY(d0, d1, (mode ? (NDS_W * NDS_H) : (170 * 128)) * 4);
+                }
+            }
+        }
+    }
+
+    FB_W = fb_w;
+    FB_H = fb_h;
+    nds.alpha.val = 0;
+    nds.alpha.pos = 0;
+    nds.alpha.border = 0;
+    nds.dis_mode = 0;
+    free(fb);
+    free(src);
+    free(d0);
+    free(d1);
+}
+#endif
+
+static void scale_2x_888(const void *src, void *dst)
+{
+#if defined(__arm__)
+    asm volatile (
+        "0:  add r8, %1, %2         ;"
+        "1:  vldmia %0!, {q0-q3}    ;"
+        "    vldmia %0!, {q8-q11}   ;"
+        "    vdup.32 d15, d7[1]     ;"
+        "    vdup.32 d14, d7[0]     ;"
+        "    vdup.32 d13, d6[1]     ;"
+        "    vdup.32 d12, d6[0]     ;"
+        "    vdup.32 d11, d5[1]     ;"
+        "    vdup.32 d10, d5[0]     ;"
+        "    vdup.32 d9, d4[1]      ;"
+        "    vdup.32 d8, d4[0]      ;"
+        "    vdup.32 d7, d3[1]      ;"
+        "    vdup.32 d6, d3[0]      ;"
+        "    vdup.32 d5, d2[1]      ;"
+        "    vdup.32 d4, d2[0]      ;"
+        "    vdup.32 d3, d1[1]      ;"
+        "    vdup.32 d2, d1[0]      ;"
+        "    vdup.32 d1, d0[1]      ;"
+        "    vdup.32 d0, d0[0]      ;"
+        "    vdup.32 d31, d23[1]    ;"
+        "    vdup.32 d30, d23[0]    ;"
+        "    vdup.32 d29, d22[1]    ;"
+        "    vdup.32 d28, d22[0]    ;"
+        "    vdup.32 d27, d21[1]    ;"
+        "    vdup.32 d26, d21[0]    ;"
+        "    vdup.32 d25, d20[1]    ;"
+        "    vdup.32 d24, d20[0]    ;"
+        "    vdup.32 d23, d19[1]    ;"
+        "    vdup.32 d22, d19[0]    ;"
+        "    vdup.32 d21, d18[1]    ;"
+        "    vdup.32 d20, d18[0]    ;"
+        "    vdup.32 d19, d17[1]    ;"
+        "    vdup.32 d18, d17[0]    ;"
+        "    vdup.32 d17, d16[1]    ;"
+        "    vdup.32 d16, d16[0]    ;"
+        "    vstmia %1!, {q0-q7}    ;"
+        "    vstmia %1!, {q8-q15}   ;"
+        "    vstmia r8!, {q0-q7}    ;"
+        "    vstmia r8!, {q8-q15}   ;"
+        "2:  vldmia %0!, {q0-q3}    ;"
+        "    vldmia %0!, {q8-q11}   ;"
+        "    vdup.32 d15, d7[1]     ;"
+        "    vdup.32 d14, d7[0]     ;"
+        "    vdup.32 d13, d6[1]     ;"
+        "    vdup.32 d12, d6[0]     ;"
+        "    vdup.32 d11, d5[1]     ;"
+        "    vdup.32 d10, d5[0]     ;"
+        "    vdup.32 d9, d4[1]      ;"
+        "    vdup.32 d8, d4[0]      ;"
+        "    vdup.32 d7, d3[1]      ;"
+        "    vdup.32 d6, d3[0]      ;"
+        "    vdup.32 d5, d2[1]      ;"
+        "    vdup.32 d4, d2[0]      ;"
+        "    vdup.32 d3, d1[1]      ;"
+        "    vdup.32 d2, d1[0]      ;"
+        "    vdup.32 d1, d0[1]      ;"
+        "    vdup.32 d0, d0[0]      ;"
+        "    vdup.32 d31, d23[1]    ;"
+        "    vdup.32 d30, d23[0]    ;"
+        "    vdup.32 d29, d22[1]    ;"
+        "    vdup.32 d28, d22[0]    ;"
+        "    vdup.32 d27, d21[1]    ;"
+        "    vdup.32 d26, d21[0]    ;"
+        "    vdup.32 d25, d20[1]    ;"
+        "    vdup.32 d24, d20[0]    ;"
+        "    vdup.32 d23, d19[1]    ;"
+        "    vdup.32 d22, d19[0]    ;"
+        "    vdup.32 d21, d18[1]    ;"
+        "    vdup.32 d20, d18[0]    ;"
+        "    vdup.32 d19, d17[1]    ;"
+        "    vdup.32 d18, d17[0]    ;"
+        "    vdup.32 d17, d16[1]    ;"
+        "    vdup.32 d16, d16[0]    ;"
+        "    vstmia %1!, {q0-q7}    ;"
+        "    vstmia %1!, {q8-q15}   ;"
+        "    vstmia r8!, {q0-q7}    ;"
+        "    vstmia r8!, {q8-q15}   ;"
+        "3:  vldmia %0!, {q0-q3}    ;"
+        "    vldmia %0!, {q8-q11}   ;"
+        "    vdup.32 d15, d7[1]     ;"
+        "    vdup.32 d14, d7[0]     ;"
+        "    vdup.32 d13, d6[1]     ;"
+        "    vdup.32 d12, d6[0]     ;"
+        "    vdup.32 d11, d5[1]     ;"
+        "    vdup.32 d10, d5[0]     ;"
+        "    vdup.32 d9, d4[1]      ;"
+        "    vdup.32 d8, d4[0]      ;"
+        "    vdup.32 d7, d3[1]      ;"
+        "    vdup.32 d6, d3[0]      ;"
+        "    vdup.32 d5, d2[1]      ;"
+        "    vdup.32 d4, d2[0]      ;"
+        "    vdup.32 d3, d1[1]      ;"
+        "    vdup.32 d2, d1[0]      ;"
+        "    vdup.32 d1, d0[1]      ;"
+        "    vdup.32 d0, d0[0]      ;"
+        "    vdup.32 d31, d23[1]    ;"
+        "    vdup.32 d30, d23[0]    ;"
+        "    vdup.32 d29, d22[1]    ;"
+        "    vdup.32 d28, d22[0]    ;"
+        "    vdup.32 d27, d21[1]    ;"
+        "    vdup.32 d26, d21[0]    ;"
+        "    vdup.32 d25, d20[1]    ;"
+        "    vdup.32 d24, d20[0]    ;"
+        "    vdup.32 d23, d19[1]    ;"
+        "    vdup.32 d22, d19[0]    ;"
+        "    vdup.32 d21, d18[1]    ;"
+        "    vdup.32 d20, d18[0]    ;"
+        "    vdup.32 d19, d17[1]    ;"
+        "    vdup.32 d18, d17[0]    ;"
+        "    vdup.32 d17, d16[1]    ;"
+        "    vdup.32 d16, d16[0]    ;"
+        "    vstmia %1!, {q0-q7}    ;"
+        "    vstmia %1!, {q8-q15}   ;"
+        "    vstmia r8!, {q0-q7}    ;"
+        "    vstmia r8!, {q8-q15}   ;"
+        "4:  vldmia %0!, {q0-q3}    ;"
+        "    vldmia %0!, {q8-q11}   ;"
+        "    vdup.32 d15, d7[1]     ;"
+        "    vdup.32 d14, d7[0]     ;"
+        "    vdup.32 d13, d6[1]     ;"
+        "    vdup.32 d12, d6[0]     ;"
+        "    vdup.32 d11, d5[1]     ;"
+        "    vdup.32 d10, d5[0]     ;"
+        "    vdup.32 d9, d4[1]      ;"
+        "    vdup.32 d8, d4[0]      ;"
+        "    vdup.32 d7, d3[1]      ;"
+        "    vdup.32 d6, d3[0]      ;"
+        "    vdup.32 d5, d2[1]      ;"
+        "    vdup.32 d4, d2[0]      ;"
+        "    vdup.32 d3, d1[1]      ;"
+        "    vdup.32 d2, d1[0]      ;"
+        "    vdup.32 d1, d0[1]      ;"
+        "    vdup.32 d0, d0[0]      ;"
+        "    vdup.32 d31, d23[1]    ;"
+        "    vdup.32 d30, d23[0]    ;"
+        "    vdup.32 d29, d22[1]    ;"
+        "    vdup.32 d28, d22[0]    ;"
+        "    vdup.32 d27, d21[1]    ;"
+        "    vdup.32 d26, d21[0]    ;"
+        "    vdup.32 d25, d20[1]    ;"
+        "    vdup.32 d24, d20[0]    ;"
+        "    vdup.32 d23, d19[1]    ;"
+        "    vdup.32 d22, d19[0]    ;"
+        "    vdup.32 d21, d18[1]    ;"
+        "    vdup.32 d20, d18[0]    ;"
+        "    vdup.32 d19, d17[1]    ;"
+        "    vdup.32 d18, d17[0]    ;"
+        "    vdup.32 d17, d16[1]    ;"
+        "    vdup.32 d16, d16[0]    ;"
+        "    vstmia %1!, {q0-q7}    ;"
+        "    vstmia %1!, {q8-q15}   ;"
+        "    vstmia r8!, {q0-q7}    ;"
+        "    vstmia r8!, {q8-q15}   ;"
+        "5:  vldmia %0!, {q0-q3}    ;"
+        "    vldmia %0!, {q8-q11}   ;"
+        "    vdup.32 d15, d7[1]     ;"
+        "    vdup.32 d14, d7[0]     ;"
+        "    vdup.32 d13, d6[1]     ;"
+        "    vdup.32 d12, d6[0]     ;"
+        "    vdup.32 d11, d5[1]     ;"
+        "    vdup.32 d10, d5[0]     ;"
+        "    vdup.32 d9, d4[1]      ;"
+        "    vdup.32 d8, d4[0]      ;"
+        "    vdup.32 d7, d3[1]      ;"
+        "    vdup.32 d6, d3[0]      ;"
+        "    vdup.32 d5, d2[1]      ;"
+        "    vdup.32 d4, d2[0]      ;"
+        "    vdup.32 d3, d1[1]      ;"
+        "    vdup.32 d2, d1[0]      ;"
+        "    vdup.32 d1, d0[1]      ;"
+        "    vdup.32 d0, d0[0]      ;"
+        "    vdup.32 d31, d23[1]    ;"
+        "    vdup.32 d30, d23[0]    ;"
+        "    vdup.32 d29, d22[1]    ;"
+        "    vdup.32 d28, d22[0]    ;"
+        "    vdup.32 d27, d21[1]    ;"
+        "    vdup.32 d26, d21[0]    ;"
+        "    vdup.32 d25, d20[1]    ;"
+        "    vdup.32 d24, d20[0]    ;"
+        "    vdup.32 d23, d19[1]    ;"
+        "    vdup.32 d22, d19[0]    ;"
+        "    vdup.32 d21, d18[1]    ;"
+        "    vdup.32 d20, d18[0]    ;"
+        "    vdup.32 d19, d17[1]    ;"
+        "    vdup.32 d18, d17[0]    ;"
+        "    vdup.32 d17, d16[1]    ;"
+        "    vdup.32 d16, d16[0]    ;"
+        "    vstmia %1!, {q0-q7}    ;"
+        "    vstmia %1!, {q8-q15}   ;"
+        "    vstmia r8!, {q0-q7}    ;"
+        "    vstmia r8!, {q8-q15}   ;"
+        "6:  vldmia %0!, {q0-q3}    ;"
+        "    vldmia %0!, {q8-q11}   ;"
+        "    vdup.32 d15, d7[1]     ;"
+        "    vdup.32 d14, d7[0]     ;"
+        "    vdup.32 d13, d6[1]     ;"
+        "    vdup.32 d12, d6[0]     ;"
+        "    vdup.32 d11, d5[1]     ;"
+        "    vdup.32 d10, d5[0]     ;"
+        "    vdup.32 d9, d4[1]      ;"
+        "    vdup.32 d8, d4[0]      ;"
+        "    vdup.32 d7, d3[1]      ;"
+        "    vdup.32 d6, d3[0]      ;"
+        "    vdup.32 d5, d2[1]      ;"
+        "    vdup.32 d4, d2[0]      ;"
+        "    vdup.32 d3, d1[1]      ;"
+        "    vdup.32 d2, d1[0]      ;"
+        "    vdup.32 d1, d0[1]      ;"
+        "    vdup.32 d0, d0[0]      ;"
+        "    vdup.32 d31, d23[1]    ;"
+        "    vdup.32 d30, d23[0]    ;"
+        "    vdup.32 d29, d22[1]    ;"
+        "    vdup.32 d28, d22[0]    ;"
+        "    vdup.32 d27, d21[1]    ;"
+        "    vdup.32 d26, d21[0]    ;"
+        "    vdup.32 d25, d20[1]    ;"
+        "    vdup.32 d24, d20[0]    ;"
+        "    vdup.32 d23, d19[1]    ;"
+        "    vdup.32 d22, d19[0]    ;"
+        "    vdup.32 d21, d18[1]    ;"
+        "    vdup.32 d20, d18[0]    ;"
+        "    vdup.32 d19, d17[1]    ;"
+        "    vdup.32 d18, d17[0]    ;"
+        "    vdup.32 d17, d16[1]    ;"
+        "    vdup.32 d16, d16[0]    ;"
+        "    vstmia %1!, {q0-q7}    ;"
+        "    vstmia %1!, {q8-q15}   ;"
+        "    vstmia r8!, {q0-q7}    ;"
+        "    vstmia r8!, {q8-q15}   ;"
+        "7:  vldmia %0!, {q0-q3}    ;"
+        "    vldmia %0!, {q8-q11}   ;"
+        "    vdup.32 d15, d7[1]     ;"
+        "    vdup.32 d14, d7[0]     ;"
+        "    vdup.32 d13, d6[1]     ;"
+        "    vdup.32 d12, d6[0]     ;"
+        "    vdup.32 d11, d5[1]     ;"
+        "    vdup.32 d10, d5[0]     ;"
+        "    vdup.32 d9, d4[1]      ;"
+        "    vdup.32 d8, d4[0]      ;"
+        "    vdup.32 d7, d3[1]      ;"
+        "    vdup.32 d6, d3[0]      ;"
+        "    vdup.32 d5, d2[1]      ;"
+        "    vdup.32 d4, d2[0]      ;"
+        "    vdup.32 d3, d1[1]      ;"
+        "    vdup.32 d2, d1[0]      ;"
+        "    vdup.32 d1, d0[1]      ;"
+        "    vdup.32 d0, d0[0]      ;"
+        "    vdup.32 d31, d23[1]    ;"
+        "    vdup.32 d30, d23[0]    ;"
+        "    vdup.32 d29, d22[1]    ;"
+        "    vdup.32 d28, d22[0]    ;"
+        "    vdup.32 d27, d21[1]    ;"
+        "    vdup.32 d26, d21[0]    ;"
+        "    vdup.32 d25, d20[1]    ;"
+        "    vdup.32 d24, d20[0]    ;"
+        "    vdup.32 d23, d19[1]    ;"
+        "    vdup.32 d22, d19[0]    ;"
+        "    vdup.32 d21, d18[1]    ;"
+        "    vdup.32 d20, d18[0]    ;"
+        "    vdup.32 d19, d17[1]    ;"
+        "    vdup.32 d18, d17[0]    ;"
+        "    vdup.32 d17, d16[1]    ;"
+        "    vdup.32 d16, d16[0]    ;"
+        "    vstmia %1!, {q0-q7}    ;"
+        "    vstmia %1!, {q8-q15}   ;"
+        "    vstmia r8!, {q0-q7}    ;"
+        "    vstmia r8!, {q8-q15}   ;"
+        "8:  vldmia %0!, {q0-q3}    ;"
+        "    vldmia %0!, {q8-q11}   ;"
+        "    vdup.32 d15, d7[1]     ;"
+        "    vdup.32 d14, d7[0]     ;"
+        "    vdup.32 d13, d6[1]     ;"
+        "    vdup.32 d12, d6[0]     ;"
+        "    vdup.32 d11, d5[1]     ;"
+        "    vdup.32 d10, d5[0]     ;"
+        "    vdup.32 d9, d4[1]      ;"
+        "    vdup.32 d8, d4[0]      ;"
+        "    vdup.32 d7, d3[1]      ;"
+        "    vdup.32 d6, d3[0]      ;"
+        "    vdup.32 d5, d2[1]      ;"
+        "    vdup.32 d4, d2[0]      ;"
+        "    vdup.32 d3, d1[1]      ;"
+        "    vdup.32 d2, d1[0]      ;"
+        "    vdup.32 d1, d0[1]      ;"
+        "    vdup.32 d0, d0[0]      ;"
+        "    vdup.32 d31, d23[1]    ;"
+        "    vdup.32 d30, d23[0]    ;"
+        "    vdup.32 d29, d22[1]    ;"
+        "    vdup.32 d28, d22[0]    ;"
+        "    vdup.32 d27, d21[1]    ;"
+        "    vdup.32 d26, d21[0]    ;"
+        "    vdup.32 d25, d20[1]    ;"
+        "    vdup.32 d24, d20[0]    ;"
+        "    vdup.32 d23, d19[1]    ;"
+        "    vdup.32 d22, d19[0]    ;"
+        "    vdup.32 d21, d18[1]    ;"
+        "    vdup.32 d20, d18[0]    ;"
+        "    vdup.32 d19, d17[1]    ;"
+        "    vdup.32 d18, d17[0]    ;"
+        "    vdup.32 d17, d16[1]    ;"
+        "    vdup.32 d16, d16[0]    ;"
+        "    vstmia %1!, {q0-q7}    ;"
+        "    vstmia %1!, {q8-q15}   ;"
+        "    vstmia r8!, {q0-q7}    ;"
+        "    vstmia r8!, {q8-q15}   ;"
+        "    add %1, %1, %2         ;"
+        "    subs %3, #1            ;"
+        "    bne 0b                 ;"
+        :
+        : "r"(src), "r"(dst), "r"(NDS_Wx2 * 4), "r"(NDS_H)
+        : "r8", "q0", "q1", "q2", "q3", "q4", "q5", "q6", "q7", "q8", "q9", "q10", "q11", "q12", "q13", "q14", "q15", "memory", "cc"
+    );
+#else
+    // host builds against the mi stand-in
+    int x = 0, y = 0;
+    const uint32_t *s = src;
+    uint32_t *d = dst;
+
+    for (y = 0; y < NDS_H; y++) {
+        for (x = 0; x < NDS_W; x++) {
+            d[(x << 1) + 0] = s[x];
+            d[(x << 1) + 1] = s[x];
+        }
+        memcpy(d + NDS_Wx2, d, NDS_Wx2 * 4);
+        s += NDS_W;
+        d += NDS_Wx2 * 2;
+    }
+#endif
+}
+
+static void scale_2x_565(const void *src, void *dst, int w, int h)
+{
+    int x = 0, y = 0;
+    uint16_t *s0 = NULL;
+    const uint16_t *s1 = src;
+    uint16_t *d = dst;
+
+    for (y=0; y<h; y++) {
+        s0 = d;
+        for (x=0; x<w; x++) {
+            *d++ = *s1;
+            *d++ = *s1++;
+        }
+        neon_memcpy(d, s0, 1024);
+        d+= NDS_Wx2;
+    }
+}
+#endif
+
 int GFX_Copy(int id, const void *pixels, SDL_Rect srcrect, SDL_Rect dstrect, int pitch, int alpha, int rotate)
 {
 #if defined(A30)
@@ -3277,7 +4493,6 @@ int GFX_Copy(int id, const void *pixels, SDL_Rect srcrect, SDL_Rect dstrect, int
     int cc = 0;
     int copy_it = 1;
     int dma_found = 0;
-    MI_U16 u16Fence = 0;
     int is_rgb565 = (pitch / srcrect.w) == 2 ? 1 : 0;
 
     if (pixels == NULL) {
@@ -3303,98 +4518,9 @@ int GFX_Copy(int id, const void *pixels, SDL_Rect srcrect, SDL_Rect dstrect, int
         }
 
         if (nds.alpha.val > 0) {
-            float m0 = (float)nds.alpha.val / 10;
-            float m1 = 1.0 - m0;
-            uint32_t *d = gfx.tmp.virAddr;
-            uint32_t r0 = 0, g0 = 0, b0 = 0;
-            uint32_t r1 = 0, g1 = 0, b1 = 0;
-            int x = 0, y = 0, ax = 0, ay = 0, sw = 0, sh = 0;
-            const uint32_t *s0 = gfx.fb.virAddr + (FB_W * gfx.vinfo.yoffset * FB_BPP);
-            const uint16_t *s1_565 = pixels;
-            const uint32_t *s1_888 = pixels;
-            uint32_t col[] = {
-                0x000000, 0xa0a0a0, 0x400000, 0x004000, 0x000040, 0x000000, 0xa0a000, 0x00a0a0
-            };
-
-            switch (nds.dis_mode) {
-            case NDS_SCREEN_LAYOUT_0:
-                sw = 170;
-                sh = 128;
-                break;
-            case NDS_SCREEN_LAYOUT_1:
-                sw = srcrect.w;
-                sh = srcrect.h;
-                break;
-            }
-
-            ay = 0;
-            for (y=0; y<sh; y++) {
-                switch (nds.dis_mode) {
-                case NDS_SCREEN_LAYOUT_0:
-                    if (y && ((y % 2) == 0)) {
-                        ay+= 1;
-                    }
-                    break;
-                }
-
-                ax = 0;
-                for (x=0; x<sw; x++) {
-                    asm ("PLD [%0, #128]"::"r" (s0));
-                    if ((nds.alpha.border > 0) && ((y == 0) || (y == (sh - 1)) || (x == 0) || (x == (sw - 1)))) {
-                        *d++ = col[nds.alpha.border];
-                    }
-                    else {
-                        switch (nds.dis_mode) {
-                        case NDS_SCREEN_LAYOUT_0:
-                            if (x && ((x % 2) == 0)) {
-                                ax+= 1;
-                            }
-                            break;
-                        }
-
-                        if (is_rgb565) {
-                            asm ("PLD [%0, #128]"::"r" (s1_565));
-                            r1 = (s1_565[((y + ay) * srcrect.w) + x + ax] & 0xf800) >> 8;
-                            g1 = (s1_565[((y + ay) * srcrect.w) + x + ax] & 0x07e0) >> 3;
-                            b1 = (s1_565[((y + ay) * srcrect.w) + x + ax] & 0x001f) << 3;
-                        }
-                        else {
-                            asm ("PLD [%0, #128]"::"r" (s1_888));
-                            r1 = (s1_888[((y + ay) * srcrect.w) + x + ax] & 0xff0000) >> 16;
-                            g1 = (s1_888[((y + ay) * srcrect.w) + x + ax] & 0x00ff00) >> 8;
-                            b1 = (s1_888[((y + ay) * srcrect.w) + x + ax] & 0x0000ff) >> 0;
-                        }
-
-                        switch (nds.alpha.pos % 4) {
-                        case 0:
-                            r0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x - 1)] & 0xff0000) >> 16;
-                            g0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x - 1)] & 0x00ff00) >> 8;
-                            b0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x - 1)] & 0x0000ff) >> 0;
-                            break;
-                        case 1:
-                            r0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0xff0000) >> 16;
-                            g0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0x00ff00) >> 8;
-                            b0 = (s0[((sh - y + (FB_H - sh) - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0x0000ff) >> 0;
-                            break;
-                        case 2:
-                            r0 = (s0[((sh - y - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0xff0000) >> 16;
-                            g0 = (s0[((sh - y - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0x00ff00) >> 8;
-                            b0 = (s0[((sh - y - 1) * FB_W) + (sw - x + (FB_W - sw) - 1)] & 0x0000ff) >> 0;
-                            break;
-                        case 3:
-                            r0 = (s0[((sh - y - 1) * FB_W) + (sw - x - 1)] & 0xff0000) >> 16;
-                            g0 = (s0[((sh - y - 1) * FB_W) + (sw - x - 1)] & 0x00ff00) >> 8;
-                            b0 = (s0[((sh - y - 1) * FB_W) + (sw - x - 1)] & 0x0000ff) >> 0;
-                            break;
-                        }
-
-                        r0 = (uint8_t)((r0 * m0) + (r1 * m1));
-                        g0 = (uint8_t)((g0 * m0) + (g1 * m1));
-                        b0 = (uint8_t)((b0 * m0) + (b1 * m1));
-                        *d++ = ((r0 << 16) | (g0 << 8) | b0);
-                    }
-                }
-            }
+            // reads the back page and writes tmp, both may still be in use
+            blit_wait(&gfx.blit);
+            blend_alpha(gfx.tmp.virAddr, gfx.fb.virAddr + (FB_W * gfx.vinfo.yoffset * FB_BPP), pixels, srcrect, is_rgb565);
             copy_it = 0;
         }
 
@@ -3477,8 +4603,7 @@ int GFX_Copy(int id, const void *pixels, SDL_Rect srcrect, SDL_Rect dstrect, int
                     gfx.hw.dst.surf.eColorFmt = E_MI_GFX_FMT_ARGB8888;
                     gfx.hw.dst.surf.phyAddr = gfx.mask.phyAddr[1];
 
-                    MI_GFX_BitBlit(&gfx.hw.src.surf, &gfx.hw.src.rt, &gfx.hw.dst.surf, &gfx.hw.dst.rt, &gfx.hw.opt, &u16Fence);
-                    MI_GFX_WaitAllDone(FALSE, u16Fence);
+                    blit_copy(&gfx.blit, &gfx.hw.src.surf, &gfx.hw.src.rt, &gfx.hw.dst.surf, &gfx.hw.dst.rt, &gfx.hw.opt);
 
                     gfx.hw.overlay.surf.phyAddr = gfx.mask.phyAddr[0];
                     gfx.hw.overlay.surf.eColorFmt = E_MI_GFX_FMT_ARGB8888;
@@ -3501,8 +4626,7 @@ int GFX_Copy(int id, const void *pixels, SDL_Rect srcrect, SDL_Rect dstrect, int
                     gfx.hw.opt.eSrcDfbBldOp = E_MI_GFX_DFB_BLD_ONE;
                     gfx.hw.opt.eDstDfbBldOp = E_MI_GFX_DFB_BLD_INVSRCALPHA;
                     gfx.hw.opt.eDFBBlendFlag = E_MI_GFX_DFB_BLEND_SRC_PREMULTIPLY | E_MI_GFX_DFB_BLEND_COLORALPHA | E_MI_GFX_DFB_BLEND_ALPHACHANNEL;
-                    MI_GFX_BitBlit(&gfx.hw.overlay.surf, &gfx.hw.overlay.rt, &gfx.hw.dst.surf, &gfx.hw.dst.rt, &gfx.hw.opt, &u16Fence);
-                    MI_GFX_WaitAllDone(FALSE, u16Fence);
+                    blit_copy(&gfx.blit, &gfx.hw.overlay.surf, &gfx.hw.overlay.rt, &gfx.hw.dst.surf, &gfx.hw.dst.rt, &gfx.hw.opt);
 
                     copy_it = 0;
                     srcrect.x = 0;
@@ -3514,319 +4638,8 @@ int GFX_Copy(int id, const void *pixels, SDL_Rect srcrect, SDL_Rect dstrect, int
                 else
 #endif
                 {
-                    asm volatile (
-                        "0:  add r8, %1, %2         ;"
-                        "1:  vldmia %0!, {q0-q3}    ;"
-                        "    vldmia %0!, {q8-q11}   ;"
-                        "    vdup.32 d15, d7[1]     ;"
-                        "    vdup.32 d14, d7[0]     ;"
-                        "    vdup.32 d13, d6[1]     ;"
-                        "    vdup.32 d12, d6[0]     ;"
-                        "    vdup.32 d11, d5[1]     ;"
-                        "    vdup.32 d10, d5[0]     ;"
-                        "    vdup.32 d9, d4[1]      ;"
-                        "    vdup.32 d8, d4[0]      ;"
-                        "    vdup.32 d7, d3[1]      ;"
-                        "    vdup.32 d6, d3[0]      ;"
-                        "    vdup.32 d5, d2[1]      ;"
-                        "    vdup.32 d4, d2[0]      ;"
-                        "    vdup.32 d3, d1[1]      ;"
-                        "    vdup.32 d2, d1[0]      ;"
-                        "    vdup.32 d1, d0[1]      ;"
-                        "    vdup.32 d0, d0[0]      ;"
-                        "    vdup.32 d31, d23[1]    ;"
-                        "    vdup.32 d30, d23[0]    ;"
-                        "    vdup.32 d29, d22[1]    ;"
-                        "    vdup.32 d28, d22[0]    ;"
-                        "    vdup.32 d27, d21[1]    ;"
-                        "    vdup.32 d26, d21[0]    ;"
-                        "    vdup.32 d25, d20[1]    ;"
-                        "    vdup.32 d24, d20[0]    ;"
-                        "    vdup.32 d23, d19[1]    ;"
-                        "    vdup.32 d22, d19[0]    ;"
-                        "    vdup.32 d21, d18[1]    ;"
-                        "    vdup.32 d20, d18[0]    ;"
-                        "    vdup.32 d19, d17[1]    ;"
-                        "    vdup.32 d18, d17[0]    ;"
-                        "    vdup.32 d17, d16[1]    ;"
-                        "    vdup.32 d16, d16[0]    ;"
-                        "    vstmia %1!, {q0-q7}    ;"
-                        "    vstmia %1!, {q8-q15}   ;"
-                        "    vstmia r8!, {q0-q7}    ;"
-                        "    vstmia r8!, {q8-q15}   ;"
-                        "2:  vldmia %0!, {q0-q3}    ;"
-                        "    vldmia %0!, {q8-q11}   ;"
-                        "    vdup.32 d15, d7[1]     ;"
-                        "    vdup.32 d14, d7[0]     ;"
-                        "    vdup.32 d13, d6[1]     ;"
-                        "    vdup.32 d12, d6[0]     ;"
-                        "    vdup.32 d11, d5[1]     ;"
-                        "    vdup.32 d10, d5[0]     ;"
-                        "    vdup.32 d9, d4[1]      ;"
-                        "    vdup.32 d8, d4[0]      ;"
-                        "    vdup.32 d7, d3[1]      ;"
-                        "    vdup.32 d6, d3[0]      ;"
-                        "    vdup.32 d5, d2[1]      ;"
-                        "    vdup.32 d4, d2[0]      ;"
-                        "    vdup.32 d3, d1[1]      ;"
-                        "    vdup.32 d2, d1[0]      ;"
-                        "    vdup.32 d1, d0[1]      ;"
-                        "    vdup.32 d0, d0[0]      ;"
-                        "    vdup.32 d31, d23[1]    ;"
-                        "    vdup.32 d30, d23[0]    ;"
-                        "    vdup.32 d29, d22[1]    ;"
-                        "    vdup.32 d28, d22[0]    ;"
-                        "    vdup.32 d27, d21[1]    ;"
-                        "    vdup.32 d26, d21[0]    ;"
-                        "    vdup.32 d25, d20[1]    ;"
-                        "    vdup.32 d24, d20[0]    ;"
-                        "    vdup.32 d23, d19[1]    ;"
-                        "    vdup.32 d22, d19[0]    ;"
-                        "    vdup.32 d21, d18[1]    ;"
-                        "    vdup.32 d20, d18[0]    ;"
-                        "    vdup.32 d19, d17[1]    ;"
-                        "    vdup.32 d18, d17[0]    ;"
-                        "    vdup.32 d17, d16[1]    ;"
-                        "    vdup.32 d16, d16[0]    ;"
-                        "    vstmia %1!, {q0-q7}    ;"
-                        "    vstmia %1!, {q8-q15}   ;"
-                        "    vstmia r8!, {q0-q7}    ;"
-                        "    vstmia r8!, {q8-q15}   ;"
-                        "3:  vldmia %0!, {q0-q3}    ;"
-                        "    vldmia %0!, {q8-q11}   ;"
-                        "    vdup.32 d15, d7[1]     ;"
-                        "    vdup.32 d14, d7[0]     ;"
-                        "    vdup.32 d13, d6[1]     ;"
-                        "    vdup.32 d12, d6[0]     ;"
-                        "    vdup.32 d11, d5[1]     ;"
-                        "    vdup.32 d10, d5[0]     ;"
-                        "    vdup.32 d9, d4[1]      ;"
-                        "    vdup.32 d8, d4[0]      ;"
-                        "    vdup.32 d7, d3[1]      ;"
-                        "    vdup.32 d6, d3[0]      ;"
-                        "    vdup.32 d5, d2[1]      ;"
-                        "    vdup.32 d4, d2[0]      ;"
-                        "    vdup.32 d3, d1[1]      ;"
-                        "    vdup.32 d2, d1[0]      ;"
-                        "    vdup.32 d1, d0[1]      ;"
-                        "    vdup.32 d0, d0[0]      ;"
-                        "    vdup.32 d31, d23[1]    ;"
-                        "    vdup.32 d30, d23[0]    ;"
-                        "    vdup.32 d29, d22[1]    ;"
-                        "    vdup.32 d28, d22[0]    ;"
-                        "    vdup.32 d27, d21[1]    ;"
-                        "    vdup.32 d26, d21[0]    ;"
-                        "    vdup.32 d25, d20[1]    ;"
-                        "    vdup.32 d24, d20[0]    ;"
-                        "    vdup.32 d23, d19[1]    ;"
-                        "    vdup.32 d22, d19[0]    ;"
-                        "    vdup.32 d21, d18[1]    ;"
-                        "    vdup.32 d20, d18[0]    ;"
-                        "    vdup.32 d19, d17[1]    ;"
-                        "    vdup.32 d18, d17[0]    ;"
-                        "    vdup.32 d17, d16[1]    ;"
-                        "    vdup.32 d16, d16[0]    ;"
-                        "    vstmia %1!, {q0-q7}    ;"
-                        "    vstmia %1!, {q8-q15}   ;"
-                        "    vstmia r8!, {q0-q7}    ;"
-                        "    vstmia r8!, {q8-q15}   ;"
-                        "4:  vldmia %0!, {q0-q3}    ;"
-                        "    vldmia %0!, {q8-q11}   ;"
-                        "    vdup.32 d15, d7[1]     ;"
-                        "    vdup.32 d14, d7[0]     ;"
-                        "    vdup.32 d13, d6[1]     ;"
-                        "    vdup.32 d12, d6[0]     ;"
-                        "    vdup.32 d11, d5[1]     ;"
-                        "    vdup.32 d10, d5[0]     ;"
-                        "    vdup.32 d9, d4[1]      ;"
-                        "    vdup.32 d8, d4[0]      ;"
-                        "    vdup.32 d7, d3[1]      ;"
-                        "    vdup.32 d6, d3[0]      ;"
-                        "    vdup.32 d5, d2[1]      ;"
-                        "    vdup.32 d4, d2[0]      ;"
-                        "    vdup.32 d3, d1[1]      ;"
-                        "    vdup.32 d2, d1[0]      ;"
-                        "    vdup.32 d1, d0[1]      ;"
-                        "    vdup.32 d0, d0[0]      ;"
-                        "    vdup.32 d31, d23[1]    ;"
-                        "    vdup.32 d30, d23[0]    ;"
-                        "    vdup.32 d29, d22[1]    ;"
-                        "    vdup.32 d28, d22[0]    ;"
-                        "    vdup.32 d27, d21[1]    ;"
-                        "    vdup.32 d26, d21[0]    ;"
-                        "    vdup.32 d25, d20[1]    ;"
-                        "    vdup.32 d24, d20[0]    ;"
-                        "    vdup.32 d23, d19[1]    ;"
-                        "    vdup.32 d22, d19[0]    ;"
-                        "    vdup.32 d21, d18[1]    ;"
-                        "    vdup.32 d20, d18[0]    ;"
-                        "    vdup.32 d19, d17[1]    ;"
-                        "    vdup.32 d18, d17[0]    ;"
-                        "    vdup.32 d17, d16[1]    ;"
-                        "    vdup.32 d16, d16[0]    ;"
-                        "    vstmia %1!, {q0-q7}    ;"
-                        "    vstmia %1!, {q8-q15}   ;"
-                        "    vstmia r8!, {q0-q7}    ;"
-                        "    vstmia r8!, {q8-q15}   ;"
-                        "5:  vldmia %0!, {q0-q3}    ;"
-                        "    vldmia %0!, {q8-q11}   ;"
-                        "    vdup.32 d15, d7[1]     ;"
-                        "    vdup.32 d14, d7[0]     ;"
-                        "    vdup.32 d13, d6[1]     ;"
-                        "    vdup.32 d12, d6[0]     ;"
-                        "    vdup.32 d11, d5[1]     ;"
-                        "    vdup.32 d10, d5[0]     ;"
-                        "    vdup.32 d9, d4[1]      ;"
-                        "    vdup.32 d8, d4[0]      ;"
-                        "    vdup.32 d7, d3[1]      ;"
-                        "    vdup.32 d6, d3[0]      ;"
-                        "    vdup.32 d5, d2[1]      ;"
-                        "    vdup.32 d4, d2[0]      ;"
-                        "    vdup.32 d3, d1[1]      ;"
-                        "    vdup.32 d2, d1[0]      ;"
-                        "    vdup.32 d1, d0[1]      ;"
-                        "    vdup.32 d0, d0[0]      ;"
-                        "    vdup.32 d31, d23[1]    ;"
-                        "    vdup.32 d30, d23[0]    ;"
-                        "    vdup.32 d29, d22[1]    ;"
-                        "    vdup.32 d28, d22[0]    ;"
-                        "    vdup.32 d27, d21[1]    ;"
-                        "    vdup.32 d26, d21[0]    ;"
-                        "    vdup.32 d25, d20[1]    ;"
-                        "    vdup.32 d24, d20[0]    ;"
-                        "    vdup.32 d23, d19[1]    ;"
-                        "    vdup.32 d22, d19[0]    ;"
-                        "    vdup.32 d21, d18[1]    ;"
-                        "    vdup.32 d20, d18[0]    ;"
-                        "    vdup.32 d19, d17[1]    ;"
-                        "    vdup.32 d18, d17[0]    ;"
-                        "    vdup.32 d17, d16[1]    ;"
-                        "    vdup.32 d16, d16[0]    ;"
-                        "    vstmia %1!, {q0-q7}    ;"
-                        "    vstmia %1!, {q8-q15}   ;"
-                        "    vstmia r8!, {q0-q7}    ;"
-                        "    vstmia r8!, {q8-q15}   ;"
-                        "6:  vldmia %0!, {q0-q3}    ;"
-                        "    vldmia %0!, {q8-q11}   ;"
-                        "    vdup.32 d15, d7[1]     ;"
-                        "    vdup.32 d14, d7[0]     ;"
-                        "    vdup.32 d13, d6[1]     ;"
-                        "    vdup.32 d12, d6[0]     ;"
-                        "    vdup.32 d11, d5[1]     ;"
-                        "    vdup.32 d10, d5[0]     ;"
-                        "    vdup.32 d9, d4[1]      ;"
-                        "    vdup.32 d8, d4[0]      ;"
-                        "    vdup.32 d7, d3[1]      ;"
-                        "    vdup.32 d6, d3[0]      ;"
-                        "    vdup.32 d5, d2[1]      ;"
-                        "    vdup.32 d4, d2[0]      ;"
-                        "    vdup.32 d3, d1[1]      ;"
-                        "    vdup.32 d2, d1[0]      ;"
-                        "    vdup.32 d1, d0[1]      ;"
-                        "    vdup.32 d0, d0[0]      ;"
-                        "    vdup.32 d31, d23[1]    ;"
-                        "    vdup.32 d30, d23[0]    ;"
-                        "    vdup.32 d29, d22[1]    ;"
-                        "    vdup.32 d28, d22[0]    ;"
-                        "    vdup.32 d27, d21[1]    ;"
-                        "    vdup.32 d26, d21[0]    ;"
-                        "    vdup.32 d25, d20[1]    ;"
-                        "    vdup.32 d24, d20[0]    ;"
-                        "    vdup.32 d23, d19[1]    ;"
-                        "    vdup.32 d22, d19[0]    ;"
-                        "    vdup.32 d21, d18[1]    ;"
-                        "    vdup.32 d20, d18[0]    ;"
-                        "    vdup.32 d19, d17[1]    ;"
-                        "    vdup.32 d18, d17[0]    ;"
-                        "    vdup.32 d17, d16[1]    ;"
-                        "    vdup.32 d16, d16[0]    ;"
-                        "    vstmia %1!, {q0-q7}    ;"
-                        "    vstmia %1!, {q8-q15}   ;"
-                        "    vstmia r8!, {q0-q7}    ;"
-                        "    vstmia r8!, {q8-q15}   ;"
-                        "7:  vldmia %0!, {q0-q3}    ;"
-                        "    vldmia %0!, {q8-q11}   ;"
-                        "    vdup.32 d15, d7[1]     ;"
-                        "    vdup.32 d14, d7[0]     ;"
-                        "    vdup.32 d13, d6[1]     ;"
-                        "    vdup.32 d12, d6[0]     ;"
-                        "    vdup.32 d11, d5[1]     ;"
-                        "    vdup.32 d10, d5[0]     ;"
-                        "    vdup.32 d9, d4[1]      ;"
-                        "    vdup.32 d8, d4[0]      ;"
-                        "    vdup.32 d7, d3[1]      ;"
-                        "    vdup.32 d6, d3[0]      ;"
-                        "    vdup.32 d5, d2[1]      ;"
-                        "    vdup.32 d4, d2[0]      ;"
-                        "    vdup.32 d3, d1[1]      ;"
-                        "    vdup.32 d2, d1[0]      ;"
-                        "    vdup.32 d1, d0[1]      ;"
-                        "    vdup.32 d0, d0[0]      ;"
-                        "    vdup.32 d31, d23[1]    ;"
-                        "    vdup.32 d30, d23[0]    ;"
-                        "    vdup.32 d29, d22[1]    ;"
-                        "    vdup.32 d28, d22[0]    ;"
-                        "    vdup.32 d27, d21[1]    ;"
-                        "    vdup.32 d26, d21[0]    ;"
-                        "    vdup.32 d25, d20[1]    ;"
-                        "    vdup.32 d24, d20[0]    ;"
-                        "    vdup.32 d23, d19[1]    ;"
-                        "    vdup.32 d22, d19[0]    ;"
-                        "    vdup.32 d21, d18[1]    ;"
-                        "    vdup.32 d20, d18[0]    ;"
-                        "    vdup.32 d19, d17[1]    ;"
-                        "    vdup.32 d18, d17[0]    ;"
-                        "    vdup.32 d17, d16[1]    ;"
-                        "    vdup.32 d16, d16[0]    ;"
-                        "    vstmia %1!, {q0-q7}    ;"
-                        "    vstmia %1!, {q8-q15}   ;"
-                        "    vstmia r8!, {q0-q7}    ;"
-                        "    vstmia r8!, {q8-q15}   ;"
-                        "8:  vldmia %0!, {q0-q3}    ;"
-                        "    vldmia %0!, {q8-q11}   ;"
-                        "    vdup.32 d15, d7[1]     ;"
-                        "    vdup.32 d14, d7[0]     ;"
-                        "    vdup.32 d13, d6[1]     ;"
-                        "    vdup.32 d12, d6[0]     ;"
-                        "    vdup.32 d11, d5[1]     ;"
-                        "    vdup.32 d10, d5[0]     ;"
-                        "    vdup.32 d9, d4[1]      ;"
-                        "    vdup.32 d8, d4[0]      ;"
-                        "    vdup.32 d7, d3[1]      ;"
-                        "    vdup.32 d6, d3[0]      ;"
-                        "    vdup.32 d5, d2[1]      ;"
-                        "    vdup.32 d4, d2[0]      ;"
-                        "    vdup.32 d3, d1[1]      ;"
-                        "    vdup.32 d2, d1[0]      ;"
-                        "    vdup.32 d1, d0[1]      ;"
-                        "    vdup.32 d0, d0[0]      ;"
-                        "    vdup.32 d31, d23[1]    ;"
-                        "    vdup.32 d30, d23[0]    ;"
-                        "    vdup.32 d29, d22[1]    ;"
-                        "    vdup.32 d28, d22[0]    ;"
-                        "    vdup.32 d27, d21[1]    ;"
-                        "    vdup.32 d26, d21[0]    ;"
-                        "    vdup.32 d25, d20[1]    ;"
-                        "    vdup.32 d24, d20[0]    ;"
-                        "    vdup.32 d23, d19[1]    ;"
-                        "    vdup.32 d22, d19[0]    ;"
-                        "    vdup.32 d21, d18[1]    ;"
-                        "    vdup.32 d20, d18[0]    ;"
-                        "    vdup.32 d19, d17[1]    ;"
-                        "    vdup.32 d18, d17[0]    ;"
-                        "    vdup.32 d17, d16[1]    ;"
-                        "    vdup.32 d16, d16[0]    ;"
-                        "    vstmia %1!, {q0-q7}    ;"
-                        "    vstmia %1!, {q8-q15}   ;"
-                        "    vstmia r8!, {q0-q7}    ;"
-                        "    vstmia r8!, {q8-q15}   ;"
-                        "    add %1, %1, %2         ;"
-                        "    subs %3, #1            ;"
-                        "    bne 0b                 ;"
-                        :
-                        : "r"(pixels), "r"(gfx.tmp.virAddr), "r"(NDS_Wx2 * 4), "r"(NDS_H)
-                        : "r8", "q0", "q1", "q2", "q3", "q4", "q5", "q6", "q7", "q8", "q9", "q10", "q11", "q12", "q13", "q14", "q15", "memory", "cc"
-                    );
+                    blit_wait(&gfx.blit);
+                    scale_2x_888(pixels, gfx.tmp.virAddr);
 
                     copy_it = 0;
                     srcrect.x = 0;
@@ -3837,20 +4650,8 @@ int GFX_Copy(int id, const void *pixels, SDL_Rect srcrect, SDL_Rect dstrect, int
                 }
             }
             else {
-                int x = 0, y = 0;
-                uint16_t *s0 = NULL;
-                uint16_t *s1 = (uint16_t*)pixels;
-                uint16_t *d = (uint16_t*)gfx.tmp.virAddr;
-
-                for (y=0; y<srcrect.h; y++) {
-                    s0 = d;
-                    for (x=0; x<srcrect.w; x++) {
-                        *d++ = *s1;
-                        *d++ = *s1++;
-                    }
-                    neon_memcpy(d, s0, 1024);
-                    d+= NDS_Wx2;
-                }
+                blit_wait(&gfx.blit);
+                scale_2x_565(pixels, gfx.tmp.virAddr, srcrect.w, srcrect.h);
 
                 copy_it = 0;
                 srcrect.x = 0;
@@ -3864,6 +4665,8 @@ int GFX_Copy(int id, const void *pixels, SDL_Rect srcrect, SDL_Rect dstrect, int
 
     if (copy_it) {
         if (dma_found == 0) {
+            // previous screen may still be reading tmp
+            blit_wait(&gfx.blit);
             neon_memcpy(gfx.tmp.virAddr, pixels, srcrect.h * pitch);
             gfx.hw.src.surf.phyAddr = gfx.tmp.phyAddr;
             MI_SYS_FlushInvCache(gfx.tmp.virAddr, pitch * srcrect.h);
@@ -3904,8 +4707,7 @@ int GFX_Copy(int id, const void *pixels, SDL_Rect srcrect, SDL_Rect dstrect, int
     gfx.hw.dst.surf.eColorFmt = E_MI_GFX_FMT_ARGB8888;
     gfx.hw.dst.surf.phyAddr = gfx.fb.phyAddr + (FB_W * gfx.vinfo.yoffset * FB_BPP);
 
-    MI_GFX_BitBlit(&gfx.hw.src.surf, &gfx.hw.src.rt, &gfx.hw.dst.surf, &gfx.hw.dst.rt, &gfx.hw.opt, &u16Fence);
-    MI_GFX_WaitAllDone(FALSE, u16Fence);
+    blit_copy(&gfx.blit, &gfx.hw.src.surf, &gfx.hw.src.rt, &gfx.hw.dst.surf, &gfx.hw.dst.rt, &gfx.hw.opt);
 
     if ((nds.menu.enable == 0) && (srcrect.w != 800) && ((srcrect.w == NDS_W) || (srcrect.w == NDS_Wx2)) && (nds.overlay.sel < nds.overlay.max)) {
         gfx.hw.overlay.surf.phyAddr = gfx.overlay.phyAddr;
@@ -3929,9 +4731,11 @@ int GFX_Copy(int id, const void *pixels, SDL_Rect srcrect, SDL_Rect dstrect, int
         gfx.hw.opt.eSrcDfbBldOp = E_MI_GFX_DFB_BLD_ONE;
         gfx.hw.opt.eDstDfbBldOp = E_MI_GFX_DFB_BLD_INVSRCALPHA;
         gfx.hw.opt.eDFBBlendFlag = E_MI_GFX_DFB_BLEND_SRC_PREMULTIPLY | E_MI_GFX_DFB_BLEND_COLORALPHA | E_MI_GFX_DFB_BLEND_ALPHACHANNEL;
-        MI_GFX_BitBlit(&gfx.hw.overlay.surf, &gfx.hw.overlay.rt, &gfx.hw.dst.surf, &gfx.hw.dst.rt, &gfx.hw.opt, &u16Fence);
-        MI_GFX_WaitAllDone(FALSE, u16Fence);
+        blit_copy(&gfx.blit, &gfx.hw.overlay.surf, &gfx.hw.overlay.rt, &gfx.hw.dst.surf, &gfx.hw.dst.rt, &gfx.hw.opt);
     }
+
+    // kick the engine and go back to emulation, GFX_Flip() waits for it
+    blit_submit(&gfx.blit);
 #endif
     return 0;
 }
@@ -3951,11 +4755,75 @@ void GFX_Flip(void)
 #endif
 
 #if defined(MINI)
+    blit_wait(&gfx.blit);
     ioctl(gfx.fb_dev, FBIOPAN_DISPLAY, &gfx.vinfo);
     gfx.vinfo.yoffset ^= FB_H;
 #endif
 }
 
+// SDL render driver hands over a finished frame here, only the video thread
+// touches the panel so it copies the frame (phy on Mini) and flips
+int GFX_Present(const void *pixels, uint64_t phy, int w, int h, int pitch)
+{
+    if (!pixels || (w <= 0) || (h <= 0) || (pitch <= 0)) {
+        return -1;
+    }
+
+#if defined(A30) || defined(MINI)
+    // RenderPresent() is called on DraStic's thread, once per emulated frame,
+    // sdl_update_screen() already counted it when DraStic's path is hooked
+    if (!update_screen_orig) {
+        mark_emu_frame();
+    }
+
+    pthread_mutex_lock(&gfx.present.lock);
+    gfx.present.w = w;
+    gfx.present.h = h;
+    gfx.present.pitch = pitch;
+    gfx.present.phy = phy;
+    gfx.present.pixels = pixels;
+    gfx.present.pending = 1;
+    pthread_mutex_unlock(&gfx.present.lock);
+#endif
+    return 0;
+}
+
+#if defined(UT)
+TEST(sdl2_video_miyoo, GFX_Present)
+{
+    uint32_t buf[4] = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(-1, GFX_Present(NULL, 0, 2, 2, 8));
+    TEST_ASSERT_EQUAL_INT(-1, GFX_Present(buf, 0, 0, 2, 8));
+    TEST_ASSERT_EQUAL_INT(-1, GFX_Present(buf, 0, 2, 2, 0));
+    TEST_ASSERT_EQUAL_INT(0, GFX_Present(buf, 0, 2, 2, 8));
+}
+#endif
+
+// frame handed to GFX_Present() is about to be freed, once this returns the
+// video thread neither holds nor reads it
+void GFX_DropPresent(void)
+{
+#if defined(A30) || defined(MINI)
+    pthread_mutex_lock(&gfx.present.lock);
+    gfx.present.pending = 0;
+    gfx.present.pixels = NULL;
+    pthread_mutex_unlock(&gfx.present.lock);
+#endif
+
+#if defined(MINI)
+    blit_wait(&gfx.blit);
+#endif
+}
+
+#if defined(UT)
+TEST(sdl2_video_miyoo, GFX_DropPresent)
+{
+    GFX_DropPresent();
+    TEST_PASS();
+}
+#endif
+
 int get_font_width(const char *info)
 {
     int w = 0, h = 0;
@@ -3978,36 +4846,101 @@ int get_font_height(const char *info)
 
 const char *to_lang(const char *p)
 {
-    const char *info = p;
-    char buf[MAX_PATH] = {0};
-    int cc = 0, r = 0, len = 0;
-    
-    if (!strcmp(nds.lang.trans[DEF_LANG_SLOT], DEF_LANG_LANG) || (p == NULL)) {
+    uint32_t h = 0;
+    uint32_t pos = 0;
+
+    if (!strcmp(nds.lang.trans[DEF_LANG_SLOT], DEF_LANG_LANG) || (p == NULL) || (lang_pool == NULL)) {
         return p;
     }
 
-    strcpy(buf, p);
-    strcat(buf, "=");
-    len = strlen(buf);
-    if ((len == 0) || (len >= MAX_PATH)) {
-        return 0;
+    h = lang_hash_key(p);
+    pos = h & (LANG_HASH_SIZE - 1);
+    while (lang_hash[pos].key) {
+        if ((lang_hash[pos].hash == h) && !strcmp(lang_hash[pos].key, p)) {
+            return lang_hash[pos].val;
+        }
+        pos = (pos + 1) & (LANG_HASH_SIZE - 1);
     }
 
-    for (cc=0; translate[cc]; cc++) {
-        if (memcmp(buf, translate[cc], len) == 0) {
-            r = 1;
-            info = &translate[cc][len];
-            //printf(PREFIX"Translate \'%s\' as \'%s\'\n", p, info);
-            break;
+    //printf(PREFIX"Failed to find the translation: \'%s\'\n", p);
+    return p;
+}
+
+#if defined(UT)
+static const char *to_lang_linear(char **table, const char *p)
+{
+    int cc = 0;
+    int len = 0;
+    char buf[MAX_PATH] = {0};
+
+    strcpy(buf, p);
+    strcat(buf, "=");
+    len = strlen(buf);
+    for (cc = 0; table[cc]; cc++) {
+        if (memcmp(buf, table[cc], len) == 0) {
+            return &table[cc][len];
         }
     }
+    return p;
+}
 
-    if (r == 0) {
-        //printf(PREFIX"Failed to find the translation: \'%s\'(len=%d)\n", p, len);
-        info = p;
-    }
-    return info;
+TEST(sdl2_video_miyoo, to_lang)
+{
+    int cc = 0;
+    int loop = 0;
+    FILE *f = NULL;
+    uint64_t t0 = 0;
+    uint64_t t1 = 0;
+    uint64_t t2 = 0;
+    char key[32] = {0};
+    char *table[MAX_LANG_LINE + 1] = {0};
+    char line[MAX_LANG_LINE][48] = {{0}};
+    const int LOOP = 200;
+
+    strcpy(nds.lang.path, "/tmp");
+    f = fopen("/tmp/ut_lang", "w+");
+    TEST_ASSERT_NOT_NULL(f);
+    for (cc = 0; cc < MAX_LANG_LINE; cc++) {
+        snprintf(line[cc], sizeof(line[cc]), "Menu item %d=Item %d", cc, cc);
+        fprintf(f, "%s\r\n", line[cc]);
+        table[cc] = line[cc];
+    }
+    fclose(f);
+
+    strcpy(nds.lang.trans[DEF_LANG_SLOT], "ut_lang");
+    TEST_ASSERT_EQUAL_INT(0, lang_load("ut_lang"));
+    TEST_ASSERT_EQUAL_STRING("Item 0", to_lang("Menu item 0"));
+    TEST_ASSERT_EQUAL_STRING("Item 127", to_lang("Menu item 127"));
+    TEST_ASSERT_EQUAL_STRING("Not there", to_lang("Not there"));
+    TEST_ASSERT_NULL(to_lang(NULL));
+
+    // one redraw of a full menu page looks up every line once
+    t0 = get_clock_us(CLOCK_MONOTONIC);
+    for (loop = 0; loop < LOOP; loop++) {
+        for (cc = 0; cc < MAX_LANG_LINE; cc++) {
+            snprintf(key, sizeof(key), "Menu item %d", cc);
+            to_lang_linear(table, key);
+        }
+    }
+    t1 = get_clock_us(CLOCK_MONOTONIC);
+    for (loop = 0; loop < LOOP; loop++) {
+        for (cc = 0; cc < MAX_LANG_LINE; cc++) {
+            snprintf(key, sizeof(key), "Menu item %d", cc);
+            to_lang(key);
+        }
+    }
+    t2 = get_clock_us(CLOCK_MONOTONIC);
+    printf(PREFIX"to_lang per %d-line redraw: linear %lluus, hashed %lluus\n",
+        MAX_LANG_LINE,
+        (unsigned long long)((t1 - t0) / LOOP),
+        (unsigned long long)((t2 - t1) / LOOP)
+    );
+
+    strcpy(nds.lang.trans[DEF_LANG_SLOT], DEF_LANG_LANG);
+    lang_unload();
+    unlink("/tmp/ut_lang");
 }
+#endif
 
 int draw_info(SDL_Surface *dst, const char *info, int x, int y, uint32_t fgcolor, uint32_t bgcolor)
 {
@@ -4057,6 +4990,309 @@ int draw_info(SDL_Surface *dst, const char *info, int x, int y, uint32_t fgcolor
     return 0;
 }
 
+static SDL_Surface *load_image(const char *path)
+{
+    asset_t *a = NULL;
+    SDL_Surface *t = NULL;
+
+    a = malloc(sizeof(asset_t));
+    if (a && (open_asset(path, ASSET_FMT_ARGB8888, ASSET_ROTATE_0, a) == 0)) {
+        // the surface points straight at the mapped asset, free_image() unmaps it
+        t = SDL_CreateRGBSurfaceWithFormatFrom((void *)a->pixels, a->hdr->w, a->hdr->h, 32, a->hdr->pitch, SDL_PIXELFORMAT_ARGB8888);
+        if (t) {
+            t->userdata = a;
+            return t;
+        }
+        close_asset(a);
+    }
+
+    if (a) {
+        free(a);
+    }
+    return IMG_Load(path);
+}
+
+static void free_image(SDL_Surface *t)
+{
+    asset_t *a = NULL;
+
+    if (t == NULL) {
+        return;
+    }
+
+    a = (t->flags & SDL_PREALLOC) ? t->userdata : NULL;
+    SDL_FreeSurface(t);
+
+    if (a) {
+        close_asset(a);
+        free(a);
+    }
+}
+
+static const char *get_bg_file(int mode)
+{
+    switch (mode) {
+    case NDS_SCREEN_LAYOUT_0:
+    case NDS_SCREEN_LAYOUT_1:
+        return NULL;
+    case NDS_SCREEN_LAYOUT_2:
+        return "bg_s0.png";
+    case NDS_SCREEN_LAYOUT_3:
+        return NULL;
+    case NDS_SCREEN_LAYOUT_4:
+        return "bg_v0.png";
+    case NDS_SCREEN_LAYOUT_5:
+        return "bg_v1.png";
+    case NDS_SCREEN_LAYOUT_6:
+        return "bg_h0.png";
+    case NDS_SCREEN_LAYOUT_7:
+        return "bg_h1.png";
+    case NDS_SCREEN_LAYOUT_8:
+        return "bg_vh_s0.png";
+    case NDS_SCREEN_LAYOUT_9:
+        return "bg_vh_s1.png";
+    case NDS_SCREEN_LAYOUT_16:
+        return "bg_vh_s2.png";
+    case NDS_SCREEN_LAYOUT_10:
+        return "bg_vh_c0.png";
+    case NDS_SCREEN_LAYOUT_11:
+        return "bg_vh_c1.png";
+    case NDS_SCREEN_LAYOUT_12:
+    case NDS_SCREEN_LAYOUT_13:
+        return "bg_hh0.png";
+    case NDS_SCREEN_LAYOUT_17:
+        return "bg_hres0.png";
+    case NDS_SCREEN_LAYOUT_18:
+        return NULL;
+    }
+    return NULL;
+}
+
+static SDL_Surface *take_prefetch(const char *path)
+{
+    int cc = 0;
+    SDL_Surface *t = NULL;
+
+    pthread_mutex_lock(&pf.mutex);
+    for (cc = 0; cc < PREFETCH_MAX; cc++) {
+        if (pf.slot[cc].img && !strcmp(pf.slot[cc].path, path)) {
+            t = pf.slot[cc].img;
+            pf.slot[cc].img = NULL;
+            pf.slot[cc].path[0] = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pf.mutex);
+    return t;
+}
+
+static int has_prefetch(const char *path)
+{
+    int cc = 0;
+    int r = 0;
+
+    pthread_mutex_lock(&pf.mutex);
+    for (cc = 0; cc < PREFETCH_MAX; cc++) {
+        if (pf.slot[cc].img && !strcmp(pf.slot[cc].path, path)) {
+            pf.slot[cc].stamp = ++pf.stamp;
+            r = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pf.mutex);
+    return r;
+}
+
+static void put_prefetch(const char *path, SDL_Surface *img)
+{
+    int cc = 0;
+    int lru = 0;
+    SDL_Surface *old = NULL;
+
+    pthread_mutex_lock(&pf.mutex);
+    for (cc = 0; cc < PREFETCH_MAX; cc++) {
+        if (pf.slot[cc].img == NULL) {
+            lru = cc;
+            break;
+        }
+
+        if (pf.slot[cc].stamp < pf.slot[lru].stamp) {
+            lru = cc;
+        }
+    }
+
+    old = pf.slot[lru].img;
+    pf.slot[lru].img = img;
+    pf.slot[lru].stamp = ++pf.stamp;
+    snprintf(pf.slot[lru].path, sizeof(pf.slot[lru].path), "%s", path);
+    pthread_mutex_unlock(&pf.mutex);
+
+    if (old) {
+        free_image(old);
+    }
+}
+
+#if defined(UT)
+TEST(sdl2_video_miyoo, put_prefetch)
+{
+    int cc = 0;
+    char buf[32] = {0};
+    SDL_Surface *t = NULL;
+
+    for (cc = 0; cc <= PREFETCH_MAX; cc++) {
+        snprintf(buf, sizeof(buf), "%d.png", cc);
+        put_prefetch(buf, SDL_CreateRGBSurface(SDL_SWSURFACE, 1, 1, 32, 0, 0, 0, 0));
+    }
+
+    TEST_ASSERT_NULL(take_prefetch("0.png"));
+    TEST_ASSERT_EQUAL_INT(1, has_prefetch("1.png"));
+    TEST_ASSERT_EQUAL_INT(0, has_prefetch("9.png"));
+
+    t = take_prefetch("1.png");
+    TEST_ASSERT_NOT_NULL(t);
+    TEST_ASSERT_EQUAL_INT(0, has_prefetch("1.png"));
+    SDL_FreeSurface(t);
+    TEST_ASSERT_EQUAL_INT(0, quit_prefetch());
+}
+#endif
+
+static int get_prefetch_path(int type, int delta, char *buf)
+{
+    int sel = 0;
+    int max = 0;
+
+    switch (type) {
+    case PREFETCH_THEME:
+        max = nds.theme.max;
+        sel = nds.theme.sel;
+        break;
+    case PREFETCH_PEN:
+        max = nds.pen.max;
+        sel = nds.pen.sel;
+        break;
+    case PREFETCH_OVERLAY:
+        max = nds.overlay.max;
+        sel = nds.overlay.sel;
+        break;
+    }
+
+    if (max <= 1) {
+        return -1;
+    }
+    sel = (sel + delta + max) % max;
+
+    if (type == PREFETCH_THEME) {
+        if ((get_bg_file(nds.dis_mode) == NULL) || (get_dir_path(nds.theme.path, sel, buf) != 0)) {
+            return -1;
+        }
+        strcat(buf, "/");
+        strcat(buf, get_bg_file(nds.dis_mode));
+        return 0;
+    }
+    return get_file_path((type == PREFETCH_PEN) ? nds.pen.path : nds.overlay.path, sel, buf, 1);
+}
+
+static void *prefetch_handler(void *param)
+{
+    int type = 0;
+    int delta = 0;
+    SDL_Surface *t = NULL;
+    char buf[MAX_PATH << 1] = {0};
+
+    register_thread("prefetch", THREAD_ROLE_IDLE);
+
+    pthread_mutex_lock(&pf.mutex);
+    while (pf.running) {
+        if (!pf.pending) {
+            pthread_cond_wait(&pf.cond, &pf.mutex);
+            continue;
+        }
+        pf.pending = 0;
+        pthread_mutex_unlock(&pf.mutex);
+
+        // neighbours of the current selection, decoded before they are asked for
+        for (type = 0; type < PREFETCH_TYPE_MAX; type++) {
+            for (delta = -1; delta <= 1; delta += 2) {
+                memset(buf, 0, sizeof(buf));
+                if (get_prefetch_path(type, delta, buf) < 0) {
+                    continue;
+                }
+
+                if (has_prefetch(buf)) {
+                    continue;
+                }
+
+                t = load_image(buf);
+                if (t) {
+                    put_prefetch(buf, t);
+                }
+            }
+        }
+        pthread_mutex_lock(&pf.mutex);
+    }
+    pthread_mutex_unlock(&pf.mutex);
+
+    unregister_thread();
+    return NULL;
+}
+
+static void kick_prefetch(void)
+{
+    pthread_mutex_lock(&pf.mutex);
+    pf.pending = 1;
+    pthread_cond_signal(&pf.cond);
+    pthread_mutex_unlock(&pf.mutex);
+}
+
+static SDL_Surface *load_prefetch(const char *path)
+{
+    SDL_Surface *t = take_prefetch(path);
+
+    if (t == NULL) {
+        t = load_image(path);
+    }
+    kick_prefetch();
+    return t;
+}
+
+static int init_prefetch(void)
+{
+    if (pf.running) {
+        return 0;
+    }
+
+    pf.running = 1;
+    if (pthread_create(&pf.thread, NULL, prefetch_handler, NULL) != 0) {
+        printf(PREFIX"Failed to create prefetch thread\n");
+        pf.running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+static int quit_prefetch(void)
+{
+    int cc = 0;
+
+    pthread_mutex_lock(&pf.mutex);
+    if (pf.running) {
+        pf.running = 0;
+        pthread_cond_signal(&pf.cond);
+        pthread_mutex_unlock(&pf.mutex);
+        pthread_join(pf.thread, NULL);
+        pthread_mutex_lock(&pf.mutex);
+    }
+
+    for (cc = 0; cc < PREFETCH_MAX; cc++) {
+        if (pf.slot[cc].img) {
+            free_image(pf.slot[cc].img);
+        }
+        memset(&pf.slot[cc], 0, sizeof(pf.slot[cc]));
+    }
+    pthread_mutex_unlock(&pf.mutex);
+    return 0;
+}
+
 int reload_pen(void)
 {
     static int pre_sel = -1;
@@ -4074,18 +5310,23 @@ int reload_pen(void)
 
         nds.pen.type = PEN_LB;
         if (get_file_path(nds.pen.path, nds.pen.sel, buf, 1) == 0) {
-            t = IMG_Load(buf);
+            t = load_prefetch(buf);
             if (t) {
 #if defined(A30)
                 int x = 0;
                 int y = 0;
-                uint32_t *p = malloc(t->pitch * t->h);
-                uint32_t *src = t->pixels;
+                uint32_t v = 0;
+                uint32_t *p = malloc(t->w * t->h * 4);
+                uint32_t *src = NULL;
                 uint32_t *dst = p;
+                int swap = (t->format->format == SDL_PIXELFORMAT_ARGB8888);
 
+                // GL_RGBA wants R in the low byte, compiled assets are ARGB8888
                 for (y = 0; y < t->h; y++) {
+                    src = (uint32_t *)((uint8_t *)t->pixels + (y * t->pitch));
                     for (x = 0; x < t->w; x++) {
-                        *dst++ = *src++;
+                        v = *src++;
+                        *dst++ = swap ? ((v & 0xff00ff00) | ((v >> 16) & 0xff) | ((v & 0xff) << 16)) : v;
                     }
                 }
                 glBindTexture(GL_TEXTURE_2D, vid.texID[TEX_PEN]);
@@ -4098,7 +5339,7 @@ int reload_pen(void)
                 free(p);
 #endif
                 nds.pen.img = SDL_ConvertSurface(t, cvt->format, 0);
-                SDL_FreeSurface(t);
+                free_image(t);
 
                 if (strstr(buf, "_lt")) {
                     nds.pen.type = PEN_LT;
@@ -4135,43 +5376,45 @@ int reload_menu(void)
     }
 
     snprintf(buf, sizeof(buf), "%s/%s", folder, MENU_BG_FILE);
-    t = IMG_Load(buf);
+    t = load_image(buf);
     if (t) {
         if (nds.menu.bg) {
             SDL_FreeSurface(nds.menu.bg);
         }
         nds.menu.bg = SDL_ConvertSurface(t, cvt->format, 0);
-        SDL_FreeSurface(t);
+        free_image(t);
     }
 
     snprintf(buf, sizeof(buf), "%s/%s", folder, MENU_CURSOR_FILE);
-    nds.menu.cursor = IMG_Load(buf);
+    free_image(nds.menu.cursor);
+    nds.menu.cursor = load_image(buf);
 
     snprintf(buf, sizeof(buf), "%s/%s", folder, DRASTIC_MENU_BG0_FILE);
-    t = IMG_Load(buf);
+    t = load_image(buf);
     if (t) {
         if (nds.menu.drastic.bg0) {
             SDL_FreeSurface(nds.menu.drastic.bg0);
         }
         nds.menu.drastic.bg0 = SDL_ConvertSurface(t, cvt->format, 0);
-        SDL_FreeSurface(t);
+        free_image(t);
     }
 
     snprintf(buf, sizeof(buf), "%s/%s", folder, DRASTIC_MENU_BG1_FILE);
-    t = IMG_Load(buf);
+    t = load_image(buf);
     if (t) {
         if (nds.menu.drastic.bg1) {
             SDL_FreeSurface(nds.menu.drastic.bg1);
         }
         nds.menu.drastic.bg1 = SDL_ConvertSurface(t, cvt->format, 0);
-        SDL_FreeSurface(t);
+        free_image(t);
     }
 
     snprintf(buf, sizeof(buf), "%s/%s", folder, DRASTIC_MENU_CURSOR_FILE);
-    nds.menu.drastic.cursor = IMG_Load(buf);
+    free_image(nds.menu.drastic.cursor);
+    nds.menu.drastic.cursor = load_image(buf);
 
     snprintf(buf, sizeof(buf), "%s/%s", folder, DRASTIC_MENU_YES_FILE);
-    t = IMG_Load(buf);
+    t = load_image(buf);
     if (t) {
         SDL_Rect nrt = {0, 0, LINE_H - 2, LINE_H - 2};
         if (nds.menu.drastic.yes) {
@@ -4181,11 +5424,11 @@ int reload_menu(void)
         if (nds.menu.drastic.yes) {
             SDL_SoftStretch(t, NULL, nds.menu.drastic.yes, NULL);
         }
-        SDL_FreeSurface(t);
+        free_image(t);
     }
 
     snprintf(buf, sizeof(buf), "%s/%s", folder, DRASTIC_MENU_NO_FILE);
-    t = IMG_Load(buf);
+    t = load_image(buf);
     if (t) {
         SDL_Rect nrt = {0, 0, LINE_H - 2, LINE_H - 2};
         if (nds.menu.drastic.no) {
@@ -4195,7 +5438,7 @@ int reload_menu(void)
         if (nds.menu.drastic.no) {
             SDL_SoftStretch(t, NULL, nds.menu.drastic.no, NULL);
         }
-        SDL_FreeSurface(t);
+        free_image(t);
     }
 
     return 0;
@@ -4231,57 +5474,16 @@ int reload_bg(void)
                 SDL_FillRect(nds.theme.img, &nds.theme.img->clip_rect, SDL_MapRGB(nds.theme.img->format, 0x00, 0x00, 0x00));
 
                 if (get_dir_path(nds.theme.path, nds.theme.sel, buf) == 0) {
-                    switch (nds.dis_mode) {
-                    case NDS_SCREEN_LAYOUT_0:
-                    case NDS_SCREEN_LAYOUT_1:
-                        return 0;
-                    case NDS_SCREEN_LAYOUT_2:
-                        strcat(buf, "/bg_s0.png");
-                        break;
-                    case NDS_SCREEN_LAYOUT_3:
-                        return 0;
-                    case NDS_SCREEN_LAYOUT_4:
-                        strcat(buf, "/bg_v0.png");
-                        break;
-                    case NDS_SCREEN_LAYOUT_5:
-                        strcat(buf, "/bg_v1.png");
-                        break;
-                    case NDS_SCREEN_LAYOUT_6:
-                        strcat(buf, "/bg_h0.png");
-                        break;
-                    case NDS_SCREEN_LAYOUT_7:
-                        strcat(buf, "/bg_h1.png");
-                        break;
-                    case NDS_SCREEN_LAYOUT_8:
-                        strcat(buf, "/bg_vh_s0.png");
-                        break;
-                    case NDS_SCREEN_LAYOUT_9:
-                        strcat(buf, "/bg_vh_s1.png");
-                        break;
-                    case NDS_SCREEN_LAYOUT_16:
-                        strcat(buf, "/bg_vh_s2.png");
-                        break;
-                    case NDS_SCREEN_LAYOUT_10:
-                        strcat(buf, "/bg_vh_c0.png");
-                        break;
-                    case NDS_SCREEN_LAYOUT_11:
-                        strcat(buf, "/bg_vh_c1.png");
-                        break;
-                    case NDS_SCREEN_LAYOUT_12:
-                    case NDS_SCREEN_LAYOUT_13:
-                        strcat(buf, "/bg_hh0.png");
-                        break;
-                    case NDS_SCREEN_LAYOUT_17:
-                        strcat(buf, "/bg_hres0.png");
-                        break;
-                    case NDS_SCREEN_LAYOUT_18:
+                    if (get_bg_file(nds.dis_mode) == NULL) {
                         return 0;
                     }
-                    
-                    t = IMG_Load(buf);
+                    strcat(buf, "/");
+                    strcat(buf, get_bg_file(nds.dis_mode));
+
+                    t = load_prefetch(buf);
                     if (t) {
                         SDL_BlitSurface(t, NULL, nds.theme.img, NULL);
-                        SDL_FreeSurface(t);
+                        free_image(t);
 #if !defined(A30)
                         GFX_Copy(-1, nds.theme.img->pixels, nds.theme.img->clip_rect, drt, nds.theme.img->pitch, 0, E_MI_GFX_ROTATE_180);
 #endif
@@ -4338,12 +5540,13 @@ int reload_overlay(void)
             SDL_FillRect(nds.overlay.img, &nds.overlay.img->clip_rect, SDL_MapRGB(nds.overlay.img->format, 0x00, 0x00, 0x00));
 
             if (get_file_path(nds.overlay.path, nds.overlay.sel, buf, 1) == 0) {
-                t = IMG_Load(buf);
+                t = load_prefetch(buf);
                 if (t) {
                     SDL_BlitSurface(t, NULL, nds.overlay.img, NULL);
-                    SDL_FreeSurface(t);
+                    free_image(t);
 
 #if defined(MINI)
+                    blit_wait(&gfx.blit);
                     neon_memcpy(gfx.overlay.virAddr, nds.overlay.img->pixels, FB_W * FB_H * 4);
                     MI_SYS_FlushInvCache(gfx.overlay.virAddr, FB_W * FB_H * FB_BPP);
 #endif
@@ -4412,6 +5615,7 @@ int MiyooVideoInit(_THIS)
     SDL_VideoDisplay display = {0};
 
     printf(PREFIX"MiyooVideoInit\n");
+    log_startup_phase("start");
 #ifndef UT
     signal(SIGTERM, sigterm_handler);
 #endif
@@ -4500,27 +5704,72 @@ int MiyooVideoInit(_THIS)
     }
 #endif
 
+    log_startup_phase("display");
+
     GFX_Init();
     read_config();
+    log_startup_phase("config");
+
     EventInit();
+    log_startup_phase("event");
 
     set_page_size(sysconf(_SC_PAGESIZE));
     add_save_load_state_handler(nds.states.path);
+#ifndef UT
+    if (init_perspective_hook() < 0) {
+        printf(PREFIX"Failed to install NEON perspective steps\n");
+    }
+#endif
+    if (access(FPROF_ENABLE_FILE, F_OK) == 0) {
+        init_func_profiler();
+    }
+    if (access(SPROF_ENABLE_FILE, F_OK) == 0) {
+        start_sampling_profiler(SPROF_SAMPLE_FILE, SPROF_MAPS_FILE, SPROF_HZ);
+    }
+#if !defined(MINI)
+    // sdl_malloc, sdl_realloc and sdl_free already own the DraStic hooks on Mini
+    if (access(MPROF_ENABLE_FILE, F_OK) == 0) {
+        init_mem_profiler(1);
+    }
+#endif
     printf(PREFIX"Installed hooking for drastic functions\n");
 
 //    detour_hook(FUN_PRINT_STRING, (intptr_t)sdl_print_string);
 //    detour_hook(FUN_SAVESTATE_PRE, (intptr_t)sdl_savestate_pre);
 //    detour_hook(FUN_SAVESTATE_POST, (intptr_t)sdl_savestate_post);
 //    detour_hook(FUN_BLIT_SCREEN_MENU, (intptr_t)sdl_blit_screen_menu);
-//    detour_hook(FUN_UPDATE_SCREEN, (intptr_t)sdl_update_screen);
+
 #ifndef UT
-//    add_hook_point(hook_table.fun.render_polygon_setup_perspective_steps, (intptr_t)render_polygon_setup_perspective_steps);
+    // after the profilers, the function profiler owns update_screen when it
+    // is enabled and frames then keep going through the renderer
+    if (!myhook.fun.update_screen) {
+        init_detour_hook();
+    }
+
+    if (add_detour_hook(myhook.fun.update_screen, sdl_update_screen, (void **)&update_screen_orig) < 0) {
+        printf(PREFIX"Failed to hook update_screen, frames go through the renderer\n");
+    }
+
+    if (init_tiled_hook() < 0) {
+        printf(PREFIX"Failed to install NEON tiled 4bpp, DraStic keeps rendering it\n");
+    }
 #endif
 
-    printf(PREFIX"Installed hooking for libc functions\n");
-//    detour_hook(FUN_MALLOC, (intptr_t)sdl_malloc);
-//    detour_hook(FUN_REALLOC, (intptr_t)sdl_realloc);
-//    detour_hook(FUN_FREE, (intptr_t)sdl_free);
+#if defined(MINI)
+    if (!myhook.fun.malloc) {
+        init_detour_hook();
+    }
+
+    if ((add_hook_point(myhook.fun.malloc, sdl_malloc) < 0) ||
+        (add_hook_point(myhook.fun.realloc, sdl_realloc) < 0) ||
+        (add_hook_point(myhook.fun.free, sdl_free) < 0))
+    {
+        printf(PREFIX"Failed to hook libc functions, screens will be copied\n");
+    }
+    else {
+        printf(PREFIX"Installed hooking for libc functions\n");
+    }
+#endif
     return 0;
 }
 
@@ -4536,9 +5785,14 @@ void MiyooVideoQuit(_THIS)
     while (savestate_busy) {
         usleep(1000000);
     }
+    quit_config_settings();
     if (system("sync") < 0) {
         printf("Failed to do sync command\n");
     }
+    stop_sampling_profiler();
+    quit_func_profiler(FPROF_REPORT_FILE);
+    quit_perspective_hook(PERSP_REPORT_FILE);
+    quit_mem_profiler(MPROF_REPORT_FILE);
     restore_detour_hook();
     write_config();
 
@@ -4568,7 +5822,7 @@ void MiyooVideoQuit(_THIS)
     }
 
     if (nds.menu.cursor) {
-        SDL_FreeSurface(nds.menu.cursor);
+        free_image(nds.menu.cursor);
         nds.menu.cursor = NULL;
     }
 
@@ -4583,7 +5837,7 @@ void MiyooVideoQuit(_THIS)
     }
 
     if (nds.menu.drastic.cursor) {
-        SDL_FreeSurface(nds.menu.drastic.cursor);
+        free_image(nds.menu.drastic.cursor);
         nds.menu.drastic.cursor = NULL;
     }
 
@@ -5183,6 +6437,7 @@ int handle_menu(int key)
         break;
     case KEY_BIT_B:
         if (cur_cpuclock != pre_cpuclock) {
+            set_governor_enable(0);
 #if defined(MINI)
             set_cpuclock(cur_cpuclock);
 #endif
@@ -5850,10 +7105,233 @@ int handle_menu(int key)
     return 0;
 }
 
+#if defined(UT) || defined(BENCH)
+#define BENCH_ENV_FONT "BENCH_FONT"
+#define BENCH_LANG_FILE "bench_lang"
+
+typedef struct {
+    void *src;
+    void *dst;
+    void *fb;
+    int w;
+    int pitch;
+    int is_565;
+} bench_gfx_t;
+
+#if defined(MINI) || defined(UT)
+static void bench_blend_alpha(void *arg)
+{
+    bench_gfx_t *p = (bench_gfx_t *)arg;
+    SDL_Rect rt = { 0, 0, NDS_W, NDS_H };
+
+    blend_alpha(p->dst, p->fb, p->src, rt, p->is_565);
+}
+
+static void bench_scale_2x_888(void *arg)
+{
+    bench_gfx_t *p = (bench_gfx_t *)arg;
+
+    scale_2x_888(p->src, p->dst);
+}
+
+static void bench_scale_2x_565(void *arg)
+{
+    bench_gfx_t *p = (bench_gfx_t *)arg;
+
+    scale_2x_565(p->src, p->dst, NDS_W, NDS_H);
+}
+#endif
+
+static void bench_draw_pen(void *arg)
+{
+    bench_gfx_t *p = (bench_gfx_t *)arg;
+
+    draw_pen(p->dst, p->w, p->pitch);
+}
+
+static void bench_to_lang(void *arg)
+{
+    int cc = 0;
+    char (*key)[32] = arg;
+
+    for (cc = 0; cc < MAX_LANG_LINE; cc++) {
+        to_lang(key[cc]);
+    }
+}
+
+static void bench_draw_info(void *arg)
+{
+    draw_info((SDL_Surface *)arg, "Save state 0 (2024/01/01 12:00)", 10, 10, 0xffffff, 0);
+}
+
+static void bench_gfx(void)
+{
+    int cc = 0;
+    int fb_w = FB_W;
+    int fb_h = FB_H;
+    bench_gfx_t p = { 0 };
+    const size_t size = NDS_Wx2 * NDS_Hx2 * 4;
+    miyoo_event e = myevent;
+    SDL_Surface *img = nds.pen.img;
+    int pen_type = nds.pen.type;
+    int dis_mode = nds.dis_mode;
+    struct _ALPHA alpha = nds.alpha;
+
+    if (FB_W == 0) {
+        FB_W = DEF_FB_W;
+        FB_H = DEF_FB_H;
+    }
+
+    p.src = malloc(size);
+    p.dst = malloc(size);
+    p.fb = malloc(FB_W * FB_H * FB_BPP);
+    if (p.src && p.dst && p.fb) {
+        // a fixed gradient, the kernels have no data dependent branches anyway
+        for (cc = 0; cc < (int)(size / 4); cc++) {
+            ((uint32_t *)p.src)[cc] = (cc * 0x010203) & 0xffffff;
+        }
+        memset(p.dst, 0, size);
+        memset(p.fb, 0x40, FB_W * FB_H * FB_BPP);
+
+#if defined(MINI) || defined(UT)
+        nds.dis_mode = NDS_SCREEN_LAYOUT_1;
+        nds.alpha.val = 5;
+        nds.alpha.pos = 0;
+        nds.alpha.border = 0;
+        p.is_565 = 0;
+        run_bench("GFX_Copy/blend_alpha/888", bench_blend_alpha, &p, NDS_W * NDS_H * 4);
+        p.is_565 = 1;
+        run_bench("GFX_Copy/blend_alpha/565", bench_blend_alpha, &p, NDS_W * NDS_H * 4);
+        run_bench("GFX_Copy/scale_2x_888", bench_scale_2x_888, &p, NDS_W * NDS_H * 4);
+        run_bench("GFX_Copy/scale_2x_565", bench_scale_2x_565, &p, NDS_W * NDS_H * 2);
+#endif
+
+        // the built-in 28x28 pen in the middle of the screen
+        myevent.pen.x = NDS_W / 2;
+        myevent.pen.y = NDS_H / 2;
+        myevent.pen.max_x = NDS_W;
+        myevent.pen.max_y = NDS_H;
+        nds.pen.img = NULL;
+        nds.pen.type = PEN_CP;
+        p.w = NDS_W;
+        p.pitch = NDS_W * 4;
+        run_bench("draw_pen/888", bench_draw_pen, &p, 28 * 28 * 4);
+        p.w = NDS_Wx2;
+        p.pitch = NDS_Wx2 * 2;
+        run_bench("draw_pen/565_2x", bench_draw_pen, &p, 56 * 56 * 2);
+    }
+    free(p.src);
+    free(p.dst);
+    free(p.fb);
+
+    myevent = e;
+    nds.pen.img = img;
+    nds.pen.type = pen_type;
+    nds.dis_mode = dis_mode;
+    nds.alpha = alpha;
+    FB_W = fb_w;
+    FB_H = fb_h;
+}
+
+static void bench_lang(void)
+{
+    int cc = 0;
+    FILE *f = NULL;
+    char buf[MAX_PATH << 1] = { 0 };
+    char path[MAX_PATH] = { 0 };
+    char lang[LANG_FILE_LEN] = { 0 };
+    char (*key)[32] = NULL;
+
+    key = malloc(MAX_LANG_LINE * 32);
+    if (key == NULL) {
+        return;
+    }
+
+    strcpy(path, nds.lang.path);
+    strcpy(lang, nds.lang.trans[DEF_LANG_SLOT]);
+    strcpy(nds.lang.path, "/tmp");
+    snprintf(buf, sizeof(buf), "%s/%s", nds.lang.path, BENCH_LANG_FILE);
+
+    // a full language file, every line of one menu page is looked up per call
+    f = fopen(buf, "w+");
+    if (f) {
+        for (cc = 0; cc < MAX_LANG_LINE; cc++) {
+            snprintf(key[cc], 32, "Menu item %d", cc);
+            fprintf(f, "%s=Item %d\r\n", key[cc], cc);
+        }
+        fclose(f);
+
+        strcpy(nds.lang.trans[DEF_LANG_SLOT], BENCH_LANG_FILE);
+        if (lang_load(BENCH_LANG_FILE) == 0) {
+            run_bench("to_lang/128", bench_to_lang, key, 0);
+        }
+        lang_unload();
+        unlink(buf);
+    }
+
+    strcpy(nds.lang.path, path);
+    strcpy(nds.lang.trans[DEF_LANG_SLOT], lang);
+    free(key);
+}
+
+static void bench_font(void)
+{
+    int init = 0;
+    TTF_Font *font = nds.font;
+    SDL_Surface *dst = NULL;
+    const char *path = getenv(BENCH_ENV_FONT);
+
+    if (path == NULL) {
+        path = FONT_PATH;
+    }
+
+    if (TTF_WasInit() == 0) {
+        TTF_Init();
+        init = 1;
+    }
+
+    nds.font = TTF_OpenFont(path, DEF_FONT_SIZE);
+    if (nds.font) {
+        dst = SDL_CreateRGBSurface(SDL_SWSURFACE, DEF_FB_W, DEF_FB_H, 32, 0, 0, 0, 0);
+        if (dst) {
+            run_bench("draw_info/31", bench_draw_info, dst, 0);
+            SDL_FreeSurface(dst);
+        }
+        TTF_CloseFont(nds.font);
+    }
+    else {
+        printf(PREFIX"Skipped draw_info, no font(\'%s\'), set %s\n", path, BENCH_ENV_FONT);
+    }
+    nds.font = font;
+
+    if (init) {
+        TTF_Quit();
+    }
+}
+
+BENCH_GROUP(sdl2_video_miyoo)
+{
+    bench_gfx();
+    bench_lang();
+    bench_font();
+}
+#endif
+
 #if defined(UT)
 TEST_GROUP_RUNNER(sdl2_video_miyoo)
 {
+    RUN_TEST_CASE(sdl2_video_miyoo, add_screen_alloc);
+    RUN_TEST_CASE(sdl2_video_miyoo, sdl_malloc);
+    RUN_TEST_CASE(sdl2_video_miyoo, sdl_free);
+    RUN_TEST_CASE(sdl2_video_miyoo, sdl_realloc);
+    RUN_TEST_CASE(sdl2_video_miyoo, flip_screen);
     RUN_TEST_CASE(sdl2_video_miyoo, get_current_menu_layer);
+    RUN_TEST_CASE(sdl2_video_miyoo, put_prefetch);
+    RUN_TEST_CASE(sdl2_video_miyoo, draw_pen);
+    RUN_TEST_CASE(sdl2_video_miyoo, blend_alpha);
+    RUN_TEST_CASE(sdl2_video_miyoo, GFX_Present);
+    RUN_TEST_CASE(sdl2_video_miyoo, GFX_DropPresent);
+    RUN_TEST_CASE(sdl2_video_miyoo, to_lang);
 }
 #endif
 
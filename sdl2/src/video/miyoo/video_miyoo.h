@@ -23,6 +23,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <linux/fb.h>
 
 #if defined(A30)
@@ -54,6 +55,7 @@
 #if defined(MINI)
 #include "mi_sys.h"
 #include "mi_gfx.h"
+#include "blit_miyoo.h"
 #endif
 
 #if !defined(MINI)
@@ -112,9 +114,6 @@
 #define DAC_BASE                0x1c22000
 #define CCU_BASE                0x01c20000
 #define BAT_CHK_CNT             300
-#define BAT_MAX_CMD             "cat /sys/class/power_supply/battery/voltage_max_design"
-#define BAT_MIN_CMD             "cat /sys/class/power_supply/battery/voltage_min_design"
-#define BAT_CUR_CMD             "cat /sys/class/power_supply/battery/voltage_now"
 #endif
 
 #if defined(MINI)
@@ -129,12 +128,13 @@
 #define RELOAD_BG_COUNT         120
 #define DEF_FONT_SIZE           24
 #define BAT_CHK_CNT             90
-#define BAT_MAX_VAL             630
-#define BAT_MIN_VAL             420
 #endif
 
 #define PREFIX                      "[SDL] "
 #define SHOT_PATH                   "/mnt/SDCARD/Screenshots"
+#define SPLASH_LOCK                 "/tmp/.splash_busy"
+#define MAX_SCREEN_ALLOC            4
+#define SPLASH_WAIT_MS              35000
 #define BIOS_PATH                   "system"
 //#define CFG_PATH                    "resources/settings.json"
 #define THEME_PATH                  "resources/bg"
@@ -228,7 +228,13 @@
 #define DEF_LANG_LANG               "english"
 #define LANG_FILE_LEN               16
 #define MAX_LANG_FILE               32
+#define PREFETCH_MAX                6
+#define PREFETCH_THEME              0
+#define PREFETCH_PEN                1
+#define PREFETCH_OVERLAY            2
+#define PREFETCH_TYPE_MAX           3
 #define MAX_LANG_LINE               128
+#define LANG_HASH_SIZE              256
 #define MAX_MENU_LINE               128
 
 #define NDS_DRASTIC_MENU_MAIN           1
@@ -285,10 +291,6 @@ typedef struct MMIYOO_VideoInfo {
     uint32_t *vol_ptr;
     uint32_t *cpu_ptr;
 #endif
-
-#if defined(MINI)
-    int sar_fd;
-#endif
 } MiyooVideoInfo;
 
 typedef struct _GFX {
@@ -316,6 +318,8 @@ typedef struct _GFX {
 
     struct {
         int cur_sel;
+        int used[2];
+        void *alloc[MAX_SCREEN_ALLOC];
         void *virAddr[2][2];
 #if defined(MINI)
         MI_PHY phyAddr[2][2];
@@ -331,6 +335,22 @@ typedef struct _GFX {
         MI_GFX_Opt_t opt;
 #endif
     } hw;
+
+#if defined(MINI)
+    BLIT_QUEUE blit;
+#endif
+
+#if defined(A30) || defined(MINI)
+    struct {
+        int pending;
+        int w;
+        int h;
+        int pitch;
+        uint64_t phy;
+        const void *pixels;
+        pthread_mutex_t lock;
+    } present;
+#endif
 } GFX;
 
 typedef struct _NDS {
@@ -476,6 +496,28 @@ typedef struct _CUST_MENU {
     CUST_MENU_SUB item[MAX_MENU_LINE];
 } CUST_MENU;
 
+typedef struct _LANG_ENTRY {
+    uint32_t hash;
+    const char *key;
+    const char *val;
+} LANG_ENTRY;
+
+typedef struct _PREFETCH_SLOT {
+    char path[MAX_PATH << 1];
+    uint32_t stamp;
+    SDL_Surface *img;
+} PREFETCH_SLOT;
+
+typedef struct _PREFETCH_CTX {
+    int running;
+    int pending;
+    uint32_t stamp;
+    pthread_t thread;
+    pthread_cond_t cond;
+    pthread_mutex_t mutex;
+    PREFETCH_SLOT slot[PREFETCH_MAX];
+} PREFETCH_CTX;
+
 #if defined(A30)
 struct _cpu_clock {
     int clk;
@@ -488,6 +530,8 @@ void neon_memcpy(void *dest, const void *src, size_t n);
 
 void GFX_Clear(void);
 void GFX_Flip(void);
+int GFX_Present(const void *pixels, uint64_t phy, int w, int h, int pitch);
+void GFX_DropPresent(void);
 int GFX_Copy(int id, const void *pixels, SDL_Rect srcrect, SDL_Rect dstrect, int pitch, int alpha, int rotate);
 
 int draw_pen(void *pixels, int width, int pitch);
@@ -509,13 +553,11 @@ void disp_resize(void);
 int get_pitch(void *chk);
 int handle_menu(int key);
 int process_drastic_menu(void);
+int get_current_menu_layer(void);
 int update_texture(void *chk, void *new, const void *pixels, int pitch);
 const void* get_pixels(void *chk);
 const char *to_lang(const char *p);
 void update_wayland_res(int w, int h);
 
-void render_scanline_tiled_4bpp(void);
-void render_polygon_setup_perspective_steps(void);
-
 #endif
 
@@ -0,0 +1,271 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <poll.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/fb.h>
+#include <linux/input.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+
+#include "asset.h"
+
+#define FB_DEV "/dev/fb0"
+#if defined(A30)
+#define INPUT_DEV "/dev/input/event3"
+#else
+#define INPUT_DEV "/dev/input/event0"
+#endif
+#define JSON_PATH "resources/settings.json"
+#define JSON_LANG "\"lang\""
+#define JSON_SPLASH "\"splash\""
+#define SPLASH_PATH "resources/splash"
+#define SPLASH_LOCK "/tmp/.splash_busy"
+#define SPLASH_TIMEOUT_MS 30000
+#define SPLASH_KEY_LINE "\n    "JSON_SPLASH": 0"
+
+static char json_buf[4096] = { 0 };
+
+static char *find_json_value(const char *key)
+{
+    char *p = strstr(json_buf, key);
+
+    if (!p) {
+        return NULL;
+    }
+
+    p += strlen(key);
+    while (*p && ((*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\r') || (*p == ':'))) {
+        p += 1;
+    }
+    return *p ? p : NULL;
+}
+
+static int add_splash_key(int fd, int len)
+{
+    int head = 0;
+    int tail = 0;
+    char *p = strchr(json_buf, '{');
+    char buf[sizeof(json_buf) + sizeof(SPLASH_KEY_LINE) + 1] = { 0 };
+
+    if (!p) {
+        return -1;
+    }
+
+    // the splash shows once, write the key back so the next boot skips it
+    head = (p - json_buf) + 1;
+    p += 1;
+    while ((*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\r')) {
+        p += 1;
+    }
+
+    tail = snprintf(buf, sizeof(buf), "%.*s%s%s", head, json_buf, SPLASH_KEY_LINE, (*p == '}') ? "\n" : ",");
+    memcpy(buf + tail, json_buf + head, len - head);
+    tail += len - head;
+
+    if ((pwrite(fd, buf, tail, 0) != tail) || (ftruncate(fd, tail) < 0)) {
+        printf("Failed to add splash key\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int update_splash_counter(int *is_en)
+{
+    int fd = -1;
+    int len = 0;
+    int val = 1;
+    int width = 0;
+    char *p = NULL;
+    char num[16] = { 0 };
+
+    fd = open(JSON_PATH, O_RDWR);
+    if (fd < 0) {
+        printf("Failed to open json file (%s)\n", JSON_PATH);
+        return -1;
+    }
+
+    len = read(fd, json_buf, sizeof(json_buf) - 1);
+    if (len <= 0) {
+        close(fd);
+        return -1;
+    }
+    json_buf[len] = 0;
+
+    p = find_json_value(JSON_LANG);
+    if (p && !strncmp(p, "\"chinese_cn\"", 12)) {
+        *is_en = 0;
+    }
+
+    p = find_json_value(JSON_SPLASH);
+    if (p) {
+        val = atoi(p);
+        while ((p[width] == '-') || ((p[width] >= '0') && (p[width] <= '9'))) {
+            width += 1;
+        }
+    }
+
+    // rewrite the digits in place, padded with spaces, so the file keeps its
+    // size and layout and only a few bytes hit the SD card
+    if ((val > 0) && (width > 0)) {
+        snprintf(num, sizeof(num), "%-*d", width, val - 1);
+        if (pwrite(fd, num, width, p - json_buf) != width) {
+            printf("Failed to update splash counter\n");
+        }
+    }
+    else if (!p) {
+        add_splash_key(fd, len);
+    }
+    close(fd);
+    return val;
+}
+
+static int show_asset(const char *path, uint8_t *fb, const struct fb_var_screeninfo *var, int line)
+{
+    int y = 0;
+    int w = 0;
+    int h = 0;
+    int fd = -1;
+    int bpp = var->bits_per_pixel / 8;
+    uint8_t *map = NULL;
+    struct stat st = { 0 };
+    const asset_hdr_t *hdr = NULL;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Failed to open splash image (%s)\n", path);
+        return -1;
+    }
+
+    if ((fstat(fd, &st) < 0) || (st.st_size < (off_t)sizeof(asset_hdr_t))) {
+        close(fd);
+        return -1;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    hdr = (const asset_hdr_t *)map;
+    if ((hdr->magic != ASSET_MAGIC) ||
+        (hdr->version != ASSET_VERSION) ||
+        (((hdr->fmt == ASSET_FMT_RGB565) ? 2 : 4) != bpp) ||
+        (((uint64_t)hdr->hdr_size + hdr->size) > (uint64_t)st.st_size))
+    {
+        printf("Invalid splash image (%s)\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    // draw into the page being scanned out right now
+    fb += (var->yoffset * line) + (var->xoffset * bpp);
+    if ((hdr->w != var->xres) && (hdr->size == (var->xres * var->yres * bpp)) && (line == (int)(var->xres * bpp))) {
+        // 320x240x16 Mini firmware scans the page out in portrait order
+        memcpy(fb, map + hdr->hdr_size, hdr->size);
+    }
+    else {
+        w = (hdr->w < var->xres) ? hdr->w : var->xres;
+        h = (hdr->h < var->yres) ? hdr->h : var->yres;
+        for (y = 0; y < h; y++) {
+            memcpy(fb + (y * line), map + hdr->hdr_size + (y * hdr->pitch), w * bpp);
+        }
+    }
+    munmap(map, st.st_size);
+    return 0;
+}
+
+static void wait_key(void)
+{
+    int fd = -1;
+    int left = SPLASH_TIMEOUT_MS;
+    struct pollfd pfd = { 0 };
+    struct input_event ev = { 0 };
+
+    fd = open(INPUT_DEV, O_RDONLY);
+    if (fd < 0) {
+        usleep(SPLASH_TIMEOUT_MS * 1000);
+        return;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (left > 0) {
+        if (poll(&pfd, 1, 100) > 0) {
+            if ((read(fd, &ev, sizeof(ev)) == sizeof(ev)) && (ev.type == EV_KEY) && (ev.value == 1)) {
+                break;
+            }
+        }
+        left -= 100;
+    }
+    close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    int fd = -1;
+    int is_en = 1;
+    int line = 0;
+    size_t size = 0;
+    uint8_t *fb = NULL;
+    char buf[255] = { 0 };
+    struct fb_var_screeninfo var = { 0 };
+    struct fb_fix_screeninfo fix = { 0 };
+
+    if (update_splash_counter(&is_en) <= 0) {
+        unlink(SPLASH_LOCK);
+        return 0;
+    }
+
+    fd = open(FB_DEV, O_RDWR);
+    if (fd < 0) {
+        unlink(SPLASH_LOCK);
+        return -1;
+    }
+
+    ioctl(fd, FBIOGET_VSCREENINFO, &var);
+    ioctl(fd, FBIOGET_FSCREENINFO, &fix);
+    line = fix.line_length;
+    size = fix.smem_len;
+
+    fb = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (fb != MAP_FAILED) {
+        snprintf(buf, sizeof(buf), "%s/%s_%dx%dx%d%s",
+            SPLASH_PATH, is_en ? "en" : "cn", var.xres, var.yres, var.bits_per_pixel, ASSET_EXT);
+
+        if (show_asset(buf, fb, &var, line) == 0) {
+            wait_key();
+            memset(fb, 0, size);
+        }
+        munmap(fb, size);
+    }
+    close(fd);
+
+    // DraStic waits on this before it touches the framebuffer
+    unlink(SPLASH_LOCK);
+    return 0;
+}
@@ -0,0 +1,257 @@
+//
+// NDS Emulator (DraStic) for Miyoo Handheld
+// Steward Fu <steward.fu@gmail.com>
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not claim
+//    that you wrote the original software. If you use this software in a product,
+//    an acknowledgment in the product documentation would be appreciated
+//    but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "sprof.h"
+
+#define MAX_SYM 32768
+#define MAX_MAP 256
+#define MAX_THREAD 64
+#define MAX_NAME 128
+#define DEF_SYM_SIZE 0x1000
+#define BUCKET_MASK 0xfffff000
+
+typedef struct {
+    uint32_t addr;
+    uint32_t size;
+    char name[MAX_NAME];
+} sym_t;
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint32_t off;
+    char name[MAX_NAME];
+} map_t;
+
+typedef struct {
+    uint32_t tid;
+    char name[32];
+} thread_t;
+
+static int sym_cnt = 0;
+static int map_cnt = 0;
+static int thread_cnt = 0;
+static sym_t sym[MAX_SYM] = { 0 };
+static map_t map[MAX_MAP] = { 0 };
+static thread_t thread[MAX_THREAD] = { 0 };
+
+static int cmp_sym(const void *a, const void *b)
+{
+    const sym_t *s0 = (const sym_t *)a;
+    const sym_t *s1 = (const sym_t *)b;
+
+    return (s0->addr < s1->addr) ? -1 : (s0->addr > s1->addr);
+}
+
+static int cmp_str(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static int load_symbol(const char *path)
+{
+    int cc = 0;
+    FILE *f = NULL;
+    char buf[256] = { 0 };
+    sym_t *s = NULL;
+
+    f = fopen(path, "r");
+    if (!f) {
+        printf("failed to open \"%s\"\n", path);
+        return -1;
+    }
+
+    while (fgets(buf, sizeof(buf), f) && (sym_cnt < MAX_SYM)) {
+        s = &sym[sym_cnt];
+        if ((buf[0] == '#') || (sscanf(buf, "%x %i %127s", &s->addr, &s->size, s->name) != 3)) {
+            continue;
+        }
+        sym_cnt += 1;
+    }
+    fclose(f);
+
+    qsort(sym, sym_cnt, sizeof(sym_t), cmp_sym);
+    for (cc = 0; cc < sym_cnt; cc++) {
+        if (sym[cc].size) {
+            continue;
+        }
+
+        sym[cc].size = DEF_SYM_SIZE;
+        if ((cc + 1) < sym_cnt) {
+            if ((sym[cc + 1].addr - sym[cc].addr) < sym[cc].size) {
+                sym[cc].size = sym[cc + 1].addr - sym[cc].addr;
+            }
+        }
+    }
+    return 0;
+}
+
+static int load_maps(const char *path)
+{
+    FILE *f = NULL;
+    char *p = NULL;
+    char buf[512] = { 0 };
+    char file[256] = { 0 };
+    map_t *m = NULL;
+    thread_t *t = NULL;
+
+    f = fopen(path, "r");
+    if (!f) {
+        printf("failed to open \"%s\"\n", path);
+        return -1;
+    }
+
+    while (fgets(buf, sizeof(buf), f)) {
+        if (!strncmp(buf, "map ", 4) && (map_cnt < MAX_MAP)) {
+            m = &map[map_cnt];
+            file[0] = 0;
+            if (sscanf(buf + 4, "%x-%x %*s %x %*s %*s %255s", &m->start, &m->end, &m->off, file) < 3) {
+                continue;
+            }
+            p = strrchr(file, '/');
+            snprintf(m->name, sizeof(m->name), "%s", file[0] ? (p ? (p + 1) : file) : "anon");
+            map_cnt += 1;
+        }
+        else if (!strncmp(buf, "thread ", 7) && (thread_cnt < MAX_THREAD)) {
+            t = &thread[thread_cnt];
+            if (sscanf(buf + 7, "%u %31s", &t->tid, t->name) == 2) {
+                thread_cnt += 1;
+            }
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static void resolve(uint32_t addr, char *buf, int len)
+{
+    int lo = 0;
+    int hi = sym_cnt - 1;
+    int mid = 0;
+    int cc = 0;
+
+    while (lo <= hi) {
+        mid = (lo + hi) >> 1;
+        if (addr < sym[mid].addr) {
+            hi = mid - 1;
+        }
+        else if (addr >= (sym[mid].addr + sym[mid].size)) {
+            lo = mid + 1;
+        }
+        else {
+            snprintf(buf, len, "%s", sym[mid].name);
+            return;
+        }
+    }
+
+    // unknown code is reported as 4KB buckets so hot spots still stand out
+    for (cc = 0; cc < map_cnt; cc++) {
+        if ((addr >= map[cc].start) && (addr < map[cc].end)) {
+            snprintf(buf, len, "%s+0x%x", map[cc].name, ((addr - map[cc].start) + map[cc].off) & BUCKET_MASK);
+            return;
+        }
+    }
+    snprintf(buf, len, "0x%08x", addr & BUCKET_MASK);
+}
+
+static const char *get_thread_name(uint32_t tid)
+{
+    int cc = 0;
+
+    for (cc = 0; cc < thread_cnt; cc++) {
+        if (thread[cc].tid == tid) {
+            return thread[cc].name;
+        }
+    }
+    return "unknown";
+}
+
+int main(int argc, char **argv)
+{
+    long cc = 0;
+    long cnt = 0;
+    long size = 0;
+    FILE *f = NULL;
+    char **line = NULL;
+    sprof_sample_t *s = NULL;
+    char pc[MAX_NAME] = { 0 };
+    char lr[MAX_NAME] = { 0 };
+    char buf[(MAX_NAME * 3) + 8] = { 0 };
+
+    if (argc < 4) {
+        printf("usage: %s <drastic.map> <%s> <%s>\n", argv[0], SPROF_MAPS_FILE, SPROF_SAMPLE_FILE);
+        return -1;
+    }
+
+    if ((load_symbol(argv[1]) < 0) || (load_maps(argv[2]) < 0)) {
+        return -1;
+    }
+
+    f = fopen(argv[3], "rb");
+    if (!f) {
+        printf("failed to open \"%s\"\n", argv[3]);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f) / sizeof(sprof_sample_t);
+    fseek(f, 0, SEEK_SET);
+
+    s = malloc((size + 1) * sizeof(sprof_sample_t));
+    line = malloc((size + 1) * sizeof(char *));
+    if (!s || !line || (fread(s, sizeof(sprof_sample_t), size, f) != (size_t)size)) {
+        printf("failed to read \"%s\"\n", argv[3]);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    for (cc = 0; cc < size; cc++) {
+        resolve(s[cc].pc, pc, sizeof(pc));
+        resolve(s[cc].lr, lr, sizeof(lr));
+
+        // lr only adds a caller frame when it points outside the sampled function
+        if (s[cc].lr && strcmp(pc, lr)) {
+            snprintf(buf, sizeof(buf), "%s;%s;%s", get_thread_name(s[cc].tid), lr, pc);
+        }
+        else {
+            snprintf(buf, sizeof(buf), "%s;%s", get_thread_name(s[cc].tid), pc);
+        }
+        line[cc] = strdup(buf);
+    }
+
+    qsort(line, size, sizeof(char *), cmp_str);
+    for (cc = 0; cc < size; cc += cnt) {
+        for (cnt = 1; ((cc + cnt) < size) && !strcmp(line[cc], line[cc + cnt]); cnt++);
+        printf("%s %ld\n", line[cc], cnt);
+    }
+
+    for (cc = 0; cc < size; cc++) {
+        free(line[cc]);
+    }
+    free(line);
+    free(s);
+    return 0;
+}
+
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+static void runAllBenches(void)
+{
+    RUN_BENCH_GROUP(common_ref);
+    RUN_BENCH_GROUP(common_memcpy);
+    RUN_BENCH_GROUP(alsa_snd);
+    RUN_BENCH_GROUP(sdl2_video_miyoo);
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-w warmup] [-r repeat] [-f filter] [-b baseline.json] [-t threshold%%] [-o result.json]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    int opt = 0;
+    int regress = 0;
+    int warmup = BENCH_DEF_WARMUP;
+    int repeat = BENCH_DEF_REPEAT;
+    double threshold = BENCH_DEF_THRESHOLD;
+    const char *filter = NULL;
+    const char *output = NULL;
+    const char *baseline = NULL;
+
+    while ((opt = getopt(argc, argv, "w:r:f:b:t:o:h")) != -1) {
+        switch (opt) {
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'r':
+            repeat = atoi(optarg);
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        case 'b':
+            baseline = optarg;
+            break;
+        case 't':
+            threshold = atof(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (init_bench(warmup, repeat, filter) < 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    printf("\n%s, warmup %d, repeat %d, median per call\n", get_bench_arch(), warmup, repeat);
+    runAllBenches();
+
+    if (baseline) {
+        regress = compare_bench(baseline, threshold);
+    }
+    dump_bench(output);
+
+    if (regress < 0) {
+        printf("\nFailed to compare with \"%s\"\n", baseline);
+    }
+    else {
+        printf("\n%d Benchmarks %d Regressions (threshold %.1f%%)\n", get_bench_count(), regress, threshold);
+    }
+    quit_bench();
+    return regress ? 1 : 0;
+}
@@ -8,11 +8,28 @@ static void runAllTests(void)
     RUN_TEST_GROUP(common_log);
     RUN_TEST_GROUP(common_cfg);
     RUN_TEST_GROUP(common_file);
+    RUN_TEST_GROUP(common_telemetry);
+    RUN_TEST_GROUP(common_governor);
+    RUN_TEST_GROUP(common_thread);
+    RUN_TEST_GROUP(common_res);
+    RUN_TEST_GROUP(common_asset);
+    RUN_TEST_GROUP(common_gamedb);
+    RUN_TEST_GROUP(common_profile);
+    RUN_TEST_GROUP(common_bench);
     RUN_TEST_GROUP(alsa_snd);
+    RUN_TEST_GROUP(mi_clk);
+    RUN_TEST_GROUP(mi_sys);
+    RUN_TEST_GROUP(mi_gfx);
+    RUN_TEST_GROUP(mi_ao);
     RUN_TEST_GROUP(detour_hook);
     RUN_TEST_GROUP(detour_drastic);
+    RUN_TEST_GROUP(detour_prof);
+    RUN_TEST_GROUP(detour_sprof);
+    RUN_TEST_GROUP(detour_render);
+    RUN_TEST_GROUP(detour_mprof);
     RUN_TEST_GROUP(sdl2_audio_miyoo);
     RUN_TEST_GROUP(sdl2_render_miyoo);
+    RUN_TEST_GROUP(sdl2_blit_miyoo);
     RUN_TEST_GROUP(sdl2_joystick_miyoo);
     RUN_TEST_GROUP(sdl2_video_miyoo);
     RUN_TEST_GROUP(sdl2_event_miyoo);
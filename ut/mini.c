@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <alsa/output.h>
+#include <alsa/input.h>
+#include <alsa/conf.h>
+#include <alsa/global.h>
+#include <alsa/timer.h>
+#include <alsa/pcm.h>
+
+#include "unity_fixture.h"
+
+#include "mi.h"
+#include "snd.h"
+#include "hook.h"
+#include "video_miyoo.h"
+
+// Mini code paths built with -DMINI and linked against the mi stand-in, the
+// device only shows up here as /dev/mi_ao which is answered by the wrappers
+
+#define UT_WAV      "mini_ut.wav"
+#define UT_FB_W     64
+#define UT_FB_H     32
+#define UT_PCM_LEN  (PCM_SAMPLES * 2 * PCM_CHANNELS)
+
+extern GFX gfx;
+extern NDS nds;
+extern int FB_W;
+extern int FB_H;
+extern int pixel_filter;
+extern miyoo_alsa myalsa;
+extern miyoo_hook myhook;
+
+// SDL core is not linked in, video_miyoo.c only reaches it from the allocator
+// constructor and that bails out unless MPROF_ENABLE_FILE exists
+int SDL_SetMemoryFunctions_REAL(SDL_malloc_func m, SDL_calloc_func c, SDL_realloc_func r, SDL_free_func f)
+{
+    return -1;
+}
+
+int __real_open(const char *path, int flags, ...);
+int __real_ioctl(int fd, unsigned long req, ...);
+
+static int ao_fd = -1;
+static int ao_vol = MIN_RAW_VALUE;
+
+int __wrap_open(const char *path, int flags, ...)
+{
+    int mode = 0;
+    va_list ap;
+
+    if (path && !strcmp(path, MI_AO_DEV)) {
+        ao_fd = __real_open("/dev/null", O_RDWR);
+        return ao_fd;
+    }
+
+    va_start(ap, flags);
+    mode = va_arg(ap, int);
+    va_end(ap);
+    return __real_open(path, flags, mode);
+}
+
+int __wrap_ioctl(int fd, unsigned long req, ...)
+{
+    void *arg = NULL;
+    va_list ap;
+
+    va_start(ap, req);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    if ((fd >= 0) && (fd == ao_fd)) {
+        int *v = (int *)(uintptr_t)((uint64_t *)arg)[1];
+
+        switch (req) {
+        case MI_AO_GETVOLUME:
+            v[1] = ao_vol;
+            return 0;
+        case MI_AO_SETVOLUME:
+            ao_vol = v[1];
+            return 0;
+        case MI_AO_SETMUTE:
+            return 0;
+        }
+        return -1;
+    }
+    return __real_ioctl(fd, req, arg);
+}
+
+TEST_GROUP(mini);
+
+TEST_SETUP(mini)
+{
+}
+
+TEST_TEAR_DOWN(mini)
+{
+}
+
+TEST(mini, GFX_Copy)
+{
+    int x = 0;
+    int y = 0;
+    uint32_t *fb = NULL;
+    uint32_t src[4 * 2] = { 0 };
+    SDL_Rect srt = { 0, 0, 4, 2 };
+    SDL_Rect drt = { 10, 20, 4, 2 };
+    const int size = UT_FB_W * UT_FB_H * FB_BPP;
+
+    FB_W = UT_FB_W;
+    FB_H = UT_FB_H;
+    pixel_filter = 0;
+    gfx.vinfo.yoffset = UT_FB_H;
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_Init());
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_GFX_Open());
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_MMA_Alloc(NULL, size * 2, &gfx.fb.phyAddr));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_Mmap(gfx.fb.phyAddr, size * 2, &gfx.fb.virAddr, TRUE));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_MMA_Alloc(NULL, size, &gfx.tmp.phyAddr));
+    TEST_ASSERT_EQUAL_INT(MI_SUCCESS, MI_SYS_Mmap(gfx.tmp.phyAddr, size, &gfx.tmp.virAddr, TRUE));
+    memset(gfx.fb.virAddr, 0, size * 2);
+
+    for (x = 0; x < 8; x++) {
+        src[x] = 0xff000000 | (x * 0x00102030);
+    }
+
+    // not a DraStic screen, goes through tmp and lands in the back page
+    TEST_ASSERT_EQUAL_INT(-1, GFX_Copy(-1, NULL, srt, drt, sizeof(uint32_t) * 4, 0, E_MI_GFX_ROTATE_0));
+    TEST_ASSERT_EQUAL_INT(0, GFX_Copy(-1, src, srt, drt, sizeof(uint32_t) * 4, 0, E_MI_GFX_ROTATE_0));
+    TEST_ASSERT_EQUAL_INT(0, blit_wait(&gfx.blit));
+
+    fb = (uint32_t *)gfx.fb.virAddr;
+    for (y = 0; y < 2; y++) {
+        for (x = 0; x < 4; x++) {
+            TEST_ASSERT_EQUAL_HEX32(src[(y * 4) + x], fb[((UT_FB_H + drt.y + y) * UT_FB_W) + drt.x + x]);
+        }
+    }
+    TEST_ASSERT_EQUAL_HEX32(0, fb[((drt.y) * UT_FB_W) + drt.x]);
+    TEST_ASSERT_EQUAL_HEX32(0, fb[((UT_FB_H + drt.y) * UT_FB_W) + drt.x - 1]);
+
+    // panel is upside down, 180 degree rotation flips the rect in place
+    TEST_ASSERT_EQUAL_INT(0, GFX_Copy(-1, src, srt, drt, sizeof(uint32_t) * 4, 0, E_MI_GFX_ROTATE_180));
+    TEST_ASSERT_EQUAL_INT(0, blit_wait(&gfx.blit));
+    for (y = 0; y < 2; y++) {
+        for (x = 0; x < 4; x++) {
+            TEST_ASSERT_EQUAL_HEX32(src[((1 - y) * 4) + (3 - x)], fb[((UT_FB_H + drt.y + y) * UT_FB_W) + drt.x + x]);
+        }
+    }
+
+    MI_SYS_Munmap(gfx.tmp.virAddr, size);
+    MI_SYS_MMA_Free(gfx.tmp.phyAddr);
+    MI_SYS_Munmap(gfx.fb.virAddr, size * 2);
+    MI_SYS_MMA_Free(gfx.fb.phyAddr);
+    MI_GFX_Close();
+    MI_SYS_Exit();
+}
+
+TEST(mini, snd_pcm_writei)
+{
+    int cc = 0;
+    int wait = 1000;
+    FILE *f = NULL;
+    uint8_t hdr[44] = { 0 };
+    int16_t *pcm = malloc(UT_PCM_LEN);
+    int16_t *out = malloc(UT_PCM_LEN);
+
+    TEST_ASSERT_NOT_NULL(pcm);
+    TEST_ASSERT_NOT_NULL(out);
+    for (cc = 0; cc < (UT_PCM_LEN / 2); cc++) {
+        pcm[cc] = (int16_t)(cc * 7);
+    }
+
+    // libdetour is the host build, it accepts the hook without patching
+    myhook.fun.spu_adpcm_decode_block = 1;
+    setenv(MI_ENV_WAV, UT_WAV, 1);
+    TEST_ASSERT_EQUAL_INT(0, snd_pcm_start(NULL));
+
+    // two writes of half a period each make up one MI_AO frame
+    TEST_ASSERT_EQUAL_INT(PCM_SAMPLES / 2, snd_pcm_writei(NULL, pcm, PCM_SAMPLES / 2));
+    TEST_ASSERT_EQUAL_INT(PCM_SAMPLES / 2, snd_pcm_writei(NULL, (uint8_t *)pcm + (UT_PCM_LEN / 2), PCM_SAMPLES / 2));
+    while ((myalsa.queue.read != myalsa.queue.write) && (wait-- > 0)) {
+        usleep(1000);
+    }
+    TEST_ASSERT_TRUE(wait > 0);
+    TEST_ASSERT_EQUAL_INT(0, snd_pcm_close(NULL));
+    unsetenv(MI_ENV_WAV);
+
+    f = fopen(UT_WAV, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL_INT(sizeof(hdr), fread(hdr, 1, sizeof(hdr), f));
+    TEST_ASSERT_EQUAL_MEMORY("RIFF", hdr, 4);
+    TEST_ASSERT_EQUAL_MEMORY("WAVE", &hdr[8], 4);
+    TEST_ASSERT_EQUAL_UINT32(PCM_FREQ, hdr[24] | (hdr[25] << 8) | (hdr[26] << 16) | (hdr[27] << 24));
+    TEST_ASSERT_EQUAL_UINT32(UT_PCM_LEN, hdr[40] | (hdr[41] << 8) | (hdr[42] << 16) | (hdr[43] << 24));
+    TEST_ASSERT_EQUAL_INT(UT_PCM_LEN, fread(out, 1, UT_PCM_LEN, f));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(pcm, out, UT_PCM_LEN / 2);
+    fclose(f);
+    unlink(UT_WAV);
+
+    free(out);
+    free(pcm);
+}
+
+TEST_GROUP_RUNNER(mini)
+{
+    RUN_TEST_CASE(mini, GFX_Copy);
+    RUN_TEST_CASE(mini, snd_pcm_writei);
+}
+
+static void runAllTests(void)
+{
+    RUN_TEST_GROUP(mini);
+}
+
+int main(int argc, const char **argv)
+{
+    printf("\n");
+    return UnityMain(argc, argv, runAllTests);
+}